@@ -40,9 +40,12 @@ export type AQStatus = {
     doses: number[];
     sH: number[];
     sM: number[];
+    sch?: number[]; // [minuteOfWeek, centiMl] pairs, 0 = Sun 00:00
     fR: number;
     pwm: number;
   }>;
+  // Last calibration run finished (SSE "job"): measured on-time in ms
+  lastJob?: { job: number; pump: string; channel: number; plannedMs: number; ms: number };
 };
 
 export const api = (method: string, url: string, body?: any) => {
@@ -58,18 +61,20 @@ export const api = (method: string, url: string, body?: any) => {
     .catch((e) => console.error(e));
 };
 
-function AppContent() {
+function AppContent({ initialConfig }: { initialConfig: Partial<AQStatus> | null }) {
   const { t } = useT();
   const [tab, setTab] = useState<'home' | 'tpa' | 'ferts' | 'config'>('home');
-  const [status, setStatus] = useState<AQStatus | null>(null);
+  const [status, setStatus] = useState<AQStatus | null>(
+    initialConfig ? ({ stocks: [], ...initialConfig } as AQStatus) : null,
+  );
   const [wifiDot, setWifiDot] = useState(false);
 
   useEffect(() => {
-    // Initial fetch
-    fetch('/api/status')
+    // Initial fetch: only the live fields, configuration came with App
+    fetch('/api/live')
       .then((r) => r.json())
       .then((data) => {
-        setStatus(data);
+        setStatus((s) => ({ ...(s ?? ({ stocks: [] } as unknown as AQStatus)), ...data }));
         setWifiDot(true);
         if (data.wifiConnected !== undefined) {
           document.body.className = data.wifiConnected ? '' : 'ap-mode';
@@ -78,12 +83,14 @@ function AppContent() {
       })
       .catch(() => setWifiDot(false));
 
-    // SSE Real-time Updates
+    // SSE Real-time Updates: each event is a patch holding only the fields
+    // that changed ("live" every second and in full right after connecting,
+    // "config"/"stocks" on change; all three in full every minute)
     const evtSource = new EventSource('/events');
-    evtSource.addEventListener('status', (e) => {
+    const onPatch = (apply: (s: AQStatus, d: any) => AQStatus) => (e: Event) => {
       try {
-        const d = JSON.parse(e.data);
-        setStatus(d);
+        const d = JSON.parse((e as MessageEvent).data);
+        setStatus((s) => apply(s ?? ({ stocks: [] } as unknown as AQStatus), d));
         setWifiDot(true);
         if (d.wifiConnected !== undefined) {
           document.body.className = d.wifiConnected ? '' : 'ap-mode';
@@ -91,7 +98,26 @@ function AppContent() {
       } catch (err) {
         console.error(err);
       }
-    });
+    };
+    const merge = (s: AQStatus, d: any) => ({ ...s, ...d });
+    evtSource.addEventListener('live', onPatch(merge));
+    evtSource.addEventListener('config', onPatch(merge));
+    // Channels arrive keyed by index ("0".."N")
+    evtSource.addEventListener(
+      'stocks',
+      onPatch((s, d) => {
+        const stocks = [...(s.stocks || [])];
+        const rest: Record<string, any> = {};
+        for (const [k, v] of Object.entries(d)) {
+          if (/^\d+$/.test(k)) stocks[+k] = v as AQStatus['stocks'][number];
+          else rest[k] = v;
+        }
+        return { ...s, ...rest, stocks };
+      }),
+    );
+
+    // Calibration run finished (the POST replied 202 with its job id)
+    evtSource.addEventListener('job', onPatch((s, d) => ({ ...s, lastJob: d })));
 
     evtSource.onerror = () => setWifiDot(false);
 
@@ -153,27 +179,26 @@ function AppContent() {
 }
 
 function App() {
-  const [initialLang, setInitialLang] = useState<number | undefined>(undefined);
+  const [config, setConfig] = useState<Partial<AQStatus> | null>(null);
   const [ready, setReady] = useState(false);
 
   useEffect(() => {
-    fetch('/api/status')
+    // Configuration (language included) is cached by the controller and
+    // revalidated with its ETag: a reload usually gets a 304
+    fetch('/api/config')
       .then((r) => r.json())
       .then((d) => {
-        setInitialLang(d.language ?? 0);
+        setConfig(d);
         setReady(true);
       })
-      .catch(() => {
-        setInitialLang(0);
-        setReady(true);
-      });
+      .catch(() => setReady(true));
   }, []);
 
   if (!ready) return null;
 
   return (
-    <I18nProvider initialLang={initialLang}>
-      <AppContent />
+    <I18nProvider initialLang={config?.language ?? 0}>
+      <AppContent initialConfig={config} />
     </I18nProvider>
   );
 }
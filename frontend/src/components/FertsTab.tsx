@@ -154,10 +154,11 @@ export default function FertsTab({ status }: { status: AQStatus | null }) {
 
     if (!status?.stocks) return <div className="text-muted text-center p-4">{t('fert.loading')}</div>;
 
-    // Filter out channel 4 (Prime — controlled by TPA)
+    // Filter out the last channel (Prime — controlled by TPA)
+    const primeIndex = status.stocks.length - 1;
     const channels = status.stocks
         .map((s, i) => ({ s, i }))
-        .filter(c => c.i !== 4);
+        .filter(c => c.i !== primeIndex);
 
     return (
         <>
@@ -20,10 +20,11 @@ export default function HomeTab({ status }: { status: AQStatus | null }) {
     const renderFertTable = () => {
         if (!status?.stocks) return <div className="text-xs text-muted">{t('home.waiting')}</div>;
 
-        // Find stocks that have at least one dose > 0, excluding Prime (index 4)
+        // Find stocks that have at least one dose > 0, excluding Prime (last)
+        const primeIndex = status.stocks.length - 1;
         const activeStocks = status.stocks
             .map((s, idx) => ({ ...s, originalIndex: idx }))
-            .filter(s => s.originalIndex !== 4 && s.doses?.some(d => Number(d) > 0));
+            .filter(s => s.originalIndex !== primeIndex && s.doses?.some(d => Number(d) > 0));
 
         if (activeStocks.length === 0) {
             return (
@@ -120,10 +121,10 @@ export default function HomeTab({ status }: { status: AQStatus | null }) {
                     <h2 className="mb-4 text-base font-medium tracking-wide text-text/90 uppercase">{t('home.stockBars')}</h2>
                     <div className="flex items-end justify-around gap-2">
                         {status.stocks.map((s, i) => {
-                            if (i === 4) return null; // Skip Prime in this section
+                            if (i === status.stocks.length - 1) return null; // Skip Prime in this section
                             const pct = Math.min(100, Math.max(0, (s.stock / 500) * 100));
                             const colors = ['#00FFFF', '#FF00FF', '#FFFF00', '#FFA500'];
-                            const color = colors[i] || '#00FF00';
+                            const color = colors[i % colors.length];
                             const label = s.name || `F${i + 1}`;
                             return (
                                 <div key={i} className="flex flex-col items-center gap-1 flex-1 max-w-[60px]">
@@ -144,8 +145,8 @@ export default function HomeTab({ status }: { status: AQStatus | null }) {
                             );
                         })}
                         {/* Prime bar */}
-                        {status.stocks.length >= 5 && (() => {
-                            const s = status.stocks[4];
+                        {status.stocks.length >= 2 && (() => {
+                            const s = status.stocks[status.stocks.length - 1];
                             const pct = Math.min(100, Math.max(0, (s.stock / 500) * 100));
                             const color = '#00FF00';
                             return (
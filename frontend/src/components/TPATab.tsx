@@ -18,6 +18,7 @@ export default function TPATab({ status }: { status: AQStatus | null }) {
     const [drainMl, setDrainMl] = useState('');
     const [refillMl, setRefillMl] = useState('');
     const [running3s, setRunning3s] = useState<string | null>(null);
+    const [runJob, setRunJob] = useState(0);
 
     // Prime config modal
     const [showPrimeConfig, setShowPrimeConfig] = useState(false);
@@ -51,6 +52,27 @@ export default function TPATab({ status }: { status: AQStatus | null }) {
         api('POST', '/api/tpa/pump', { pump, state });
     };
 
+    // The controller replies 202 at once and reports the run over SSE
+    const handleRun3s = async (pump: 'drain' | 'refill') => {
+        setRunning3s(pump);
+        try {
+            const r = await fetch('/api/tpa/run3s', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify({ pump }) });
+            const d = await r.json();
+            if (d.error) throw new Error(d.error);
+            setRunJob(d.job);
+        } catch (e) {
+            alert((e as Error).message);
+            setRunning3s(null);
+        }
+    };
+
+    useEffect(() => {
+        if (runJob && status?.lastJob?.job === runJob) {
+            setRunning3s(null);
+            setRunJob(0);
+        }
+    }, [status?.lastJob, runJob]);
+
     return (
         <div className="flex flex-col gap-4 pb-4">
             {/* TPA SCHEDULING CARD */}
@@ -190,11 +212,7 @@ export default function TPATab({ status }: { status: AQStatus | null }) {
                     <label className="text-xs font-bold text-muted uppercase tracking-wider">{t('tpa.drainPump')}</label>
                     <div className="flex items-center gap-2">
                         <button
-                            onClick={async () => {
-                                setRunning3s('drain');
-                                await fetch('/api/tpa/run3s', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify({ pump: 'drain' }) });
-                                setRunning3s(null);
-                            }}
+                            onClick={() => handleRun3s('drain')}
                             disabled={running3s !== null}
                             className="flex-none rounded-md bg-accent/20 px-4 py-2 text-[10px] font-bold uppercase tracking-wider text-accent transition hover:bg-accent/30 active:scale-95 disabled:opacity-50"
                         >
@@ -228,11 +246,7 @@ export default function TPATab({ status }: { status: AQStatus | null }) {
                     <label className="text-xs font-bold text-muted uppercase tracking-wider">{t('tpa.refillPump')}</label>
                     <div className="flex items-center gap-2">
                         <button
-                            onClick={async () => {
-                                setRunning3s('refill');
-                                await fetch('/api/tpa/run3s', { method: 'POST', headers: { 'Content-Type': 'application/json' }, body: JSON.stringify({ pump: 'refill' }) });
-                                setRunning3s(null);
-                            }}
+                            onClick={() => handleRun3s('refill')}
                             disabled={running3s !== null}
                             className="flex-none rounded-md bg-accent/20 px-4 py-2 text-[10px] font-bold uppercase tracking-wider text-accent transition hover:bg-accent/30 active:scale-95 disabled:opacity-50"
                         >
@@ -262,16 +276,16 @@ export default function TPATab({ status }: { status: AQStatus | null }) {
                 </div>
             </div>
 
-            {/* PRIME (CH5) CONFIGURATION */}
-            {status?.stocks && status.stocks.length >= 5 && (
-                <FertCard index={4} s={status.stocks[4]} onConfig={() => setShowPrimeConfig(true)} />
+            {/* PRIME CONFIGURATION (last channel) */}
+            {status?.stocks && status.stocks.length >= 2 && (
+                <FertCard index={status.stocks.length - 1} s={status.stocks[status.stocks.length - 1]} onConfig={() => setShowPrimeConfig(true)} />
             )}
 
             {/* Prime Config Modal */}
-            {showPrimeConfig && status?.stocks && status.stocks.length >= 5 && (
+            {showPrimeConfig && status?.stocks && status.stocks.length >= 2 && (
                 <FertConfigModal
-                    index={4}
-                    s={status.stocks[4]}
+                    index={status.stocks.length - 1}
+                    s={status.stocks[status.stocks.length - 1]}
                     onClose={() => setShowPrimeConfig(false)}
                 />
             )}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/// What a timed job switches
+enum class JobTarget : uint8_t {
+  PIN = 0, // GPIO actuator (drain/refill pump); index = pin
+  FERT,    // Fert channel, prime included; index = channel
+};
+
+/// @brief Timed actuator runs (the calibration "run 3 s" buttons).
+///
+/// start() switches the output on, arms a one-shot esp_timer to switch it
+/// off and returns at once with a job id, so a web handler never holds the
+/// async_tcp task for the length of the run. The on-time is measured from
+/// the switch-on to the switch-off call, timer latency included, and
+/// handed with the job to the completion callback by poll(), which also
+/// stops overdue jobs if the timer could not be created or fires late.
+///
+/// Outputs are switched through a caller-supplied function (ActuatorLog,
+/// FertManager), called outside the lock: from the caller of start() and
+/// from the esp_timer task or poll() for the stop. The function may refuse
+/// the switch-on (the output is owned elsewhere); start() then fails.
+class ActuatorJobs {
+public:
+  enum class State : uint8_t {
+    FREE = 0, // Slot unused, or completion already delivered
+    RUNNING,  // Output on, stop timer armed
+    STOPPING, // Claimed by one stopper, output being switched off
+    DONE,     // Output off; completion not yet delivered by poll()
+  };
+
+  struct Job {
+    uint32_t id;
+    JobTarget target;
+    uint8_t index;
+    State state;
+    uint32_t plannedMs;
+    uint32_t actualUs; // Measured on-time once stopped
+    int64_t startUs;
+    int64_t stopAtUs;
+  };
+
+  /// @return false to refuse a switch-on; ignored for the switch-off
+  typedef bool (*SwitchFn)(JobTarget target, uint8_t index, bool on,
+                           void *ctx);
+  /// Called from poll() (owner task, not the timer task)
+  typedef void (*DoneFn)(const Job &job, void *ctx);
+
+  ActuatorJobs();
+  ~ActuatorJobs();
+
+  void setSwitch(SwitchFn fn, void *ctx) {
+    _switchFn = fn;
+    _switchCtx = ctx;
+  }
+  void setDoneCallback(DoneFn fn, void *ctx) {
+    _doneFn = fn;
+    _doneCtx = ctx;
+  }
+
+  /// Switch the target on for ms and arm its stop.
+  /// @return job id (never 0); 0 if the target already has a job running,
+  ///         every slot is taken, no switch function is set or the switch
+  ///         function refused
+  uint32_t start(JobTarget target, uint8_t index, uint32_t ms);
+
+  /// True while a job holds the target on
+  bool isRunning(JobTarget target, uint8_t index) const;
+  uint8_t getRunningCount() const;
+
+  /// Stop overdue jobs (timer fallback) and deliver completions.
+  /// Call regularly from the loop.
+  void poll();
+
+private:
+  Job _jobs[ACTUATOR_JOB_SLOTS];
+  uint32_t _nextId;
+  SwitchFn _switchFn;
+  void *_switchCtx;
+  DoneFn _doneFn;
+  void *_doneCtx;
+  esp_timer_handle_t _timer;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  static void _onTimer(void *arg);
+  void _stopDue(int64_t nowUs);
+  void _arm(int64_t nowUs);
+  /// _mux held: a job (running or stopping) owns the target
+  bool _busyLocked(JobTarget target, uint8_t index) const;
+};
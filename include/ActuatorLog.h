@@ -0,0 +1,106 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+class CounterStore;
+
+/// @brief Runtime accounting for the OUTPUT_PINS actuators (fert pumps,
+/// prime, drain, refill, solenoid, canister SSR). Every switch goes through
+/// write() (GPIO) or note() (pins driven by LEDC), which timestamp on/off
+/// edges with esp_timer and keep, per actuator, the lifetime on-time, the
+/// number of off → on cycles and the last ACTUATOR_HISTORY on-durations.
+/// A pump needing longer runs for the same job (worn peristaltic tubing,
+/// a slowing drain pump) shows as recent runs above the lifetime average.
+///
+/// write()/note() are static so any module, ISR or timer callback can use
+/// them without a pointer; they update the instance constructed last (the
+/// firmware has one) under a spinlock and are allocation-free. Repeated
+/// writes of the same level are not counted as edges.
+///
+/// Lifetime totals go to the EEPROM counter store (NVS if it is not in
+/// use) at most every ACTUATOR_SAVE_INTERVAL_MS; the on-duration history
+/// is RAM only.
+class ActuatorLog {
+public:
+  struct Stats {
+    bool on;
+    uint64_t onMs;      // Lifetime on-time, running stretch included
+    uint32_t cycles;    // Lifetime off → on switches
+    uint32_t currentMs; // Running stretch (0 if off)
+    uint8_t recent;     // Valid entries in recentMs
+    uint32_t recentMs[ACTUATOR_HISTORY]; // Last finished runs, newest first
+
+    uint32_t recentAvgMs() const;
+    uint32_t lifetimeAvgMs() const;
+  };
+
+  ActuatorLog();
+  ~ActuatorLog();
+
+  /// Load the persisted totals (EEPROM bank, else NVS). Edges seen before
+  /// begin() (boot-time pin setup) are kept.
+  void begin();
+
+  /// Persist the totals once ACTUATOR_SAVE_INTERVAL_MS has passed (loop,
+  /// under ControlLock: the counter store is shared with fert saves)
+  void update();
+
+  /// Persist now (I2C/NVS: not from an ISR; under ControlLock)
+  void save();
+
+  void setCounterStore(CounterStore *store) { _counters = store; }
+
+  /// digitalWrite() plus edge accounting for OUTPUT_PINS entries
+  static void IRAM_ATTR write(uint8_t pin, uint8_t level);
+
+  /// Account an on/off change of a pin driven by a peripheral (LEDC duty)
+  static void IRAM_ATTR note(uint8_t pin, bool on);
+
+  /// Index in OUTPUT_PINS, -1 if the pin is not an actuator
+  static int8_t IRAM_ATTR indexOf(uint8_t pin);
+
+  /// Short label ("fert1", "drain", ...)
+  static const char *getName(uint8_t idx);
+
+  /// Consistent copy of one actuator's counters
+  Stats getStats(uint8_t idx) const;
+
+  /// Human-readable table on Serial
+  void printReport() const;
+
+  /// Append all actuators as a JSON array to out
+  void appendJSON(String &out) const;
+
+private:
+  // Persisted per actuator (EEPROM bank / NVS blob)
+  struct __attribute__((packed)) Saved {
+    uint32_t onS;
+    uint32_t cycles;
+  };
+
+  struct Actuator {
+    bool on;
+    int64_t sinceUs; // esp_timer time of the last off → on edge
+    uint64_t onUs;   // Finished runs only
+    uint32_t cycles;
+    uint32_t recentMs[ACTUATOR_HISTORY];
+    uint8_t head; // Next recentMs slot
+    uint8_t recent;
+  };
+
+  static ActuatorLog *_active;
+
+  Actuator _act[NUM_OUTPUT_PINS];
+  CounterStore *_counters;
+  Preferences _prefs;
+  unsigned long _lastSaveMs;
+  unsigned long _lastMirrorMs;
+  Saved _nvsCopy[NUM_OUTPUT_PINS]; // Last totals written to NVS
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  void _edge(uint8_t idx, bool on, int64_t nowUs);
+  void _snapshot(Saved *out) const;
+  void _writeNvs(const Saved *rec);
+};
@@ -45,6 +45,7 @@ constexpr unsigned long DISPLAY_TIMEOUT_MS = 30UL * 1000; // 30s auto-off
 
 // --- I2C (DS3231 RTC) ---
 // Using ESP32 default I2C: SDA=21, SCL=22
+constexpr uint32_t I2C_CLOCK_HZ = 400000; // DS3231 + AT24C32 fast mode
 
 // ============================================================================
 // ALL OUTPUT PINS (for batch initialization)
@@ -55,9 +56,26 @@ constexpr uint8_t OUTPUT_PINS[] = {PIN_FERT1,  PIN_FERT2,    PIN_FERT3,
 constexpr uint8_t NUM_OUTPUT_PINS =
     sizeof(OUTPUT_PINS) / sizeof(OUTPUT_PINS[0]);
 
+// Outputs switched on by a LOW level (the canister SSR input)
+constexpr bool isActiveLowPin(uint8_t pin) { return pin == PIN_CANISTER; }
+
 // Fertilizer pin array for indexed access
 constexpr uint8_t FERT_PINS[] = {PIN_FERT1, PIN_FERT2, PIN_FERT3, PIN_FERT4};
-constexpr uint8_t NUM_FERTS = 4;
+constexpr uint8_t NUM_FERTS = 4; // Fert channels; the prime pump is one more
+
+// -- Fert pump outputs --
+// LEDC drives FERT_PINS + PIN_PRIME straight from the ESP32. PCA9685 drives
+// channel i (prime = NUM_FERTS) on expander output i, 16 per chip at
+// consecutive addresses, for builds with more channels than free GPIOs.
+enum class FertOutput : uint8_t { LEDC, PCA9685 };
+constexpr FertOutput FERT_OUTPUT = FertOutput::LEDC;
+constexpr uint32_t FERT_LEDC_FREQ_HZ = 5000;
+constexpr uint8_t PCA9685_I2C_ADDR = 0x40;
+constexpr uint16_t PCA9685_PWM_HZ = 1000; // Pump MOSFETs, like LEDC
+
+static_assert(FERT_OUTPUT != FertOutput::LEDC ||
+                  sizeof(FERT_PINS) == NUM_FERTS,
+              "LEDC output needs one FERT_PINS entry per channel");
 
 // ============================================================================
 // TIMING & SAFETY CONSTANTS
@@ -72,6 +90,20 @@ constexpr unsigned long TIMEOUT_FERT_MS = 30UL * 1000;              // 30 sec
 constexpr unsigned long TIMEOUT_EMERGENCY_MS = 3UL * 60 * 1000;     // 3 min
 constexpr unsigned long MAINTENANCE_DURATION_MS = 30UL * 60 * 1000; // 30 min
 
+// Timer-driven dosing (pump stopped by an esp_timer one-shot)
+constexpr unsigned long DOSE_STOP_GRACE_MS = 1000; // Past cap → TPA error
+
+// Parallel dosing budget (defaults; tunable via `dosing` / /api/fert/power)
+constexpr uint8_t DOSE_MAX_CONCURRENT = 3;        // Pumps on at once
+constexpr uint16_t DOSE_CURRENT_BUDGET_MA = 1000; // PSU share, 0 = no limit
+constexpr uint16_t DOSE_PUMP_CURRENT_MA = 300;    // Per pump at full duty
+
+// Predictive drain/refill cut-off (time-to-target projection + one-shot timer)
+constexpr unsigned long TPA_CUTOFF_ARM_WINDOW_MS = 3000; // Arm when ETA below
+constexpr unsigned long TPA_CUTOFF_LEAD_MS = 150;    // Relay + pump coast-down
+constexpr unsigned long TPA_CUTOFF_SETTLE_MS = 1500; // Surface settle, confirm
+constexpr float TPA_CUTOFF_TOLERANCE_CM = 0.5f;      // Short by more → resume
+
 // Volumes and flow
 constexpr float DEFAULT_DOSE_ML = 5.0f;      // Default dose per fertilizer
 constexpr float DEFAULT_PRIME_ML = 10.0f;    // Default Prime dose
@@ -87,6 +119,25 @@ constexpr float ULTRASONIC_MAX_DISTANCE_CM = 400.0f;
 constexpr uint8_t ULTRASONIC_SAMPLES = 5; // Median filter samples
 constexpr unsigned long ULTRASONIC_PULSE_TIMEOUT_US =
     30000; // 30 ms echo timeout
+constexpr unsigned long ULTRASONIC_PING_INTERVAL_MS =
+    30; // Background sampler: one ping every 30 ms
+constexpr unsigned long ULTRASONIC_WINDOW_MS =
+    (ULTRASONIC_SAMPLES + 1) * ULTRASONIC_PING_INTERVAL_MS; // Filter window
+constexpr unsigned long LEVEL_SAMPLE_MAX_AGE_MS =
+    200; // Callers reuse a cached level sample up to this age
+
+// -- Level estimator (alpha-beta filter over individual pings) --
+constexpr float LEVEL_EST_ALPHA = 0.35f;     // Position gain
+constexpr float LEVEL_EST_BETA = 0.02f;      // Rate gain
+constexpr float LEVEL_EST_GATE_CM = 2.0f;    // Larger residual = outlier
+constexpr uint8_t LEVEL_EST_MAX_REJECTS = 3; // Outliers in a row → re-seed
+constexpr uint8_t LEVEL_EST_WARMUP = 5;      // Samples to full confidence
+constexpr unsigned long LEVEL_EST_STALE_MS =
+    2000; // Confidence decays to 0 without new samples
+constexpr float LEVEL_EST_MIN_CONFIDENCE =
+    0.5f; // Below this, predictions fall back to the filtered level
+constexpr unsigned long LEVEL_PREDICT_HORIZON_MS =
+    250; // Look-ahead for pump cut-off (cache age + one control tick)
 
 // -- Water levels (distance from sensor in cm — lower distance = higher water)
 constexpr float LEVEL_SAFETY_MIN_CM = 5.0f;     // Overflow alert
@@ -102,4 +153,124 @@ constexpr uint8_t DEFAULT_FERT_MINUTE = 0;
 
 // -- Loop timing --
 constexpr unsigned long TELEMETRY_INTERVAL_MS = 10000;  // 10s
-constexpr unsigned long SAFETY_CHECK_INTERVAL_MS = 500; // 500ms
+
+// -- Adaptive sensor sampling (SafetyWatchdog picks a policy per mode) --
+// Check = safety-check period; pings = ultrasonic pings per check (the
+// sampler pings every check/pings ms, floored at ULTRASONIC_PING_INTERVAL_MS)
+constexpr uint16_t SAMPLING_IDLE_CHECK_MS = 2000; // Outputs off, level steady
+constexpr uint8_t SAMPLING_IDLE_PINGS = 3;
+constexpr uint16_t SAMPLING_ACTIVE_CHECK_MS = 250; // Drain/refill/solenoid on
+constexpr uint8_t SAMPLING_ACTIVE_PINGS = 5;
+constexpr uint16_t SAMPLING_EMERGENCY_CHECK_MS = 100; // Emergency drain
+constexpr uint8_t SAMPLING_EMERGENCY_PINGS = 3;
+constexpr uint16_t SAMPLING_MIN_CHECK_MS = 50; // Control task period
+constexpr uint16_t SAMPLING_MAX_CHECK_MS = 10000;
+constexpr float SAMPLING_STABLE_RATE_CM_S =
+    0.05f; // Idle only while the level moves slower than this
+
+// -- FreeRTOS tasks --
+// Control task (safety + TPA) preempts loopTask (prio 1) and AsyncTCP (prio 3)
+// A tick holds ControlLock, which web handlers wait on. It does not block on
+// the ultrasonic sensor: a fallback burst (sampler stalled) is taken before
+// the lock (SafetyWatchdog::prefetchBurst()).
+constexpr unsigned long CONTROL_TASK_PERIOD_MS = 50; // Fixed control tick
+constexpr uint8_t CONTROL_TASK_PRIORITY = 5;
+constexpr uint8_t CONTROL_TASK_CORE = 1; // loopTask core, away from WiFi
+constexpr uint32_t CONTROL_TASK_STACK = 6144;
+// Notification task: Pushsafer HTTPS can block for 15 s, so it runs alone
+constexpr uint8_t NOTIFY_TASK_PRIORITY = 1;
+constexpr uint8_t NOTIFY_TASK_CORE = 0;
+constexpr uint32_t NOTIFY_TASK_STACK = 8192;
+constexpr uint8_t NOTIFY_QUEUE_LEN = 8;
+// Task watchdog: control task and loopTask must each check in within this
+constexpr uint32_t TASK_WDT_TIMEOUT_S = 5;
+
+// -- Loop profiler --
+constexpr uint8_t PERF_MAX_STAGES = 8;
+constexpr uint8_t PERF_HIST_BUCKETS =
+    20; // Bucket b holds durations in [2^(b-1), 2^b) us; last one ≥ 262 ms
+
+// -- Loop scheduler (loopTask jobs; safety runs in the control task) --
+constexpr uint8_t SCHED_MAX_JOBS = 10;
+constexpr uint32_t SCHED_MAX_SLEEP_MS = 500; // Longest idle between checks
+constexpr uint32_t SCHED_SERIAL_PERIOD_MS = 50;
+constexpr uint32_t SCHED_DISPLAY_PERIOD_MS = 50; // Button debounce needs this
+constexpr uint32_t SCHED_WEB_PERIOD_MS = 100;
+constexpr uint32_t SCHED_DOSING_PERIOD_MS = 100; // Dose completion delivery
+constexpr uint32_t SCHED_TPA_BOOKKEEPING_PERIOD_MS = 250;
+constexpr uint32_t SCHED_CALENDAR_PERIOD_MS = 1000; // Fert/TPA/report checks
+constexpr uint32_t SCHED_TIME_PERIOD_MS = 1000;
+constexpr uint32_t SCHED_WIFI_RETRY_PERIOD_MS = 30000;
+
+// -- Event agenda (fert, TPA and report schedules) --
+constexpr uint8_t AGENDA_CAPACITY =
+    NUM_FERTS + 4; // Fert channels + prime, TPA, daily report, midnight
+constexpr uint32_t AGENDA_LATE_GRACE_S =
+    900; // Events found later than this are skipped as missed
+
+// -- Fert NVS layout --
+// Channel config is one CRC-checked blob; stock and last-dose counters keep
+// their own keys. Bump the version when FertManager::ConfigBlob changes.
+constexpr uint16_t FERT_CFG_MAGIC = 0x4643; // "FC"
+constexpr uint8_t FERT_CFG_VERSION = 2;     // 1 = per-day dose + time
+// Weekly plan entries per channel (two doses a day). Part of the blob
+// layout: changing it needs a version bump.
+constexpr uint8_t FERT_SCHEDULE_SLOTS = 14;
+
+// -- Dose journal (LittleFS) --
+// Fixed-size records appended to numbered segment files; the oldest segment
+// is deleted once JOURNAL_MAX_SEGMENTS exist.
+constexpr const char *JOURNAL_DIR = "/journal";
+constexpr uint16_t JOURNAL_SEGMENT_ENTRIES = 512; // 12 KB per segment
+constexpr uint8_t JOURNAL_MAX_SEGMENTS = 8; // ~4000 doses: months of history
+
+// -- Counter EEPROM (AT24C32 on the DS3231 module) --
+// High-churn counters rotate through 32-byte page slots instead of NVS: each
+// bank owns COUNTER_SLOTS_PER_BANK pages and every update takes the next one.
+constexpr uint8_t EEPROM_I2C_ADDR = 0x57;
+constexpr uint16_t EEPROM_SIZE = 4096;
+constexpr uint8_t EEPROM_PAGE_SIZE = 32;
+constexpr uint32_t EEPROM_WRITE_CYCLE_MS = 10; // Busy (NACKs) after a write
+constexpr uint16_t COUNTER_MAGIC = 0x4354; // "CT"
+constexpr uint8_t COUNTER_VERSION = 1;
+constexpr uint8_t COUNTER_MAX_BANKS = 8;
+constexpr uint8_t COUNTER_SLOTS_PER_BANK = 15; // (128 pages - header) / 8
+constexpr uint32_t COUNTER_NVS_MIRROR_MS =
+    24UL * 3600 * 1000; // Refresh the NVS fallback copy at most this often
+
+// -- Actuator accounting (on-time, cycles per OUTPUT_PINS entry) --
+constexpr uint8_t ACTUATOR_HISTORY = 8; // Last on-durations kept per output
+constexpr uint32_t ACTUATOR_SAVE_INTERVAL_MS =
+    10UL * 60 * 1000; // Totals persisted at most this often (power loss)
+
+// -- Settings registry (aqua, notify and pumpcal NVS namespaces) --
+// Each namespace is one CRC-checked record alternating between two keys.
+// Edits are committed once they pause, or after the longest deferral.
+constexpr uint16_t SETTINGS_MAGIC = 0x5352; // "SR"
+constexpr uint32_t SETTINGS_COMMIT_DELAY_MS = 3000; // Quiet time before commit
+constexpr uint32_t SETTINGS_COMMIT_MAX_MS = 15000;  // Longest deferral
+constexpr uint16_t SETTINGS_RECORD_MAX = 512; // Bytes per namespace record
+
+// -- TPA checkpoint (resume a cycle interrupted by a reset) --
+// Held in RTC slow memory and mirrored to NVS ("tpa"/"ckpt") on every state
+// change; the mirror only matters after a power loss.
+constexpr uint16_t TPA_CKPT_MAGIC = 0x5443; // "TC"
+
+// -- Web status JSON (SSE payload, built into one static buffer) --
+// SSE topics: "live" on a fixed period, "config"/"stocks" when changed.
+// Events are patches; every topic is resent in full on the resync period.
+constexpr uint32_t WEB_SSE_LIVE_MS = 1000;
+constexpr uint32_t WEB_SSE_RESYNC_MS = 60000;
+constexpr size_t WEB_STATUS_JSON_MAX = 4096; // ~3 KB with full fert schedules
+// /api/config body kept in RAM between setter changes (streamed if larger)
+constexpr size_t WEB_CONFIG_JSON_MAX = 3584;
+
+// -- Web request bodies (JSON, reassembled when split across TCP chunks) --
+constexpr size_t WEB_BODY_MAX = 1024;        // Full fert schedule ~450 bytes
+constexpr uint8_t WEB_BODY_SLOTS = 2;        // Chunked bodies in flight
+constexpr uint32_t WEB_BODY_STALE_MS = 5000; // Slot of a dropped request
+
+// -- Timed actuator jobs (calibration runs started from the web) --
+constexpr uint8_t ACTUATOR_JOB_SLOTS = 4;     // Runs in flight
+constexpr uint32_t CALIBRATION_RUN_MS = 3000; // "Run 3 s" on-time
+constexpr uint32_t WEB_RESTART_DELAY_MS = 500; // Reply sent before a restart
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+/// @brief RAII guard for the control path (SafetyWatchdog + WaterManager +
+/// TPA actuators). The control task holds it for each tick; loop() and web
+/// handlers take it before mutating control state so a tick never observes a
+/// half-applied command. Recursive, so nested guards are safe.
+class ControlLock {
+public:
+  ControlLock() {
+    if (_mutex())
+      xSemaphoreTakeRecursive(_mutex(), portMAX_DELAY);
+  }
+  ~ControlLock() {
+    if (_mutex())
+      xSemaphoreGiveRecursive(_mutex());
+  }
+
+  ControlLock(const ControlLock &) = delete;
+  ControlLock &operator=(const ControlLock &) = delete;
+
+  /// Create the mutex — call once in setup() before starting tasks
+  static void init() {
+    if (!_mutex())
+      _mutex() = xSemaphoreCreateRecursiveMutex();
+  }
+
+private:
+  static SemaphoreHandle_t &_mutex() {
+    static SemaphoreHandle_t m = nullptr;
+    return m;
+  }
+};
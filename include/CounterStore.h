@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <Preferences.h> // ESP32 NVS (store id + fallback flag)
+#include <Wire.h>
+
+/// Counter groups kept in the EEPROM, one record (≤ MAX_RECORD bytes) each
+enum class CounterBank : uint8_t {
+  FERT_STOCK = 0, // float[channels] mL left
+  FERT_LAST_DOSE, // uint32_t[channels] dose keys (date key * 1440 + minute)
+  FERT_RUNTIME,   // uint32_t[channels] total pump on-time (ms)
+  TPA_LAST_RUN,   // uint32_t epoch
+  ACTUATORS,      // {on-time s, cycles}[NUM_OUTPUT_PINS] (ActuatorLog)
+};
+
+/// @brief Wear-rotated counter store in the DS3231 module's AT24C32 EEPROM.
+///
+/// Page 0 holds a header with a random store id; each bank owns
+/// COUNTER_SLOTS_PER_BANK pages. An update writes the whole record to the
+/// bank's next slot {seq, bank, len, payload, padding, crc}: one page for
+/// up to 22 bytes (a 5-channel fert record), more for larger channel
+/// counts. Slots rotate through the bank, so the pages share the writes,
+/// and a write torn by a power cut only loses that update (the previous
+/// slot still has the highest valid seq). The CRC is seeded with the store
+/// id, so slots left by an earlier id are ignored without erasing them.
+/// Slots carry their own length: a record written with another size (a
+/// different channel count) is still found and reported by
+/// getBankLength().
+///
+/// NVS stays the fallback. begin() trusts the EEPROM only if its id matches
+/// the one recorded in NVS and no counter went to NVS since (EEPROM missing
+/// at boot, or a failed write); otherwise it starts a fresh id and the
+/// owners reseed their banks from NVS (readBank() returns false).
+///
+/// I2C access is synchronous; call from one task at a time (loop task or
+/// under ControlLock), like the owners' NVS writes it replaces.
+class CounterStore {
+public:
+  /// Largest record: slots of at most half a bank keep a previous copy
+  static constexpr uint16_t MAX_RECORD =
+      COUNTER_SLOTS_PER_BANK / 2 * EEPROM_PAGE_SIZE - 10;
+
+  CounterStore();
+
+  /// Probe the EEPROM, check the header against NVS and scan every bank
+  /// for its newest slot (~4 KB read, boot only).
+  /// @return true if the EEPROM is present and usable
+  bool begin(TwoWire &wire, uint8_t addr = EEPROM_I2C_ADDR);
+
+  bool isReady() const { return _ready; }
+
+  /// Read the newest record of a bank (one I2C read of its slot).
+  /// @return false if the bank has no record of exactly len bytes under
+  ///         this store id
+  bool readBank(CounterBank bank, void *data, size_t len);
+
+  /// Size of the bank's newest record, 0 if none
+  size_t getBankLength(CounterBank bank) const;
+
+  /// Write a record to the bank's next slot. An unchanged record is not
+  /// rewritten. On an I2C error the store stops being ready and NVS is
+  /// flagged as newer, so the caller must persist to NVS instead.
+  bool writeBank(CounterBank bank, const void *data, size_t len);
+
+  // ---- Stats ----
+  uint32_t getStoreId() const { return _id; }
+  uint32_t getWriteCount() const { return _writes; }
+  uint32_t getBankSeq(CounterBank bank) const;
+  void printReport() const;
+
+private:
+  // Slot start; the payload follows, and the last 4 bytes of the slot's
+  // last page are a CRC-32 (seeded with the store id) of everything before
+  struct __attribute__((packed)) SlotHead {
+    uint32_t seq;
+    uint8_t bank;
+    uint8_t len;
+  };
+
+  struct __attribute__((packed)) Header {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t banks;
+    uint8_t slotsPerBank;
+    uint8_t reserved[3];
+    uint32_t id;
+    uint32_t crc;
+  };
+
+  struct Bank {
+    uint32_t seq;     // 0 = no record
+    uint8_t page;     // First page of the newest record within the bank
+    uint8_t pages;    // Its slot size
+    uint16_t len;
+    uint32_t dataCrc; // Payload CRC, to skip unchanged rewrites
+  };
+
+  TwoWire *_wire;
+  uint8_t _addr;
+  bool _ready;
+  uint32_t _id;
+  uint32_t _writes;
+  uint32_t _lastWriteMs;
+  Bank _banks[COUNTER_MAX_BANKS];
+
+  bool _format(Preferences &prefs);
+  void _scanBanks();
+  static uint8_t _pagesFor(size_t len);
+  static uint16_t _pageAddr(uint8_t bank, uint8_t page);
+  void _markNvsNewer();
+
+  // ---- AT24C32 access ----
+  bool _waitReady();
+  bool _readBytes(uint16_t addr, void *data, size_t len);
+  bool _writePage(uint16_t addr, const void *data, size_t len);
+};
@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// CRC-32 (IEEE 802.3, reflected, poly 0xEDB88320) used to validate blobs
+/// persisted to NVS. Pass a previous result as `crc` to continue a running
+/// checksum over several buffers.
+uint32_t crc32(const void *data, size_t len, uint32_t crc = 0);
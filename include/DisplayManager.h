@@ -9,7 +9,8 @@
 // Forward declarations
 class TimeManager;
 class WaterManager;
-class FertManager;
+template <uint8_t N> class FertManagerT;
+using FertManager = FertManagerT<NUM_FERTS>;
 class SafetyWatchdog;
 class WebManager;
 
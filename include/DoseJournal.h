@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <FS.h>
+
+/// @brief Append-only log of every completed dose on LittleFS.
+///
+/// Records are fixed-size and CRC-checked, written to segment files of
+/// JOURNAL_SEGMENT_ENTRIES each (JOURNAL_DIR/00042.jnl, ...). A segment is
+/// only ever appended to and the oldest one is deleted as a whole, so a
+/// power cut can at worst tear the final record: begin() keeps the valid
+/// prefix and starts a fresh segment. The RAM time index holds the epoch
+/// range of each segment, so a range query skips whole segments and
+/// bisects into a time-ordered one instead of reading the full history.
+///
+/// append() is called from the dosing job; queries may run concurrently
+/// from a web handler (index access is guarded, file I/O is not held under
+/// the lock).
+class DoseJournal {
+public:
+  enum class Result : uint8_t {
+    OK = 0,
+    ABORTED, // Stopped early; deliveredMl is pro-rata
+  };
+
+  static constexpr uint8_t FLAG_SCHEDULED = 0x01; // vs. TPA Prime / manual
+  static constexpr uint8_t ALL_CHANNELS = 0xFF;
+
+  struct __attribute__((packed)) Record {
+    uint32_t epoch;      // Dose start, RTC local epoch
+    uint32_t durationMs; // Measured pump on-time
+    float requestedMl;   // After the timeout cap
+    float deliveredMl;
+    uint8_t channel; // 0..NUM_FERTS (NUM_FERTS = Prime)
+    uint8_t pwm;
+    uint8_t result; // Result
+    uint8_t flags;
+    uint32_t crc; // CRC-32 of the bytes above
+  };
+
+  /// Range query state; survives between read() calls so a caller can
+  /// stream results in small batches
+  struct Query {
+    uint32_t from, to; // Inclusive epoch range
+    uint8_t channel;   // ALL_CHANNELS or one channel
+    uint16_t seq;      // Segment being read
+    uint16_t pos;      // Next record in that segment
+    bool started;      // seq/pos are valid
+    bool seek;         // Bisect to `from` on the next read
+    bool done;
+  };
+
+  DoseJournal();
+
+  /// Scan the segment files and build the time index. Creates `dir`.
+  /// @return false if the directory cannot be used
+  bool begin(fs::FS &fs, const char *dir = JOURNAL_DIR);
+
+  /// Append one record (CRC is filled in). Rotates segments as needed.
+  bool append(Record rec);
+
+  /// Start a query over [from, to] for one channel or ALL_CHANNELS
+  void beginQuery(Query &q, uint32_t from, uint32_t to,
+                  uint8_t channel = ALL_CHANNELS) const;
+
+  /// Fill up to max matching records, oldest first.
+  /// @return records written; 0 only once the query is done
+  size_t read(Query &q, Record *out, size_t max);
+
+  static bool isValid(const Record &rec);
+  static const char *resultName(uint8_t result);
+
+  // ---- Stats ----
+  uint8_t getSegmentCount() const { return _segCount; }
+  uint32_t getEntryCount() const;
+  uint32_t getOldestEpoch() const;
+  uint32_t getNewestEpoch() const;
+  bool isReady() const { return _fs != nullptr; }
+
+private:
+  struct Segment {
+    uint16_t seq;
+    uint16_t count;    // Valid records
+    uint32_t minEpoch; // Time index
+    uint32_t maxEpoch;
+    bool sorted; // Epochs never go backwards (bisect allowed)
+    bool sealed; // Full or torn tail: never appended to again
+  };
+
+  fs::FS *_fs;
+  char _dir[24];
+  Segment _segs[JOURNAL_MAX_SEGMENTS]; // Oldest first
+  uint8_t _segCount;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  void _path(uint16_t seq, char *buf, size_t len) const;
+  static bool _parseName(const char *name, uint16_t &seq);
+  bool _scanSegment(uint16_t seq, Segment &seg);
+  void _openSegment();
+  int _findSegment(uint16_t seq) const;
+  void _enterSegment(Query &q, int idx) const;
+  size_t _readSegment(Query &q, const Segment &seg, Record *out, size_t max);
+  static uint16_t _lowerBound(fs::File &f, uint16_t count, uint32_t epoch);
+};
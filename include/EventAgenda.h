@@ -0,0 +1,87 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+
+/// What an agenda entry triggers
+enum class AgendaKind : uint8_t {
+  FERT_DOSE = 0, // arg = channel
+  TPA,
+  DAILY_REPORT,
+  NEW_DAY, // Midnight: reset daily notification counters
+};
+
+const char *agendaKindName(AgendaKind kind);
+
+/// How late an event was when it was taken off the agenda
+enum class AgendaTiming : uint8_t {
+  ON_TIME = 0, // Within its scheduled minute
+  LATE,        // Past its minute but within AGENDA_LATE_GRACE_S: still runs
+  MISSED,      // Beyond the grace window: skipped and reported
+};
+
+struct AgendaEvent {
+  uint32_t dueEpoch; // Local time (RTC epoch), always on a minute boundary
+  AgendaKind kind;
+  uint8_t arg;
+};
+
+/// @brief Precomputed schedule: a binary min-heap of the next due time of
+/// every scheduled job (fert channels, TPA, daily report, midnight reset).
+/// The owner rebuilds it only when a schedule changes and re-arms a job
+/// after it fires, so each loop pass is a single O(1) look at the head
+/// instead of matching every schedule against the current minute. Events
+/// found past their minute (loop blocked, RTC jumped) are classified as
+/// late or missed rather than silently skipped.
+class EventAgenda {
+public:
+  EventAgenda();
+
+  void clear();
+
+  /// Add an event. dueEpoch 0 means "never" and is ignored.
+  /// @return false if the agenda is full or dueEpoch is 0
+  bool push(uint32_t dueEpoch, AgendaKind kind, uint8_t arg = 0);
+
+  /// O(1): is the earliest event due at nowEpoch?
+  bool isDue(uint32_t nowEpoch) const {
+    return _count > 0 && _heap[0].dueEpoch <= nowEpoch;
+  }
+
+  /// Earliest event, or nullptr if empty
+  const AgendaEvent *peek() const { return _count ? &_heap[0] : nullptr; }
+
+  /// Remove the earliest event if it is due, classifying its lateness.
+  /// Late and missed events are counted and logged.
+  bool popDue(uint32_t nowEpoch, AgendaEvent &out, AgendaTiming &timing);
+
+  uint8_t size() const { return _count; }
+
+  /// Copy of the entries in due order (for reports)
+  uint8_t snapshot(AgendaEvent *out, uint8_t maxCount) const;
+
+  uint32_t getLateCount() const { return _lateCount; }
+  uint32_t getMissedCount() const { return _missedCount; }
+  /// Last missed event (dueEpoch 0 if none yet)
+  const AgendaEvent &getLastMissed() const { return _lastMissed; }
+
+  /// Next time at or after fromEpoch with the given hour:minute
+  static uint32_t nextDaily(uint32_t fromEpoch, uint8_t hour, uint8_t minute);
+
+  /// Next time at or after fromEpoch matching a per-weekday time
+  /// (index 0 = Sunday). Days whose bit is clear in dayMask are skipped.
+  /// @return 0 if no day is enabled
+  static uint32_t nextWeekly(uint32_t fromEpoch, const uint8_t hour[7],
+                             const uint8_t minute[7], uint8_t dayMask = 0x7F);
+
+private:
+  AgendaEvent _heap[AGENDA_CAPACITY];
+  uint8_t _count;
+  uint32_t _lateCount;
+  uint32_t _missedCount;
+  AgendaEvent _lastMissed;
+
+  static bool _before(const AgendaEvent &a, const AgendaEvent &b);
+  void _siftUp(uint8_t i);
+  void _siftDown(uint8_t i);
+};
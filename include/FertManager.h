@@ -1,58 +1,191 @@
 #pragma once
 
 #include "Config.h"
+#include "PumpOutput.h"
 #include <Arduino.h>
 #include <Preferences.h> // ESP32 NVS
-#include <RTClib.h>
+#include <RTClib.h>      // DateTime
+#include <esp_timer.h>
 
-/// @brief Manages fertilizer dosing with NVS deduplication and stock tracking.
-#pragma once
+class CounterStore;
 
-#include "Config.h"
-#include <Arduino.h>
-#include <Preferences.h> // ESP32 NVS
-#include <RTClib.h>      // DateTime
+/// Dose engine types, shared by every channel count
+struct FertDosing {
+  enum class DoseState : uint8_t {
+    IDLE = 0, // Never dosed, or completion already delivered
+    QUEUED,   // Accepted, waiting for a free slot in the power budget
+    RUNNING,  // Pump on, stop timer armed
+    DONE,     // Pump stopped; completion not yet delivered by pollDoses()
+  };
+
+  struct DoseStatus {
+    DoseState state;
+    float ml;           // Volume planned (after the timeout cap)
+    float deliveredMl;  // Pro-rata volume once stopped
+    uint32_t plannedUs; // Pump on-time needed for ml
+    uint32_t actualUs;  // Measured on-time once stopped
+    uint32_t waitUs;    // Time spent QUEUED before the pump started
+    bool scheduled;     // Started by the schedule (vs. TPA Prime)
+    bool aborted;       // Stopped early by stopDose()
+  };
+
+  /// Called from pollDoses() (owner task, not the timer task)
+  typedef void (*DoseDoneFn)(uint8_t ch, const DoseStatus &status, void *ctx);
+
+  /// Pumps running back to back or in parallel, from the first start until
+  /// nothing is running or queued
+  struct DoseWindow {
+    int64_t startUs; // esp_timer_get_time() of the first pump start
+    int64_t endUs;   // Last pump stop (0 while the window is open)
+    uint8_t doses;
+    uint8_t peakPumps;
+    uint16_t peakMA;
+    float ml;
+  };
+
+  /// One bit per channel (prime included)
+  typedef uint32_t ChannelMask;
+
+  /// One entry of a channel's weekly plan, as stored and sent
+  struct __attribute__((packed)) DoseSlot {
+    uint16_t minuteOfWeek; // day * 1440 + hour * 60 + minute, 0 = Sun 00:00
+    uint16_t centiMl;      // Dose in 0.01 mL (0 = time kept, no dose)
+  };
+  static constexpr uint16_t MINUTES_PER_WEEK = 7 * 1440;
+};
 
 /// @brief Manages fertilizer dosing with NVS deduplication and stock tracking.
-class FertManager {
+///
+/// N is the number of fert channels; the prime pump is channel N. Arrays,
+/// the NVS blob, the EEPROM counter records and the JSON/display views all
+/// follow it. The firmware uses FertManager (N = NUM_FERTS); member
+/// definitions live in FertManager.cpp, instantiated for the counts built.
+template <uint8_t N> class FertManagerT : public FertDosing {
+  static_assert(N >= 1 && N + 1 <= 32, "channel masks are 32-bit");
+
 public:
-  FertManager();
+  static constexpr uint8_t CHANNELS = N + 1; // Ferts + prime
+
+  FertManagerT();
+  ~FertManagerT();
 
   /// Initialize NVS and load saved state
   void begin();
 
-  /// Check schedule and dose if needed. Should be called periodically.
-  /// @param now Current DateTime from TimeManager
-  void update(DateTime now);
+  /// Keep stock, last-dose and runtime counters in the EEPROM counter store
+  /// instead of NVS (call before begin(); nullptr = NVS only). Setters
+  /// that save reach the store: callers outside the loop hold ControlLock.
+  void setCounterStore(CounterStore *store) { _counters = store; }
+
+  /// Drive the pumps through another backend, e.g. a PCA9685 expander
+  /// (call before begin(); nullptr = native LEDC on FERT_PINS + PIN_PRIME)
+  void setOutput(PumpOutput *out) { _out = out; }
+
+  /// Run one channel's scheduled dose for the day of `due` (once per day;
+  /// skipped if stock is short). Dispatched by the event agenda.
+  void runScheduledDose(uint8_t ch, DateTime due);
+
+  /// Next scheduled dose of a channel at or after fromEpoch (RTC local
+  /// epoch). Days with a zero dose are skipped; 0 if no day doses.
+  uint32_t nextDoseEpoch(uint8_t ch, uint32_t fromEpoch) const;
+
+  /// Bumped whenever doses or dose times change (agenda rebuild trigger)
+  uint32_t getScheduleRevision() const { return _schedRev; }
+
+  /// Bumped whenever a per-channel value shown by the dashboard changes
+  /// (config, schedule, stock, pump on-time)
+  uint32_t getStateRevision() const { return _stateRev; }
+
+  // ---- Non-blocking dosing engine ----
+  /// Start the pump and arm a one-shot timer to stop it after ml/flow, or
+  /// queue the dose if the power budget is full (it starts as soon as a
+  /// running pump stops, or until a manual run on the channel ends).
+  /// Returns at once; the volume is taken from stock up front (refunded
+  /// pro-rata if the dose is aborted).
+  /// @param ch Channel index 0..N-1 (fertilizers) or N (prime)
+  /// @return false if the channel is invalid, busy (including two finished
+  ///         doses not yet delivered by pollDoses()), or ml <= 0
+  bool startDose(uint8_t ch, float ml);
+
+  /// Stop a running dose early, or drop it from the queue
+  void stopDose(uint8_t ch);
+  void stopAllDoses();
+
+  /// True while the dose is running or queued
+  bool isDosing(uint8_t ch) const;
+  bool isAnyDosing() const;
+  DoseStatus getDoseStatus(uint8_t ch) const;
 
-  /// Manually dose a specific channel
-  /// @param ch Channel index 0-3 (fertilizers) or 4 (prime)
-  /// @param ml Volume in mL
-  /// @return true if dosing completed without timeout
-  bool doseChannel(uint8_t ch, float ml);
+  // ---- Power budget (parallel dosing) ----
+  /// @param maxConcurrent Pumps allowed on at once (1..N+1)
+  /// @param budgetMA PSU current for the pumps, 0 = no current limit
+  void setDoseBudget(uint8_t maxConcurrent, uint16_t budgetMA);
+  uint8_t getMaxConcurrent() const { return _maxConcurrent; }
+  uint16_t getCurrentBudgetMA() const { return _budgetMA; }
+  /// Pump current at full duty; the load counted is mA × pwm / 255
+  void setPumpCurrentMA(uint8_t ch, uint16_t mA);
+  uint16_t getPumpCurrentMA(uint8_t ch) const {
+    return (ch <= N) ? _pumpMA[ch] : 0;
+  }
+  uint16_t getLoadMA(uint8_t ch) const;
+  uint8_t getRunningCount() const;
+  uint8_t getQueuedCount() const;
+  /// Current window if one is open, else the last finished one
+  DoseWindow getDoseWindow() const;
+  bool isDoseWindowOpen() const;
+
+  /// Completion listener for every dose (one per manager)
+  void setDoseCallback(DoseDoneFn fn, void *ctx) {
+    _doneFn = fn;
+    _doneCtx = ctx;
+  }
+
+  /// Deliver completions (stock refunds, callback) and stop any overdue
+  /// pump if the timer is unavailable. Call regularly from the loop.
+  void pollDoses();
 
   /// Manually turn the pump ON or OFF for priming the line
   void manualPump(uint8_t ch, bool state);
 
-  // ---- Dose volumes (per day of week, 0=Sun..6=Sat) ----
+  /// Timed manual run (calibration): switch the pump on and hold the
+  /// channel, so a dose that comes due is queued instead of cutting the
+  /// run short.
+  /// @return false if the channel is dosing, queued or already held
+  bool beginManualRun(uint8_t ch);
+  /// Switch the pump off and release the channel; a dose queued meanwhile
+  /// starts now. Safe from the esp_timer task.
+  void endManualRun(uint8_t ch);
+  bool isManualRun(uint8_t ch) const;
+
+  // ---- Weekly plan (sorted DoseSlot table per channel, NVS) ----
+  /// Replace a channel's plan (any order; several doses a day allowed)
+  /// @return false if count > FERT_SCHEDULE_SLOTS, a minute is past the
+  ///         week or appears twice
+  bool setSchedule(uint8_t ch, const DoseSlot *slots, uint8_t count);
+  uint8_t getScheduleCount(uint8_t ch) const {
+    return (ch <= N) ? _schedCount[ch] : 0;
+  }
+  DoseSlot getScheduleSlot(uint8_t ch, uint8_t i) const;
+
+  // ---- Per-day view of the plan (day of week, 0=Sun..6=Sat) ----
+  /// Set the day to one dose at its first entry's time (default time if
+  /// the day has none); split doses that day are merged into it
   void setDoseML(uint8_t ch, uint8_t dayOfWeek, float ml);
+  /// Total of the day's doses
   float getDoseML(uint8_t ch, uint8_t dayOfWeek) const;
 
-  // ---- Scheduling Config per day of week (NVS) ----
+  /// Move the day's first entry (added with no dose if the day has none)
   void setScheduleTime(uint8_t ch, uint8_t day, uint8_t hour, uint8_t minute);
   /// Set same time for all 7 days (convenience)
   void setScheduleTimeAll(uint8_t ch, uint8_t hour, uint8_t minute);
-  uint8_t getSchedHour(uint8_t ch, uint8_t day) const {
-    return (ch <= NUM_FERTS && day < 7) ? _schedHour[ch][day] : 0;
-  }
-  uint8_t getSchedMinute(uint8_t ch, uint8_t day) const {
-    return (ch <= NUM_FERTS && day < 7) ? _schedMinute[ch][day] : 0;
-  }
+  /// Time of the day's first entry (the default time if it has none)
+  uint8_t getSchedHour(uint8_t ch, uint8_t day) const;
+  uint8_t getSchedMinute(uint8_t ch, uint8_t day) const;
 
   // ---- Flow Rate Calibration (NVS) ----
   void setFlowRate(uint8_t ch, float mlPerSec);
   float getFlowRate(uint8_t ch) const {
-    return (ch <= NUM_FERTS) ? _flowRateMLps[ch] : 1.5f;
+    return (ch <= N) ? _flowRateMLps[ch] : 1.5f;
   }
 
   // ---- Stock tracking ----
@@ -68,15 +201,25 @@ public:
   // ---- PWM Control (NVS) ----
   void setPWM(uint8_t ch, uint8_t pwm);
   uint8_t getPWM(uint8_t ch) const {
-    return (ch <= NUM_FERTS) ? _pwm[ch] : 255;
+    return (ch <= N) ? _pwm[ch] : 255;
   }
 
   // ---- Custom Names (NVS) ----
-  String getName(uint8_t ch) const;
+  const String &getName(uint8_t ch) const;
   void setName(uint8_t ch, const String &name);
 
-  /// Save stock levels and names to NVS
+  /// Total pump on-time of a channel across all doses (ms)
+  uint32_t getPumpRuntimeMs(uint8_t ch) const {
+    return (ch <= N) ? _pumpRunMs[ch] : 0;
+  }
+
+  /// Write whatever changed since the last save: the config blob if any
+  /// setting changed, and the counters that moved (EEPROM bank, or the
+  /// NVS key of each channel whose value moved)
   void saveState();
+  bool isDirty() const {
+    return _cfgDirty || _stockDirty || _lastDoseDirty || _runtimeDirty;
+  }
 
   /// Was today's dose already applied?
   bool wasDosedToday(DateTime now) const;
@@ -84,34 +227,163 @@ public:
 private:
   Preferences _prefs;
 
-  // Dose volumes per channel (CH1-CH4 ferts + CH5 prime)
-  // [Channel][DayOfWeek] where 0 = Sunday, 6 = Saturday
-  float _doseML[NUM_FERTS + 1][7];
+  // Weekly plan per channel (N ferts + prime), sorted by minute of week
+  DoseSlot _sched[N + 1][FERT_SCHEDULE_SLOTS];
+  uint8_t _schedCount[N + 1];
 
   // Remaining stock per channel
-  float _stockML[NUM_FERTS + 1];
+  float _stockML[N + 1];
 
   // Custom names per channel
-  String _names[NUM_FERTS + 1];
+  String _names[N + 1];
 
-  // Last dose date (day of year * 1000 + year) for dedup (per channel)
-  uint32_t _lastDoseKey[NUM_FERTS + 1];
+  // Last dose run, as _doseKey() (date key * 1440 + minute of day), for
+  // dedup (per channel)
+  uint32_t _lastDoseKey[N + 1];
 
-  // Low stock warning threshold per channel (mL)
-  float _lowStockThreshold[NUM_FERTS + 1];
+  // Total pump on-time per channel (ms)
+  uint32_t _pumpRunMs[N + 1];
 
-  // Schedule config (per day of week: 0=Sun..6=Sat)
-  uint8_t _schedHour[NUM_FERTS + 1][7];
-  uint8_t _schedMinute[NUM_FERTS + 1][7];
+  // Low stock warning threshold per channel (mL)
+  float _lowStockThreshold[N + 1];
 
   // Calibrated flow rate (mL per second)
-  float _flowRateMLps[NUM_FERTS + 1];
+  float _flowRateMLps[N + 1];
 
   // PWM Configuration (0-255)
-  uint8_t _pwm[NUM_FERTS + 1];
+  uint8_t _pwm[N + 1];
+
+  uint32_t _schedRev;
+  uint32_t _stateRev;
+
+  // ---- Persistence ----
+  // Everything but the counters, as stored under the "cfg" key: a header,
+  // one ChannelConfig per channel (prime last) and a tail. Packed so the
+  // layout does not depend on compiler padding; the channel count in the
+  // header lets a blob written by a build with another N be remapped.
+  struct __attribute__((packed)) ChannelConfig {
+    uint8_t slots; // Entries used in sched
+    DoseSlot sched[FERT_SCHEDULE_SLOTS];
+    float flowRate;
+    float lowStock;
+    uint16_t pumpMA;
+    uint8_t pwm;
+    char name[16];
+  };
+  // Version 1: one dose and time per day; read once to migrate
+  struct __attribute__((packed)) ChannelConfigV1 {
+    float doseML[7];
+    uint8_t schedHour[7];
+    uint8_t schedMinute[7];
+    float flowRate;
+    float lowStock;
+    uint16_t pumpMA;
+    uint8_t pwm;
+    char name[16];
+  };
+  struct __attribute__((packed)) BlobHeader {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t channels;
+  };
+  struct __attribute__((packed)) BlobTail {
+    uint8_t maxConcurrent;
+    uint16_t budgetMA;
+    uint32_t crc; // CRC-32 of every byte before it
+  };
+  struct __attribute__((packed)) ConfigBlob {
+    BlobHeader head;
+    ChannelConfig ch[N + 1];
+    BlobTail tail;
+  };
+  uint8_t _storedChannels; // Channel count of the blob found at boot
+  bool _cfgDirty;
+  ChannelMask _stockDirty;
+  ChannelMask _lastDoseDirty;
+  bool _runtimeDirty;
+  CounterStore *_counters;
+  unsigned long _lastMirrorMs; // Last full NVS copy of EEPROM counters
+
+  void _markConfigDirty() {
+    _cfgDirty = true;
+    _stateRev++;
+  }
+  void _markStockDirty(uint8_t ch) {
+    _stockDirty |= (ChannelMask)1 << ch;
+    _stateRev++;
+  }
+  void _saveCounters();
+  void _loadCounters();
+  /// Convert dose keys stored as plain date keys (before per-minute dedup)
+  void _upgradeDoseKeys();
+  static constexpr uint32_t LEGACY_DOSE_KEY_LIMIT = 10000000; // Year < 10000
+  bool _loadConfigBlob();
+  void _loadLegacyConfig();
+  bool _saveConfigBlob();
+  void _removeLegacyKeys();
+
+  // Dosing engine: one one-shot timer serves all channels, always armed for
+  // the earliest pending stop
+  struct Dose {
+    DoseStatus status;
+    int64_t queuedUs;
+    int64_t startUs;
+    int64_t stopAtUs;
+    uint32_t seq; // Queue order
+  };
+  Dose _doses[N + 1];
+  // Finished dose displaced by a new one on the channel before pollDoses()
+  // delivered it; DONE while pending
+  DoseStatus _undelivered[N + 1];
+  uint32_t _doseSeq;
+  ChannelMask _held; // Channels owned by a manual run: doses wait
+  uint8_t _maxConcurrent;
+  uint16_t _budgetMA;
+  uint16_t _pumpMA[N + 1];
+  DoseWindow _window;
+  bool _windowOpen;
+  bool _windowReported;
+  esp_timer_handle_t _doseTimer;
+  DoseDoneFn _doneFn;
+  void *_doneCtx;
+  mutable portMUX_TYPE _doseMux = portMUX_INITIALIZER_UNLOCKED;
+
+  static void _onDoseTimer(void *arg);
+  /// Stop every RUNNING channel whose time is up, then start queued ones
+  void _stopDue(int64_t nowUs);
+  /// Start queued doses (oldest first) that fit the budget. Call with
+  /// _doseMux held; returns the channels to switch on.
+  ChannelMask _promoteQueuedLocked(int64_t nowUs);
+  void _closeWindowIfIdleLocked(int64_t nowUs);
+  void _switchOn(ChannelMask mask);
+  uint16_t _activeLoadMA() const;
+  void _armDoseTimer(int64_t nowUs);
+  /// Refund, runtime and completion callback of one finished dose
+  void _deliverDose(uint8_t ch, const DoseStatus &st);
 
   /// Compute unique key for a date (for NVS dedup)
   uint32_t _dateKey(DateTime dt) const;
+  /// Key of one dose minute; grows with time, so one key covers "this
+  /// and every earlier dose"
+  uint32_t _doseKey(DateTime dt) const;
+
+  // ---- Plan table helpers ----
+  static uint16_t _minuteOfWeek(DateTime dt);
+  static uint16_t _toCentiMl(float ml);
+  /// Sorted, no duplicate minute, all inside the week, fits the table
+  static bool _planValid(const DoseSlot *slots, uint8_t count);
+  /// First entry at or after minuteOfWeek (count if none)
+  uint8_t _lowerBound(uint8_t ch, uint16_t minuteOfWeek) const;
+  /// Insert keeping the order; false if full or the minute is taken
+  bool _insertSlot(uint8_t ch, DoseSlot slot);
+  void _removeSlot(uint8_t ch, uint8_t i);
+  /// Rebuild a plan from one dose and time per day (legacy layouts)
+  void _setPlanFromDays(uint8_t ch, const float doseML[7],
+                        const uint8_t hour[7], const uint8_t minute[7]);
+  /// Move the day's first entry to hour:minute (setScheduleTime)
+  /// @return true if the plan changed
+  bool _moveDayStart(uint8_t ch, uint8_t day, uint8_t hour, uint8_t minute);
+  void _planChanged();
 
   /// Load state from NVS
   void _loadState();
@@ -119,6 +391,11 @@ private:
   /// Mark today as dosed for a channel in NVS
   void _markDosed(uint8_t ch, DateTime now);
 
-  /// Get the GPIO pin for a channel (0-3 = fert, 4 = prime)
-  uint8_t _pinForChannel(uint8_t ch) const;
+  // Pump outputs: _out if set, else the built-in LEDC backend
+  PumpOutput *_out;
+  LedcPumpOutput _ledc;
+  PumpOutput &_output() { return _out ? *_out : _ledc; }
 };
+
+using FertManager = FertManagerT<NUM_FERTS>;
+extern template class FertManagerT<NUM_FERTS>;
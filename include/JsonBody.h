@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+
+enum class JsonType : uint8_t { INT, FLOAT, STRING, FLOAT_ARRAY };
+
+/// @brief One expected member of a request body.
+///
+/// Outputs are left untouched unless the member is present with a usable
+/// value, so callers preset them to their "missing" value (-1 for the web
+/// handlers). true/false are read as 1/0 by INT and FLOAT fields; null and
+/// values of another type count as missing. An array holding anything but
+/// numbers is missing too, though elements before the first non-number may
+/// already be stored.
+struct JsonField {
+  const char *key;
+  JsonType type;
+  void *out;
+  uint16_t cap;   // STRING: buffer bytes incl. NUL; FLOAT_ARRAY: elements
+  uint16_t count; // STRING: bytes stored; FLOAT_ARRAY: elements in the body
+  bool found;
+
+  static JsonField integer(const char *key, int &out) {
+    return {key, JsonType::INT, &out, 0, 0, false};
+  }
+  static JsonField number(const char *key, float &out) {
+    return {key, JsonType::FLOAT, &out, 0, 0, false};
+  }
+  /// Decoded UTF-8, cut to size - 1 bytes and NUL-terminated
+  static JsonField string(const char *key, char *out, uint16_t size) {
+    return {key, JsonType::STRING, out, size, 0, false};
+  }
+  /// count is the length of the array in the body: elements past cap are
+  /// not stored, so count > cap tells a caller the array was too long
+  static JsonField array(const char *key, float *out, uint16_t cap) {
+    return {key, JsonType::FLOAT_ARRAY, out, cap, 0, false};
+  }
+};
+
+/// @brief Fill a field table from a JSON object in one pass.
+///
+/// Walks len bytes (no NUL terminator needed) without copying them or
+/// touching the heap. Members not in the table, nested objects included,
+/// are skipped; a duplicate member overwrites the earlier one.
+/// @return false if the body is not a well-formed JSON object (fields
+///         matched before the error keep their values)
+bool jsonParseObject(const uint8_t *body, size_t len, JsonField *fields,
+                     uint8_t fieldCount);
+
+/// @brief Reassembles request bodies that arrive in several chunks.
+///
+/// A body delivered in one chunk is handed back in place. A longer one is
+/// copied into one of WEB_BODY_SLOTS fixed slots of WEB_BODY_MAX bytes,
+/// keyed by its request; a slot left by a dropped connection is reclaimed
+/// after WEB_BODY_STALE_MS. Not thread-safe: feed from one task (the async
+/// TCP task for the web server).
+class BodyArena {
+public:
+  enum Result : uint8_t {
+    PARTIAL,   // Stored, more chunks to come
+    COMPLETE,  // body/bodyLen hold the whole body
+    TOO_LARGE, // First chunk of a body over WEB_BODY_MAX: reply 413
+    BUSY,      // First chunk, every slot in use: reply 503
+    DROPPED    // Later chunk of a rejected body: ignore
+  };
+
+  BodyArena();
+
+  /// Hand over one chunk (arguments of the body handler). On COMPLETE the
+  /// slot is already free: body stays valid until the next feed().
+  Result feed(const void *owner, const uint8_t *data, size_t len,
+              size_t index, size_t total, unsigned long nowMs,
+              const uint8_t *&body, size_t &bodyLen);
+
+  uint8_t slotsInUse() const;
+
+private:
+  struct Slot {
+    const void *owner; // nullptr = free
+    unsigned long startMs;
+    size_t filled;
+    uint8_t data[WEB_BODY_MAX];
+  };
+  Slot _slots[WEB_BODY_SLOTS];
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <Arduino.h>
+
+/// @brief Cuts a JSON object down to the top-level members that changed
+/// since the previous call.
+///
+/// Each member ("key":value, as written) is hashed (FNV-1a) and compared
+/// with the hash stored for its position; unchanged members are dropped
+/// in place, so the object sent next is a patch the client merges into
+/// what it has. Members past MAX_MEMBERS are always kept. reset() makes
+/// the next call keep everything (full resync).
+///
+///   JsonWriter w(buf, sizeof(buf));
+///   writeTopic(w);
+///   size_t n = delta.filter(buf, w.length());
+///   if (n) send(buf);
+class JsonDelta {
+public:
+  static constexpr uint8_t MAX_MEMBERS = 40;
+
+  JsonDelta() { reset(); }
+
+  /// Rewrite the object in json (len bytes, as produced by JsonWriter) to
+  /// its changed members. NUL-terminated when there is room.
+  /// @return length of the patch; 0 if nothing changed or json is not an
+  ///         object
+  size_t filter(char *json, size_t len);
+
+  void reset() {
+    _count = 0;
+    _primed = false;
+  }
+
+private:
+  uint32_t _hash[MAX_MEMBERS];
+  uint8_t _count;  // Members seen last time
+  bool _primed;    // _hash holds a previous document
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <Arduino.h>
+
+/// @brief Streaming JSON writer that never touches the heap.
+///
+/// Tokens are formatted straight into a caller-owned buffer (NUL-terminated,
+/// truncation flagged by overflowed()) or into a Print such as an
+/// AsyncResponseStream. Commas are inserted from a per-depth bit, so
+/// callers only say what comes next:
+///
+///   JsonWriter w(buf, sizeof(buf));
+///   w.beginObject().field("level", 12.5f, 1).beginArray("doses");
+///   for (...) w.value(ml, 1);
+///   w.endArray().endObject();
+///
+/// Numbers are formatted by hand (no printf, no String); a NaN or infinite
+/// float is written as null. Strings are escaped. Nesting depth is limited
+/// to JSON_MAX_DEPTH.
+class JsonWriter {
+public:
+  static constexpr uint8_t JSON_MAX_DEPTH = 31;
+
+  /// Write into buf (size includes the terminating NUL)
+  JsonWriter(char *buf, size_t size);
+
+  /// Write through out (nothing is buffered here)
+  explicit JsonWriter(Print &out);
+
+  JsonWriter &beginObject();
+  JsonWriter &endObject();
+  JsonWriter &beginArray();
+  JsonWriter &endArray();
+  JsonWriter &beginObject(const char *k) { return key(k).beginObject(); }
+  JsonWriter &beginArray(const char *k) { return key(k).beginArray(); }
+
+  /// Member name; the next call writes its value
+  JsonWriter &key(const char *k);
+
+  JsonWriter &value(bool v);
+  JsonWriter &value(int v) { return _int(v); }
+  JsonWriter &value(long v) { return _int(v); }
+  JsonWriter &value(long long v) { return _int(v); }
+  JsonWriter &value(unsigned v) { return _uint(v); }
+  JsonWriter &value(unsigned long v) { return _uint(v); }
+  JsonWriter &value(unsigned long long v) { return _uint(v); }
+  /// Fixed-point, decimals capped at 6 (|v| * 10^decimals below 1.8e19)
+  JsonWriter &value(float v, uint8_t decimals = 2);
+  JsonWriter &value(const char *s);
+  JsonWriter &value(const String &s) { return value(s.c_str()); }
+  JsonWriter &nullValue();
+
+  /// Pre-built JSON text written as one value
+  JsonWriter &raw(const char *json);
+
+  /// key(k).value(v)
+  template <typename T> JsonWriter &field(const char *k, T v) {
+    return key(k).value(v);
+  }
+  JsonWriter &field(const char *k, float v, uint8_t decimals) {
+    return key(k).value(v, decimals);
+  }
+
+  /// Buffer mode: text so far. Always NUL-terminated.
+  const char *c_str() const { return _buf ? _buf : ""; }
+  /// Characters produced (buffer mode: stored; Print mode: written)
+  size_t length() const { return _len; }
+  /// Buffer too small: the text is cut and not valid JSON
+  bool overflowed() const { return _overflow; }
+
+  /// Start over on the same buffer or Print
+  void reset();
+
+private:
+  char *_buf;
+  size_t _size;
+  Print *_out;
+  size_t _len;
+  bool _overflow;
+  bool _afterKey;   // A key was written: no comma before its value
+  uint8_t _depth;
+  uint32_t _filled; // Bit d: depth d already holds an element
+
+  JsonWriter &_int(long long v);
+  JsonWriter &_uint(unsigned long long v);
+  void _separator();
+  void _put(const char *s, size_t n);
+  void _put(char c) { _put(&c, 1); }
+  void _putDigits(unsigned long long v, uint8_t minDigits = 1);
+  void _putEscaped(const char *s);
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+
+/// @brief Streaming alpha-beta filter for the ultrasonic water level.
+/// Keeps a filtered distance (cm) and its rate of change (cm/s) across
+/// samples; each update is O(1) with no buffering or sorting. Residuals
+/// larger than LEVEL_EST_GATE_CM are treated as outliers; if
+/// LEVEL_EST_MAX_REJECTS arrive in a row the level really moved and the
+/// filter re-seeds on the newest sample.
+class LevelEstimator {
+public:
+  LevelEstimator();
+
+  /// Forget all state (next sample seeds the filter)
+  void reset();
+
+  /// Feed one raw distance sample taken at tMs.
+  /// @return false if the sample was rejected as an outlier
+  bool update(float cm, uint32_t tMs);
+
+  bool isValid() const { return _valid; }
+
+  /// Filtered distance (cm) at the last accepted sample; -1 if none
+  float level() const { return _valid ? _x : -1.0f; }
+
+  /// Rate of change (cm/s). Negative = distance shrinking = water rising.
+  float rate() const { return _valid ? _v : 0.0f; }
+
+  /// Extrapolated distance (cm) at tMs
+  float predict(uint32_t tMs) const;
+
+  /// 0..1 — combines warm-up, residual noise, recent outliers and age
+  float confidence(uint32_t nowMs) const;
+
+  /// Timestamp (ms) of the last accepted sample
+  uint32_t lastUpdateMs() const { return _tMs; }
+
+private:
+  float _x;          // Filtered distance (cm)
+  float _v;          // Rate (cm/s)
+  float _residAvg;   // Running mean of |residual| (cm)
+  uint32_t _tMs;     // Time of last accepted sample
+  uint8_t _accepted; // Samples since seed (saturates at LEVEL_EST_WARMUP)
+  uint8_t _rejects;  // Consecutive outliers
+  bool _valid;
+
+  void _seed(float cm, uint32_t tMs);
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/// @brief Per-stage timing for a periodic task. Each stage keeps
+/// min/avg/max and a log2 histogram of its duration (esp_timer us); each
+/// iteration's stage times are summed so the slowest iteration is kept with
+/// its per-stage breakdown. Recording is O(1) and allocation-free; the writer
+/// is the owning task, readers (serial, web) take snapshots under a spinlock.
+class LoopProfiler {
+public:
+  struct StageStats {
+    uint32_t count;
+    uint32_t minUs;
+    uint32_t maxUs;
+    uint32_t lastUs;
+    uint64_t totalUs;
+    uint32_t hist[PERF_HIST_BUCKETS];
+
+    uint32_t avgUs() const { return count ? (uint32_t)(totalUs / count) : 0; }
+  };
+
+  struct Iteration {
+    uint32_t totalUs;
+    uint32_t atMs; // millis() when the iteration ended
+    uint32_t stageUs[PERF_MAX_STAGES];
+  };
+
+  /// @param name        label used in reports ("loop", "control")
+  /// @param stageNames  one label per stage (must outlive the profiler)
+  LoopProfiler(const char *name, const char *const *stageNames,
+               uint8_t stageCount);
+
+  /// Mark the start/end of one task iteration
+  void beginIteration();
+  void endIteration();
+
+  /// Add one measured duration for stage
+  void record(uint8_t stage, uint32_t us);
+
+  /// Clear all statistics
+  void reset();
+
+  const char *getName() const { return _name; }
+  uint8_t getStageCount() const { return _stageCount; }
+  const char *getStageName(uint8_t stage) const { return _stageNames[stage]; }
+
+  /// Consistent copies for reporting
+  StageStats getStage(uint8_t stage) const;
+  Iteration getWorst() const;
+  uint32_t getIterations() const;
+
+  /// Histogram bucket for a duration
+  static uint8_t bucketFor(uint32_t us);
+
+  /// Human-readable table on Serial
+  void printReport() const;
+
+  /// Append this profiler as a JSON object to out (no trailing comma)
+  void appendJSON(String &out) const;
+
+private:
+  const char *_name;
+  const char *const *_stageNames;
+  uint8_t _stageCount;
+
+  StageStats _stages[PERF_MAX_STAGES];
+  Iteration _current;
+  Iteration _worst;
+  uint32_t _iterations;
+  int64_t _iterStartUs;
+  bool _inIteration;
+
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+/// @brief RAII stage timer: records the time between construction and
+/// destruction against one profiler stage.
+class PerfScope {
+public:
+  PerfScope(LoopProfiler &prof, uint8_t stage)
+      : _prof(prof), _stage(stage), _startUs(esp_timer_get_time()) {}
+  ~PerfScope() {
+    _prof.record(_stage, (uint32_t)(esp_timer_get_time() - _startUs));
+  }
+
+  PerfScope(const PerfScope &) = delete;
+  PerfScope &operator=(const PerfScope &) = delete;
+
+private:
+  LoopProfiler &_prof;
+  uint8_t _stage;
+  int64_t _startUs;
+};
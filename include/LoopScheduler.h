@@ -0,0 +1,76 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+
+/// @brief Cooperative deadline scheduler for loopTask. Each job has a period,
+/// a priority and a deadline (max start lateness after its release). runDue()
+/// runs every due job once, highest priority first (earliest release breaks
+/// ties); msUntilNext() tells the caller how long it may sleep. A job that
+/// starts more than deadlineMs after its release, or whose releases were
+/// skipped because it fell a whole period behind, counts as a deadline miss.
+class LoopScheduler {
+public:
+  typedef void (*JobFn)();
+
+  struct JobStats {
+    const char *name;
+    uint32_t periodMs;
+    uint32_t deadlineMs;
+    uint8_t priority;
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t maxLateMs; // Worst start lateness after release
+    uint32_t lastRunMs; // millis() of the last start
+  };
+
+  LoopScheduler();
+
+  /// Register a job, first due immediately.
+  /// @param priority    higher runs first (FreeRTOS convention)
+  /// @param deadlineMs  allowed start lateness; 0 = one period
+  /// @return job id, or -1 if the table is full or the period is 0
+  int8_t addJob(const char *name, JobFn fn, uint32_t periodMs,
+                uint8_t priority, uint32_t deadlineMs = 0);
+
+  /// Release a job now instead of at its next period boundary
+  void trigger(int8_t id);
+
+  /// Run every job that is due, each at most once
+  /// @return number of jobs run
+  uint8_t runDue();
+
+  /// Time until the earliest release (0 = something is due), capped at
+  /// SCHED_MAX_SLEEP_MS so the loop still checks in with the TWDT
+  uint32_t msUntilNext() const;
+
+  uint8_t getJobCount() const { return _count; }
+  JobStats getJob(uint8_t id) const;
+  uint32_t getTotalMisses() const;
+
+  /// Clear run/miss counters (schedule is kept)
+  void resetStats();
+
+  /// Human-readable table on Serial
+  void printReport() const;
+
+  /// Append the job table as a JSON array to out
+  void appendJSON(String &out) const;
+
+private:
+  struct Job {
+    JobStats stats;
+    JobFn fn;
+    uint32_t nextMs; // Next release (millis)
+  };
+
+  Job _jobs[SCHED_MAX_JOBS];
+  uint8_t _count;
+
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  /// Signed difference that survives millis() wrap-around
+  static int32_t _since(uint32_t now, uint32_t then) {
+    return (int32_t)(now - then);
+  }
+};
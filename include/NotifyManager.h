@@ -4,6 +4,13 @@
 #include "NotifyStrings.h"
 #include <Arduino.h>
 
+class SettingsStore;
+
+#ifndef UNIT_TEST
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#endif
+
 /// @brief Notification event types (each has independent cooldown)
 enum NotifyType : uint8_t {
   NOTIFY_TPA_COMPLETE = 0,
@@ -21,9 +28,18 @@ class NotifyManager {
 public:
   NotifyManager();
 
-  /// Initialize — load config from NVS
+  /// Initialize — load config from the settings registry
   void begin();
 
+  /// Registry holding the "notify" settings (call before begin()). Without
+  /// it the configuration is kept in RAM only.
+  void setSettings(SettingsStore *settings) { _settings = settings; }
+
+  /// Start the background delivery task. After this, notify*() calls only
+  /// enqueue and return; the HTTPS round-trip runs on NOTIFY_TASK_CORE.
+  /// Before (or without) it, sends stay synchronous.
+  void startTask();
+
   /// Call from loop — checks if daily report should be sent
   void update(uint8_t currentHour, uint8_t currentMinute);
 
@@ -37,7 +53,7 @@ public:
   void notifyFertComplete(uint8_t channel, float doseML);
   void notifyDailyLevel(float levelCm);
 
-  // ---- Configuration (persisted in NVS namespace "notify") ----
+  // ---- Configuration (settings registry, namespace "notify") ----
 
   void setPrivateKey(const String &key);
   String getPrivateKey() const { return _privateKey; }
@@ -56,6 +72,9 @@ public:
 
   uint16_t getDailyCount() const { return _dailyCount; }
 
+  /// Midnight rollover: reset the daily counter and report flag
+  void startNewDay();
+
   /// Send a manual test notification
   void sendTest();
 
@@ -66,6 +85,7 @@ public:
 #endif
 
 private:
+  SettingsStore *_settings;
   String _privateKey;
   Lang _lang;
   bool _typeEnabled[NOTIFY_TYPE_COUNT];
@@ -86,11 +106,30 @@ private:
   /// Check if a notification of given type can be sent (rate limiting)
   bool _canSend(NotifyType type);
 
-  /// Send notification via Pushsafer HTTPS API
-  /// @return true if sent successfully
+  /// Send notification — enqueued if the delivery task runs, else inline
+  /// @return true if sent (or queued) successfully
   bool _send(NotifyType type, const char *title, const char *message,
              const char *icon, const char *sound);
 
+  /// Blocking Pushsafer HTTPS POST
+  /// @return true if sent successfully
+  bool _deliver(NotifyType type, const char *title, const char *message,
+                const char *icon, const char *sound);
+
+#ifndef UNIT_TEST
+  /// One pending notification (copied — callers pass stack buffers)
+  struct NotifyJob {
+    NotifyType type;
+    char title[64];
+    char message[192];
+    char icon[4];
+    char sound[4];
+  };
+
+  QueueHandle_t _queue = nullptr;
+  static void _taskEntry(void *arg);
+#endif
+
   void _loadConfig();
   void _saveConfig();
 
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <Wire.h>
+
+/// @brief Where the fert pump duties go. FertManager stages every change
+/// of one operation with set() and applies them with one flush(), so a
+/// backend behind a bus can send them as a single transaction.
+///
+/// set() and flush() are called from the owner task and the dose timer
+/// task; implementations must tolerate that.
+class PumpOutput {
+public:
+  virtual ~PumpOutput() {}
+
+  /// Configure `channels` outputs (prime last), all off
+  virtual bool begin(uint8_t channels) = 0;
+
+  /// Stage a duty: 0 = off, 255 = full on
+  virtual void set(uint8_t ch, uint8_t duty) = 0;
+
+  /// Apply everything staged since the last flush
+  /// @return false if the outputs could not be written (retried next flush)
+  virtual bool flush() = 0;
+};
+
+/// @brief Native LEDC PWM: channel i on FERT_PINS[i], the last channel on
+/// PIN_PRIME. Writes go straight to the LEDC registers; flush() is a no-op.
+class LedcPumpOutput : public PumpOutput {
+public:
+  bool begin(uint8_t channels) override;
+  void set(uint8_t ch, uint8_t duty) override;
+  bool flush() override { return true; }
+
+private:
+  uint8_t _channels = 0;
+
+  uint8_t _pin(uint8_t ch) const; // 0xFF if the channel has no pin
+};
+
+/// @brief PCA9685 16-channel I2C PWM expander(s). set() only updates RAM;
+/// flush() writes the changed span of each chip's LEDn registers in one
+/// auto-increment burst, and the chip latches them together at the STOP,
+/// so pumps switched by one operation change at the same instant.
+class Pca9685PumpOutput : public PumpOutput {
+public:
+  static constexpr uint8_t OUTPUTS_PER_CHIP = 16;
+  static constexpr uint8_t MAX_CHANNELS = 32; // Two chips
+
+  explicit Pca9685PumpOutput(TwoWire &wire, uint8_t addr = PCA9685_I2C_ADDR,
+                             uint16_t pwmHz = PCA9685_PWM_HZ);
+
+  bool begin(uint8_t channels) override;
+  void set(uint8_t ch, uint8_t duty) override;
+  bool flush() override;
+
+  /// I2C transactions sent by flush() (bus load check)
+  uint32_t getFlushWrites() const { return _flushWrites; }
+
+private:
+  TwoWire *_wire;
+  uint8_t _addr;
+  uint16_t _pwmHz;
+  uint8_t _channels;
+  uint8_t _duty[MAX_CHANNELS];
+  uint32_t _dirty;   // Channel mask staged but not yet written
+  bool _flushing;    // A flush is on the bus; it also sends later changes
+  uint32_t _flushWrites;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  bool _writeRegs(uint8_t chip, uint8_t reg, const uint8_t *data,
+                  uint8_t len);
+};
@@ -1,8 +1,29 @@
 #pragma once
 
 #include "Config.h"
+#include "LevelEstimator.h"
+#include "UltrasonicSampler.h"
 #include <Arduino.h>
 
+/// @brief Sensor sampling mode, re-selected from system state every update()
+enum class SamplingMode : uint8_t { IDLE = 0, ACTIVE, EMERGENCY };
+constexpr uint8_t SAMPLING_MODE_COUNT = 3;
+
+/// @brief Returns human-readable name for a sampling mode
+const char *samplingModeName(SamplingMode m);
+
+/// @brief How often a mode checks the sensors and how many pings it takes
+struct SamplingPolicy {
+  uint16_t checkMs; // Safety-check period
+  uint8_t pings;    // Ultrasonic pings per check (also the burst size)
+
+  /// Sampler ping period: pings spread over one check
+  uint16_t pingIntervalMs() const {
+    uint16_t ms = checkMs / pings;
+    return ms < ULTRASONIC_PING_INTERVAL_MS ? ULTRASONIC_PING_INTERVAL_MS : ms;
+  }
+};
+
 /// @brief Safety-first watchdog: sensor reads, overflow detection, emergency
 /// actions.
 class SafetyWatchdog {
@@ -17,21 +38,52 @@ public:
 
   // ---- Sensor reads ----
 
-  /// Ultrasonic distance (cm). Uses median filter. Returns -1 on error.
+  /// Ultrasonic distance (cm). Feeds every ping the background sampler took
+  /// since the last call through the level estimator (non-blocking); falls
+  /// back to a blocking burst if the sampler is not producing pings.
+  /// Returns the filtered level, -1 on error.
   float readUltrasonic();
 
+  /// Control task, before it takes ControlLock: if the sampler is stalled
+  /// and this tick's safety check will need a reading, take the blocking
+  /// burst now. readUltrasonic() then uses it instead of blocking with the
+  /// lock held (up to pings × 60 ms, every web handler waiting).
+  void prefetchBurst();
+
   /// Optical max-level sensor: true = water at max level (STOP pumps!)
   bool isOpticalHigh();
 
   /// Reservoir float switch: true = reservoir is full
   bool isReservoirFull();
 
+  /// Shared level cache: returns the last filtered reading if it is at most
+  /// maxAgeMs old, otherwise takes a fresh reading. Every consumer should go
+  /// through this so one control tick costs one sensor read.
+  float getLevel(unsigned long maxAgeMs = LEVEL_SAMPLE_MAX_AGE_MS);
+
+  /// Age (ms) of the cached level sample; ULONG_MAX if none yet
+  unsigned long getLevelAgeMs() const;
+
+  /// Filtered level extrapolated horizonMs ahead using the estimated rate.
+  /// Falls back to getLevel() while confidence is below
+  /// LEVEL_EST_MIN_CONFIDENCE.
+  float predictLevel(unsigned long horizonMs);
+
+  /// Estimated rate of change (cm/s); negative = water rising
+  float getLevelRate() const { return _estimator.rate(); }
+
+  /// Estimator confidence 0..1
+  float getLevelConfidence() const;
+
   /// Last valid ultrasonic reading (cm)
   float getLastDistance() const { return _lastDistance; }
 
   /// True if ultrasonic sensor is producing valid readings
   bool areSensorsConnected() const { return _sensorsConnected; }
 
+  /// True if the interrupt-driven background sampler is active
+  bool isSamplerRunning() const { return _sampler.isRunning(); }
+
   // ---- Emergency actions ----
 
   /// Immediately set ALL output pins LOW
@@ -49,31 +101,113 @@ public:
   void exitMaintenance();
   bool isMaintenanceMode() const { return _maintenance; }
 
+  // ---- Adaptive sampling ----
+
+  /// Set the policy for one mode (checkMs within SAMPLING_MIN/MAX_CHECK_MS,
+  /// pings 1..UltrasonicSampler::RING_SIZE). Applies at once if mode is
+  /// current. @return false if rejected
+  bool setSamplingPolicy(SamplingMode mode, uint16_t checkMs, uint8_t pings);
+  const SamplingPolicy &getSamplingPolicy(SamplingMode mode) const {
+    return _policies[(uint8_t)mode];
+  }
+
+  /// Mode picked by the last update()
+  SamplingMode getSamplingMode() const { return _samplingMode; }
+
+  /// Current safety-check period (ms)
+  uint16_t getCheckIntervalMs() const {
+    return _policies[(uint8_t)_samplingMode].checkMs;
+  }
+
   // ---- Flags for other managers ----
 
   /// True if optical sensor triggered overflow during last update
   bool overflowDetected() const { return _overflowFlag; }
 
+  /// Latched by the optical-sensor ISR, which has already driven
+  /// PIN_REFILL and PIN_SOLENOID LOW. Cleared by update() once the sensor
+  /// reads normal again.
+  bool opticalTripped() const { return _opticalTripped; }
+
+  /// Latched by the float-switch ISR, which has already closed
+  /// PIN_SOLENOID. Cleared by update() once the reservoir reads not full.
+  bool floatTripped() const { return _floatTripped; }
+
 private:
   float _lastDistance;
+  unsigned long _lastDistanceMs; // When _lastDistance was sampled
+  bool _hasSample;
   bool _emergency;
   bool _sensorsConnected;
   uint8_t _ultrasonicFailCount;
   bool _overflowFlag;
 
+  // Hardware cut-offs (set from ISR context)
+  volatile bool _opticalTripped;
+  volatile bool _floatTripped;
+  volatile uint32_t _opticalTripUs; // esp_timer time of the last optical trip
+  bool _opticalTripReported;
+
   // Maintenance
-  bool _maintenance;
+  volatile bool _maintenance; // Read by the cut-off ISRs
   unsigned long _maintenanceStart;
 
   // Timing
   unsigned long _lastCheckMs;
 
+  // Adaptive sampling
+  SamplingPolicy _policies[SAMPLING_MODE_COUNT];
+  SamplingMode _samplingMode;
+
   // Emergency drain tracking
   bool _emergencyDraining;
   unsigned long _emergencyDrainStart;
 
-  /// Median filter helper
-  float _medianOfFive(float *arr);
+  // Background ping engine (timer + echo ISR)
+  UltrasonicSampler _sampler;
+  uint32_t _samplerCursor; // Last ping consumed from the sampler
+
+  // Fallback burst taken by prefetchBurst() outside ControlLock
+  struct Burst {
+    float samples[UltrasonicSampler::RING_SIZE];
+    uint32_t stamps[UltrasonicSampler::RING_SIZE];
+    uint8_t count;
+    unsigned long doneMs;
+    bool ready;
+  };
+  Burst _prefetched;
+  mutable portMUX_TYPE _prefetchMux = portMUX_INITIALIZER_UNLOCKED;
+
+  // Streaming level + rate filter
+  LevelEstimator _estimator;
+
+  /// Legacy blocking burst (pulseIn). Returns number of valid samples.
+  uint8_t _burstRead(float *samples, uint32_t *stamps);
+  /// Sampler not running or no ping lately: reads have to block
+  bool _samplerStalled() const;
+  /// Hand over a fresh prefetched burst (consumed either way).
+  /// @return false if there is none
+  bool _takePrefetched(float *samples, uint32_t *stamps, uint8_t &count);
+
+  /// Update connection state and stream valid samples into the estimator
+  float _applySamples(const float *samples, const uint32_t *stamps,
+                      uint8_t validCount);
+
+  /// Optical max-level edge: refill + solenoid OFF, latch the trip
+  static void IRAM_ATTR _onOpticalEdge(void *arg);
+
+  /// Float-switch edge: solenoid OFF, latch the trip
+  static void IRAM_ATTR _onFloatEdge(void *arg);
+
+  /// Report ISR trips and clear latches whose sensor reads normal again
+  void _serviceTrips();
+
+  /// Mode for the current system state: emergency drain, any TPA output on
+  /// or the level moving → faster; otherwise idle
+  SamplingMode _selectSamplingMode();
+
+  /// Switch mode and retune the background sampler
+  void _applySamplingMode(SamplingMode mode);
 
   /// Check if water level is dangerously high
   void _checkOverflow();
@@ -0,0 +1,142 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <Preferences.h>
+
+/// NVS namespaces whose settings live in the registry
+enum class SettingNs : uint8_t { AQUA, NOTIFY, PUMPCAL, COUNT };
+
+enum class SettingType : uint8_t { U8, U16, U32, FLOAT, STR, BYTES };
+
+/// Every registry setting; SettingsStore.cpp declares key, type, default
+/// and range of each, in this order.
+enum class Setting : uint8_t {
+  // aqua (WebManager)
+  TPA_INTERVAL,
+  TPA_HOUR,
+  TPA_MINUTE,
+  TPA_LAST_RUN, // NVS fallback of the EEPROM counter
+  TPA_PERCENT,
+  CANISTER_SAFE_PCT,
+  LANGUAGE,
+  PRIME_ML,
+  AQ_HEIGHT,
+  AQ_LENGTH,
+  AQ_WIDTH,
+  AQ_MARGIN,
+  DRAIN_FLOW,  // mL/s (3 s calibration)
+  REFILL_FLOW, // mL/s
+  PRIME_RATIO,
+  RESERVOIR_VOLUME,
+  RESERVOIR_SAFETY,
+  SAMPLING, // SamplingPolicy[SAMPLING_MODE_COUNT]
+  // notify (NotifyManager)
+  NOTIFY_KEY,
+  NOTIFY_MASK,
+  REPORT_HOUR,
+  REPORT_MINUTE,
+  // pumpcal (TPA flow calibration)
+  DRAIN_LPM,
+  REFILL_LPM,
+  COUNT
+};
+
+/// Declaration of one setting
+struct SettingDef {
+  SettingNs ns;
+  const char *key; // Record entry name (= NVS key of the per-key layout)
+  SettingType type;
+  uint8_t size;    // Bytes held (STR: max length + NUL)
+  double def;      // Numeric types (double: exact for any uint32_t)
+  double min;
+  double max;
+};
+
+/// @brief Typed registry of the configuration settings, persisted as one
+/// record per NVS namespace.
+///
+/// begin() loads every namespace in one pass. Setters clamp to the declared
+/// range and mark only settings whose value actually changed; update()
+/// commits the dirty namespaces once edits pause for
+/// SETTINGS_COMMIT_DELAY_MS (at most SETTINGS_COMMIT_MAX_MS after the first
+/// change), so a burst of web edits costs one flash write per namespace.
+///
+/// A record {magic, seq, len, entries, crc} alternates between the keys
+/// "rec0" and "rec1"; the newest valid one wins at boot, so a write torn by
+/// a power cut leaves the previous complete configuration. Entries are
+/// {key, type, size, value}: settings added or removed by a firmware update
+/// fall back to their default or are skipped. Without a record, the
+/// per-key values of the old layout are read and converted.
+///
+/// Getters and setters may be called from any task (the values sit behind
+/// a spinlock). Commits write NVS under ControlLock, so flush() may also be
+/// called from a web handler (before a restart).
+class SettingsStore {
+public:
+  SettingsStore();
+
+  /// Load all namespaces (records, else legacy keys)
+  void begin();
+
+  /// Commit dirty namespaces whose debounce expired (call from loop)
+  void update();
+
+  /// Commit every dirty namespace now (before a restart, or for values
+  /// that must not be lost to a power cut)
+  /// @return false if a namespace write failed (kept dirty)
+  bool flush();
+
+  uint32_t getUInt(Setting id) const;
+  float getFloat(Setting id) const;
+  String getString(Setting id) const;
+  /// @return false if never set (BYTES have no default)
+  bool getBytes(Setting id, void *out, size_t len) const;
+
+  /// Store a value clamped to the setting's range
+  /// @return true if the stored value changed
+  bool setUInt(Setting id, uint32_t value);
+  bool setFloat(Setting id, float value);
+  bool setString(Setting id, const String &value);
+  bool setBytes(Setting id, const void *data, size_t len);
+
+  bool isDirty() const { return _dirty != 0; }
+  uint32_t getCommitCount() const { return _commits; }
+
+  static const SettingDef &getDef(Setting id);
+
+  /// Dirty settings, commit count and record slot/seq per namespace
+  void printReport() const;
+
+private:
+  static constexpr uint8_t COUNT = (uint8_t)Setting::COUNT;
+  static constexpr uint8_t NS_COUNT = (uint8_t)SettingNs::COUNT;
+  static constexpr uint16_t IMAGE_BYTES = 160; // Sum of the setting sizes
+
+  struct __attribute__((packed)) RecordHeader {
+    uint16_t magic;
+    uint32_t seq;
+    uint16_t len; // Entry bytes after the header
+  };
+
+  uint8_t _values[IMAGE_BYTES]; // Every setting, at _offset[id]
+  uint16_t _offset[COUNT];
+  uint32_t _present; // BYTES settings holding a value
+  uint32_t _dirty;   // Settings changed since their last commit
+  bool _loading;     // begin(): values read back are not changes
+  unsigned long _firstDirtyMs;
+  unsigned long _lastChangeMs;
+  uint32_t _seq[NS_COUNT]; // Seq of the newest record (0 = none)
+  uint8_t _slot[NS_COUNT]; // Key of the newest record (rec0/rec1)
+  uint32_t _commits;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  static uint32_t _nsMask(SettingNs ns);
+  bool _set(Setting id, const void *data, size_t len);
+  bool _setNumber(Setting id, double value);
+  double _getNumber(Setting id) const;
+  bool _loadRecord(Preferences &prefs, SettingNs ns);
+  void _parseEntries(SettingNs ns, const uint8_t *p, size_t len);
+  bool _loadLegacy(Preferences &prefs, SettingNs ns);
+  bool _commit(SettingNs ns);
+};
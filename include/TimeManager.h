@@ -29,6 +29,8 @@ public:
 
   /// Get formatted time string "YYYY/MM/DD HH:MM:SS"
   String getFormattedTime();
+  /// Same into out (20 bytes), without a String
+  void formatTime(char *out, size_t len);
 
   /// RTC physically connected?
   bool isRtcConnected() const { return _rtcConnected; }
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Config.h"
+#include <Arduino.h>
+#include <esp_timer.h>
+
+/// @brief Background JSN-SR04T sampler: a periodic esp_timer fires one ping
+/// every ULTRASONIC_PING_INTERVAL_MS and a GPIO edge interrupt on the echo pin
+/// measures the pulse width. Results land in a small timestamped ring buffer,
+/// so readers never block on pulseIn().
+class UltrasonicSampler {
+public:
+  /// One ping result. echoUs == 0 means no (valid) echo.
+  struct Sample {
+    uint32_t timestampMs; // esp_timer time of the ping (ms since boot)
+    uint16_t echoUs;      // Echo pulse width (us)
+  };
+
+  static constexpr uint8_t RING_SIZE = 16;
+
+  UltrasonicSampler();
+
+  /// Attach the echo interrupt and start the ping timer.
+  /// @return false if the timer could not be created (caller falls back to
+  ///         blocking reads)
+  bool begin(uint8_t trigPin, uint8_t echoPin, unsigned long periodMs);
+
+  /// Stop pinging and detach the echo interrupt
+  void end();
+
+  bool isRunning() const { return _timer != nullptr && _running; }
+
+  /// Change the ping period of a running sampler
+  /// @return false if not running or the timer could not be restarted
+  bool setPeriod(unsigned long periodMs);
+  unsigned long getPeriodMs() const { return _periodMs; }
+
+  /// Copy distances (cm) of valid pings newer than maxAgeMs, newest first.
+  /// @param out       destination buffer (maxCount entries)
+  /// @param pings     optional: number of pings (valid or not) in the window
+  /// @param newestMs  optional: timestamp of the newest returned sample
+  /// @return number of valid distances written to out
+  uint8_t collect(float *out, uint8_t maxCount, unsigned long maxAgeMs,
+                  uint8_t *pings = nullptr, uint32_t *newestMs = nullptr) const;
+
+  /// Copy pings recorded since the caller's cursor, oldest first, and advance
+  /// the cursor. Pings overwritten before being read are skipped; if more
+  /// than maxCount are pending only the newest maxCount are returned.
+  /// @return number of samples written to out
+  uint8_t readSince(uint32_t &cursor, Sample *out, uint8_t maxCount) const;
+
+  /// True if the newest ping (valid or not) is at most maxAgeMs old
+  bool hasPingWithin(unsigned long maxAgeMs) const;
+
+  /// Convert an echo width to distance (cm); -1 if out of range
+  static float echoToCm(uint16_t echoUs);
+
+  /// Record one ping result (called from the timer task and the echo ISR)
+  void IRAM_ATTR push(uint32_t timestampMs, uint16_t echoUs);
+
+  uint32_t getPingCount() const { return _pingCount; }
+  uint32_t getMissCount() const { return _missCount; }
+
+private:
+  uint8_t _trigPin;
+  uint8_t _echoPin;
+  bool _running;
+  unsigned long _periodMs;
+  esp_timer_handle_t _timer;
+
+  // Echo capture state (shared with ISR)
+  volatile int64_t _pingUs;  // When the current ping was fired
+  volatile int64_t _riseUs;  // Rising edge of the current echo (0 = none yet)
+  volatile bool _awaitingEcho;
+
+  // Ring buffer
+  Sample _ring[RING_SIZE];
+  volatile uint8_t _head; // Next write slot
+  volatile uint8_t _count;
+  volatile uint32_t _pingCount;
+  volatile uint32_t _missCount;
+  mutable portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+
+  static void _onPingTimer(void *arg);
+  static void IRAM_ATTR _onEchoEdge(void *arg);
+};
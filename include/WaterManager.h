@@ -2,10 +2,12 @@
 
 #include "Config.h"
 #include <Arduino.h>
+#include <esp_timer.h>
 
 // Forward declarations
 class SafetyWatchdog;
-class FertManager;
+template <uint8_t N> class FertManagerT;
+using FertManager = FertManagerT<NUM_FERTS>;
 
 /// @brief TPA state machine states
 enum class TPAState : uint8_t {
@@ -23,6 +25,34 @@ enum class TPAState : uint8_t {
 /// @brief Returns human-readable name for a TPA state
 const char *tpaStateName(TPAState s);
 
+/// Checkpoint flag: the Prime pump was started (its stock already debited)
+constexpr uint8_t TPA_CKPT_PRIME_STARTED = 0x01;
+
+/// @brief TPA progress, rewritten every tick and on every transition so a
+/// cycle cut short by a reset can be resumed (see WaterManager::resumeTPA())
+struct __attribute__((packed)) TpaCheckpoint {
+  uint16_t magic;     // TPA_CKPT_MAGIC
+  uint8_t state;      // TPAState (not running = nothing to resume)
+  uint8_t flags;      // TPA_CKPT_*
+  uint32_t seq;       // Bumped on every state change (triggers the NVS mirror)
+  uint32_t elapsedMs; // Time spent in the state so far
+  float drainTargetCm;
+  float refillTargetCm; // Level the cycle started from
+  float canisterSafeLevelCm;
+  float primeML;
+  uint32_t timeoutDrainMs;
+  uint32_t timeoutRefillMs;
+  float litersPerCm;
+  float aqEffectiveHeightCm;
+  float drainFlowLPM; // Inline calibration, may be newer than NVS
+  float refillFlowLPM;
+  uint32_t crc; // CRC-32 of the bytes above
+};
+
+/// Checkpoint slot in RTC slow memory: survives panics, watchdog and
+/// software resets, not a power loss (the NVS mirror covers that)
+extern TpaCheckpoint tpaRtcCheckpoint;
+
 /// @brief Manages the TPA (Troca Parcial de Água) state machine.
 class WaterManager {
 public:
@@ -40,6 +70,23 @@ public:
   /// Abort TPA cycle immediately (emergency or user cancel)
   void abortTPA();
 
+  // ---- Checkpoint (resume after a reset) ----
+
+  /// Load the checkpoint of a cycle cut short by a reset (RTC slow memory,
+  /// else the NVS mirror). Call right after the outputs are driven LOW:
+  /// keeps the canister off while the tank may be below its intake.
+  /// @return true if resumeTPA() has a cycle to pick up
+  bool loadCheckpoint();
+
+  /// Resume the loaded cycle where it stopped, or finish it safely if the
+  /// sensors can't be trusted. Call after begin() and the flow calibration,
+  /// before the control task starts.
+  void resumeTPA();
+
+  /// Copy the checkpoint to NVS if the state changed since the last call
+  /// (call from loop: a flash write must not stall the control tick)
+  void mirrorCheckpoint();
+
   /// Current state
   TPAState getState() const { return _state; }
   const char *getStateName() const { return tpaStateName(_state); }
@@ -73,6 +120,11 @@ public:
   float getRefillFlowLPM() const { return _refillFlowLPM; }
   bool isCalibrated() const { return _drainFlowLPM > 0 && _refillFlowLPM > 0; }
 
+  /// Distance (cm) past the target when the last drain/refill settled.
+  /// Positive = overshoot, negative = stopped short.
+  float getLastDrainOvershootCm() const { return _lastDrainOvershootCm; }
+  float getLastRefillOvershootCm() const { return _lastRefillOvershootCm; }
+
   /// Canister filter state
   bool isCanisterOn() const {
     return digitalRead(PIN_CANISTER) == LOW;
@@ -97,6 +149,7 @@ private:
   // Dosing state
   bool
       _doseCompleted; // Tracks if Prime dosing already happened in DOSING_PRIME
+  bool _primeDosing;  // Prime pump running on FertManager's dose timer
 
   // Parameters
   float _drainTargetCm;
@@ -117,6 +170,24 @@ private:
   float _drainFlowLPM;        // Calibrated drain flow rate (L/min)
   float _refillFlowLPM;       // Calibrated refill flow rate (L/min)
 
+  // Predictive cut-off: a one-shot timer stops the pump at the projected
+  // instant; the next settled reading confirms (or resumes the pump)
+  esp_timer_handle_t _cutoffTimer;
+  volatile uint8_t _cutoffPin; // Pump the timer will stop (0 = not armed)
+  volatile bool _cutoffFired;
+  volatile unsigned long _cutoffFiredMs;
+  bool _cutoffDisabled; // Undershot once: sensor-only for rest of the state
+  portMUX_TYPE _cutoffMux = portMUX_INITIALIZER_UNLOCKED;
+  float _lastDrainOvershootCm;
+  float _lastRefillOvershootCm;
+
+  // Checkpoint
+  uint32_t _ckptSeq;      // Seq of the last state change saved
+  uint32_t _mirroredSeq;  // Seq last copied to NVS (0 = none yet)
+  TpaCheckpoint _pending; // Loaded at boot, consumed by resumeTPA()
+  bool _hasPending;
+  portMUX_TYPE _ckptMux = portMUX_INITIALIZER_UNLOCKED;
+
   // Telemetry
   String _lastTPATime;
   String _lastErrorMsg;
@@ -127,11 +198,42 @@ private:
   void _handleDraining();
   void _handleFillingReservoir();
   void _handleDosingPrime();
+  void _stopPrimeDose();
   void _handleRefilling();
   void _handleCanisterOn();
 
+  /// Capture drain flow rate from inline calibration data
+  void _captureDrainCalibration(float dist, unsigned long endMs);
+
   /// Capture refill flow rate from inline calibration data
-  void _captureRefillCalibration();
+  void _captureRefillCalibration(unsigned long endMs);
+
+  // ---- Predictive cut-off ----
+
+  /// Turn the pump on unless it already is or the cut-off timer just fired.
+  /// @return true if it was switched on by this call
+  bool _pumpOnIfIdle(uint8_t pin);
+
+  /// Projected ms until dist reaches targetCm; dir = +1 draining (distance
+  /// grows), -1 refilling. Blends the calibrated flow with the live slope.
+  /// @return 0 if already there, ULONG_MAX if no usable rate
+  unsigned long _projectTimeToTargetMs(float dist, float targetCm,
+                                       float flowLPM, int8_t dir);
+
+  /// (Re)arm the one-shot cut-off for pin once the ETA is inside the window
+  void _armCutoff(uint8_t pin, float dist, float targetCm, float flowLPM,
+                  int8_t dir);
+  void _disarmCutoff();
+  static void _onCutoffTimer(void *arg);
+
+  /// Log and record how far past targetCm the level settled
+  void _recordOvershoot(bool drain, float targetCm, float finalCm,
+                        const char *how);
+
+  /// Write the current progress to RTC slow memory
+  /// @param transition true on a state change (bumps the seq)
+  void _saveCheckpoint(bool transition);
+  static bool _checkpointValid(const TpaCheckpoint &c);
 
   /// Elapsed time in current state (ms)
   unsigned long _stateElapsed() const { return millis() - _stateStartMs; }
@@ -1,16 +1,28 @@
 #pragma once
 
+#include "ActuatorJobs.h"
 #include "Config.h"
+#include "JsonDelta.h"
 #include <Arduino.h>
 
 // Forward declarations
 class TimeManager;
 class WaterManager;
-class FertManager;
+template <uint8_t N> class FertManagerT;
+using FertManager = FertManagerT<NUM_FERTS>;
 class SafetyWatchdog;
 class NotifyManager;
+class LoopProfiler;
+class LoopScheduler;
+class EventAgenda;
+class DoseJournal;
+class CounterStore;
+class ActuatorLog;
+class SettingsStore;
+class JsonWriter;
 
 #ifdef USE_WEBSERVER
+#include "JsonBody.h"
 #include <ESPAsyncWebServer.h>
 #endif
 
@@ -26,12 +38,38 @@ public:
   /// Run web server + update telemetry (call from loop)
   void update();
 
+  /// Profilers reported by the `perf` command and /api/perf
+  void setProfilers(LoopProfiler *control, LoopProfiler *loop) {
+    _controlPerf = control;
+    _loopPerf = loop;
+  }
+
+  /// loopTask scheduler whose job table is included in perf reports
+  void setScheduler(LoopScheduler *sched) { _sched = sched; }
+
+  /// Schedule agenda listed by the `agenda` command and /api/status
+  void setAgenda(EventAgenda *agenda) { _agenda = agenda; }
+
+  /// Dose journal served by /api/fert/history and the `journal` command
+  void setJournal(DoseJournal *journal) { _journal = journal; }
+
+  /// EEPROM store for the last TPA run time (call before begin())
+  void setCounterStore(CounterStore *store) { _counters = store; }
+
+  /// Actuator on-time accounting (serial `actuators`, /api/actuators)
+  void setActuatorLog(ActuatorLog *log) { _actuators = log; }
+
+  /// Registry holding the aqua settings (call before begin())
+  void setSettings(SettingsStore *settings) { _settings = settings; }
+
   // ---- Schedule parameters (read by main loop) ----
   uint16_t getTpaInterval() const { return _tpaInterval; }
   uint8_t getTpaHour() const { return _tpaHour; }
   uint8_t getTpaMinute() const { return _tpaMinute; }
   uint32_t getTpaLastRun() const { return _tpaLastRun; }
   void setTpaLastRun(uint32_t epoch);
+  /// Bumped on every parameter load/save (agenda rebuild trigger)
+  uint32_t getParamsRevision() const { return _paramsRev; }
   uint8_t getTpaPercent() const { return _tpaPercent; }
   uint8_t getCanisterSafePct() const { return _canisterSafePct; }
   uint8_t getLanguage() const { return _language; }
@@ -61,12 +99,21 @@ private:
   FertManager *_fert;
   SafetyWatchdog *_safety;
   NotifyManager *_notify;
+  LoopProfiler *_controlPerf;
+  LoopProfiler *_loopPerf;
+  LoopScheduler *_sched;
+  EventAgenda *_agenda;
+  DoseJournal *_journal;
+  CounterStore *_counters;
+  ActuatorLog *_actuators;
+  SettingsStore *_settings;
 
   // Schedule parameters
   uint16_t _tpaInterval;
   uint8_t _tpaHour;
   uint8_t _tpaMinute;
   uint32_t _tpaLastRun;
+  uint32_t _paramsRev;
   uint8_t _tpaPercent;      // % of aquarium volume to change
   uint8_t _canisterSafePct; // Min water level % for safe canister operation
   uint8_t _language;        // 0=PT, 1=EN, 2=JA
@@ -86,30 +133,96 @@ private:
 
   // Telemetry timing
   unsigned long _lastTelemetryMs;
-  unsigned long _lastSSEMs;
-
-  // NVS persistence
+  unsigned long _lastLiveMs;
+  unsigned long _lastResyncMs;
+  uint32_t _sentConfigRev; // Revisions the last config/stocks events had
+  uint32_t _sentStocksRev;
+  volatile bool _sseKick;  // Client connected: full resync now
+  JsonDelta _liveDelta;
+  JsonDelta _configDelta;
+  JsonDelta _stocksDelta;
+  char _statusBuf[WEB_STATUS_JSON_MAX]; // SSE payload, reused every tick
+
+  // /api/config cache: rebuilt only after _paramsRev or the fert state
+  // revision moves; its ETag is "<bootId>-<version>"
+  uint32_t _bootId;
+  uint32_t _configVersion; // Monotonic, bumped once per observed change
+  uint32_t _cfgParamsRev;  // Revisions the version was taken at
+  uint32_t _cfgFertRev;
+  size_t _configCacheLen;  // 0: stale, rebuilt on the next request
+  char _configCache[WEB_CONFIG_JSON_MAX];
+
+  // Persistence (SettingsStore, aqua namespace)
   void _loadParams();
   void _saveParams();
 
   // Telemetry
   void _updateTelemetry();
-  String _buildStatusJSON();
+  void _writeStatusJSON(JsonWriter &w);
+  // SSE topics: members of one object, also composed by _writeStatusJSON
+  void _writeLiveFields(JsonWriter &w);
+  void _writeConfigFields(JsonWriter &w);
+  void _writeStocksFields(JsonWriter &w); // "0".."N" per channel
+  void _writeStock(JsonWriter &w, uint8_t ch);
+  void _writeChannels(JsonWriter &w); // "stocks" array + thresholds
+  /// /api/config body: version, schedule parameters, channels
+  void _writeConfigJSON(JsonWriter &w);
+  /// Bump _configVersion (and drop the cache) if a setter moved a revision
+  void _syncConfigVersion();
+  /// Build a topic into _statusBuf and send the members that changed
+  void _sendTopic(const char *event, JsonDelta &delta,
+                  void (WebManager::*fields)(JsonWriter &));
 
   // Serial UI
   void _printStatus();
   void _printHelp();
 
-  // JSON helpers
-  static int _extractInt(const String &json, const char *key);
-  static float _extractFloat(const String &json, const char *key);
-  static String _extractString(const String &json, const char *key);
-  static bool _extractFloatArray(const String &json, const char *key,
-                                 float *outArray, uint8_t expectedSize);
+  // Profiling
+  String _buildPerfJSON();
+  void _resetPerf();
+  void _printAgenda();
+  void _printDosing();
+  void _printJournal();
 
 #ifdef USE_WEBSERVER
   AsyncWebServer _server;
   AsyncEventSource _events;
+  BodyArena _bodies; // Chunked POST bodies being reassembled
   void _setupRoutes();
+
+  // Calibration runs: timed off by _jobs, never by the request handler
+  ActuatorJobs _jobs;
+  uint32_t _drainRunUs; // Measured on-time of the last run (0: none yet)
+  uint32_t _refillRunUs;
+  uint32_t _fertRunUs[NUM_FERTS + 1];
+  /// 202 with the job id, or 409 if the pump already runs a job
+  void _sendJobReply(AsyncWebServerRequest *request, uint32_t id);
+  /// Why a drain/refill calibration run may not start now, or nullptr.
+  /// Call with ControlLock held.
+  const char *_pinRunRefusal(uint8_t pin) const;
+  /// Fert runs go through FertManager's manual run, which holds the
+  /// channel so a scheduled dose waits instead of being cut short; drain
+  /// and refill runs are refused while _pinRunRefusal() objects
+  static bool _switchJob(JobTarget target, uint8_t index, bool on,
+                         void *ctx);
+  /// Record the measured on-time and report it (SSE "job")
+  static void _onJobDone(const ActuatorJobs::Job &job, void *ctx);
+
+  // Restart requested by a handler, done by update() once the reply is out
+  volatile bool _restartPending;
+  unsigned long _restartAtMs;
+
+  /// Body handler front end: reassemble the body, then fill fields.
+  /// @return true once the whole body is parsed; false while chunks are
+  ///         pending or after an error reply (400/413/503) was sent
+  bool _parseBody(AsyncWebServerRequest *request, const uint8_t *data,
+                  size_t len, size_t index, size_t total, JsonField *fields,
+                  uint8_t fieldCount);
+  template <size_t N>
+  bool _parseBody(AsyncWebServerRequest *request, const uint8_t *data,
+                  size_t len, size_t index, size_t total,
+                  JsonField (&fields)[N]) {
+    return _parseBody(request, data, len, index, total, fields, N);
+  }
 #endif
 };
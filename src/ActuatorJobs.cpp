@@ -0,0 +1,185 @@
+#include "ActuatorJobs.h"
+
+// stopAtUs of a job whose output is still being switched on
+static const int64_t NOT_ARMED = INT64_MAX;
+
+static_assert(ACTUATOR_JOB_SLOTS <= 8, "_stopDue keeps due jobs in a byte");
+
+ActuatorJobs::ActuatorJobs()
+    : _nextId(1), _switchFn(nullptr), _switchCtx(nullptr), _doneFn(nullptr),
+      _doneCtx(nullptr), _timer(nullptr) {
+  memset(_jobs, 0, sizeof(_jobs));
+}
+
+ActuatorJobs::~ActuatorJobs() {
+  if (_timer) {
+    esp_timer_stop(_timer);
+    esp_timer_delete(_timer);
+  }
+}
+
+uint32_t ActuatorJobs::start(JobTarget target, uint8_t index, uint32_t ms) {
+  if (!_switchFn)
+    return 0;
+
+  if (!_timer) {
+    esp_timer_create_args_t args = {};
+    args.callback = &ActuatorJobs::_onTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "act_job";
+    if (esp_timer_create(&args, &_timer) != ESP_OK) {
+      _timer = nullptr; // poll() stops the output instead
+      Serial.println("[Jobs] WARNING: job timer unavailable, polling");
+    }
+  }
+
+  // Reserve a slot first: a second request for the target is refused
+  // while the output is being switched on
+  Job *job = nullptr;
+  uint32_t id = 0;
+  portENTER_CRITICAL(&_mux);
+  if (!_busyLocked(target, index)) {
+    for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+      if (_jobs[i].state == State::FREE) {
+        job = &_jobs[i];
+        break;
+      }
+    }
+  }
+  if (job) {
+    id = _nextId++;
+    if (_nextId == 0)
+      _nextId = 1;
+    *job = {};
+    job->id = id;
+    job->target = target;
+    job->index = index;
+    job->state = State::RUNNING;
+    job->plannedMs = ms;
+    job->stopAtUs = NOT_ARMED;
+  }
+  portEXIT_CRITICAL(&_mux);
+  if (!job)
+    return 0;
+
+  if (!_switchFn(target, index, true, _switchCtx)) {
+    portENTER_CRITICAL(&_mux);
+    job->state = State::FREE;
+    portEXIT_CRITICAL(&_mux);
+    return 0;
+  }
+  int64_t nowUs = esp_timer_get_time();
+  portENTER_CRITICAL(&_mux);
+  job->startUs = nowUs;
+  job->stopAtUs = nowUs + (int64_t)ms * 1000;
+  portEXIT_CRITICAL(&_mux);
+  _arm(nowUs);
+  return id;
+}
+
+bool ActuatorJobs::isRunning(JobTarget target, uint8_t index) const {
+  portENTER_CRITICAL(&_mux);
+  bool busy = _busyLocked(target, index);
+  portEXIT_CRITICAL(&_mux);
+  return busy;
+}
+
+uint8_t ActuatorJobs::getRunningCount() const {
+  uint8_t n = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    if (_jobs[i].state == State::RUNNING || _jobs[i].state == State::STOPPING)
+      n++;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return n;
+}
+
+void ActuatorJobs::poll() {
+  _stopDue(esp_timer_get_time());
+
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    Job job;
+    portENTER_CRITICAL(&_mux);
+    job = _jobs[i];
+    if (job.state == State::DONE)
+      _jobs[i].state = State::FREE;
+    portEXIT_CRITICAL(&_mux);
+    if (job.state != State::DONE)
+      continue;
+
+    Serial.printf("[Jobs] #%lu done: %lu us (planned %lu ms)\n",
+                  (unsigned long)job.id, (unsigned long)job.actualUs,
+                  (unsigned long)job.plannedMs);
+    if (_doneFn)
+      _doneFn(job, _doneCtx);
+  }
+}
+
+// ---- Timer side ----
+
+void ActuatorJobs::_onTimer(void *arg) {
+  ActuatorJobs *self = static_cast<ActuatorJobs *>(arg);
+  int64_t nowUs = esp_timer_get_time();
+  self->_stopDue(nowUs);
+  self->_arm(esp_timer_get_time());
+}
+
+void ActuatorJobs::_stopDue(int64_t nowUs) {
+  // Runs on the esp_timer task or in poll(). A due job is claimed
+  // (STOPPING) under the lock, so only one of them switches it off.
+  uint8_t due = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    Job &j = _jobs[i];
+    if (j.state == State::RUNNING && j.stopAtUs <= nowUs) {
+      j.state = State::STOPPING;
+      due |= 1 << i;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    if (!(due & (1 << i)))
+      continue;
+    _switchFn(_jobs[i].target, _jobs[i].index, false, _switchCtx);
+    int64_t offUs = esp_timer_get_time();
+    portENTER_CRITICAL(&_mux);
+    _jobs[i].actualUs = (uint32_t)(offUs - _jobs[i].startUs);
+    _jobs[i].state = State::DONE;
+    portEXIT_CRITICAL(&_mux);
+  }
+}
+
+void ActuatorJobs::_arm(int64_t nowUs) {
+  if (!_timer)
+    return;
+
+  int64_t next = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    const Job &j = _jobs[i];
+    if (j.state == State::RUNNING && j.stopAtUs != NOT_ARMED &&
+        (next == 0 || j.stopAtUs < next))
+      next = j.stopAtUs;
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  if (esp_timer_is_active(_timer))
+    esp_timer_stop(_timer);
+  if (next == 0)
+    return;
+  int64_t waitUs = next - nowUs;
+  esp_timer_start_once(_timer, waitUs > 0 ? (uint64_t)waitUs : 1);
+}
+
+bool ActuatorJobs::_busyLocked(JobTarget target, uint8_t index) const {
+  for (uint8_t i = 0; i < ACTUATOR_JOB_SLOTS; i++) {
+    const Job &j = _jobs[i];
+    if ((j.state == State::RUNNING || j.state == State::STOPPING) &&
+        j.target == target && j.index == index)
+      return true;
+  }
+  return false;
+}
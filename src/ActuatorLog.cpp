@@ -0,0 +1,220 @@
+#include "ActuatorLog.h"
+#include "CounterStore.h"
+#include <esp_timer.h>
+
+// Same order as OUTPUT_PINS
+static const char *const ACTUATOR_NAMES[] = {
+    "fert1", "fert2",  "fert3",    "fert4",   "prime",
+    "drain", "refill", "solenoid", "canister"};
+static_assert(sizeof(ACTUATOR_NAMES) / sizeof(ACTUATOR_NAMES[0]) ==
+                  NUM_OUTPUT_PINS,
+              "One name per OUTPUT_PINS entry");
+
+ActuatorLog *ActuatorLog::_active = nullptr;
+
+ActuatorLog::ActuatorLog()
+    : _counters(nullptr), _lastSaveMs(0), _lastMirrorMs(0) {
+  memset(_act, 0, sizeof(_act));
+  memset(_nvsCopy, 0, sizeof(_nvsCopy));
+  _active = this;
+}
+
+ActuatorLog::~ActuatorLog() {
+  if (_active == this)
+    _active = nullptr;
+}
+
+void ActuatorLog::begin() {
+  _prefs.begin("actuators", false);
+  if (_prefs.getBytes("rt", _nvsCopy, sizeof(_nvsCopy)) != sizeof(_nvsCopy))
+    memset(_nvsCopy, 0, sizeof(_nvsCopy));
+
+  // The EEPROM holds the newest totals; a store begin() just formatted has
+  // no bank yet and is seeded from NVS below
+  Saved rec[NUM_OUTPUT_PINS];
+  bool fromEeprom = _counters && _counters->isReady() &&
+                    _counters->readBank(CounterBank::ACTUATORS, rec,
+                                        sizeof(rec));
+  if (!fromEeprom)
+    memcpy(rec, _nvsCopy, sizeof(rec));
+
+  // Added to whatever ran since boot (pin setup, canister on)
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
+    _act[i].onUs += rec[i].onS * 1000000ULL;
+    _act[i].cycles += rec[i].cycles;
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  _lastSaveMs = _lastMirrorMs = millis();
+  if (!fromEeprom && _counters && _counters->isReady())
+    save();
+  Serial.printf("[Actuators] Totals loaded from %s\n",
+                fromEeprom ? "EEPROM" : "NVS");
+}
+
+void ActuatorLog::update() {
+  if (millis() - _lastSaveMs >= ACTUATOR_SAVE_INTERVAL_MS)
+    save();
+}
+
+void ActuatorLog::save() {
+  Saved rec[NUM_OUTPUT_PINS];
+  _snapshot(rec);
+  _lastSaveMs = millis();
+
+  bool eeprom = _counters && _counters->isReady() &&
+                _counters->writeBank(CounterBank::ACTUATORS, rec,
+                                     sizeof(rec));
+  if (!eeprom || millis() - _lastMirrorMs >= COUNTER_NVS_MIRROR_MS) {
+    _writeNvs(rec);
+    _lastMirrorMs = millis();
+  }
+}
+
+// ============================================================================
+// EDGE RECORDING (any context)
+// ============================================================================
+
+void IRAM_ATTR ActuatorLog::write(uint8_t pin, uint8_t level) {
+  digitalWrite(pin, level);
+  note(pin, isActiveLowPin(pin) ? level == LOW : level != LOW);
+}
+
+void IRAM_ATTR ActuatorLog::note(uint8_t pin, bool on) {
+  ActuatorLog *log = _active;
+  int8_t idx = indexOf(pin);
+  if (log && idx >= 0)
+    log->_edge(idx, on, esp_timer_get_time());
+}
+
+int8_t IRAM_ATTR ActuatorLog::indexOf(uint8_t pin) {
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
+    if (OUTPUT_PINS[i] == pin)
+      return i;
+  }
+  return -1;
+}
+
+void IRAM_ATTR ActuatorLog::_edge(uint8_t idx, bool on, int64_t nowUs) {
+  portENTER_CRITICAL_SAFE(&_mux);
+  Actuator &a = _act[idx];
+  if (on && !a.on) {
+    a.on = true;
+    a.sinceUs = nowUs;
+    a.cycles++;
+  } else if (!on && a.on) {
+    uint64_t us = nowUs - a.sinceUs;
+    a.on = false;
+    a.onUs += us;
+    a.recentMs[a.head] = (uint32_t)(us / 1000);
+    a.head = (a.head + 1) % ACTUATOR_HISTORY;
+    if (a.recent < ACTUATOR_HISTORY)
+      a.recent++;
+  }
+  portEXIT_CRITICAL_SAFE(&_mux);
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+const char *ActuatorLog::getName(uint8_t idx) {
+  return idx < NUM_OUTPUT_PINS ? ACTUATOR_NAMES[idx] : "?";
+}
+
+uint32_t ActuatorLog::Stats::recentAvgMs() const {
+  uint64_t sum = 0;
+  for (uint8_t i = 0; i < recent; i++)
+    sum += recentMs[i];
+  return recent ? (uint32_t)(sum / recent) : 0;
+}
+
+uint32_t ActuatorLog::Stats::lifetimeAvgMs() const {
+  // The running stretch is not a finished run
+  uint32_t done = on ? cycles - 1 : cycles;
+  uint64_t ms = onMs - currentMs;
+  return done ? (uint32_t)(ms / done) : 0;
+}
+
+ActuatorLog::Stats ActuatorLog::getStats(uint8_t idx) const {
+  Stats s;
+  memset(&s, 0, sizeof(s));
+  if (idx >= NUM_OUTPUT_PINS)
+    return s;
+  int64_t nowUs = esp_timer_get_time();
+  portENTER_CRITICAL(&_mux);
+  Actuator a = _act[idx];
+  portEXIT_CRITICAL(&_mux);
+
+  s.on = a.on;
+  s.cycles = a.cycles;
+  s.currentMs = a.on ? (uint32_t)((nowUs - a.sinceUs) / 1000) : 0;
+  s.onMs = a.onUs / 1000 + s.currentMs;
+  s.recent = a.recent;
+  for (uint8_t i = 0; i < a.recent; i++)
+    s.recentMs[i] =
+        a.recentMs[(a.head + ACTUATOR_HISTORY - 1 - i) % ACTUATOR_HISTORY];
+  return s;
+}
+
+void ActuatorLog::printReport() const {
+  Serial.println("[Actuators] Lifetime on-time, cycles, average run "
+                 "(recent / lifetime)");
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
+    Stats s = getStats(i);
+    Serial.printf("  %-8s %-3s %9lu s %7lu cycles  avg %lu / %lu ms",
+                  getName(i), s.on ? "ON" : "off",
+                  (unsigned long)(s.onMs / 1000), (unsigned long)s.cycles,
+                  (unsigned long)s.recentAvgMs(),
+                  (unsigned long)s.lifetimeAvgMs());
+    if (s.on)
+      Serial.printf("  (on %lu ms)", (unsigned long)s.currentMs);
+    Serial.println();
+  }
+}
+
+void ActuatorLog::appendJSON(String &out) const {
+  char buf[200];
+  out += "[";
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
+    Stats s = getStats(i);
+    snprintf(buf, sizeof(buf),
+             "%s{\"name\":\"%s\",\"pin\":%u,\"on\":%s,\"onS\":%lu,"
+             "\"cycles\":%lu,\"curMs\":%lu,\"avgMs\":%lu,\"lifeAvgMs\":%lu,"
+             "\"lastMs\":[",
+             i ? "," : "", getName(i), OUTPUT_PINS[i], s.on ? "true" : "false",
+             (unsigned long)(s.onMs / 1000), (unsigned long)s.cycles,
+             (unsigned long)s.currentMs, (unsigned long)s.recentAvgMs(),
+             (unsigned long)s.lifetimeAvgMs());
+    out += buf;
+    for (uint8_t k = 0; k < s.recent; k++) {
+      snprintf(buf, sizeof(buf), "%s%lu", k ? "," : "",
+               (unsigned long)s.recentMs[k]);
+      out += buf;
+    }
+    out += "]}";
+  }
+  out += "]";
+}
+
+// ============================================================================
+// PERSISTENCE
+// ============================================================================
+
+void ActuatorLog::_snapshot(Saved *out) const {
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
+    Stats s = getStats(i);
+    out[i].onS = (uint32_t)(s.onMs / 1000);
+    out[i].cycles = s.cycles;
+  }
+}
+
+void ActuatorLog::_writeNvs(const Saved *rec) {
+  if (memcmp(rec, _nvsCopy, sizeof(_nvsCopy)) == 0)
+    return;
+  if (_prefs.putBytes("rt", rec, sizeof(_nvsCopy)) == sizeof(_nvsCopy))
+    memcpy(_nvsCopy, rec, sizeof(_nvsCopy));
+  else
+    Serial.println("[Actuators] ERROR: NVS write failed");
+}
@@ -0,0 +1,270 @@
+#include "CounterStore.h"
+#include "Crc32.h"
+#include <stddef.h>
+
+static constexpr uint8_t READ_CHUNK = 32; // Well under the 128 B Wire buffer
+
+CounterStore::CounterStore()
+    : _wire(nullptr), _addr(EEPROM_I2C_ADDR), _ready(false), _id(0),
+      _writes(0), _lastWriteMs(0) {
+  memset(_banks, 0, sizeof(_banks));
+}
+
+// ============================================================================
+// BOOT: PROBE, RECONCILE WITH NVS, SCAN
+// ============================================================================
+
+bool CounterStore::begin(TwoWire &wire, uint8_t addr) {
+  _wire = &wire;
+  _addr = addr;
+  _ready = false;
+  _id = 0;
+  memset(_banks, 0, sizeof(_banks));
+
+  Preferences prefs;
+  prefs.begin("counters", false);
+  uint32_t nvsId = prefs.getUInt("id", 0);
+  bool nvsNewer = prefs.getUChar("nvsNew", 0) != 0;
+
+  _wire->beginTransmission(_addr);
+  if (_wire->endTransmission() != 0) {
+    // Owners keep writing NVS: it must win once the EEPROM is back
+    Serial.printf("[Counters] No EEPROM at 0x%02X, counters stay in NVS\n",
+                  _addr);
+    if (!nvsNewer)
+      prefs.putUChar("nvsNew", 1);
+    prefs.end();
+    return false;
+  }
+
+  Header h;
+  bool valid = _readBytes(0, &h, sizeof(h)) && h.magic == COUNTER_MAGIC &&
+               h.version == COUNTER_VERSION &&
+               h.banks == COUNTER_MAX_BANKS &&
+               h.slotsPerBank == COUNTER_SLOTS_PER_BANK &&
+               h.crc == crc32(&h, offsetof(Header, crc));
+
+  if (valid && h.id != 0 && h.id == nvsId && !nvsNewer) {
+    _id = h.id;
+    _ready = true;
+    _scanBanks();
+    Serial.printf("[Counters] EEPROM store %08lX loaded\n",
+                  (unsigned long)_id);
+  } else {
+    const char *why = !valid            ? "blank"
+                      : nvsId == 0      ? "not yet adopted"
+                      : h.id != nvsId   ? "from another controller"
+                                        : "older than NVS";
+    Serial.printf("[Counters] EEPROM %s, reseeding from NVS\n", why);
+    _ready = _format(prefs);
+  }
+  prefs.end();
+  return _ready;
+}
+
+bool CounterStore::_format(Preferences &prefs) {
+  Header h = {};
+  h.magic = COUNTER_MAGIC;
+  h.version = COUNTER_VERSION;
+  h.banks = COUNTER_MAX_BANKS;
+  h.slotsPerBank = COUNTER_SLOTS_PER_BANK;
+  do {
+    h.id = esp_random();
+  } while (h.id == 0);
+  h.crc = crc32(&h, offsetof(Header, crc));
+
+  // Header first: a cut before the NVS id is written just formats again
+  if (!_writePage(0, &h, sizeof(h))) {
+    Serial.println("[Counters] EEPROM header write failed");
+    return false;
+  }
+  _id = h.id;
+  prefs.putUInt("id", _id);
+  prefs.putUChar("nvsNew", 0);
+  memset(_banks, 0, sizeof(_banks)); // Old slots fail the new id's CRC
+  return true;
+}
+
+void CounterStore::_scanBanks() {
+  // Slots may span pages: read the whole bank and try every page as a start
+  uint8_t buf[COUNTER_SLOTS_PER_BANK * EEPROM_PAGE_SIZE];
+  for (uint8_t b = 0; b < COUNTER_MAX_BANKS; b++) {
+    if (!_readBytes(_pageAddr(b, 0), buf, sizeof(buf)))
+      continue;
+    for (uint8_t p = 0; p < COUNTER_SLOTS_PER_BANK; p++) {
+      const uint8_t *slot = buf + p * EEPROM_PAGE_SIZE;
+      SlotHead h;
+      memcpy(&h, slot, sizeof(h));
+      if (h.bank != b || h.len > MAX_RECORD || h.seq <= _banks[b].seq)
+        continue;
+      uint8_t pages = _pagesFor(h.len);
+      size_t size = pages * EEPROM_PAGE_SIZE;
+      uint32_t crc;
+      if (p + pages > COUNTER_SLOTS_PER_BANK)
+        continue;
+      memcpy(&crc, slot + size - sizeof(crc), sizeof(crc));
+      if (crc != crc32(slot, size - sizeof(crc), _id))
+        continue;
+      Bank &bank = _banks[b];
+      bank.seq = h.seq;
+      bank.page = p;
+      bank.pages = pages;
+      bank.len = h.len;
+      bank.dataCrc = crc32(slot + sizeof(h), h.len);
+    }
+  }
+}
+
+// ============================================================================
+// RECORDS
+// ============================================================================
+
+bool CounterStore::readBank(CounterBank bank, void *data, size_t len) {
+  uint8_t b = (uint8_t)bank;
+  if (!_ready || b >= COUNTER_MAX_BANKS || _banks[b].seq == 0 ||
+      _banks[b].len != len)
+    return false;
+  const Bank &cur = _banks[b];
+  return _readBytes(_pageAddr(b, cur.page) + sizeof(SlotHead), data, len) &&
+         crc32(data, len) == cur.dataCrc;
+}
+
+size_t CounterStore::getBankLength(CounterBank bank) const {
+  uint8_t b = (uint8_t)bank;
+  if (!_ready || b >= COUNTER_MAX_BANKS || _banks[b].seq == 0)
+    return 0;
+  return _banks[b].len;
+}
+
+bool CounterStore::writeBank(CounterBank bank, const void *data, size_t len) {
+  uint8_t b = (uint8_t)bank;
+  if (!_ready || b >= COUNTER_MAX_BANKS || len > MAX_RECORD)
+    return false;
+  Bank &cur = _banks[b];
+  uint32_t dataCrc = crc32(data, len);
+  if (cur.seq && cur.len == len && cur.dataCrc == dataCrc)
+    return true;
+
+  uint8_t pages = _pagesFor(len);
+  size_t size = pages * EEPROM_PAGE_SIZE;
+  uint8_t slot[COUNTER_SLOTS_PER_BANK / 2 * EEPROM_PAGE_SIZE] = {};
+  SlotHead h = {cur.seq + 1, b, (uint8_t)len};
+  memcpy(slot, &h, sizeof(h));
+  memcpy(slot + sizeof(h), data, len);
+  uint32_t crc = crc32(slot, size - sizeof(crc), _id);
+  memcpy(slot + size - sizeof(crc), &crc, sizeof(crc));
+  uint8_t next = cur.seq ? cur.page + cur.pages : 0;
+  if (next + pages > COUNTER_SLOTS_PER_BANK)
+    next = 0;
+
+  // A cut between pages leaves a slot whose CRC fails: the old one wins
+  for (uint8_t p = 0; p < pages; p++) {
+    if (!_writePage(_pageAddr(b, next + p), slot + p * EEPROM_PAGE_SIZE,
+                    EEPROM_PAGE_SIZE)) {
+      Serial.printf("[Counters] EEPROM write failed (bank %u), using NVS\n",
+                    b);
+      _ready = false;
+      _markNvsNewer();
+      return false;
+    }
+  }
+  cur.seq = h.seq;
+  cur.page = next;
+  cur.pages = pages;
+  cur.len = len;
+  cur.dataCrc = dataCrc;
+  _writes++;
+  return true;
+}
+
+uint32_t CounterStore::getBankSeq(CounterBank bank) const {
+  uint8_t b = (uint8_t)bank;
+  return b < COUNTER_MAX_BANKS ? _banks[b].seq : 0;
+}
+
+void CounterStore::printReport() const {
+  if (!_ready) {
+    Serial.println("[Counters] EEPROM not in use, counters in NVS");
+    return;
+  }
+  Serial.printf("[Counters] EEPROM 0x%02X, store %08lX, %lu writes since "
+                "boot\n",
+                _addr, (unsigned long)_id, (unsigned long)_writes);
+  for (uint8_t b = 0; b < COUNTER_MAX_BANKS; b++) {
+    if (_banks[b].seq)
+      Serial.printf("  bank %u  seq %lu  %3u B  page %2u/%u\n", b,
+                    (unsigned long)_banks[b].seq, _banks[b].len,
+                    _banks[b].page, COUNTER_SLOTS_PER_BANK);
+  }
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+uint8_t CounterStore::_pagesFor(size_t len) {
+  size_t bytes = sizeof(SlotHead) + len + sizeof(uint32_t);
+  return (uint8_t)((bytes + EEPROM_PAGE_SIZE - 1) / EEPROM_PAGE_SIZE);
+}
+
+uint16_t CounterStore::_pageAddr(uint8_t bank, uint8_t page) {
+  return (uint16_t)(1 + bank * COUNTER_SLOTS_PER_BANK + page) *
+         EEPROM_PAGE_SIZE;
+}
+
+void CounterStore::_markNvsNewer() {
+  Preferences prefs;
+  prefs.begin("counters", false);
+  prefs.putUChar("nvsNew", 1);
+  prefs.end();
+}
+
+// ---- AT24C32 access ----
+
+bool CounterStore::_waitReady() {
+  // After a page write the chip NACKs until its internal cycle ends
+  if (millis() - _lastWriteMs >= EEPROM_WRITE_CYCLE_MS)
+    return true;
+  for (uint8_t i = 0; i < 100; i++) {
+    _wire->beginTransmission(_addr);
+    if (_wire->endTransmission() == 0)
+      return true;
+    delayMicroseconds(100);
+  }
+  return false;
+}
+
+bool CounterStore::_readBytes(uint16_t addr, void *data, size_t len) {
+  uint8_t *p = static_cast<uint8_t *>(data);
+  while (len) {
+    uint8_t n = len > READ_CHUNK ? READ_CHUNK : (uint8_t)len;
+    if (!_waitReady())
+      return false;
+    _wire->beginTransmission(_addr);
+    _wire->write((uint8_t)(addr >> 8));
+    _wire->write((uint8_t)(addr & 0xFF));
+    if (_wire->endTransmission(false) != 0)
+      return false;
+    if (_wire->requestFrom(_addr, n) != n)
+      return false;
+    for (uint8_t i = 0; i < n; i++)
+      p[i] = _wire->read();
+    p += n;
+    addr += n;
+    len -= n;
+  }
+  return true;
+}
+
+bool CounterStore::_writePage(uint16_t addr, const void *data, size_t len) {
+  // Callers pass whole, page-aligned pages: a write never wraps in-page
+  if (!_waitReady())
+    return false;
+  _wire->beginTransmission(_addr);
+  _wire->write((uint8_t)(addr >> 8));
+  _wire->write((uint8_t)(addr & 0xFF));
+  _wire->write(static_cast<const uint8_t *>(data), len);
+  bool ok = _wire->endTransmission() == 0;
+  _lastWriteMs = millis();
+  return ok;
+}
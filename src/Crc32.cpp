@@ -0,0 +1,13 @@
+#include "Crc32.h"
+
+uint32_t crc32(const void *data, size_t len, uint32_t crc) {
+  // Bitwise: a few hundred bytes per save does not justify a 1 KB table
+  const uint8_t *p = static_cast<const uint8_t *>(data);
+  crc = ~crc;
+  while (len--) {
+    crc ^= *p++;
+    for (uint8_t b = 0; b < 8; b++)
+      crc = (crc >> 1) ^ (0xEDB88320UL & (0UL - (crc & 1)));
+  }
+  return ~crc;
+}
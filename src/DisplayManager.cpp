@@ -661,8 +661,12 @@ void DisplayManager::_drawAquariumPageLive() {
 // =============================================================================
 void DisplayManager::_drawStockPage() {
   const uint8_t numBars = NUM_FERTS + 1;
-  const uint8_t barW = 22;
+  // 22 px bars up to 5 channels; more channels narrow the bars, and each
+  // text row is drawn only where its label fits the channel's slot
+  const uint8_t fitW = (160 - 2 * (numBars + 1)) / numBars;
+  const uint8_t barW = fitW < 22 ? fitW : 22;
   const uint8_t gap = (160 - numBars * barW) / (numBars + 1);
+  const uint8_t slotW = barW + gap;
   const uint8_t barTop = 40; // pushed down to avoid header overlap
   const uint8_t barH = 60;
 
@@ -677,8 +681,8 @@ void DisplayManager::_drawStockPage() {
       pct = 0.0f;
     uint8_t fillH = (uint8_t)(pct * barH);
 
-    // Unique color per channel
-    uint16_t chColor = CHANNEL_COLORS[i % 5];
+    // Unique color per channel (ferts cycle, prime keeps its own)
+    uint16_t chColor = CHANNEL_COLORS[i == NUM_FERTS ? 4 : i % 4];
 
     // Bar outline in channel color
     _display.drawRect(x, barTop, barW, barH, chColor);
@@ -695,8 +699,10 @@ void DisplayManager::_drawStockPage() {
     uint8_t tw = strlen(buf) * 6;
     _display.setTextSize(1);
     _display.setTextColor(chColor);
-    _display.setCursor(x + (barW - tw) / 2, barTop - 10);
-    _display.print(buf);
+    if (tw <= slotW) {
+      _display.setCursor(x + (barW - tw) / 2, barTop - 10);
+      _display.print(buf);
+    }
 
     // Channel name below bar (from saved config)
     String name = _fert->getName(i);
@@ -707,9 +713,12 @@ void DisplayManager::_drawStockPage() {
         name = "PR";
       }
     }
-    // Truncate to fit bar width (max 3 chars at size 1)
-    if (name.length() > 3) {
-      name = name.substring(0, 3);
+    // Truncate to fit the slot (max 3 chars at size 1)
+    uint8_t maxChars = slotW / 6 < 3 ? slotW / 6 : 3;
+    if (maxChars < 1)
+      maxChars = 1;
+    if (name.length() > maxChars) {
+      name = name.substring(0, maxChars);
     }
     _display.setTextColor(chColor);
     uint8_t lw = name.length() * 6;
@@ -721,8 +730,10 @@ void DisplayManager::_drawStockPage() {
     char mlBuf[8];
     snprintf(mlBuf, sizeof(mlBuf), "%.0f", stock);
     uint8_t mlW = strlen(mlBuf) * 6;
-    _display.setCursor(x + (barW - mlW) / 2, barTop + barH + 14);
-    _display.print(mlBuf);
+    if (mlW <= slotW) {
+      _display.setCursor(x + (barW - mlW) / 2, barTop + barH + 14);
+      _display.print(mlBuf);
+    }
   }
 }
 
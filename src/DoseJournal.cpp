@@ -0,0 +1,428 @@
+#include "DoseJournal.h"
+#include "Crc32.h"
+#include <stddef.h>
+
+static constexpr size_t RECORD_CRC_LEN = offsetof(DoseJournal::Record, crc);
+static constexpr uint8_t READ_BATCH = 8; // Records per file read (192 B)
+
+DoseJournal::DoseJournal() : _fs(nullptr), _segCount(0) {
+  _dir[0] = '\0';
+  memset(_segs, 0, sizeof(_segs));
+}
+
+// ============================================================================
+// BOOT SCAN
+// ============================================================================
+
+bool DoseJournal::begin(fs::FS &fs, const char *dir) {
+  _fs = nullptr;
+  _segCount = 0;
+  strncpy(_dir, dir, sizeof(_dir) - 1);
+  _dir[sizeof(_dir) - 1] = '\0';
+
+  if (!fs.exists(_dir) && !fs.mkdir(_dir)) {
+    Serial.printf("[Journal] Cannot create %s\n", _dir);
+    return false;
+  }
+
+  // Keep the newest JOURNAL_MAX_SEGMENTS segment numbers, oldest first
+  uint16_t keep[JOURNAL_MAX_SEGMENTS];
+  uint8_t kept = 0;
+  bool stale = false;
+  File root = fs.open(_dir);
+  if (!root || !root.isDirectory()) {
+    Serial.printf("[Journal] %s is not a directory\n", _dir);
+    return false;
+  }
+  for (File f = root.openNextFile(); f; f = root.openNextFile()) {
+    uint16_t seq;
+    bool isSeg = _parseName(f.name(), seq);
+    f.close();
+    if (!isSeg)
+      continue;
+    if (kept == JOURNAL_MAX_SEGMENTS) {
+      stale = true;
+      if (seq < keep[0])
+        continue;
+      memmove(keep, keep + 1, (kept - 1) * sizeof(keep[0]));
+      kept--;
+    }
+    uint8_t i = kept;
+    while (i > 0 && keep[i - 1] > seq) {
+      keep[i] = keep[i - 1];
+      i--;
+    }
+    keep[i] = seq;
+    kept++;
+  }
+  root.close();
+  _fs = &fs;
+
+  while (stale) {
+    // JOURNAL_MAX_SEGMENTS was lowered: drop segments older than those kept,
+    // a few per directory pass (no removal while iterating)
+    uint16_t old[8];
+    uint8_t nOld = 0;
+    root = fs.open(_dir);
+    for (File f = root.openNextFile(); f && nOld < 8;
+         f = root.openNextFile()) {
+      uint16_t seq;
+      if (_parseName(f.name(), seq) && seq < keep[0])
+        old[nOld++] = seq;
+      f.close();
+    }
+    root.close();
+    char path[40];
+    for (uint8_t i = 0; i < nOld; i++) {
+      _path(old[i], path, sizeof(path));
+      _fs->remove(path);
+    }
+    stale = nOld == 8;
+  }
+
+  for (uint8_t i = 0; i < kept; i++) {
+    Segment seg;
+    if (_scanSegment(keep[i], seg))
+      _segs[_segCount++] = seg;
+  }
+  // Only the newest segment is ever appended to
+  for (uint8_t i = 0; i + 1 < _segCount; i++)
+    _segs[i].sealed = true;
+
+  Serial.printf("[Journal] %u segment(s), %lu dose(s)", _segCount,
+                (unsigned long)getEntryCount());
+  if (_segCount)
+    Serial.printf(" from %lu to %lu", (unsigned long)getOldestEpoch(),
+                  (unsigned long)getNewestEpoch());
+  Serial.println();
+  return true;
+}
+
+bool DoseJournal::_scanSegment(uint16_t seq, Segment &seg) {
+  char path[40];
+  _path(seq, path, sizeof(path));
+  File f = _fs->open(path, FILE_READ);
+  if (!f)
+    return false;
+
+  size_t size = f.size();
+  memset(&seg, 0, sizeof(seg));
+  seg.seq = seq;
+  seg.sorted = true;
+
+  // Count the valid prefix; anything after a bad record is a torn write
+  Record batch[READ_BATCH];
+  bool torn = false;
+  while (!torn && seg.count < JOURNAL_SEGMENT_ENTRIES) {
+    size_t got = f.read((uint8_t *)batch, sizeof(batch)) / sizeof(Record);
+    if (!got)
+      break;
+    for (size_t i = 0; i < got && seg.count < JOURNAL_SEGMENT_ENTRIES; i++) {
+      if (!isValid(batch[i])) {
+        torn = true;
+        break;
+      }
+      uint32_t t = batch[i].epoch;
+      if (seg.count == 0) {
+        seg.minEpoch = seg.maxEpoch = t;
+      } else {
+        if (t < seg.maxEpoch)
+          seg.sorted = false;
+        seg.minEpoch = min(seg.minEpoch, t);
+        seg.maxEpoch = max(seg.maxEpoch, t);
+      }
+      seg.count++;
+    }
+  }
+  f.close();
+
+  if (seg.count == 0) {
+    _fs->remove(path);
+    return false;
+  }
+  if (size != (size_t)seg.count * sizeof(Record)) {
+    Serial.printf("[Journal] %s: %u valid record(s), %u stray byte(s)\n",
+                  path, seg.count,
+                  (unsigned)(size - (size_t)seg.count * sizeof(Record)));
+    seg.sealed = true;
+  }
+  if (seg.count >= JOURNAL_SEGMENT_ENTRIES)
+    seg.sealed = true;
+  return true;
+}
+
+// ============================================================================
+// APPEND
+// ============================================================================
+
+bool DoseJournal::append(Record rec) {
+  if (!_fs)
+    return false;
+  rec.crc = crc32(&rec, RECORD_CRC_LEN);
+
+  if (_segCount == 0 || _segs[_segCount - 1].sealed)
+    _openSegment();
+
+  // Only this (single) writer mutates the index, so reading it unlocked here
+  // is safe; updates are published under the lock for concurrent queries
+  const Segment &seg = _segs[_segCount - 1];
+  char path[40];
+  _path(seg.seq, path, sizeof(path));
+  File f = _fs->open(path, FILE_APPEND);
+  size_t written = 0;
+  if (f) {
+    written = f.write((const uint8_t *)&rec, sizeof(rec));
+    f.close(); // Commits the record (LittleFS is copy-on-write)
+  }
+  bool ok = written == sizeof(rec);
+
+  portENTER_CRITICAL(&_mux);
+  Segment &s = _segs[_segCount - 1];
+  if (ok) {
+    if (s.count == 0) {
+      s.minEpoch = s.maxEpoch = rec.epoch;
+    } else {
+      if (rec.epoch < s.maxEpoch)
+        s.sorted = false; // Clock stepped back: linear scan from now on
+      s.minEpoch = min(s.minEpoch, rec.epoch);
+      s.maxEpoch = max(s.maxEpoch, rec.epoch);
+    }
+    s.count++;
+    if (s.count >= JOURNAL_SEGMENT_ENTRIES)
+      s.sealed = true;
+  } else if (written > 0) {
+    s.sealed = true; // Partial record on disk: never append after it
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  if (!ok)
+    Serial.printf("[Journal] Write to %s failed\n", path);
+  return ok;
+}
+
+void DoseJournal::_openSegment() {
+  uint16_t seq = _segCount ? _segs[_segCount - 1].seq + 1 : 0;
+
+  if (_segCount == JOURNAL_MAX_SEGMENTS) {
+    char path[40];
+    _path(_segs[0].seq, path, sizeof(path));
+    portENTER_CRITICAL(&_mux);
+    memmove(_segs, _segs + 1, (_segCount - 1) * sizeof(Segment));
+    _segCount--;
+    portEXIT_CRITICAL(&_mux);
+    _fs->remove(path);
+  }
+
+  Segment seg = {};
+  seg.seq = seq;
+  seg.sorted = true;
+  portENTER_CRITICAL(&_mux);
+  _segs[_segCount++] = seg;
+  portEXIT_CRITICAL(&_mux);
+}
+
+// ============================================================================
+// QUERIES
+// ============================================================================
+
+void DoseJournal::beginQuery(Query &q, uint32_t from, uint32_t to,
+                             uint8_t channel) const {
+  memset(&q, 0, sizeof(q));
+  q.from = from;
+  q.to = to;
+  q.channel = channel;
+}
+
+size_t DoseJournal::read(Query &q, Record *out, size_t max) {
+  size_t n = 0;
+  while (n < max && !q.done) {
+    Segment seg;
+    bool have = false;
+    portENTER_CRITICAL(&_mux);
+    int idx = q.started ? _findSegment(q.seq) : -1;
+    if (idx < 0 && _segCount) {
+      // First read, or our segment was rotated out: only the oldest is ever
+      // deleted, so everything left is newer
+      idx = 0;
+      _enterSegment(q, idx);
+    }
+    if (idx >= 0 && idx < _segCount) {
+      seg = _segs[idx];
+      have = true;
+    }
+    portEXIT_CRITICAL(&_mux);
+    if (!have || !_fs) {
+      q.done = true;
+      break;
+    }
+
+    // Time index: skip segments entirely outside the range
+    if (seg.count && seg.maxEpoch >= q.from && seg.minEpoch <= q.to)
+      n += _readSegment(q, seg, out + n, max - n);
+    else
+      q.pos = seg.count;
+
+    if (q.pos >= seg.count) {
+      portENTER_CRITICAL(&_mux);
+      idx = _findSegment(q.seq);
+      if (idx >= 0 && idx + 1 < _segCount)
+        _enterSegment(q, idx + 1);
+      else if (idx >= 0)
+        q.done = true; // Newest segment read to its count at entry
+      portEXIT_CRITICAL(&_mux);
+    }
+  }
+  return n;
+}
+
+size_t DoseJournal::_readSegment(Query &q, const Segment &seg, Record *out,
+                                 size_t max) {
+  char path[40];
+  _path(seg.seq, path, sizeof(path));
+  File f = _fs->open(path, FILE_READ);
+  if (!f) {
+    q.pos = seg.count; // Rotated out under us
+    return 0;
+  }
+
+  if (q.seek) {
+    q.seek = false;
+    if (seg.sorted && q.from > seg.minEpoch)
+      q.pos = _lowerBound(f, seg.count, q.from);
+  }
+  if (!f.seek((uint32_t)q.pos * sizeof(Record))) {
+    f.close();
+    q.pos = seg.count;
+    return 0;
+  }
+
+  size_t n = 0;
+  Record batch[READ_BATCH];
+  while (n < max && q.pos < seg.count) {
+    size_t want = min<size_t>(READ_BATCH, seg.count - q.pos);
+    size_t got = f.read((uint8_t *)batch, want * sizeof(Record)) /
+                 sizeof(Record);
+    if (!got) {
+      q.pos = seg.count;
+      break;
+    }
+    for (size_t i = 0; i < got && n < max; i++) {
+      const Record &r = batch[i];
+      q.pos++;
+      if (!isValid(r))
+        continue;
+      if (seg.sorted && r.epoch > q.to) {
+        q.pos = seg.count; // Nothing later in this segment can match
+        break;
+      }
+      if (r.epoch < q.from || r.epoch > q.to)
+        continue;
+      if (q.channel != ALL_CHANNELS && r.channel != q.channel)
+        continue;
+      out[n++] = r;
+    }
+  }
+  f.close();
+  return n;
+}
+
+uint16_t DoseJournal::_lowerBound(fs::File &f, uint16_t count,
+                                  uint32_t epoch) {
+  // First record with epoch >= `epoch`, reading only the epoch fields
+  uint16_t lo = 0, hi = count;
+  while (lo < hi) {
+    uint16_t mid = lo + (hi - lo) / 2;
+    uint32_t t = 0;
+    if (!f.seek((uint32_t)mid * sizeof(Record)) ||
+        f.read((uint8_t *)&t, sizeof(t)) != sizeof(t))
+      return lo;
+    if (t < epoch)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// ============================================================================
+// HELPERS
+// ============================================================================
+
+bool DoseJournal::isValid(const Record &rec) {
+  return rec.crc == crc32(&rec, RECORD_CRC_LEN);
+}
+
+const char *DoseJournal::resultName(uint8_t result) {
+  switch ((Result)result) {
+  case Result::OK:
+    return "ok";
+  case Result::ABORTED:
+    return "aborted";
+  }
+  return "unknown";
+}
+
+uint32_t DoseJournal::getEntryCount() const {
+  uint32_t total = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < _segCount; i++)
+    total += _segs[i].count;
+  portEXIT_CRITICAL(&_mux);
+  return total;
+}
+
+uint32_t DoseJournal::getOldestEpoch() const {
+  uint32_t t = 0;
+  bool any = false;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < _segCount; i++) {
+    if (_segs[i].count && (!any || _segs[i].minEpoch < t)) {
+      t = _segs[i].minEpoch;
+      any = true;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+  return t;
+}
+
+uint32_t DoseJournal::getNewestEpoch() const {
+  uint32_t t = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < _segCount; i++) {
+    if (_segs[i].count && _segs[i].maxEpoch > t)
+      t = _segs[i].maxEpoch;
+  }
+  portEXIT_CRITICAL(&_mux);
+  return t;
+}
+
+void DoseJournal::_path(uint16_t seq, char *buf, size_t len) const {
+  snprintf(buf, len, "%s/%05u.jnl", _dir, seq);
+}
+
+bool DoseJournal::_parseName(const char *name, uint16_t &seq) {
+  const char *base = strrchr(name, '/'); // Some cores return the full path
+  base = base ? base + 1 : name;
+  unsigned n;
+  char ext[4];
+  if (sscanf(base, "%5u.%3s", &n, ext) != 2 || strcmp(ext, "jnl") != 0 ||
+      n > 0xFFFF)
+    return false;
+  seq = (uint16_t)n;
+  return true;
+}
+
+int DoseJournal::_findSegment(uint16_t seq) const {
+  for (uint8_t i = 0; i < _segCount; i++) {
+    if (_segs[i].seq == seq)
+      return i;
+  }
+  return -1;
+}
+
+void DoseJournal::_enterSegment(Query &q, int idx) const {
+  q.seq = _segs[idx].seq;
+  q.pos = 0;
+  q.started = true;
+  q.seek = true;
+}
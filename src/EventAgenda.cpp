@@ -0,0 +1,152 @@
+#include "EventAgenda.h"
+
+const char *agendaKindName(AgendaKind kind) {
+  switch (kind) {
+  case AgendaKind::FERT_DOSE:
+    return "fert";
+  case AgendaKind::TPA:
+    return "tpa";
+  case AgendaKind::DAILY_REPORT:
+    return "report";
+  case AgendaKind::NEW_DAY:
+    return "new_day";
+  }
+  return "?";
+}
+
+EventAgenda::EventAgenda()
+    : _count(0), _lateCount(0), _missedCount(0), _lastMissed() {}
+
+void EventAgenda::clear() { _count = 0; }
+
+bool EventAgenda::push(uint32_t dueEpoch, AgendaKind kind, uint8_t arg) {
+  if (dueEpoch == 0 || _count >= AGENDA_CAPACITY)
+    return false;
+  _heap[_count] = {dueEpoch, kind, arg};
+  _siftUp(_count);
+  _count++;
+  return true;
+}
+
+bool EventAgenda::popDue(uint32_t nowEpoch, AgendaEvent &out,
+                         AgendaTiming &timing) {
+  if (!isDue(nowEpoch))
+    return false;
+
+  out = _heap[0];
+  _count--;
+  if (_count > 0) {
+    _heap[0] = _heap[_count];
+    _siftDown(0);
+  }
+
+  uint32_t lateS = nowEpoch - out.dueEpoch;
+  if (lateS < 60) {
+    timing = AgendaTiming::ON_TIME;
+    return true;
+  }
+
+  timing = lateS <= AGENDA_LATE_GRACE_S ? AgendaTiming::LATE
+                                        : AgendaTiming::MISSED;
+  if (timing == AgendaTiming::LATE) {
+    _lateCount++;
+  } else {
+    _missedCount++;
+    _lastMissed = out;
+  }
+  Serial.printf("[Agenda] %s %s/%d: due %02lu:%02lu, %lu s late\n",
+                timing == AgendaTiming::LATE ? "Running late" : "MISSED",
+                agendaKindName(out.kind), out.arg,
+                (unsigned long)(out.dueEpoch / 3600 % 24),
+                (unsigned long)(out.dueEpoch / 60 % 60), (unsigned long)lateS);
+  return true;
+}
+
+uint8_t EventAgenda::snapshot(AgendaEvent *out, uint8_t maxCount) const {
+  // Selection over a copy: the agenda is tiny and reports are rare
+  AgendaEvent tmp[AGENDA_CAPACITY];
+  uint8_t n = _count;
+  memcpy(tmp, _heap, n * sizeof(AgendaEvent));
+
+  uint8_t written = 0;
+  while (n > 0 && written < maxCount) {
+    uint8_t best = 0;
+    for (uint8_t i = 1; i < n; i++) {
+      if (_before(tmp[i], tmp[best]))
+        best = i;
+    }
+    out[written++] = tmp[best];
+    tmp[best] = tmp[--n];
+  }
+  return written;
+}
+
+// ============================================================================
+// TIME HELPERS
+// ============================================================================
+
+uint32_t EventAgenda::nextDaily(uint32_t fromEpoch, uint8_t hour,
+                                uint8_t minute) {
+  uint32_t day = fromEpoch / 86400;
+  uint32_t t = day * 86400 + (uint32_t)hour * 3600 + (uint32_t)minute * 60;
+  return t >= fromEpoch ? t : t + 86400;
+}
+
+uint32_t EventAgenda::nextWeekly(uint32_t fromEpoch, const uint8_t hour[7],
+                                 const uint8_t minute[7], uint8_t dayMask) {
+  uint32_t day = fromEpoch / 86400;
+  // Eight days: today's slot may already have passed, same weekday next week
+  for (uint8_t k = 0; k < 8; k++) {
+    uint8_t dow = (uint8_t)((day + k + 4) % 7); // 1970-01-01 was a Thursday
+    if (!(dayMask & (1 << dow)))
+      continue;
+    uint32_t t = (day + k) * 86400 + (uint32_t)hour[dow] * 3600 +
+                 (uint32_t)minute[dow] * 60;
+    if (t >= fromEpoch)
+      return t;
+  }
+  return 0;
+}
+
+// ============================================================================
+// HEAP
+// ============================================================================
+
+bool EventAgenda::_before(const AgendaEvent &a, const AgendaEvent &b) {
+  // Ties in the same minute run in kind order (doses before TPA)
+  if (a.dueEpoch != b.dueEpoch)
+    return a.dueEpoch < b.dueEpoch;
+  if (a.kind != b.kind)
+    return a.kind < b.kind;
+  return a.arg < b.arg;
+}
+
+void EventAgenda::_siftUp(uint8_t i) {
+  while (i > 0) {
+    uint8_t parent = (i - 1) / 2;
+    if (!_before(_heap[i], _heap[parent]))
+      break;
+    AgendaEvent t = _heap[i];
+    _heap[i] = _heap[parent];
+    _heap[parent] = t;
+    i = parent;
+  }
+}
+
+void EventAgenda::_siftDown(uint8_t i) {
+  for (;;) {
+    uint8_t l = 2 * i + 1;
+    uint8_t r = l + 1;
+    uint8_t m = i;
+    if (l < _count && _before(_heap[l], _heap[m]))
+      m = l;
+    if (r < _count && _before(_heap[r], _heap[m]))
+      m = r;
+    if (m == i)
+      return;
+    AgendaEvent t = _heap[i];
+    _heap[i] = _heap[m];
+    _heap[m] = t;
+    i = m;
+  }
+}
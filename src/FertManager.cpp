@@ -1,313 +1,1278 @@
 #include "FertManager.h"
+#include "CounterStore.h"
+#include "Crc32.h"
+#include <algorithm>
+#include <vector>
 
-FertManager::FertManager() {
-  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+template <uint8_t N>
+FertManagerT<N>::FertManagerT()
+    : _schedRev(0), _stateRev(0),
+      _storedChannels(CHANNELS), _cfgDirty(false), _stockDirty(0),
+      _lastDoseDirty(0), _runtimeDirty(false),
+      _counters(nullptr), _lastMirrorMs(0), _doseSeq(0), _held(0),
+      _maxConcurrent(DOSE_MAX_CONCURRENT), _budgetMA(DOSE_CURRENT_BUDGET_MA),
+      _windowOpen(false), _windowReported(true), _doseTimer(nullptr),
+      _doneFn(nullptr), _doneCtx(nullptr), _out(nullptr) {
+  memset(_doses, 0, sizeof(_doses));
+  memset(_undelivered, 0, sizeof(_undelivered));
+  memset(&_window, 0, sizeof(_window));
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    // One entry per day at the default time, 0 mL to prevent accidental
+    // dosing
     for (uint8_t d = 0; d < 7; d++) {
-      _doseML[i][d] =
-          0.0f; // Default 0 for all days to prevent accidental dosing
-      _schedHour[i][d] = DEFAULT_FERT_HOUR;
-      _schedMinute[i][d] = DEFAULT_FERT_MINUTE;
+      _sched[i][d].minuteOfWeek =
+          d * 1440 + DEFAULT_FERT_HOUR * 60 + DEFAULT_FERT_MINUTE;
+      _sched[i][d].centiMl = 0;
     }
+    _schedCount[i] = 7;
     _stockML[i] = DEFAULT_STOCK_ML;
-    _names[i] = (i < NUM_FERTS) ? String("CH") + String(i + 1) : "Prime";
+    _names[i] = (i < N) ? String("CH") + String(i + 1) : "Prime";
     _lastDoseKey[i] = 0;
+    _pumpRunMs[i] = 0;
     _flowRateMLps[i] = FLOW_RATE_ML_PER_SEC; // Default 1.5 mL/s
     _pwm[i] = 255;
     _lowStockThreshold[i] = 50.0f; // Default low stock warning at 50 mL
+    _pumpMA[i] = DOSE_PUMP_CURRENT_MA;
   }
 }
 
-void FertManager::begin() {
+template <uint8_t N> FertManagerT<N>::~FertManagerT() {
+  if (_doseTimer) {
+    esp_timer_stop(_doseTimer);
+    esp_timer_delete(_doseTimer);
+  }
+}
+
+template <uint8_t N>
+void FertManagerT<N>::begin() {
   _prefs.begin("fert", false); // RW mode
   _loadState();
 
-  // Initialize LEDC (hardware PWM) for the pump pins
-  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
-    ledcSetup(i, 5000, 8); // Channel i, 5kHz, 8-bit resolution (0-255)
-    ledcAttachPin(_pinForChannel(i), i);
-    ledcWrite(i, 0); // Initialize OFF
-  }
+  // Pump outputs, all off
+  if (!_output().begin(CHANNELS))
+    Serial.println("[Fert] WARNING: pump output backend not ready");
 
   Serial.println("[Fert] Manager initialized.");
   Serial.printf("[Fert] Last dose key: %u\n", _lastDoseKey[0]);
-  for (uint8_t i = 0; i < NUM_FERTS; i++) {
+  for (uint8_t i = 0; i < N; i++) {
     Serial.printf("[Fert] CH%d ('%s'): stock=%.1f ml\n", i + 1,
                   _names[i].c_str(), _stockML[i]);
   }
   Serial.printf("[Fert] Prime ('%s'): stock=%.1f ml\n",
-                _names[NUM_FERTS].c_str(), _stockML[NUM_FERTS]);
-}
-
-void FertManager::update(DateTime now) {
-  uint32_t todayKey = _dateKey(now);
-  uint8_t currentDow = now.dayOfTheWeek();
-  uint8_t currentHour = now.hour();
-  uint8_t currentMinute = now.minute();
-
-  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
-    // Check if it's the right time for today's day-of-week (minute precision)
-    if (currentHour == _schedHour[i][currentDow] &&
-        currentMinute == _schedMinute[i][currentDow]) {
-      // Check if it was already dosed today
-      if (_lastDoseKey[i] != todayKey) {
-        float ds = _doseML[i][currentDow];
-        if (ds > 0 && _stockML[i] >= ds) {
-          Serial.printf("[Fert] Scheduled auto-dose CH%d: %.1f ml\n", i + 1,
-                        ds);
-          if (doseChannel(i, ds)) {
-            _stockML[i] -= ds;
-            if (_stockML[i] < 0)
-              _stockML[i] = 0;
-            _markDosed(i, now);
-            saveState();
-          }
-        } else if (ds > 0) {
-          Serial.printf(
-              "[Fert] Skipping CH%d: Insufficient stock (%.1f < %.1f)\n", i + 1,
-              _stockML[i], ds);
-        } else if (ds <= 0) {
-          _markDosed(
-              i,
-              now); // Volume is 0 for today, just mark as checked to prevent
-                    // loop repeats if someone sets it via UI during the minute
-        }
-      }
+                _names[N].c_str(), _stockML[N]);
+}
+
+template <uint8_t N>
+void FertManagerT<N>::runScheduledDose(uint8_t ch, DateTime due) {
+  if (ch > N)
+    return;
+
+  // Already ran this dose (or a later one the same day)
+  uint32_t key = _doseKey(due);
+  if (key / 1440 == _lastDoseKey[ch] / 1440 && key <= _lastDoseKey[ch])
+    return;
+
+  uint16_t mow = _minuteOfWeek(due);
+  uint8_t i = _lowerBound(ch, mow);
+  if (i == _schedCount[ch] || _sched[ch][i].minuteOfWeek != mow)
+    return; // No entry at that minute (plan edited since it was queued)
+
+  float ds = _sched[ch][i].centiMl / 100.0f;
+  if (ds > 0 && _stockML[ch] >= ds) {
+    Serial.printf("[Fert] Scheduled auto-dose CH%d: %.1f ml\n", ch + 1, ds);
+    // Marked at start: the pump finishes on its own timer, and a reboot
+    // mid-dose must not repeat it
+    if (startDose(ch, ds)) {
+      _doses[ch].status.scheduled = true;
+      _markDosed(ch, due);
+    }
+  } else if (ds > 0) {
+    Serial.printf("[Fert] Skipping CH%d: Insufficient stock (%.1f < %.1f)\n",
+                  ch + 1, _stockML[ch], ds);
+  } else {
+    // Entry only keeps the day's time: mark as checked to prevent loop
+    // repeats if someone sets a volume via UI during the minute
+    _markDosed(ch, due);
+  }
+}
+
+template <uint8_t N>
+uint32_t FertManagerT<N>::nextDoseEpoch(uint8_t ch, uint32_t fromEpoch) const {
+  if (ch > N)
+    return 0;
+  // Sunday 00:00 of fromEpoch's week (1970-01-01 was a Thursday)
+  uint32_t day = fromEpoch / 86400;
+  uint32_t weekStart = (day - (day + 4) % 7) * 86400UL;
+  uint16_t fromMin = (fromEpoch - weekStart + 59) / 60; // At or after
+  for (uint8_t week = 0; week < 2; week++) {
+    // Binary search to the first entry at or after fromMin; only entries
+    // kept for their time alone (0 mL) are stepped over
+    for (uint8_t i = _lowerBound(ch, fromMin); i < _schedCount[ch]; i++) {
+      const DoseSlot &s = _sched[ch][i];
+      if (s.centiMl > 0)
+        return weekStart + s.minuteOfWeek * 60UL;
     }
+    weekStart += 7 * 86400UL;
+    fromMin = 0;
   }
+  return 0; // No dose in the plan
 }
 
-bool FertManager::doseChannel(uint8_t ch, float ml) {
-  if (ch > NUM_FERTS)
+// ============================================================================
+// DOSING ENGINE
+// ============================================================================
+
+template <uint8_t N>
+bool FertManagerT<N>::startDose(uint8_t ch, float ml) {
+  if (ch > N || ml <= 0)
     return false;
-  if (ml <= 0)
+  // A finished dose waits in DONE for pollDoses(); one such record is set
+  // aside below, a second would be lost
+  portENTER_CRITICAL(&_doseMux);
+  DoseState prev = _doses[ch].status.state;
+  bool busy = prev == DoseState::RUNNING || prev == DoseState::QUEUED ||
+              (prev == DoseState::DONE &&
+               _undelivered[ch].state == DoseState::DONE);
+  portEXIT_CRITICAL(&_doseMux);
+  if (busy) {
+    Serial.printf("[Fert] CH%d busy, dose rejected\n", ch + 1);
     return false;
+  }
 
-  uint8_t pin = _pinForChannel(ch);
   float rate = _flowRateMLps[ch];
   if (rate <= 0)
     rate = FLOW_RATE_ML_PER_SEC; // Fallback safety
 
-  unsigned long durationMs = (unsigned long)((ml / rate) * 1000.0f);
-  unsigned long timeout =
-      (ch == NUM_FERTS) ? TIMEOUT_PRIME_MS : TIMEOUT_FERT_MS;
+  uint32_t durationUs = (uint32_t)((ml / rate) * 1000000.0f);
+  uint32_t timeoutUs =
+      ((ch == N) ? TIMEOUT_PRIME_MS : TIMEOUT_FERT_MS) * 1000UL;
 
   // Cap to timeout
-  if (durationMs > timeout) {
+  if (durationUs > timeoutUs) {
     Serial.printf("[Fert] WARNING: dose duration %lu ms exceeds timeout %lu "
                   "ms. Capping.\n",
-                  durationMs, timeout);
-    durationMs = timeout;
+                  (unsigned long)(durationUs / 1000),
+                  (unsigned long)(timeoutUs / 1000));
+    durationUs = timeoutUs;
+    ml = rate * durationUs / 1000000.0f;
+  }
+
+  if (!_doseTimer) {
+    esp_timer_create_args_t args = {};
+    args.callback = &FertManagerT::_onDoseTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "fert_dose";
+    if (esp_timer_create(&args, &_doseTimer) != ESP_OK) {
+      _doseTimer = nullptr; // pollDoses() stops the pump instead
+      Serial.println("[Fert] WARNING: dose timer unavailable, polling");
+    }
+  }
+
+  // Reserve the volume now so a concurrent schedule check sees it gone
+  _stockML[ch] -= ml;
+  if (_stockML[ch] < 0)
+    _stockML[ch] = 0;
+  _markStockDirty(ch);
+  saveState();
+
+  int64_t nowUs = esp_timer_get_time();
+  Dose d = {};
+  d.status.state = DoseState::QUEUED;
+  d.status.ml = ml;
+  d.status.plannedUs = durationUs;
+  d.queuedUs = nowUs;
+
+  portENTER_CRITICAL(&_doseMux);
+  d.seq = _doseSeq++;
+  if (_doses[ch].status.state == DoseState::DONE)
+    _undelivered[ch] = _doses[ch].status; // Refund/callback still owed
+  _doses[ch] = d;
+  ChannelMask on = _promoteQueuedLocked(nowUs);
+  portEXIT_CRITICAL(&_doseMux);
+  _switchOn(on);
+
+  if (on & ((ChannelMask)1 << ch)) {
+    Serial.printf("[Fert] Activating CH%d for %lu us (Rate: %.2f mL/s)\n",
+                  ch + 1, (unsigned long)durationUs, rate);
+    _armDoseTimer(nowUs);
+  } else {
+    Serial.printf("[Fert] CH%d queued (%u pumps on, %u/%u mA)\n", ch + 1,
+                  getRunningCount(), _activeLoadMA(), _budgetMA);
+  }
+  return true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::stopDose(uint8_t ch) {
+  if (ch > N)
+    return;
+  int64_t nowUs = esp_timer_get_time();
+  bool stopped = false;
+  ChannelMask on = 0;
+
+  portENTER_CRITICAL(&_doseMux);
+  Dose &d = _doses[ch];
+  if (d.status.state == DoseState::RUNNING) {
+    uint32_t ranUs = (uint32_t)(nowUs - d.startUs);
+    d.status.actualUs = ranUs;
+    d.status.aborted = ranUs < d.status.plannedUs;
+    d.status.deliveredMl =
+        d.status.aborted ? d.status.ml * ranUs / d.status.plannedUs
+                         : d.status.ml;
+    d.status.state = DoseState::DONE;
+    stopped = true;
+  } else if (d.status.state == DoseState::QUEUED) {
+    d.status.waitUs = (uint32_t)(nowUs - d.queuedUs);
+    d.status.aborted = true;
+    d.status.deliveredMl = 0;
+    d.status.state = DoseState::DONE;
+  }
+  if (stopped)
+    on = _promoteQueuedLocked(nowUs);
+  _closeWindowIfIdleLocked(nowUs);
+  portEXIT_CRITICAL(&_doseMux);
+
+  if (stopped) {
+    _output().set(ch, 0);
+    _switchOn(on); // Flushes the stop with the starts: one bus write
+    Serial.printf("[Fert] CH%d dose stopped early\n", ch + 1);
+    _armDoseTimer(nowUs); // Next channel's stop, if any
+  }
+}
+
+template <uint8_t N>
+void FertManagerT<N>::stopAllDoses() {
+  // Queue first, so stopping a pump does not start a waiting one
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (getDoseStatus(i).state == DoseState::QUEUED)
+      stopDose(i);
+  }
+  for (uint8_t i = 0; i < CHANNELS; i++)
+    stopDose(i);
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::isDosing(uint8_t ch) const {
+  if (ch > N)
+    return false;
+  portENTER_CRITICAL(&_doseMux);
+  DoseState st = _doses[ch].status.state;
+  portEXIT_CRITICAL(&_doseMux);
+  return st == DoseState::RUNNING || st == DoseState::QUEUED;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::isAnyDosing() const {
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (isDosing(i))
+      return true;
+  }
+  return false;
+}
+
+template <uint8_t N>
+FertDosing::DoseStatus FertManagerT<N>::getDoseStatus(uint8_t ch) const {
+  DoseStatus st = {};
+  if (ch > N)
+    return st;
+  portENTER_CRITICAL(&_doseMux);
+  st = _doses[ch].status;
+  portEXIT_CRITICAL(&_doseMux);
+  return st;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::pollDoses() {
+  // Fallback if the timer could not be created or is late; a bus backend
+  // also retries a write that failed
+  int64_t nowUs = esp_timer_get_time();
+  _stopDue(nowUs);
+  _output().flush();
+
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    DoseStatus earlier, st;
+    portENTER_CRITICAL(&_doseMux);
+    earlier = _undelivered[i];
+    _undelivered[i].state = DoseState::IDLE;
+    st = _doses[i].status;
+    if (st.state == DoseState::DONE)
+      _doses[i].status.state = DoseState::IDLE;
+    portEXIT_CRITICAL(&_doseMux);
+    // In run order
+    if (earlier.state == DoseState::DONE)
+      _deliverDose(i, earlier);
+    if (st.state == DoseState::DONE)
+      _deliverDose(i, st);
+  }
+
+  portENTER_CRITICAL(&_doseMux);
+  bool report = !_windowOpen && !_windowReported;
+  DoseWindow w = _window;
+  _windowReported = true;
+  portEXIT_CRITICAL(&_doseMux);
+  if (report) {
+    Serial.printf("[Fert] Dosing window: %u doses, %.1f ml, %lu ms "
+                  "(peak %u pumps, %u mA)\n",
+                  w.doses, w.ml, (unsigned long)((w.endUs - w.startUs) / 1000),
+                  w.peakPumps, w.peakMA);
+  }
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_deliverDose(uint8_t ch, const DoseStatus &st) {
+  if (st.aborted) {
+    // Give back what the pump never moved
+    _stockML[ch] += st.ml - st.deliveredMl;
+    _markStockDirty(ch);
+  }
+  _pumpRunMs[ch] += st.actualUs / 1000;
+  _runtimeDirty = true;
+  _stateRev++;
+  saveState();
+  Serial.printf("[Fert] CH%d dose done: %.2f ml in %lu us (planned %lu, "
+                "queued %lu)%s\n",
+                ch + 1, st.deliveredMl, (unsigned long)st.actualUs,
+                (unsigned long)st.plannedUs, (unsigned long)st.waitUs,
+                st.aborted ? " ABORTED" : "");
+  if (_doneFn)
+    _doneFn(ch, st, _doneCtx);
+}
+
+// ---- Power budget ----
+
+template <uint8_t N>
+void FertManagerT<N>::setDoseBudget(uint8_t maxConcurrent, uint16_t budgetMA) {
+  if (maxConcurrent < 1)
+    maxConcurrent = 1;
+  if (maxConcurrent > CHANNELS)
+    maxConcurrent = CHANNELS;
+  if (maxConcurrent != _maxConcurrent || budgetMA != _budgetMA) {
+    _maxConcurrent = maxConcurrent;
+    _budgetMA = budgetMA;
+    _markConfigDirty();
+    saveState();
+  }
+  Serial.printf("[Fert] Dose budget: %u pumps, %u mA\n", maxConcurrent,
+                budgetMA);
+}
+
+template <uint8_t N>
+void FertManagerT<N>::setPumpCurrentMA(uint8_t ch, uint16_t mA) {
+  if (ch <= N && _pumpMA[ch] != mA) {
+    _pumpMA[ch] = mA;
+    _markConfigDirty();
+    saveState();
+  }
+}
+
+template <uint8_t N>
+uint16_t FertManagerT<N>::getLoadMA(uint8_t ch) const {
+  if (ch > N)
+    return 0;
+  return (uint16_t)(((uint32_t)_pumpMA[ch] * _pwm[ch] + 254) / 255);
+}
+
+template <uint8_t N>
+uint8_t FertManagerT<N>::getRunningCount() const {
+  uint8_t n = 0;
+  portENTER_CRITICAL(&_doseMux);
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (_doses[i].status.state == DoseState::RUNNING)
+      n++;
+  }
+  portEXIT_CRITICAL(&_doseMux);
+  return n;
+}
+
+template <uint8_t N>
+uint8_t FertManagerT<N>::getQueuedCount() const {
+  uint8_t n = 0;
+  portENTER_CRITICAL(&_doseMux);
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (_doses[i].status.state == DoseState::QUEUED)
+      n++;
+  }
+  portEXIT_CRITICAL(&_doseMux);
+  return n;
+}
+
+template <uint8_t N>
+FertDosing::DoseWindow FertManagerT<N>::getDoseWindow() const {
+  portENTER_CRITICAL(&_doseMux);
+  DoseWindow w = _window;
+  portEXIT_CRITICAL(&_doseMux);
+  return w;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::isDoseWindowOpen() const {
+  portENTER_CRITICAL(&_doseMux);
+  bool open = _windowOpen;
+  portEXIT_CRITICAL(&_doseMux);
+  return open;
+}
+
+// ---- Timer side ----
+
+template <uint8_t N>
+void FertManagerT<N>::_onDoseTimer(void *arg) {
+  FertManagerT *self = static_cast<FertManagerT *>(arg);
+  int64_t nowUs = esp_timer_get_time();
+  self->_stopDue(nowUs);
+  self->_armDoseTimer(nowUs);
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_stopDue(int64_t nowUs) {
+  // Runs on the esp_timer task: pump off/on (at most one bus write) and
+  // bookkeeping only, no flash I/O
+  ChannelMask off = 0;
+  portENTER_CRITICAL(&_doseMux);
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    Dose &d = _doses[i];
+    if (d.status.state != DoseState::RUNNING || d.stopAtUs > nowUs)
+      continue;
+    d.status.actualUs = (uint32_t)(nowUs - d.startUs);
+    d.status.deliveredMl = d.status.ml;
+    d.status.state = DoseState::DONE;
+    off |= (ChannelMask)1 << i;
+  }
+  ChannelMask on = off ? _promoteQueuedLocked(nowUs) : 0;
+  _closeWindowIfIdleLocked(nowUs);
+  portEXIT_CRITICAL(&_doseMux);
+
+  // Off before on, so the budget is never exceeded even briefly (a bus
+  // backend applies both in the same write)
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (off & ((ChannelMask)1 << i))
+      _output().set(i, 0);
+  }
+  _switchOn(on);
+}
+
+template <uint8_t N>
+FertDosing::ChannelMask FertManagerT<N>::_promoteQueuedLocked(int64_t nowUs) {
+  uint8_t running = 0;
+  uint32_t loadMA = 0;
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (_doses[i].status.state == DoseState::RUNNING) {
+      running++;
+      loadMA += getLoadMA(i);
+    }
   }
 
-  Serial.printf("[Fert] Activating pin %d for %lu ms (Rate: %.2f mL/s)\n", pin,
-                durationMs, rate);
-  ledcWrite(ch, _pwm[ch]);
+  ChannelMask on = 0;
+  for (;;) {
+    // Oldest queued dose that fits; a pump larger than the whole budget
+    // still runs, alone
+    int8_t pick = -1;
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+      const Dose &d = _doses[i];
+      if (d.status.state != DoseState::QUEUED)
+        continue;
+      if (_held & ((ChannelMask)1 << i))
+        continue; // Waits for the manual run to end
+      if (running >= _maxConcurrent)
+        break;
+      bool fits = _budgetMA == 0 || running == 0 ||
+                  loadMA + getLoadMA(i) <= _budgetMA;
+      if (fits && (pick < 0 || (int32_t)(d.seq - _doses[pick].seq) < 0))
+        pick = i;
+    }
+    if (pick < 0)
+      break;
+
+    Dose &d = _doses[pick];
+    d.status.state = DoseState::RUNNING;
+    d.status.waitUs = (uint32_t)(nowUs - d.queuedUs);
+    d.startUs = nowUs;
+    d.stopAtUs = nowUs + d.status.plannedUs;
+    running++;
+    loadMA += getLoadMA(pick);
+    on |= (ChannelMask)1 << pick;
 
-  unsigned long start = millis();
-  while ((millis() - start) < durationMs) {
-    delay(10); // Yield to watchdog
+    if (!_windowOpen) {
+      memset(&_window, 0, sizeof(_window));
+      _window.startUs = nowUs;
+      _windowOpen = true;
+      _windowReported = false;
+    }
+    _window.doses++;
+    _window.ml += d.status.ml;
+    if (running > _window.peakPumps)
+      _window.peakPumps = running;
+    if (loadMA > _window.peakMA)
+      _window.peakMA = loadMA;
   }
+  return on;
+}
 
-  ledcWrite(ch, 0);
+template <uint8_t N>
+void FertManagerT<N>::_closeWindowIfIdleLocked(int64_t nowUs) {
+  if (!_windowOpen)
+    return;
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    DoseState st = _doses[i].status.state;
+    if (st == DoseState::RUNNING || st == DoseState::QUEUED)
+      return;
+  }
+  _window.endUs = nowUs;
+  _windowOpen = false;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_switchOn(ChannelMask mask) {
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (mask & ((ChannelMask)1 << i))
+      _output().set(i, _pwm[i]);
+  }
+  _output().flush();
+}
+
+template <uint8_t N>
+uint16_t FertManagerT<N>::_activeLoadMA() const {
+  uint16_t mA = 0;
+  portENTER_CRITICAL(&_doseMux);
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (_doses[i].status.state == DoseState::RUNNING)
+      mA += getLoadMA(i);
+  }
+  portEXIT_CRITICAL(&_doseMux);
+  return mA;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_armDoseTimer(int64_t nowUs) {
+  if (!_doseTimer)
+    return;
+
+  int64_t next = 0;
+  portENTER_CRITICAL(&_doseMux);
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    const Dose &d = _doses[i];
+    if (d.status.state == DoseState::RUNNING &&
+        (next == 0 || d.stopAtUs < next))
+      next = d.stopAtUs;
+  }
+  portEXIT_CRITICAL(&_doseMux);
+
+  if (esp_timer_is_active(_doseTimer))
+    esp_timer_stop(_doseTimer);
+  if (next == 0)
+    return;
+  int64_t waitUs = next - nowUs;
+  esp_timer_start_once(_doseTimer, waitUs > 0 ? (uint64_t)waitUs : 1);
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::beginManualRun(uint8_t ch) {
+  if (ch > N)
+    return false;
+  ChannelMask bit = (ChannelMask)1 << ch;
+  portENTER_CRITICAL(&_doseMux);
+  DoseState st = _doses[ch].status.state;
+  bool ok = !(_held & bit) && st != DoseState::RUNNING &&
+            st != DoseState::QUEUED;
+  if (ok)
+    _held |= bit;
+  portEXIT_CRITICAL(&_doseMux);
+  if (!ok)
+    return false;
+  _output().set(ch, _pwm[ch]);
+  _output().flush();
   return true;
 }
 
-void FertManager::manualPump(uint8_t ch, bool state) {
-  if (ch > NUM_FERTS)
+template <uint8_t N>
+void FertManagerT<N>::endManualRun(uint8_t ch) {
+  if (ch > N)
+    return;
+  ChannelMask bit = (ChannelMask)1 << ch;
+  int64_t nowUs = esp_timer_get_time();
+  portENTER_CRITICAL(&_doseMux);
+  bool held = _held & bit;
+  _held &= ~bit;
+  ChannelMask on = held ? _promoteQueuedLocked(nowUs) : 0;
+  portEXIT_CRITICAL(&_doseMux);
+  if (!held)
+    return;
+  _output().set(ch, 0);
+  _switchOn(on); // Flushes the stop with the starts: one bus write
+  if (on)
+    _armDoseTimer(nowUs);
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::isManualRun(uint8_t ch) const {
+  if (ch > N)
+    return false;
+  portENTER_CRITICAL(&_doseMux);
+  bool held = _held & ((ChannelMask)1 << ch);
+  portEXIT_CRITICAL(&_doseMux);
+  return held;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::manualPump(uint8_t ch, bool state) {
+  if (ch > N)
     return;
-  ledcWrite(ch, state ? _pwm[ch] : 0);
+  if (!state)
+    stopDose(ch); // OFF also ends a timed dose on this channel
+  _output().set(ch, state ? _pwm[ch] : 0);
+  _output().flush();
   Serial.printf("[Fert] Manual pump CH%d set to %s (PWM: %d)\n", ch + 1,
                 state ? "ON" : "OFF", state ? _pwm[ch] : 0);
 }
 
-void FertManager::setPWM(uint8_t ch, uint8_t pwm) {
-  if (ch <= NUM_FERTS) {
+template <uint8_t N>
+void FertManagerT<N>::setPWM(uint8_t ch, uint8_t pwm) {
+  if (ch <= N && _pwm[ch] != pwm) {
     _pwm[ch] = pwm;
+    _markConfigDirty();
     saveState();
   }
 }
 
-void FertManager::setDoseML(uint8_t ch, uint8_t dayOfWeek, float ml) {
-  if (ch <= NUM_FERTS && dayOfWeek < 7) {
-    _doseML[ch][dayOfWeek] = ml;
-  }
+template <uint8_t N>
+bool FertManagerT<N>::setSchedule(uint8_t ch, const DoseSlot *slots,
+                                  uint8_t count) {
+  if (ch > N || count > FERT_SCHEDULE_SLOTS)
+    return false;
+  DoseSlot sorted[FERT_SCHEDULE_SLOTS];
+  memcpy(sorted, slots, count * sizeof(DoseSlot));
+  std::sort(sorted, sorted + count, [](const DoseSlot &a, const DoseSlot &b) {
+    return a.minuteOfWeek < b.minuteOfWeek;
+  });
+  if (!_planValid(sorted, count))
+    return false;
+  if (count == _schedCount[ch] &&
+      memcmp(sorted, _sched[ch], count * sizeof(DoseSlot)) == 0)
+    return true;
+  memcpy(_sched[ch], sorted, count * sizeof(DoseSlot));
+  _schedCount[ch] = count;
+  _planChanged();
+  return true;
 }
 
-float FertManager::getDoseML(uint8_t ch, uint8_t dayOfWeek) const {
-  return (ch <= NUM_FERTS && dayOfWeek < 7) ? _doseML[ch][dayOfWeek] : 0.0f;
+template <uint8_t N>
+FertDosing::DoseSlot FertManagerT<N>::getScheduleSlot(uint8_t ch,
+                                                      uint8_t i) const {
+  if (ch > N || i >= _schedCount[ch])
+    return DoseSlot{0, 0};
+  return _sched[ch][i];
 }
 
-void FertManager::setScheduleTime(uint8_t ch, uint8_t day, uint8_t hour,
-                                  uint8_t minute) {
-  if (ch <= NUM_FERTS && day < 7) {
-    _schedHour[ch][day] = hour;
-    _schedMinute[ch][day] = minute;
+template <uint8_t N>
+void FertManagerT<N>::setDoseML(uint8_t ch, uint8_t dayOfWeek, float ml) {
+  if (ch > N || dayOfWeek >= 7)
+    return;
+  uint16_t centi = _toCentiMl(ml);
+  uint16_t dayEnd = (dayOfWeek + 1) * 1440;
+  uint8_t i = _lowerBound(ch, dayOfWeek * 1440);
+  uint8_t end = i;
+  while (end < _schedCount[ch] && _sched[ch][end].minuteOfWeek < dayEnd)
+    end++;
+
+  if (end == i) {
+    if (!_insertSlot(ch, DoseSlot{(uint16_t)(dayOfWeek * 1440 +
+                                             DEFAULT_FERT_HOUR * 60 +
+                                             DEFAULT_FERT_MINUTE),
+                                  centi}))
+      return;
+  } else {
+    if (end == i + 1 && _sched[ch][i].centiMl == centi)
+      return; // Unchanged
+    _sched[ch][i].centiMl = centi;
+    while (--end > i)
+      _removeSlot(ch, end);
   }
+  _planChanged();
 }
 
-void FertManager::setScheduleTimeAll(uint8_t ch, uint8_t hour, uint8_t minute) {
-  if (ch <= NUM_FERTS) {
-    for (uint8_t d = 0; d < 7; d++) {
-      _schedHour[ch][d] = hour;
-      _schedMinute[ch][d] = minute;
-    }
+template <uint8_t N>
+float FertManagerT<N>::getDoseML(uint8_t ch, uint8_t dayOfWeek) const {
+  if (ch > N || dayOfWeek >= 7)
+    return 0.0f;
+  uint16_t dayEnd = (dayOfWeek + 1) * 1440;
+  uint32_t centi = 0;
+  for (uint8_t i = _lowerBound(ch, dayOfWeek * 1440);
+       i < _schedCount[ch] && _sched[ch][i].minuteOfWeek < dayEnd; i++)
+    centi += _sched[ch][i].centiMl;
+  return centi / 100.0f;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::_moveDayStart(uint8_t ch, uint8_t day, uint8_t hour,
+                                    uint8_t minute) {
+  uint16_t mow = day * 1440 + hour * 60 + minute;
+  uint8_t i = _lowerBound(ch, day * 1440);
+  if (i == _schedCount[ch] || _sched[ch][i].minuteOfWeek >= (day + 1) * 1440)
+    return _insertSlot(ch, DoseSlot{mow, 0}); // Day had no entry
+  if (_sched[ch][i].minuteOfWeek == mow)
+    return false;
+
+  // Re-insert at the new time; a split dose already there absorbs it
+  DoseSlot moved = _sched[ch][i];
+  _removeSlot(ch, i);
+  uint8_t at = _lowerBound(ch, mow);
+  if (at < _schedCount[ch] && _sched[ch][at].minuteOfWeek == mow) {
+    uint32_t sum = (uint32_t)_sched[ch][at].centiMl + moved.centiMl;
+    _sched[ch][at].centiMl = sum > 0xFFFF ? 0xFFFF : sum;
+  } else {
+    moved.minuteOfWeek = mow;
+    _insertSlot(ch, moved);
   }
+  return true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::setScheduleTime(uint8_t ch, uint8_t day, uint8_t hour,
+                                      uint8_t minute) {
+  if (ch <= N && day < 7 && hour < 24 && minute < 60 &&
+      _moveDayStart(ch, day, hour, minute))
+    _planChanged();
 }
 
-void FertManager::setFlowRate(uint8_t ch, float mlPerSec) {
-  if (ch <= NUM_FERTS && mlPerSec > 0.01f) {
+template <uint8_t N>
+void FertManagerT<N>::setScheduleTimeAll(uint8_t ch, uint8_t hour,
+                                         uint8_t minute) {
+  if (ch > N || hour >= 24 || minute >= 60)
+    return;
+  bool changed = false;
+  for (uint8_t d = 0; d < 7; d++)
+    changed |= _moveDayStart(ch, d, hour, minute);
+  if (changed)
+    _planChanged();
+}
+
+template <uint8_t N>
+uint8_t FertManagerT<N>::getSchedHour(uint8_t ch, uint8_t day) const {
+  if (ch > N || day >= 7)
+    return 0;
+  uint8_t i = _lowerBound(ch, day * 1440);
+  if (i == _schedCount[ch] || _sched[ch][i].minuteOfWeek >= (day + 1) * 1440)
+    return DEFAULT_FERT_HOUR;
+  return (_sched[ch][i].minuteOfWeek % 1440) / 60;
+}
+
+template <uint8_t N>
+uint8_t FertManagerT<N>::getSchedMinute(uint8_t ch, uint8_t day) const {
+  if (ch > N || day >= 7)
+    return 0;
+  uint8_t i = _lowerBound(ch, day * 1440);
+  if (i == _schedCount[ch] || _sched[ch][i].minuteOfWeek >= (day + 1) * 1440)
+    return DEFAULT_FERT_MINUTE;
+  return _sched[ch][i].minuteOfWeek % 60;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::setFlowRate(uint8_t ch, float mlPerSec) {
+  if (ch <= N && mlPerSec > 0.01f && _flowRateMLps[ch] != mlPerSec) {
     _flowRateMLps[ch] = mlPerSec;
+    _markConfigDirty();
   }
 }
 
-float FertManager::getStockML(uint8_t ch) const {
-  return (ch <= NUM_FERTS) ? _stockML[ch] : 0;
+template <uint8_t N>
+float FertManagerT<N>::getStockML(uint8_t ch) const {
+  return (ch <= N) ? _stockML[ch] : 0;
 }
 
-void FertManager::setStockML(uint8_t ch, float ml) {
-  if (ch <= NUM_FERTS) {
+template <uint8_t N>
+void FertManagerT<N>::setStockML(uint8_t ch, float ml) {
+  if (ch <= N && _stockML[ch] != ml) {
     _stockML[ch] = ml;
+    _markStockDirty(ch);
   }
 }
 
-void FertManager::resetStock(uint8_t ch, float ml) {
-  if (ch <= NUM_FERTS) {
+template <uint8_t N>
+void FertManagerT<N>::resetStock(uint8_t ch, float ml) {
+  if (ch <= N) {
     _stockML[ch] = ml;
+    _markStockDirty(ch);
     saveState();
     Serial.printf("[Fert] Stock CH%d reset to %.1f ml\n", ch + 1, ml);
   }
 }
 
-void FertManager::setLowStockThreshold(uint8_t ch, float ml) {
-  if (ch <= NUM_FERTS && ml >= 0) {
-    _lowStockThreshold[ch] = ml;
+template <uint8_t N>
+void FertManagerT<N>::setLowStockThreshold(uint8_t ch, float ml) {
+  if (ch <= N && ml >= 0) {
+    if (_lowStockThreshold[ch] != ml) {
+      _lowStockThreshold[ch] = ml;
+      _markConfigDirty();
+    }
     saveState();
     Serial.printf("[Fert] CH%d low stock threshold set to %.0f mL\n", ch + 1,
                   ml);
   }
 }
 
-float FertManager::getLowStockThreshold(uint8_t ch) const {
-  return (ch <= NUM_FERTS) ? _lowStockThreshold[ch] : 50.0f;
+template <uint8_t N>
+float FertManagerT<N>::getLowStockThreshold(uint8_t ch) const {
+  return (ch <= N) ? _lowStockThreshold[ch] : 50.0f;
 }
 
-bool FertManager::isLowStock(uint8_t ch) const {
-  if (ch > NUM_FERTS)
+template <uint8_t N>
+bool FertManagerT<N>::isLowStock(uint8_t ch) const {
+  if (ch > N)
     return false;
   return _stockML[ch] < _lowStockThreshold[ch] && _lowStockThreshold[ch] > 0;
 }
 
-String FertManager::getName(uint8_t ch) const {
-  if (ch <= NUM_FERTS) {
+template <uint8_t N>
+const String &FertManagerT<N>::getName(uint8_t ch) const {
+  static const String none;
+  if (ch <= N) {
     return _names[ch];
   }
-  return "";
+  return none;
 }
 
-void FertManager::setName(uint8_t ch, const String &name) {
-  if (ch <= NUM_FERTS) {
+template <uint8_t N>
+void FertManagerT<N>::setName(uint8_t ch, const String &name) {
+  if (ch <= N) {
     // Truncate name to save NVS space (max 15 chars)
     String safeName = name.substring(0, 15);
-    _names[ch] = safeName;
+    if (safeName != _names[ch]) {
+      _names[ch] = safeName;
+      _markConfigDirty();
+    }
     saveState();
     Serial.printf("[Fert] CH%d renamed to '%s'\n", ch + 1, safeName.c_str());
   }
 }
 
-void FertManager::saveState() {
-  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
-    char key[16];
-
-    for (uint8_t d = 0; d < 7; d++) {
-      snprintf(key, sizeof(key), "d%d_%d", i, d); // e.g. d0_0, d0_6
-      _prefs.putFloat(key, _doseML[i][d]);
-    }
-
-    snprintf(key, sizeof(key), "stock%d", i);
-    _prefs.putFloat(key, _stockML[i]);
-
-    snprintf(key, sizeof(key), "name%d", i);
-    _prefs.putString(key, _names[i]);
+template <uint8_t N>
+void FertManagerT<N>::saveState() {
+  if (_cfgDirty)
+    _saveConfigBlob();
+  _saveCounters();
+}
 
-    snprintf(key, sizeof(key), "lk%d", i); // Last key
-    _prefs.putUInt(key, _lastDoseKey[i]);
+template <uint8_t N>
+void FertManagerT<N>::_saveCounters() {
+  if (!_stockDirty && !_lastDoseDirty && !_runtimeDirty)
+    return;
 
-    // Schedule Hours/Minutes per day of week
-    for (uint8_t d = 0; d < 7; d++) {
-      snprintf(key, sizeof(key), "sH%d_%d", i, d);
-      _prefs.putUChar(key, _schedHour[i][d]);
-      snprintf(key, sizeof(key), "sM%d_%d", i, d);
-      _prefs.putUChar(key, _schedMinute[i][d]);
+  const ChannelMask all = ~(ChannelMask)0 >> (32 - CHANNELS);
+  if (_counters && _counters->isReady()) {
+    bool ok = (!_stockDirty ||
+               _counters->writeBank(CounterBank::FERT_STOCK, _stockML,
+                                    sizeof(_stockML))) &&
+              (!_lastDoseDirty ||
+               _counters->writeBank(CounterBank::FERT_LAST_DOSE,
+                                    _lastDoseKey, sizeof(_lastDoseKey))) &&
+              (!_runtimeDirty ||
+               _counters->writeBank(CounterBank::FERT_RUNTIME, _pumpRunMs,
+                                    sizeof(_pumpRunMs)));
+    if (ok && millis() - _lastMirrorMs < COUNTER_NVS_MIRROR_MS) {
+      _stockDirty = _lastDoseDirty = 0;
+      _runtimeDirty = false;
+      return;
     }
+    // The EEPROM just failed (NVS is the master from now on) or the daily
+    // NVS fallback refresh is due: copy every counter
+    _stockDirty = _lastDoseDirty = all;
+    _runtimeDirty = true;
+    _lastMirrorMs = millis();
+  }
 
-    snprintf(key, sizeof(key), "fR%d", i); // Flow Rate
-    _prefs.putFloat(key, _flowRateMLps[i]);
-
-    snprintf(key, sizeof(key), "pwm%d", i); // PWM Config
-    _prefs.putUChar(key, _pwm[i]);
-
-    snprintf(key, sizeof(key), "lt%d", i); // Low stock Threshold
-    _prefs.putFloat(key, _lowStockThreshold[i]);
+  // NVS: one small key per channel that actually moved
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    char key[16];
+    if (_stockDirty & ((ChannelMask)1 << i)) {
+      snprintf(key, sizeof(key), "stock%d", i);
+      _prefs.putFloat(key, _stockML[i]);
+    }
+    if (_lastDoseDirty & ((ChannelMask)1 << i)) {
+      snprintf(key, sizeof(key), "lk%d", i);
+      _prefs.putUInt(key, _lastDoseKey[i]);
+    }
   }
+  if (_runtimeDirty)
+    _prefs.putBytes("rt", _pumpRunMs, sizeof(_pumpRunMs));
+  _stockDirty = _lastDoseDirty = 0;
+  _runtimeDirty = false;
 }
 
-bool FertManager::wasDosedToday(DateTime now) const {
+template <uint8_t N>
+bool FertManagerT<N>::wasDosedToday(DateTime now) const {
   // Simplification: return true if CH1 was dosed today (telemetry mostly)
-  return _dateKey(now) == _lastDoseKey[0];
+  return _dateKey(now) == _lastDoseKey[0] / 1440;
 }
 
 // ============================================================================
 // PRIVATE
 // ============================================================================
 
-uint32_t FertManager::_dateKey(DateTime dt) const {
+template <uint8_t N>
+uint32_t FertManagerT<N>::_dateKey(DateTime dt) const {
   // Unique key per day: year * 1000 + dayOfYear
   // dayOfYear approximation using month*31+day (good enough for dedup)
   return (uint32_t)dt.year() * 1000 + (uint32_t)dt.month() * 31 +
          (uint32_t)dt.day();
 }
 
-void FertManager::_loadState() {
-  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+template <uint8_t N>
+uint32_t FertManagerT<N>::_doseKey(DateTime dt) const {
+  return _dateKey(dt) * 1440 + dt.hour() * 60 + dt.minute();
+}
+
+template <uint8_t N>
+uint16_t FertManagerT<N>::_minuteOfWeek(DateTime dt) {
+  return dt.dayOfTheWeek() * 1440 + dt.hour() * 60 + dt.minute();
+}
+
+template <uint8_t N>
+uint16_t FertManagerT<N>::_toCentiMl(float ml) {
+  if (!(ml > 0))
+    return 0;
+  return ml >= 655.35f ? 0xFFFF : (uint16_t)(ml * 100.0f + 0.5f);
+}
+
+template <uint8_t N>
+uint8_t FertManagerT<N>::_lowerBound(uint8_t ch, uint16_t minuteOfWeek) const {
+  uint8_t lo = 0, hi = _schedCount[ch];
+  while (lo < hi) {
+    uint8_t mid = (lo + hi) / 2;
+    if (_sched[ch][mid].minuteOfWeek < minuteOfWeek)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::_planValid(const DoseSlot *slots, uint8_t count) {
+  if (count > FERT_SCHEDULE_SLOTS)
+    return false;
+  for (uint8_t i = 0; i < count; i++) {
+    if (slots[i].minuteOfWeek >= MINUTES_PER_WEEK ||
+        (i > 0 && slots[i].minuteOfWeek <= slots[i - 1].minuteOfWeek))
+      return false;
+  }
+  return true;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::_insertSlot(uint8_t ch, DoseSlot slot) {
+  uint8_t at = _lowerBound(ch, slot.minuteOfWeek);
+  if (at < _schedCount[ch] && _sched[ch][at].minuteOfWeek == slot.minuteOfWeek)
+    return false;
+  if (_schedCount[ch] >= FERT_SCHEDULE_SLOTS) {
+    Serial.printf("[Fert] CH%d plan full (%u entries)\n", ch + 1,
+                  FERT_SCHEDULE_SLOTS);
+    return false;
+  }
+  memmove(&_sched[ch][at + 1], &_sched[ch][at],
+          (_schedCount[ch] - at) * sizeof(DoseSlot));
+  _sched[ch][at] = slot;
+  _schedCount[ch]++;
+  return true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_removeSlot(uint8_t ch, uint8_t i) {
+  memmove(&_sched[ch][i], &_sched[ch][i + 1],
+          (_schedCount[ch] - i - 1) * sizeof(DoseSlot));
+  _schedCount[ch]--;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_setPlanFromDays(uint8_t ch, const float doseML[7],
+                                       const uint8_t hour[7],
+                                       const uint8_t minute[7]) {
+  for (uint8_t d = 0; d < 7; d++) {
+    bool valid = hour[d] < 24 && minute[d] < 60;
+    _sched[ch][d].minuteOfWeek =
+        d * 1440 + (valid ? hour[d] * 60 + minute[d]
+                          : DEFAULT_FERT_HOUR * 60 + DEFAULT_FERT_MINUTE);
+    _sched[ch][d].centiMl = _toCentiMl(doseML[d]);
+  }
+  _schedCount[ch] = 7;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_planChanged() {
+  _markConfigDirty();
+  _schedRev++;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_loadState() {
+  _storedChannels = CHANNELS;
+  _cfgDirty = false;
+  if (!_loadConfigBlob()) {
+    // First boot on this layout (or a corrupt blob): rebuild from the
+    // per-key settings, write the blob and drop the old keys
+    _loadLegacyConfig();
+    if (_saveConfigBlob()) {
+      _removeLegacyKeys();
+      Serial.println("[Fert] Config migrated to packed NVS blob.");
+    }
+  }
+  _stockDirty = _lastDoseDirty = 0;
+  _runtimeDirty = false;
+  _schedRev++;
+  _stateRev++;
+
+  _lastMirrorMs = millis();
+  _loadCounters();
+  _upgradeDoseKeys();
+
+  if (_storedChannels != CHANNELS) {
+    // Written by a build with another channel count: rewrite everything in
+    // this layout, NVS copies included (the prime's keys move with N)
+    Serial.printf("[Fert] Channel count changed (%u -> %u), state remapped\n",
+                  _storedChannels, CHANNELS);
+    for (uint8_t i = CHANNELS; i < _storedChannels; i++) {
+      char key[16];
+      snprintf(key, sizeof(key), "stock%d", i);
+      _prefs.remove(key);
+      snprintf(key, sizeof(key), "lk%d", i);
+      _prefs.remove(key);
+    }
+    _cfgDirty = true;
+    _stockDirty = _lastDoseDirty = ~(ChannelMask)0 >> (32 - CHANNELS);
+    _runtimeDirty = true;
+    _lastMirrorMs = millis() - COUNTER_NVS_MIRROR_MS;
+    _storedChannels = CHANNELS;
+  }
+  saveState();
+}
+
+// Index channel ch (of `channels`, prime last) had in a stored layout of
+// `stored` channels, or -1 if that layout did not have it
+static int storedIndex(uint8_t ch, uint8_t channels, uint8_t stored) {
+  if (ch == channels - 1)
+    return stored - 1;
+  return ch < stored - 1 ? ch : -1;
+}
+
+// Read a per-channel counter bank, whatever channel count wrote it
+template <typename T>
+static bool readCounterBank(CounterStore *cs, CounterBank bank, T *dst,
+                            uint8_t channels) {
+  size_t len = cs->getBankLength(bank);
+  size_t stored = len / sizeof(T);
+  if (len % sizeof(T) || stored < 2 || stored > 32)
+    return false;
+  T buf[32];
+  if (!cs->readBank(bank, buf, len))
+    return false;
+  for (uint8_t i = 0; i < channels; i++) {
+    int k = storedIndex(i, channels, stored);
+    if (k >= 0)
+      dst[i] = buf[k];
+  }
+  return true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_loadCounters() {
+  // NVS keys are per stored index; the constructor defaults stay for
+  // channels the stored layout did not have
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    int k = storedIndex(i, CHANNELS, _storedChannels);
+    if (k < 0)
+      continue;
+    char key[16];
+    snprintf(key, sizeof(key), "stock%d", k);
+    _stockML[i] = _prefs.getFloat(key, DEFAULT_STOCK_ML);
+
+    snprintf(key, sizeof(key), "lk%d", k);
+    _lastDoseKey[i] = _prefs.getUInt(key, 0);
+  }
+  size_t rtLen = _prefs.getBytesLength("rt");
+  if (rtLen % sizeof(uint32_t) == 0 && rtLen / sizeof(uint32_t) >= 2 &&
+      rtLen / sizeof(uint32_t) <= 32) {
+    uint32_t rt[32];
+    uint8_t stored = rtLen / sizeof(uint32_t);
+    _prefs.getBytes("rt", rt, rtLen);
+    for (uint8_t i = 0; i < CHANNELS; i++) {
+      int k = storedIndex(i, CHANNELS, stored);
+      if (k >= 0)
+        _pumpRunMs[i] = rt[k];
+    }
+  }
+
+  // The EEPROM holds the newest counters. A store begin() just formatted
+  // has no banks yet: seed it from the NVS values loaded above.
+  if (!_counters || !_counters->isReady())
+    return;
+  const ChannelMask all = ~(ChannelMask)0 >> (32 - CHANNELS);
+  if (!readCounterBank(_counters, CounterBank::FERT_STOCK, _stockML,
+                       CHANNELS))
+    _stockDirty = all;
+  if (!readCounterBank(_counters, CounterBank::FERT_LAST_DOSE, _lastDoseKey,
+                       CHANNELS))
+    _lastDoseDirty = all;
+  if (!readCounterBank(_counters, CounterBank::FERT_RUNTIME, _pumpRunMs,
+                       CHANNELS))
+    _runtimeDirty = true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_upgradeDoseKeys() {
+  // Keys written before per-minute dedup are plain date keys: count them
+  // as "every dose of that day ran"
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    if (_lastDoseKey[i] && _lastDoseKey[i] < LEGACY_DOSE_KEY_LIMIT) {
+      _lastDoseKey[i] = _lastDoseKey[i] * 1440 + 1439;
+      _lastDoseDirty |= (ChannelMask)1 << i;
+    }
+  }
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::_loadConfigBlob() {
+  // Any channel count: the header says how many ChannelConfigs follow
+  size_t len = _prefs.getBytesLength("cfg");
+  if (len < sizeof(BlobHeader) + sizeof(BlobTail))
+    return false;
+  std::vector<uint8_t> buf(len);
+  if (_prefs.getBytes("cfg", buf.data(), len) != len)
+    return false;
+  BlobHeader head;
+  BlobTail tail;
+  memcpy(&head, buf.data(), sizeof(head));
+  memcpy(&tail, buf.data() + len - sizeof(tail), sizeof(tail));
+  uint8_t stored = head.channels;
+  bool v1 = head.version == 1;
+  size_t chSize = v1 ? sizeof(ChannelConfigV1) : sizeof(ChannelConfig);
+  if (head.magic != FERT_CFG_MAGIC ||
+      (head.version != FERT_CFG_VERSION && !v1) || stored < 2 ||
+      stored > 32 || len != sizeof(head) + stored * chSize + sizeof(tail))
+    return false;
+  if (crc32(buf.data(), len - sizeof(tail.crc)) != tail.crc) {
+    Serial.println("[Fert] WARNING: config blob CRC mismatch, ignoring.");
+    return false;
+  }
+
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    int k = storedIndex(i, CHANNELS, stored);
+    if (k < 0)
+      continue; // New channel: constructor defaults
+    const uint8_t *rec = buf.data() + sizeof(head) + k * chSize;
+    ChannelConfig c;
+    if (v1) {
+      // One dose and time per day: becomes a 7-entry plan
+      ChannelConfigV1 old;
+      memcpy(&old, rec, sizeof(old));
+      float doseML[7];
+      uint8_t hour[7], minute[7];
+      memcpy(doseML, old.doseML, sizeof(doseML)); // Packed: may be unaligned
+      memcpy(hour, old.schedHour, sizeof(hour));
+      memcpy(minute, old.schedMinute, sizeof(minute));
+      _setPlanFromDays(i, doseML, hour, minute);
+      c.flowRate = old.flowRate;
+      c.lowStock = old.lowStock;
+      c.pumpMA = old.pumpMA;
+      c.pwm = old.pwm;
+      memcpy(c.name, old.name, sizeof(c.name));
+    } else {
+      memcpy(&c, rec, sizeof(c));
+      if (_planValid(c.sched, c.slots)) {
+        memcpy(_sched[i], c.sched, sizeof(c.sched));
+        _schedCount[i] = c.slots;
+      } else {
+        Serial.printf("[Fert] WARNING: CH%d plan invalid, using default\n",
+                      i + 1);
+      }
+    }
+    _flowRateMLps[i] = c.flowRate;
+    _lowStockThreshold[i] = c.lowStock;
+    _pumpMA[i] = c.pumpMA;
+    _pwm[i] = c.pwm;
+    char name[sizeof(c.name) + 1];
+    memcpy(name, c.name, sizeof(c.name));
+    name[sizeof(c.name)] = '\0';
+    _names[i] = name;
+  }
+  _maxConcurrent = tail.maxConcurrent;
+  if (_maxConcurrent < 1 || _maxConcurrent > CHANNELS)
+    _maxConcurrent = DOSE_MAX_CONCURRENT;
+  _budgetMA = tail.budgetMA;
+  _storedChannels = stored;
+  if (v1) {
+    _cfgDirty = true; // Rewritten in this layout by _loadState()
+    Serial.println("[Fert] Config blob v1 migrated to dose plans.");
+  }
+  return true;
+}
+
+template <uint8_t N>
+bool FertManagerT<N>::_saveConfigBlob() {
+  ConfigBlob blob;
+  memset(&blob, 0, sizeof(blob));
+  blob.head.magic = FERT_CFG_MAGIC;
+  blob.head.version = FERT_CFG_VERSION;
+  blob.head.channels = CHANNELS;
+  for (uint8_t i = 0; i < CHANNELS; i++) {
+    ChannelConfig &c = blob.ch[i];
+    c.slots = _schedCount[i];
+    memcpy(c.sched, _sched[i], sizeof(c.sched));
+    c.flowRate = _flowRateMLps[i];
+    c.lowStock = _lowStockThreshold[i];
+    c.pumpMA = _pumpMA[i];
+    c.pwm = _pwm[i];
+    strncpy(c.name, _names[i].c_str(), sizeof(c.name));
+  }
+  blob.tail.maxConcurrent = _maxConcurrent;
+  blob.tail.budgetMA = _budgetMA;
+  blob.tail.crc = crc32(&blob, sizeof(blob) - sizeof(blob.tail.crc));
+
+  if (_prefs.putBytes("cfg", &blob, sizeof(blob)) != sizeof(blob)) {
+    Serial.println("[Fert] ERROR: config blob write failed.");
+    return false; // Stays dirty: retried on the next save
+  }
+  _cfgDirty = false;
+  return true;
+}
+
+template <uint8_t N>
+void FertManagerT<N>::_loadLegacyConfig() {
+  for (uint8_t i = 0; i < CHANNELS; i++) {
     char key[16];
 
     // Backwards Compatibility: Read legacy single-dose to use as fallback
     snprintf(key, sizeof(key), "dose%d", i);
-    float legacyDose = _prefs.getFloat(key, (i == NUM_FERTS) ? DEFAULT_PRIME_ML
+    float legacyDose = _prefs.getFloat(key, (i == N) ? DEFAULT_PRIME_ML
                                                              : DEFAULT_DOSE_ML);
 
     // If a channel was previously disabled via schedule bitmask, respect it
     snprintf(key, sizeof(key), "sD%d", i);
     uint8_t legacyMask = _prefs.getUChar(key, 127);
 
+    float doseML[7];
     for (uint8_t d = 0; d < 7; d++) {
       snprintf(key, sizeof(key), "d%d_%d", i, d);
       float defaultDose = ((legacyMask & (1 << d)) != 0) ? legacyDose : 0.0f;
-      _doseML[i][d] = _prefs.getFloat(key, defaultDose);
+      doseML[d] = _prefs.getFloat(key, defaultDose);
     }
 
-    snprintf(key, sizeof(key), "stock%d", i);
-    _stockML[i] = _prefs.getFloat(key, DEFAULT_STOCK_ML);
-
     snprintf(key, sizeof(key), "name%d", i);
     String defaultName =
-        (i < NUM_FERTS) ? String("CH") + String(i + 1) : "Prime";
+        (i < N) ? String("CH") + String(i + 1) : "Prime";
     _names[i] = _prefs.getString(key, defaultName);
 
-    snprintf(key, sizeof(key), "lk%d", i);
-    _lastDoseKey[i] = _prefs.getUInt(key, 0);
-
     // Per-day schedule times with backward compat from legacy single keys
     snprintf(key, sizeof(key), "sH%d", i);
     uint8_t legacyHour = _prefs.getUChar(key, DEFAULT_FERT_HOUR);
     snprintf(key, sizeof(key), "sM%d", i);
     uint8_t legacyMin = _prefs.getUChar(key, DEFAULT_FERT_MINUTE);
+    uint8_t hour[7], minute[7];
     for (uint8_t d = 0; d < 7; d++) {
       snprintf(key, sizeof(key), "sH%d_%d", i, d);
-      _schedHour[i][d] = _prefs.getUChar(key, legacyHour);
+      hour[d] = _prefs.getUChar(key, legacyHour);
       snprintf(key, sizeof(key), "sM%d_%d", i, d);
-      _schedMinute[i][d] = _prefs.getUChar(key, legacyMin);
+      minute[d] = _prefs.getUChar(key, legacyMin);
     }
+    _setPlanFromDays(i, doseML, hour, minute);
 
     snprintf(key, sizeof(key), "fR%d", i);
     _flowRateMLps[i] = _prefs.getFloat(key, FLOW_RATE_ML_PER_SEC);
@@ -317,25 +1282,53 @@ void FertManager::_loadState() {
 
     snprintf(key, sizeof(key), "lt%d", i);
     _lowStockThreshold[i] = _prefs.getFloat(key, 50.0f);
+
+    snprintf(key, sizeof(key), "pmA%d", i);
+    _pumpMA[i] = _prefs.getUShort(key, DOSE_PUMP_CURRENT_MA);
   }
+  _maxConcurrent = _prefs.getUChar("dMax", DOSE_MAX_CONCURRENT);
+  if (_maxConcurrent < 1 || _maxConcurrent > CHANNELS)
+    _maxConcurrent = DOSE_MAX_CONCURRENT;
+  _budgetMA = _prefs.getUShort("dBud", DOSE_CURRENT_BUDGET_MA);
 }
 
-void FertManager::_markDosed(uint8_t ch, DateTime now) {
-  if (ch <= NUM_FERTS) {
-    _lastDoseKey[ch] = _dateKey(now);
-
+template <uint8_t N>
+void FertManagerT<N>::_removeLegacyKeys() {
+  // ~130 entries freed; stock%d and lk%d stay as they are
+  static const char *const perChannel[] = {"dose%d", "sD%d", "sH%d", "sM%d",
+                                           "name%d", "fR%d", "pwm%d", "lt%d",
+                                           "pmA%d"};
+  for (uint8_t i = 0; i < CHANNELS; i++) {
     char key[16];
-    snprintf(key, sizeof(key), "lk%d", ch);
-    _prefs.putUInt(key, _lastDoseKey[ch]);
+    for (const char *fmt : perChannel) {
+      snprintf(key, sizeof(key), fmt, i);
+      _prefs.remove(key);
+    }
+    for (uint8_t d = 0; d < 7; d++) {
+      snprintf(key, sizeof(key), "d%d_%d", i, d);
+      _prefs.remove(key);
+      snprintf(key, sizeof(key), "sH%d_%d", i, d);
+      _prefs.remove(key);
+      snprintf(key, sizeof(key), "sM%d_%d", i, d);
+      _prefs.remove(key);
+    }
   }
+  _prefs.remove("dMax");
+  _prefs.remove("dBud");
 }
 
-uint8_t FertManager::_pinForChannel(uint8_t ch) const {
-  if (ch < NUM_FERTS) {
-    return FERT_PINS[ch];
-  }
-  if (ch == NUM_FERTS) {
-    return PIN_PRIME;
+template <uint8_t N>
+void FertManagerT<N>::_markDosed(uint8_t ch, DateTime now) {
+  if (ch <= N) {
+    _lastDoseKey[ch] = _doseKey(now);
+    _lastDoseDirty |= (ChannelMask)1 << ch;
+    _saveCounters();
   }
-  return 0; // Invalid
 }
+
+// Channel counts built into this image. The firmware uses NUM_FERTS; the
+// native tests also build a 12-channel manager on a PCA9685 backend.
+template class FertManagerT<NUM_FERTS>;
+#ifdef UNIT_TEST
+template class FertManagerT<12>;
+#endif
@@ -0,0 +1,498 @@
+#include "JsonBody.h"
+#include <limits.h>
+#include <math.h>
+
+/// Unread part of the body
+struct Cursor {
+  const uint8_t *p;
+  const uint8_t *end;
+};
+
+static void skipWs(Cursor &c) {
+  while (c.p < c.end &&
+         (*c.p == ' ' || *c.p == '\t' || *c.p == '\n' || *c.p == '\r'))
+    c.p++;
+}
+
+static bool take(Cursor &c, char ch) {
+  if (c.p < c.end && *c.p == (uint8_t)ch) {
+    c.p++;
+    return true;
+  }
+  return false;
+}
+
+static bool isDigit(uint8_t ch) { return ch >= '0' && ch <= '9'; }
+
+// ============================================================================
+// TOKENS
+// ============================================================================
+
+static bool literal(Cursor &c, const char *word) {
+  for (; *word; word++)
+    if (!take(c, *word))
+      return false;
+  return true;
+}
+
+/// Decimal number. Hand-rolled: strtod needs a terminated copy and newlib's
+/// allocates big integers for its exact rounding.
+static bool parseNumber(Cursor &c, double &v) {
+  const uint8_t *p = c.p;
+  bool neg = p < c.end && *p == '-';
+  if (neg)
+    p++;
+
+  uint64_t mant = 0; // First 19 significant digits
+  int exp10 = 0;
+  uint8_t digits = 0;
+  for (; p < c.end && isDigit(*p); p++, digits = 1) {
+    if (mant < 1000000000000000000ULL)
+      mant = mant * 10 + (*p - '0');
+    else
+      exp10++;
+  }
+  if (!digits)
+    return false;
+  if (p < c.end && *p == '.') {
+    p++;
+    if (p >= c.end || !isDigit(*p))
+      return false;
+    for (; p < c.end && isDigit(*p); p++) {
+      if (mant < 1000000000000000000ULL) {
+        mant = mant * 10 + (*p - '0');
+        exp10--;
+      }
+    }
+  }
+  if (p < c.end && (*p == 'e' || *p == 'E')) {
+    p++;
+    bool expNeg = p < c.end && *p == '-';
+    if (p < c.end && (*p == '-' || *p == '+'))
+      p++;
+    if (p >= c.end || !isDigit(*p))
+      return false;
+    int e = 0;
+    for (; p < c.end && isDigit(*p); p++)
+      if (e < 1000)
+        e = e * 10 + (*p - '0');
+    exp10 += expNeg ? -e : e;
+  }
+
+  double r = (double)mant;
+  if (mant != 0 && exp10 != 0) {
+    // 10^|exp10| by squaring; overflows to inf (r / inf = 0)
+    double scale = 1.0, base = 10.0;
+    for (unsigned e = exp10 < 0 ? -exp10 : exp10; e; e >>= 1, base *= base)
+      if (e & 1)
+        scale *= base;
+    r = exp10 < 0 ? r / scale : r * scale;
+  }
+  v = neg ? -r : r;
+  c.p = p;
+  return true;
+}
+
+static bool hex4(Cursor &c, uint32_t &cp) {
+  if (c.end - c.p < 4)
+    return false;
+  cp = 0;
+  for (uint8_t i = 0; i < 4; i++, c.p++) {
+    uint8_t h = *c.p;
+    if (isDigit(h))
+      cp = cp << 4 | (h - '0');
+    else if ((h | 0x20) >= 'a' && (h | 0x20) <= 'f')
+      cp = cp << 4 | ((h | 0x20) - 'a' + 10);
+    else
+      return false;
+  }
+  return true;
+}
+
+/// Bounded output of a decoded string
+struct StrOut {
+  char *buf; // nullptr: decode and drop (skipped value, key)
+  uint16_t cap;
+  uint16_t len;
+  bool full; // Something did not fit: nothing more is stored
+
+  void put(const uint8_t *bytes, uint8_t n) {
+    if (!buf || full)
+      return;
+    if (len + n >= cap) {
+      full = true;
+      return;
+    }
+    memcpy(buf + len, bytes, n);
+    len += n;
+  }
+};
+
+static void putCodePoint(StrOut &out, uint32_t cp) {
+  uint8_t u[4];
+  uint8_t n;
+  if (cp < 0x80) {
+    u[0] = cp;
+    n = 1;
+  } else if (cp < 0x800) {
+    u[0] = 0xC0 | cp >> 6;
+    u[1] = 0x80 | (cp & 0x3F);
+    n = 2;
+  } else if (cp < 0x10000) {
+    u[0] = 0xE0 | cp >> 12;
+    u[1] = 0x80 | (cp >> 6 & 0x3F);
+    u[2] = 0x80 | (cp & 0x3F);
+    n = 3;
+  } else {
+    u[0] = 0xF0 | cp >> 18;
+    u[1] = 0x80 | (cp >> 12 & 0x3F);
+    u[2] = 0x80 | (cp >> 6 & 0x3F);
+    u[3] = 0x80 | (cp & 0x3F);
+    n = 4;
+  }
+  out.put(u, n);
+}
+
+/// String at c.p (opening quote), decoded into out
+static bool parseString(Cursor &c, StrOut &out) {
+  if (!take(c, '"'))
+    return false;
+  while (c.p < c.end) {
+    uint8_t ch = *c.p++;
+    if (ch == '"') {
+      if (out.full) {
+        // Drop a multi-byte character cut by the limit
+        uint16_t i = out.len;
+        while (i > 0 && ((uint8_t)out.buf[i - 1] & 0xC0) == 0x80)
+          i--;
+        if (i > 0 && (uint8_t)out.buf[i - 1] >= 0xC0) {
+          uint8_t lead = out.buf[i - 1];
+          uint8_t need = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : 2;
+          if (out.len - (i - 1) < need)
+            out.len = i - 1;
+        }
+      }
+      if (out.buf)
+        out.buf[out.len] = '\0';
+      return true;
+    }
+    if (ch < 0x20)
+      return false;
+    if (ch != '\\') {
+      out.put(&ch, 1);
+      continue;
+    }
+    if (c.p >= c.end)
+      return false;
+    uint32_t cp;
+    switch (*c.p++) {
+    case '"':
+      cp = '"';
+      break;
+    case '\\':
+      cp = '\\';
+      break;
+    case '/':
+      cp = '/';
+      break;
+    case 'b':
+      cp = '\b';
+      break;
+    case 'f':
+      cp = '\f';
+      break;
+    case 'n':
+      cp = '\n';
+      break;
+    case 'r':
+      cp = '\r';
+      break;
+    case 't':
+      cp = '\t';
+      break;
+    case 'u':
+      if (!hex4(c, cp))
+        return false;
+      if (cp >= 0xD800 && cp < 0xDC00) {
+        // High surrogate: pairs with a following \uDC00..\uDFFF
+        uint32_t lo;
+        Cursor save = c;
+        if (take(c, '\\') && take(c, 'u') && hex4(c, lo) && lo >= 0xDC00 &&
+            lo < 0xE000) {
+          cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+        } else {
+          c = save;
+          cp = 0xFFFD;
+        }
+      } else if (cp >= 0xDC00 && cp < 0xE000) {
+        cp = 0xFFFD;
+      }
+      break;
+    default:
+      return false;
+    }
+    putCodePoint(out, cp);
+  }
+  return false;
+}
+
+/// Any value, checked only as far as needed to find where it ends
+static bool skipValue(Cursor &c) {
+  if (c.p >= c.end)
+    return false;
+  StrOut none = {nullptr, 0, 0, false};
+  switch (*c.p) {
+  case '"':
+    return parseString(c, none);
+  case 't':
+    return literal(c, "true");
+  case 'f':
+    return literal(c, "false");
+  case 'n':
+    return literal(c, "null");
+  case '{':
+  case '[': {
+    uint16_t depth = 0;
+    while (c.p < c.end) {
+      uint8_t ch = *c.p;
+      if (ch == '"') {
+        if (!parseString(c, none))
+          return false;
+        continue;
+      }
+      c.p++;
+      if (ch == '{' || ch == '[')
+        depth++;
+      else if ((ch == '}' || ch == ']') && --depth == 0)
+        return true;
+    }
+    return false;
+  }
+  default:
+    double v;
+    return parseNumber(c, v);
+  }
+}
+
+/// Number, or true/false as 1/0
+static bool parseScalar(Cursor &c, double &v, bool &usable) {
+  usable = true;
+  if (c.p < c.end && *c.p == 't') {
+    v = 1;
+    return literal(c, "true");
+  }
+  if (c.p < c.end && *c.p == 'f') {
+    v = 0;
+    return literal(c, "false");
+  }
+  if (c.p < c.end && (*c.p == '-' || isDigit(*c.p)))
+    return parseNumber(c, v);
+  usable = false;
+  return skipValue(c);
+}
+
+// ============================================================================
+// FIELDS
+// ============================================================================
+
+static bool readField(Cursor &c, JsonField &f) {
+  double v;
+  bool usable;
+  switch (f.type) {
+  case JsonType::INT:
+    if (!parseScalar(c, v, usable))
+      return false;
+    if (usable && v >= INT_MIN && v <= INT_MAX) {
+      *(int *)f.out = (int)v;
+      f.found = true;
+    }
+    return true;
+
+  case JsonType::FLOAT:
+    if (!parseScalar(c, v, usable))
+      return false;
+    if (usable && !isinf((float)v)) {
+      *(float *)f.out = (float)v;
+      f.found = true;
+    }
+    return true;
+
+  case JsonType::STRING: {
+    if (c.p >= c.end || *c.p != '"')
+      return skipValue(c);
+    StrOut out = {f.cap ? (char *)f.out : nullptr, f.cap, 0, false};
+    if (!parseString(c, out))
+      return false;
+    f.count = out.len;
+    f.found = f.cap > 0;
+    return true;
+  }
+
+  case JsonType::FLOAT_ARRAY: {
+    if (!take(c, '['))
+      return skipValue(c);
+    uint16_t n = 0;
+    bool numeric = true;
+    skipWs(c);
+    if (take(c, ']')) {
+      f.count = 0;
+      f.found = true;
+      return true;
+    }
+    for (;;) {
+      skipWs(c);
+      if (c.p < c.end && (*c.p == '-' || isDigit(*c.p))) {
+        if (!parseNumber(c, v))
+          return false;
+        if (n < f.cap)
+          ((float *)f.out)[n] = (float)v;
+      } else {
+        numeric = false;
+        if (!skipValue(c))
+          return false;
+      }
+      if (n < UINT16_MAX)
+        n++;
+      skipWs(c);
+      if (take(c, ','))
+        continue;
+      if (take(c, ']'))
+        break;
+      return false;
+    }
+    if (numeric) {
+      f.count = n;
+      f.found = true;
+    }
+    return true;
+  }
+  }
+  return false;
+}
+
+/// Member name at c.p matched against the table (names are plain ASCII)
+static bool parseKey(Cursor &c, JsonField *fields, uint8_t fieldCount,
+                     JsonField *&match) {
+  match = nullptr;
+  const uint8_t *start = c.p + 1;
+  StrOut none = {nullptr, 0, 0, false};
+  if (!parseString(c, none))
+    return false;
+  size_t n = c.p - 1 - start;
+  if (memchr(start, '\\', n))
+    return true;
+  for (uint8_t i = 0; i < fieldCount; i++) {
+    if (strncmp(fields[i].key, (const char *)start, n) == 0 &&
+        fields[i].key[n] == '\0') {
+      match = &fields[i];
+      break;
+    }
+  }
+  return true;
+}
+
+bool jsonParseObject(const uint8_t *body, size_t len, JsonField *fields,
+                     uint8_t fieldCount) {
+  Cursor c = {body, body + len};
+  skipWs(c);
+  if (!take(c, '{'))
+    return false;
+  skipWs(c);
+  if (!take(c, '}')) {
+    for (;;) {
+      skipWs(c);
+      JsonField *f;
+      if (c.p >= c.end || *c.p != '"' || !parseKey(c, fields, fieldCount, f))
+        return false;
+      skipWs(c);
+      if (!take(c, ':'))
+        return false;
+      skipWs(c);
+      if (!(f ? readField(c, *f) : skipValue(c)))
+        return false;
+      skipWs(c);
+      if (take(c, ','))
+        continue;
+      if (take(c, '}'))
+        break;
+      return false;
+    }
+  }
+  skipWs(c);
+  return c.p == c.end;
+}
+
+// ============================================================================
+// CHUNKED BODIES
+// ============================================================================
+
+BodyArena::BodyArena() {
+  for (Slot &s : _slots) {
+    s.owner = nullptr;
+    s.startMs = 0;
+    s.filled = 0;
+  }
+}
+
+BodyArena::Result BodyArena::feed(const void *owner, const uint8_t *data,
+                                  size_t len, size_t index, size_t total,
+                                  unsigned long nowMs, const uint8_t *&body,
+                                  size_t &bodyLen) {
+  body = nullptr;
+  bodyLen = 0;
+  Slot *slot = nullptr;
+  for (Slot &s : _slots) {
+    if (s.owner == owner) {
+      slot = &s;
+      break;
+    }
+  }
+
+  if (index == 0) {
+    if (slot)
+      slot->owner = nullptr; // Same request object, new body
+    if (total > WEB_BODY_MAX)
+      return TOO_LARGE;
+    if (len >= total) {
+      body = data;
+      bodyLen = total;
+      return COMPLETE;
+    }
+    slot = nullptr;
+    for (Slot &s : _slots) {
+      if (!s.owner || nowMs - s.startMs >= WEB_BODY_STALE_MS) {
+        slot = &s;
+        break;
+      }
+    }
+    if (!slot)
+      return BUSY;
+    slot->owner = owner;
+    slot->startMs = nowMs;
+    slot->filled = 0;
+  } else if (!slot) {
+    return DROPPED;
+  }
+
+  if (index != slot->filled || index + len > total || total > WEB_BODY_MAX) {
+    slot->owner = nullptr;
+    return DROPPED;
+  }
+  memcpy(slot->data + index, data, len);
+  slot->filled += len;
+  if (slot->filled < total)
+    return PARTIAL;
+
+  slot->owner = nullptr;
+  body = slot->data;
+  bodyLen = slot->filled;
+  return COMPLETE;
+}
+
+uint8_t BodyArena::slotsInUse() const {
+  uint8_t n = 0;
+  for (const Slot &s : _slots)
+    if (s.owner)
+      n++;
+  return n;
+}
@@ -0,0 +1,70 @@
+#include "JsonDelta.h"
+
+static uint32_t fnv1a(const char *s, size_t n) {
+  uint32_t h = 2166136261UL;
+  while (n--) {
+    h ^= (uint8_t)*s++;
+    h *= 16777619UL;
+  }
+  return h;
+}
+
+size_t JsonDelta::filter(char *json, size_t len) {
+  if (len < 2 || json[0] != '{' || json[len - 1] != '}')
+    return 0;
+
+  size_t out = 1; // Patch written so far, after its '{'
+  size_t i = 1;
+  uint8_t idx = 0;
+  bool any = false;
+  while (i < len - 1) {
+    // One member: up to a comma outside strings and nested values
+    size_t start = i;
+    int depth = 0;
+    bool inStr = false;
+    for (; i < len - 1; i++) {
+      char c = json[i];
+      if (inStr) {
+        if (c == '\\')
+          i++;
+        else if (c == '"')
+          inStr = false;
+      } else if (c == '"') {
+        inStr = true;
+      } else if (c == '{' || c == '[') {
+        depth++;
+      } else if (c == '}' || c == ']') {
+        depth--;
+      } else if (c == ',' && depth == 0) {
+        break;
+      }
+    }
+    size_t n = i - start;
+    i++; // Past the comma
+
+    bool changed = true;
+    if (idx < MAX_MEMBERS) {
+      uint32_t h = fnv1a(json + start, n);
+      changed = !_primed || idx >= _count || _hash[idx] != h;
+      _hash[idx] = h;
+    }
+    idx++;
+    if (!changed)
+      continue;
+    if (any)
+      json[out++] = ',';
+    memmove(json + out, json + start, n);
+    out += n;
+    any = true;
+  }
+
+  bool first = !_primed;
+  _count = idx < MAX_MEMBERS ? idx : MAX_MEMBERS;
+  _primed = true;
+  if (!any && !first)
+    return 0;
+  json[out++] = '}';
+  if (out < len)
+    json[out] = '\0';
+  return out;
+}
@@ -0,0 +1,228 @@
+#include "JsonWriter.h"
+#include <math.h>
+
+static const uint32_t POW10[] = {1, 10, 100, 1000, 10000, 100000, 1000000};
+
+JsonWriter::JsonWriter(char *buf, size_t size)
+    : _buf(buf), _size(size), _out(nullptr) {
+  reset();
+}
+
+JsonWriter::JsonWriter(Print &out) : _buf(nullptr), _size(0), _out(&out) {
+  reset();
+}
+
+void JsonWriter::reset() {
+  _len = 0;
+  _overflow = false;
+  _afterKey = false;
+  _depth = 0;
+  _filled = 0;
+  if (_buf && _size)
+    _buf[0] = '\0';
+}
+
+// ============================================================================
+// STRUCTURE
+// ============================================================================
+
+void JsonWriter::_separator() {
+  if (_afterKey) {
+    _afterKey = false;
+    return;
+  }
+  uint32_t bit = 1UL << _depth;
+  if (_filled & bit)
+    _put(',');
+  _filled |= bit;
+}
+
+JsonWriter &JsonWriter::beginObject() {
+  _separator();
+  _put('{');
+  if (_depth < JSON_MAX_DEPTH)
+    _depth++;
+  _filled &= ~(1UL << _depth);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endObject() {
+  _put('}');
+  if (_depth > 0)
+    _depth--;
+  return *this;
+}
+
+JsonWriter &JsonWriter::beginArray() {
+  _separator();
+  _put('[');
+  if (_depth < JSON_MAX_DEPTH)
+    _depth++;
+  _filled &= ~(1UL << _depth);
+  return *this;
+}
+
+JsonWriter &JsonWriter::endArray() {
+  _put(']');
+  if (_depth > 0)
+    _depth--;
+  return *this;
+}
+
+JsonWriter &JsonWriter::key(const char *k) {
+  _separator();
+  _putEscaped(k);
+  _put(':');
+  _afterKey = true;
+  return *this;
+}
+
+// ============================================================================
+// VALUES
+// ============================================================================
+
+JsonWriter &JsonWriter::value(bool v) {
+  _separator();
+  if (v)
+    _put("true", 4);
+  else
+    _put("false", 5);
+  return *this;
+}
+
+JsonWriter &JsonWriter::_int(long long v) {
+  _separator();
+  if (v < 0) {
+    _put('-');
+    _putDigits(0ULL - (unsigned long long)v);
+  } else {
+    _putDigits((unsigned long long)v);
+  }
+  return *this;
+}
+
+JsonWriter &JsonWriter::_uint(unsigned long long v) {
+  _separator();
+  _putDigits(v);
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(float v, uint8_t decimals) {
+  if (isnan(v) || isinf(v))
+    return nullValue();
+  if (decimals > 6)
+    decimals = 6;
+
+  // Round half away from zero on the scaled magnitude
+  double scaled = fabs((double)v) * POW10[decimals] + 0.5;
+  if (scaled >= 1.8e19)
+    return nullValue();
+  unsigned long long n = (unsigned long long)scaled;
+
+  _separator();
+  if (v < 0 && n != 0)
+    _put('-');
+  _putDigits(n / POW10[decimals]);
+  if (decimals) {
+    _put('.');
+    _putDigits(n % POW10[decimals], decimals);
+  }
+  return *this;
+}
+
+JsonWriter &JsonWriter::value(const char *s) {
+  _separator();
+  _putEscaped(s ? s : "");
+  return *this;
+}
+
+JsonWriter &JsonWriter::nullValue() {
+  _separator();
+  _put("null", 4);
+  return *this;
+}
+
+JsonWriter &JsonWriter::raw(const char *json) {
+  _separator();
+  _put(json, strlen(json));
+  return *this;
+}
+
+// ============================================================================
+// OUTPUT
+// ============================================================================
+
+void JsonWriter::_put(const char *s, size_t n) {
+  if (_out) {
+    _out->write((const uint8_t *)s, n);
+    _len += n;
+    return;
+  }
+  if (!_buf || _size == 0) {
+    _overflow = _overflow || n > 0;
+    return;
+  }
+  size_t room = _size - 1 - _len;
+  if (n > room) {
+    n = room;
+    _overflow = true;
+  }
+  memcpy(_buf + _len, s, n);
+  _len += n;
+  _buf[_len] = '\0';
+}
+
+void JsonWriter::_putDigits(unsigned long long v, uint8_t minDigits) {
+  char tmp[20];
+  uint8_t i = sizeof(tmp);
+  // 32-bit division where possible (64-bit is a libgcc call on the ESP32)
+  while (v > 0xFFFFFFFFULL) {
+    tmp[--i] = '0' + (char)(v % 10);
+    v /= 10;
+  }
+  uint32_t v32 = (uint32_t)v;
+  do {
+    tmp[--i] = '0' + (char)(v32 % 10);
+    v32 /= 10;
+  } while (v32);
+  while (sizeof(tmp) - i < minDigits)
+    tmp[--i] = '0';
+  _put(tmp + i, sizeof(tmp) - i);
+}
+
+void JsonWriter::_putEscaped(const char *s) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  _put('"');
+  const char *run = s; // Start of the current run of plain characters
+  for (; *s; s++) {
+    uint8_t c = (uint8_t)*s;
+    if (c >= 0x20 && c != '"' && c != '\\')
+      continue;
+    _put(run, s - run);
+    run = s + 1;
+    switch (c) {
+    case '"':
+      _put("\\\"", 2);
+      break;
+    case '\\':
+      _put("\\\\", 2);
+      break;
+    case '\n':
+      _put("\\n", 2);
+      break;
+    case '\r':
+      _put("\\r", 2);
+      break;
+    case '\t':
+      _put("\\t", 2);
+      break;
+    default: {
+      char esc[6] = {'\\', 'u', '0', '0', HEX_DIGITS[c >> 4],
+                     HEX_DIGITS[c & 0xF]};
+      _put(esc, sizeof(esc));
+    }
+    }
+  }
+  _put(run, s - run);
+  _put('"');
+}
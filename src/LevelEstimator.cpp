@@ -0,0 +1,85 @@
+#include "LevelEstimator.h"
+#include <math.h>
+
+LevelEstimator::LevelEstimator() { reset(); }
+
+void LevelEstimator::reset() {
+  _x = 0;
+  _v = 0;
+  _residAvg = 0;
+  _tMs = 0;
+  _accepted = 0;
+  _rejects = 0;
+  _valid = false;
+}
+
+void LevelEstimator::_seed(float cm, uint32_t tMs) {
+  _x = cm;
+  _v = 0;
+  _residAvg = 0;
+  _tMs = tMs;
+  _accepted = 1;
+  _rejects = 0;
+  _valid = true;
+}
+
+bool LevelEstimator::update(float cm, uint32_t tMs) {
+  if (!_valid) {
+    _seed(cm, tMs);
+    return true;
+  }
+
+  // Out-of-order samples are treated as simultaneous with the last one
+  int32_t dtMs = (int32_t)(tMs - _tMs);
+  if (dtMs < 0)
+    dtMs = 0;
+  float dt = dtMs / 1000.0f;
+
+  float predicted = _x + _v * dt;
+  float residual = cm - predicted;
+
+  if (fabsf(residual) > LEVEL_EST_GATE_CM) {
+    if (++_rejects < LEVEL_EST_MAX_REJECTS)
+      return false;
+    // Several outliers in a row agree: the level really moved
+    _seed(cm, tMs);
+    return true;
+  }
+
+  _rejects = 0;
+  _x = predicted + LEVEL_EST_ALPHA * residual;
+  if (dtMs > 0) {
+    // Floor dt at one ping interval so near-simultaneous samples can't
+    // blow up the rate gain
+    float dtRate = dt;
+    const float minDt = ULTRASONIC_PING_INTERVAL_MS / 1000.0f;
+    if (dtRate < minDt)
+      dtRate = minDt;
+    _v += (LEVEL_EST_BETA / dtRate) * residual;
+    _tMs = tMs;
+  }
+  _residAvg += (fabsf(residual) - _residAvg) * 0.2f;
+  if (_accepted < LEVEL_EST_WARMUP)
+    _accepted++;
+  return true;
+}
+
+float LevelEstimator::predict(uint32_t tMs) const {
+  if (!_valid)
+    return -1.0f;
+  return _x + _v * ((int32_t)(tMs - _tMs) / 1000.0f);
+}
+
+static float _unit(float v) { return v < 0 ? 0.0f : (v > 1.0f ? 1.0f : v); }
+
+float LevelEstimator::confidence(uint32_t nowMs) const {
+  if (!_valid)
+    return 0.0f;
+
+  float warm = (float)_accepted / LEVEL_EST_WARMUP;
+  float noise = 1.0f - _residAvg / LEVEL_EST_GATE_CM;
+  float outliers = 1.0f - (float)_rejects / LEVEL_EST_MAX_REJECTS;
+  float age = 1.0f - (float)(nowMs - _tMs) / LEVEL_EST_STALE_MS;
+
+  return _unit(warm) * _unit(noise) * _unit(outliers) * _unit(age);
+}
@@ -0,0 +1,172 @@
+#include "LoopProfiler.h"
+
+LoopProfiler::LoopProfiler(const char *name, const char *const *stageNames,
+                           uint8_t stageCount)
+    : _name(name), _stageNames(stageNames),
+      _stageCount(stageCount > PERF_MAX_STAGES ? PERF_MAX_STAGES : stageCount),
+      _iterations(0), _iterStartUs(0), _inIteration(false) {
+  reset();
+}
+
+// ============================================================================
+// RECORDING (owning task)
+// ============================================================================
+
+void LoopProfiler::beginIteration() {
+  memset(_current.stageUs, 0, sizeof(_current.stageUs));
+  _iterStartUs = esp_timer_get_time();
+  _inIteration = true;
+}
+
+void LoopProfiler::endIteration() {
+  if (!_inIteration)
+    return; // No matching beginIteration()
+  _current.totalUs = (uint32_t)(esp_timer_get_time() - _iterStartUs);
+  _current.atMs = millis();
+  _inIteration = false;
+
+  portENTER_CRITICAL(&_mux);
+  _iterations++;
+  if (_current.totalUs > _worst.totalUs)
+    _worst = _current;
+  portEXIT_CRITICAL(&_mux);
+}
+
+void LoopProfiler::record(uint8_t stage, uint32_t us) {
+  if (stage >= _stageCount)
+    return;
+  uint8_t bucket = bucketFor(us);
+
+  portENTER_CRITICAL(&_mux);
+  StageStats &s = _stages[stage];
+  s.count++;
+  s.totalUs += us;
+  s.lastUs = us;
+  if (us < s.minUs)
+    s.minUs = us;
+  if (us > s.maxUs)
+    s.maxUs = us;
+  s.hist[bucket]++;
+  portEXIT_CRITICAL(&_mux);
+
+  // A stage may run more than once per iteration
+  _current.stageUs[stage] += us;
+}
+
+void LoopProfiler::reset() {
+  portENTER_CRITICAL(&_mux);
+  memset(_stages, 0, sizeof(_stages));
+  for (uint8_t i = 0; i < PERF_MAX_STAGES; i++)
+    _stages[i].minUs = UINT32_MAX;
+  memset(&_worst, 0, sizeof(_worst));
+  _iterations = 0;
+  portEXIT_CRITICAL(&_mux);
+}
+
+uint8_t LoopProfiler::bucketFor(uint32_t us) {
+  // Number of significant bits: 0 → 0, 1 → 1, 2..3 → 2, 4..7 → 3, ...
+  uint8_t bits = 0;
+  while (us && bits < PERF_HIST_BUCKETS - 1) {
+    us >>= 1;
+    bits++;
+  }
+  return bits;
+}
+
+// ============================================================================
+// SNAPSHOTS (any task)
+// ============================================================================
+
+LoopProfiler::StageStats LoopProfiler::getStage(uint8_t stage) const {
+  StageStats s;
+  portENTER_CRITICAL(&_mux);
+  s = _stages[stage < _stageCount ? stage : 0];
+  portEXIT_CRITICAL(&_mux);
+  if (s.count == 0)
+    s.minUs = 0;
+  return s;
+}
+
+LoopProfiler::Iteration LoopProfiler::getWorst() const {
+  Iteration w;
+  portENTER_CRITICAL(&_mux);
+  w = _worst;
+  portEXIT_CRITICAL(&_mux);
+  return w;
+}
+
+uint32_t LoopProfiler::getIterations() const {
+  portENTER_CRITICAL(&_mux);
+  uint32_t n = _iterations;
+  portEXIT_CRITICAL(&_mux);
+  return n;
+}
+
+// ============================================================================
+// REPORTS
+// ============================================================================
+
+void LoopProfiler::printReport() const {
+  Iteration worst = getWorst();
+  Serial.printf("[Perf] %s: %lu iterations, worst %lu us at %lu ms\n", _name,
+                (unsigned long)getIterations(), (unsigned long)worst.totalUs,
+                (unsigned long)worst.atMs);
+  Serial.println("  stage        count      min      avg      max   worst (us)");
+  for (uint8_t i = 0; i < _stageCount; i++) {
+    StageStats s = getStage(i);
+    Serial.printf("  %-9s %8lu %8lu %8lu %8lu %7lu\n", _stageNames[i],
+                  (unsigned long)s.count, (unsigned long)s.minUs,
+                  (unsigned long)s.avgUs(), (unsigned long)s.maxUs,
+                  (unsigned long)worst.stageUs[i]);
+  }
+
+  // Histograms: only non-empty buckets, labelled by their lower bound
+  for (uint8_t i = 0; i < _stageCount; i++) {
+    StageStats s = getStage(i);
+    if (s.count == 0)
+      continue;
+    Serial.printf("  %-9s", _stageNames[i]);
+    for (uint8_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+      if (s.hist[b])
+        Serial.printf(" >=%lu:%lu", b ? (1UL << (b - 1)) : 0UL,
+                      (unsigned long)s.hist[b]);
+    }
+    Serial.println();
+  }
+}
+
+void LoopProfiler::appendJSON(String &out) const {
+  char buf[160];
+  Iteration worst = getWorst();
+
+  snprintf(buf, sizeof(buf),
+           "{\"name\":\"%s\",\"iterations\":%lu,\"worst\":{\"us\":%lu,"
+           "\"atMs\":%lu,\"stageUs\":[",
+           _name, (unsigned long)getIterations(), (unsigned long)worst.totalUs,
+           (unsigned long)worst.atMs);
+  out += buf;
+  for (uint8_t i = 0; i < _stageCount; i++) {
+    snprintf(buf, sizeof(buf), "%s%lu", i ? "," : "",
+             (unsigned long)worst.stageUs[i]);
+    out += buf;
+  }
+  out += "]},\"stages\":[";
+
+  for (uint8_t i = 0; i < _stageCount; i++) {
+    StageStats s = getStage(i);
+    snprintf(buf, sizeof(buf),
+             "%s{\"name\":\"%s\",\"count\":%lu,\"minUs\":%lu,\"avgUs\":%lu,"
+             "\"maxUs\":%lu,\"lastUs\":%lu,\"hist\":[",
+             i ? "," : "", _stageNames[i], (unsigned long)s.count,
+             (unsigned long)s.minUs, (unsigned long)s.avgUs(),
+             (unsigned long)s.maxUs, (unsigned long)s.lastUs);
+    out += buf;
+    for (uint8_t b = 0; b < PERF_HIST_BUCKETS; b++) {
+      snprintf(buf, sizeof(buf), "%s%lu", b ? "," : "",
+               (unsigned long)s.hist[b]);
+      out += buf;
+    }
+    out += "]}";
+  }
+  out += "]}";
+}
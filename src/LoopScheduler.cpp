@@ -0,0 +1,155 @@
+#include "LoopScheduler.h"
+
+LoopScheduler::LoopScheduler() : _count(0) {
+  memset(_jobs, 0, sizeof(_jobs));
+}
+
+int8_t LoopScheduler::addJob(const char *name, JobFn fn, uint32_t periodMs,
+                             uint8_t priority, uint32_t deadlineMs) {
+  if (_count >= SCHED_MAX_JOBS || periodMs == 0 || !fn)
+    return -1;
+
+  Job &j = _jobs[_count];
+  memset(&j, 0, sizeof(j));
+  j.stats.name = name;
+  j.stats.periodMs = periodMs;
+  j.stats.deadlineMs = deadlineMs ? deadlineMs : periodMs;
+  j.stats.priority = priority;
+  j.fn = fn;
+  j.nextMs = millis();
+  return (int8_t)_count++;
+}
+
+void LoopScheduler::trigger(int8_t id) {
+  if (id < 0 || id >= _count)
+    return;
+  uint32_t now = millis();
+  if (_since(now, _jobs[id].nextMs) < 0)
+    _jobs[id].nextMs = now;
+}
+
+// ============================================================================
+// DISPATCH
+// ============================================================================
+
+uint8_t LoopScheduler::runDue() {
+  bool ran[SCHED_MAX_JOBS] = {};
+  uint8_t runs = 0;
+
+  for (;;) {
+    // Pick the highest-priority due job; time moves on as jobs run, so the
+    // due set is re-evaluated after each one
+    uint32_t now = millis();
+    int8_t pick = -1;
+    for (uint8_t i = 0; i < _count; i++) {
+      if (ran[i] || _since(now, _jobs[i].nextMs) < 0)
+        continue;
+      if (pick < 0 ||
+          _jobs[i].stats.priority > _jobs[pick].stats.priority ||
+          (_jobs[i].stats.priority == _jobs[pick].stats.priority &&
+           _since(_jobs[pick].nextMs, _jobs[i].nextMs) > 0)) {
+        pick = (int8_t)i;
+      }
+    }
+    if (pick < 0)
+      return runs;
+
+    Job &j = _jobs[pick];
+    uint32_t late = (uint32_t)_since(now, j.nextMs);
+
+    // Next release keeps the period grid; releases already in the past are
+    // dropped (no burst of catch-up runs) and counted as misses
+    uint32_t skipped = late / j.stats.periodMs;
+    j.nextMs += (skipped + 1) * j.stats.periodMs;
+
+    portENTER_CRITICAL(&_mux);
+    j.stats.runs++;
+    j.stats.lastRunMs = now;
+    if (late > j.stats.maxLateMs)
+      j.stats.maxLateMs = late;
+    if (late > j.stats.deadlineMs)
+      j.stats.misses++;
+    j.stats.misses += skipped;
+    portEXIT_CRITICAL(&_mux);
+
+    ran[pick] = true;
+    runs++;
+    j.fn();
+  }
+}
+
+uint32_t LoopScheduler::msUntilNext() const {
+  uint32_t now = millis();
+  uint32_t wait = SCHED_MAX_SLEEP_MS;
+  for (uint8_t i = 0; i < _count; i++) {
+    int32_t d = _since(_jobs[i].nextMs, now);
+    if (d <= 0)
+      return 0;
+    if ((uint32_t)d < wait)
+      wait = (uint32_t)d;
+  }
+  return wait;
+}
+
+// ============================================================================
+// STATISTICS
+// ============================================================================
+
+LoopScheduler::JobStats LoopScheduler::getJob(uint8_t id) const {
+  JobStats s;
+  portENTER_CRITICAL(&_mux);
+  s = _jobs[id < _count ? id : 0].stats;
+  portEXIT_CRITICAL(&_mux);
+  return s;
+}
+
+uint32_t LoopScheduler::getTotalMisses() const {
+  uint32_t total = 0;
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < _count; i++)
+    total += _jobs[i].stats.misses;
+  portEXIT_CRITICAL(&_mux);
+  return total;
+}
+
+void LoopScheduler::resetStats() {
+  portENTER_CRITICAL(&_mux);
+  for (uint8_t i = 0; i < _count; i++) {
+    _jobs[i].stats.runs = 0;
+    _jobs[i].stats.misses = 0;
+    _jobs[i].stats.maxLateMs = 0;
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+void LoopScheduler::printReport() const {
+  Serial.printf("[Sched] %d jobs, %lu deadline misses\n", _count,
+                (unsigned long)getTotalMisses());
+  Serial.println(
+      "  job        prio  period  deadline     runs   misses  maxLate (ms)");
+  for (uint8_t i = 0; i < _count; i++) {
+    JobStats s = getJob(i);
+    Serial.printf("  %-9s %5u %7lu %9lu %8lu %8lu %8lu\n", s.name,
+                  (unsigned)s.priority, (unsigned long)s.periodMs,
+                  (unsigned long)s.deadlineMs, (unsigned long)s.runs,
+                  (unsigned long)s.misses, (unsigned long)s.maxLateMs);
+  }
+}
+
+void LoopScheduler::appendJSON(String &out) const {
+  char buf[192];
+  out += "[";
+  for (uint8_t i = 0; i < _count; i++) {
+    JobStats s = getJob(i);
+    snprintf(buf, sizeof(buf),
+             "%s{\"name\":\"%s\",\"priority\":%u,\"periodMs\":%lu,"
+             "\"deadlineMs\":%lu,\"runs\":%lu,\"misses\":%lu,"
+             "\"maxLateMs\":%lu,\"lastRunMs\":%lu}",
+             i ? "," : "", s.name, (unsigned)s.priority,
+             (unsigned long)s.periodMs, (unsigned long)s.deadlineMs,
+             (unsigned long)s.runs, (unsigned long)s.misses,
+             (unsigned long)s.maxLateMs, (unsigned long)s.lastRunMs);
+    out += buf;
+  }
+  out += "]";
+}
@@ -1,20 +1,19 @@
 #include "NotifyManager.h"
-#include <Preferences.h>
+#include "SettingsStore.h"
 
 #ifdef USE_WEBSERVER
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
 #endif
 
-static Preferences _nPrefs;
-
 // ============================================================================
 // CONSTRUCTOR
 // ============================================================================
 
 NotifyManager::NotifyManager()
-    : _lang(LANG_PT), _dailyReportHour(8), _dailyReportMinute(0),
-      _dailyReportSent(false), _dailyCount(0), _lastResetDay(0) {
+    : _settings(nullptr), _lang(LANG_PT), _dailyReportHour(8),
+      _dailyReportMinute(0), _dailyReportSent(false), _dailyCount(0),
+      _lastResetDay(0) {
   for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++) {
     _typeEnabled[i] = true; // All enabled by default
     _lastNotifyMs[i] = 0;
@@ -35,18 +34,50 @@ void NotifyManager::begin() {
                 _dailyReportMinute);
 }
 
+// ============================================================================
+// DELIVERY TASK
+// ============================================================================
+
+void NotifyManager::startTask() {
+#ifndef UNIT_TEST
+  if (_queue)
+    return;
+  _queue = xQueueCreate(NOTIFY_QUEUE_LEN, sizeof(NotifyJob));
+  if (!_queue) {
+    Serial.println("[Notify] Queue alloc failed, staying synchronous.");
+    return;
+  }
+  xTaskCreatePinnedToCore(_taskEntry, "notify", NOTIFY_TASK_STACK, this,
+                          NOTIFY_TASK_PRIORITY, nullptr, NOTIFY_TASK_CORE);
+  Serial.println("[Notify] Delivery task started.");
+#endif
+}
+
+#ifndef UNIT_TEST
+void NotifyManager::_taskEntry(void *arg) {
+  NotifyManager *self = static_cast<NotifyManager *>(arg);
+  NotifyJob job;
+  for (;;) {
+    if (xQueueReceive(self->_queue, &job, portMAX_DELAY) != pdTRUE)
+      continue;
+    if (!self->_deliver(job.type, job.title, job.message, job.icon,
+                        job.sound) &&
+        job.type < NOTIFY_TYPE_COUNT) {
+      // Release the cooldown reserved at enqueue so the next event retries
+      self->_lastNotifyMs[job.type] = 0;
+    }
+  }
+}
+#endif
+
 // ============================================================================
 // UPDATE (called from loop — checks daily report schedule)
 // ============================================================================
 
 void NotifyManager::update(uint8_t currentHour, uint8_t currentMinute) {
   // Reset daily counter at midnight
-  if (currentHour == 0 && currentMinute == 0) {
-    if (_dailyCount > 0) {
-      _dailyCount = 0;
-      _dailyReportSent = false;
-    }
-  }
+  if (currentHour == 0 && currentMinute == 0 && _dailyCount > 0)
+    startNewDay();
 
   // Reset daily report flag when we pass the report hour
   if (currentHour != _dailyReportHour || currentMinute != _dailyReportMinute) {
@@ -175,6 +206,32 @@ bool NotifyManager::_canSend(NotifyType type) {
 bool NotifyManager::_send(NotifyType type, const char *title,
                           const char *message, const char *icon,
                           const char *sound) {
+#ifndef UNIT_TEST
+  if (_queue) {
+    NotifyJob job;
+    job.type = type;
+    strlcpy(job.title, title, sizeof(job.title));
+    strlcpy(job.message, message, sizeof(job.message));
+    strlcpy(job.icon, icon, sizeof(job.icon));
+    strlcpy(job.sound, sound, sizeof(job.sound));
+    if (xQueueSend(_queue, &job, 0) != pdTRUE) {
+      Serial.println("[Notify] Queue full, dropping notification.");
+      return false;
+    }
+    // Reserve the cooldown now so the same event isn't queued repeatedly
+    // while the HTTPS request is still in flight
+    if (type < NOTIFY_TYPE_COUNT) {
+      _lastNotifyMs[type] = millis();
+    }
+    return true;
+  }
+#endif
+  return _deliver(type, title, message, icon, sound);
+}
+
+bool NotifyManager::_deliver(NotifyType type, const char *title,
+                             const char *message, const char *icon,
+                             const char *sound) {
 #ifdef UNIT_TEST
   // In test mode, just record the attempt
   _lastSendResult = true;
@@ -273,6 +330,11 @@ bool NotifyManager::isTypeEnabled(NotifyType type) const {
   return false;
 }
 
+void NotifyManager::startNewDay() {
+  _dailyCount = 0;
+  _dailyReportSent = false;
+}
+
 void NotifyManager::setDailyReportHour(uint8_t h, uint8_t m) {
   _dailyReportHour = h;
   _dailyReportMinute = m;
@@ -285,23 +347,24 @@ void NotifyManager::setDailyReportHour(uint8_t h, uint8_t m) {
 // ============================================================================
 
 void NotifyManager::_loadConfig() {
-  _nPrefs.begin("notify", true); // readonly
-  _privateKey = _nPrefs.getString("key", "");
+  if (!_settings)
+    return;
+  _privateKey = _settings->getString(Setting::NOTIFY_KEY);
 
   // Load per-type toggles (stored as a bitmask in a single byte)
-  uint8_t mask = _nPrefs.getUChar("mask", 0xFF); // all enabled by default
+  uint8_t mask = _settings->getUInt(Setting::NOTIFY_MASK);
   for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++) {
     _typeEnabled[i] = (mask >> i) & 1;
   }
 
-  _dailyReportHour = _nPrefs.getUChar("repH", 8);
-  _dailyReportMinute = _nPrefs.getUChar("repM", 0);
-  _nPrefs.end();
+  _dailyReportHour = _settings->getUInt(Setting::REPORT_HOUR);
+  _dailyReportMinute = _settings->getUInt(Setting::REPORT_MINUTE);
 }
 
 void NotifyManager::_saveConfig() {
-  _nPrefs.begin("notify", false);
-  _nPrefs.putString("key", _privateKey);
+  if (!_settings)
+    return;
+  _settings->setString(Setting::NOTIFY_KEY, _privateKey);
 
   // Store toggles as bitmask
   uint8_t mask = 0;
@@ -309,9 +372,8 @@ void NotifyManager::_saveConfig() {
     if (_typeEnabled[i])
       mask |= (1 << i);
   }
-  _nPrefs.putUChar("mask", mask);
+  _settings->setUInt(Setting::NOTIFY_MASK, mask);
 
-  _nPrefs.putUChar("repH", _dailyReportHour);
-  _nPrefs.putUChar("repM", _dailyReportMinute);
-  _nPrefs.end();
+  _settings->setUInt(Setting::REPORT_HOUR, _dailyReportHour);
+  _settings->setUInt(Setting::REPORT_MINUTE, _dailyReportMinute);
 }
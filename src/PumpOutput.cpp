@@ -0,0 +1,175 @@
+#include "PumpOutput.h"
+#include "ActuatorLog.h"
+
+// ============================================================================
+// LEDC
+// ============================================================================
+
+uint8_t LedcPumpOutput::_pin(uint8_t ch) const {
+  return (ch == _channels - 1) ? PIN_PRIME
+         : (ch < NUM_FERTS)    ? FERT_PINS[ch]
+                               : 0xFF;
+}
+
+bool LedcPumpOutput::begin(uint8_t channels) {
+  _channels = channels;
+  for (uint8_t i = 0; i < channels; i++) {
+    uint8_t pin = _pin(i);
+    if (pin == 0xFF) {
+      Serial.printf("[Pump] CH%d has no LEDC pin\n", i + 1);
+      continue;
+    }
+    ledcSetup(i, FERT_LEDC_FREQ_HZ, 8); // Channel i, 8-bit (0-255)
+    ledcAttachPin(pin, i);
+    ledcWrite(i, 0); // Initialize OFF
+  }
+  return channels <= NUM_FERTS + 1;
+}
+
+void LedcPumpOutput::set(uint8_t ch, uint8_t duty) {
+  if (ch >= _channels)
+    return;
+  ledcWrite(ch, duty);
+  ActuatorLog::note(_pin(ch), duty > 0);
+}
+
+// ============================================================================
+// PCA9685
+// ============================================================================
+
+namespace {
+constexpr uint8_t REG_MODE1 = 0x00;
+constexpr uint8_t REG_MODE2 = 0x01;
+constexpr uint8_t REG_LED0_ON_L = 0x06;
+constexpr uint8_t REG_ALL_LED_OFF_H = 0xFD;
+constexpr uint8_t REG_PRESCALE = 0xFE;
+constexpr uint8_t MODE1_AI = 0x20;    // Register auto-increment
+constexpr uint8_t MODE1_SLEEP = 0x10; // Oscillator off (prescale writable)
+constexpr uint8_t MODE2_OUTDRV = 0x04; // Totem pole into the MOSFET gates
+constexpr uint8_t LED_FULL = 0x10;     // Bit 4 of LEDn_ON_H / LEDn_OFF_H
+constexpr uint32_t OSC_HZ = 25000000;
+} // namespace
+
+Pca9685PumpOutput::Pca9685PumpOutput(TwoWire &wire, uint8_t addr,
+                                     uint16_t pwmHz)
+    : _wire(&wire), _addr(addr), _pwmHz(pwmHz), _channels(0), _dirty(0),
+      _flushing(false), _flushWrites(0) {
+  memset(_duty, 0, sizeof(_duty));
+}
+
+bool Pca9685PumpOutput::begin(uint8_t channels) {
+  if (channels > MAX_CHANNELS)
+    channels = MAX_CHANNELS;
+  _channels = channels;
+  uint8_t chips = (channels + OUTPUTS_PER_CHIP - 1) / OUTPUTS_PER_CHIP;
+  uint8_t prescale = (uint8_t)((OSC_HZ + 2048UL * _pwmHz) /
+                               (4096UL * _pwmHz) - 1);
+
+  bool ok = true;
+  for (uint8_t c = 0; c < chips; c++) {
+    // Outputs off first: the chip keeps running across an ESP32 reset
+    uint8_t allOff = LED_FULL;
+    uint8_t sleep = MODE1_SLEEP | MODE1_AI;
+    uint8_t wake = MODE1_AI;
+    uint8_t mode2 = MODE2_OUTDRV;
+    if (!_writeRegs(c, REG_ALL_LED_OFF_H, &allOff, 1) ||
+        !_writeRegs(c, REG_MODE1, &sleep, 1) ||
+        !_writeRegs(c, REG_PRESCALE, &prescale, 1) ||
+        !_writeRegs(c, REG_MODE1, &wake, 1) ||
+        !_writeRegs(c, REG_MODE2, &mode2, 1)) {
+      Serial.printf("[Pump] PCA9685 at 0x%02X not responding\n", _addr + c);
+      ok = false;
+    }
+  }
+  delayMicroseconds(500); // Oscillator start-up after leaving SLEEP
+
+  portENTER_CRITICAL(&_mux);
+  memset(_duty, 0, sizeof(_duty));
+  _dirty = 0;
+  portEXIT_CRITICAL(&_mux);
+  if (ok)
+    Serial.printf("[Pump] PCA9685 x%u at 0x%02X, %u channels, %u Hz\n",
+                  chips, _addr, channels, _pwmHz);
+  return ok;
+}
+
+void Pca9685PumpOutput::set(uint8_t ch, uint8_t duty) {
+  if (ch >= _channels)
+    return;
+  portENTER_CRITICAL(&_mux);
+  if (_duty[ch] != duty) {
+    _duty[ch] = duty;
+    _dirty |= 1UL << ch;
+  }
+  portEXIT_CRITICAL(&_mux);
+}
+
+bool Pca9685PumpOutput::flush() {
+  // One flusher at a time, and it loops until nothing is staged: a caller
+  // that finds a flush on the bus leaves its change to it, so an older
+  // snapshot can never land after a newer one
+  portENTER_CRITICAL(&_mux);
+  if (_flushing) {
+    portEXIT_CRITICAL(&_mux);
+    return true;
+  }
+  _flushing = true;
+  bool ok = true;
+  while (_dirty) {
+    uint32_t mask = _dirty;
+    uint8_t duty[MAX_CHANNELS];
+    memcpy(duty, _duty, sizeof(duty));
+    _dirty = 0;
+    portEXIT_CRITICAL(&_mux);
+
+    uint32_t failed = 0;
+    for (uint8_t c = 0; c * OUTPUTS_PER_CHIP < _channels; c++) {
+      uint8_t first = c * OUTPUTS_PER_CHIP;
+      uint16_t chipMask = (uint16_t)(mask >> first);
+      if (!chipMask)
+        continue;
+      uint8_t lo = 0, hi = OUTPUTS_PER_CHIP - 1;
+      while (!(chipMask & (1 << lo)))
+        lo++;
+      while (!(chipMask & (1 << hi)))
+        hi--;
+
+      // LEDn_ON_L, ON_H, OFF_L, OFF_H for every output in [lo, hi]
+      uint8_t regs[OUTPUTS_PER_CHIP * 4];
+      uint8_t len = 0;
+      for (uint8_t o = lo; o <= hi; o++) {
+        uint8_t d = duty[first + o];
+        uint16_t off = (uint16_t)((d * 4095UL + 127) / 255);
+        regs[len++] = 0;
+        regs[len++] = (d == 255) ? LED_FULL : 0;
+        regs[len++] = (d == 0 || d == 255) ? 0 : (uint8_t)(off & 0xFF);
+        regs[len++] = (d == 0)     ? LED_FULL
+                      : (d == 255) ? 0
+                                   : (uint8_t)(off >> 8);
+      }
+      if (!_writeRegs(c, REG_LED0_ON_L + 4 * lo, regs, len))
+        failed |= (uint32_t)chipMask << first;
+      _flushWrites++;
+    }
+
+    portENTER_CRITICAL(&_mux);
+    if (failed) {
+      _dirty |= failed; // Next flush retries
+      ok = false;
+      break;
+    }
+  }
+  _flushing = false;
+  portEXIT_CRITICAL(&_mux);
+  if (!ok)
+    Serial.println("[Pump] ERROR: PCA9685 write failed");
+  return ok;
+}
+
+bool Pca9685PumpOutput::_writeRegs(uint8_t chip, uint8_t reg,
+                                   const uint8_t *data, uint8_t len) {
+  _wire->beginTransmission(_addr + chip);
+  _wire->write(reg);
+  _wire->write(data, len);
+  return _wire->endTransmission() == 0;
+}
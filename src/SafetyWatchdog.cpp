@@ -1,11 +1,35 @@
 #include "SafetyWatchdog.h"
-#include <algorithm> // std::sort
+#include "ActuatorLog.h"
+#include <climits> // ULONG_MAX
+#include <esp_timer.h>
+#include <math.h>
+
+const char *samplingModeName(SamplingMode m) {
+  switch (m) {
+  case SamplingMode::IDLE:
+    return "IDLE";
+  case SamplingMode::ACTIVE:
+    return "ACTIVE";
+  case SamplingMode::EMERGENCY:
+    return "EMERGENCY";
+  default:
+    return "UNKNOWN";
+  }
+}
 
 SafetyWatchdog::SafetyWatchdog()
-    : _lastDistance(-1), _emergency(false), _sensorsConnected(false),
-      _ultrasonicFailCount(0), _overflowFlag(false), _maintenance(false),
-      _maintenanceStart(0), _lastCheckMs(0), _emergencyDraining(false),
-      _emergencyDrainStart(0) {}
+    : _lastDistance(-1), _lastDistanceMs(0), _hasSample(false),
+      _emergency(false), _sensorsConnected(false),
+      _ultrasonicFailCount(0), _overflowFlag(false), _opticalTripped(false),
+      _floatTripped(false), _opticalTripUs(0), _opticalTripReported(false),
+      _maintenance(false), _maintenanceStart(0), _lastCheckMs(0),
+      _policies{{SAMPLING_IDLE_CHECK_MS, SAMPLING_IDLE_PINGS},
+                {SAMPLING_ACTIVE_CHECK_MS, SAMPLING_ACTIVE_PINGS},
+                {SAMPLING_EMERGENCY_CHECK_MS, SAMPLING_EMERGENCY_PINGS}},
+      _samplingMode(SamplingMode::ACTIVE), _emergencyDraining(false),
+      _emergencyDrainStart(0), _samplerCursor(0) {
+  memset(&_prefetched, 0, sizeof(_prefetched));
+}
 
 void SafetyWatchdog::begin() {
   // Ultrasonic
@@ -19,9 +43,21 @@ void SafetyWatchdog::begin() {
   // Float switch (active LOW, pulled up)
   pinMode(PIN_FLOAT, INPUT_PULLUP);
 
+  // Both switch to LOW when water arrives: cut the inflow from the ISR
+  // instead of waiting for the next poll
+  attachInterruptArg(digitalPinToInterrupt(PIN_OPTICAL),
+                     &SafetyWatchdog::_onOpticalEdge, this, FALLING);
+  attachInterruptArg(digitalPinToInterrupt(PIN_FLOAT),
+                     &SafetyWatchdog::_onFloatEdge, this, FALLING);
+
   // Initial sensor probe — detect if ultrasonic is connected
   readUltrasonic();
 
+  // Start background pinging; readUltrasonic() falls back to blocking reads
+  // if the sampler can't start. Active until the first update() picks a mode.
+  _sampler.begin(PIN_TRIG, PIN_ECHO,
+                 _policies[(uint8_t)_samplingMode].pingIntervalMs());
+
   Serial.printf("[Safety] Watchdog initialized. Sensors: %s\n",
                 _sensorsConnected ? "CONNECTED" : "NOT CONNECTED");
 }
@@ -31,10 +67,102 @@ void SafetyWatchdog::begin() {
 // ============================================================================
 
 float SafetyWatchdog::readUltrasonic() {
-  float samples[ULTRASONIC_SAMPLES];
+  UltrasonicSampler::Sample fresh[UltrasonicSampler::RING_SIZE];
+  uint8_t n = _sampler.readSince(_samplerCursor, fresh,
+                                 UltrasonicSampler::RING_SIZE);
+
+  float samples[UltrasonicSampler::RING_SIZE];
+  uint32_t stamps[UltrasonicSampler::RING_SIZE];
   uint8_t validCount = 0;
+  for (uint8_t i = 0; i < n; i++) {
+    float cm = UltrasonicSampler::echoToCm(fresh[i].echoUs);
+    if (cm > 0) {
+      samples[validCount] = cm;
+      stamps[validCount] = fresh[i].timestampMs;
+      validCount++;
+    }
+  }
+
+  if (n == 0) {
+    // Sampler alive (missed at most one ping) but nothing new since the
+    // last read
+    if (!_samplerStalled())
+      return _lastDistance;
+    // Sampler not running or stalled — use the control task's burst from
+    // before it took ControlLock, else block
+    if (!_takePrefetched(samples, stamps, validCount))
+      validCount = _burstRead(samples, stamps);
+  }
+
+  return _applySamples(samples, stamps, validCount);
+}
 
-  for (uint8_t i = 0; i < ULTRASONIC_SAMPLES; i++) {
+void SafetyWatchdog::prefetchBurst() {
+  // Only when update() is about to read: a burst nobody consumes would
+  // still spin pulseIn() on the control core
+  if (_maintenance || !_sensorsConnected || !_samplerStalled())
+    return;
+  if ((millis() - _lastCheckMs) < getCheckIntervalMs() ||
+      getLevelAgeMs() <= LEVEL_SAMPLE_MAX_AGE_MS)
+    return;
+
+  Burst b;
+  b.count = _burstRead(b.samples, b.stamps);
+  b.doneMs = millis();
+  b.ready = true;
+  portENTER_CRITICAL(&_prefetchMux);
+  _prefetched = b;
+  portEXIT_CRITICAL(&_prefetchMux);
+}
+
+bool SafetyWatchdog::_samplerStalled() const {
+  return !_sampler.hasPingWithin(2 * _sampler.getPeriodMs() +
+                                 ULTRASONIC_PULSE_TIMEOUT_US / 1000);
+}
+
+bool SafetyWatchdog::_takePrefetched(float *samples, uint32_t *stamps,
+                                     uint8_t &count) {
+  portENTER_CRITICAL(&_prefetchMux);
+  bool fresh = _prefetched.ready &&
+               (millis() - _prefetched.doneMs) <= LEVEL_SAMPLE_MAX_AGE_MS;
+  _prefetched.ready = false;
+  if (fresh) {
+    count = _prefetched.count;
+    memcpy(samples, _prefetched.samples, count * sizeof(float));
+    memcpy(stamps, _prefetched.stamps, count * sizeof(uint32_t));
+  }
+  portEXIT_CRITICAL(&_prefetchMux);
+  return fresh;
+}
+
+float SafetyWatchdog::getLevel(unsigned long maxAgeMs) {
+  if (_hasSample && (millis() - _lastDistanceMs) <= maxAgeMs)
+    return _lastDistance;
+  return readUltrasonic();
+}
+
+unsigned long SafetyWatchdog::getLevelAgeMs() const {
+  if (!_hasSample)
+    return ULONG_MAX;
+  return millis() - _lastDistanceMs;
+}
+
+float SafetyWatchdog::predictLevel(unsigned long horizonMs) {
+  float level = getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+  if (level < 0 || getLevelConfidence() < LEVEL_EST_MIN_CONFIDENCE)
+    return level;
+  return _estimator.predict(millis() + horizonMs);
+}
+
+float SafetyWatchdog::getLevelConfidence() const {
+  return _estimator.confidence(millis());
+}
+
+uint8_t SafetyWatchdog::_burstRead(float *samples, uint32_t *stamps) {
+  uint8_t validCount = 0;
+  uint8_t pings = _policies[(uint8_t)_samplingMode].pings;
+
+  for (uint8_t i = 0; i < pings; i++) {
     // Send trigger pulse
     digitalWrite(PIN_TRIG, LOW);
     delayMicroseconds(2);
@@ -43,19 +171,28 @@ float SafetyWatchdog::readUltrasonic() {
     digitalWrite(PIN_TRIG, LOW);
 
     // Measure echo pulse duration
+    uint32_t pingMs = millis();
     unsigned long duration =
         pulseIn(PIN_ECHO, HIGH, ULTRASONIC_PULSE_TIMEOUT_US);
 
     if (duration > 0) {
       float distance = (duration * 0.0343f) / 2.0f;
       if (distance > 0 && distance < ULTRASONIC_MAX_DISTANCE_CM) {
-        samples[validCount++] = distance;
+        samples[validCount] = distance;
+        stamps[validCount] = pingMs;
+        validCount++;
       }
     }
     delay(30); // JSN-SR04T needs ~30ms between measurements
     yield();   // Let FreeRTOS IDLE task run (prevents task WDT trigger)
   }
 
+  return validCount;
+}
+
+float SafetyWatchdog::_applySamples(const float *samples,
+                                    const uint32_t *stamps,
+                                    uint8_t validCount) {
   if (validCount == 0) {
     _ultrasonicFailCount++;
     if (_ultrasonicFailCount >= 10 && _sensorsConnected) {
@@ -76,20 +213,14 @@ float SafetyWatchdog::readUltrasonic() {
         "[Safety] Ultrasonic sensor connected — safety checks enabled.");
   }
 
-  // If we have enough samples, use median; otherwise use average
-  if (validCount >= 3) {
-    // Pad remaining with valid values for median
-    float sorted[ULTRASONIC_SAMPLES];
-    for (uint8_t i = 0; i < validCount; i++)
-      sorted[i] = samples[i];
-    std::sort(sorted, sorted + validCount);
-    _lastDistance = sorted[validCount / 2];
-  } else {
-    float sum = 0;
-    for (uint8_t i = 0; i < validCount; i++)
-      sum += samples[i];
-    _lastDistance = sum / validCount;
-  }
+  // Stream every ping through the estimator (oldest first)
+  for (uint8_t i = 0; i < validCount; i++)
+    _estimator.update(samples[i], stamps[i]);
+
+  // A lone outlier leaves the estimate (and its timestamp) untouched
+  _lastDistance = _estimator.level();
+  _lastDistanceMs = _estimator.lastUpdateMs();
+  _hasSample = true;
 
   return _lastDistance;
 }
@@ -104,6 +235,47 @@ bool SafetyWatchdog::isReservoirFull() {
   return digitalRead(PIN_FLOAT) == LOW;
 }
 
+// ============================================================================
+// HARDWARE CUT-OFFS (ISR)
+// ============================================================================
+
+void IRAM_ATTR SafetyWatchdog::_onOpticalEdge(void *arg) {
+  SafetyWatchdog *self = static_cast<SafetyWatchdog *>(arg);
+  // Re-read the pin: ignore sub-microsecond glitches and maintenance work
+  if (self->_maintenance || digitalRead(PIN_OPTICAL) != LOW)
+    return;
+  ActuatorLog::write(PIN_REFILL, LOW);
+  ActuatorLog::write(PIN_SOLENOID, LOW);
+  self->_opticalTripUs = (uint32_t)esp_timer_get_time();
+  self->_opticalTripped = true;
+}
+
+void IRAM_ATTR SafetyWatchdog::_onFloatEdge(void *arg) {
+  SafetyWatchdog *self = static_cast<SafetyWatchdog *>(arg);
+  if (self->_maintenance || digitalRead(PIN_FLOAT) != LOW)
+    return;
+  ActuatorLog::write(PIN_SOLENOID, LOW);
+  self->_floatTripped = true;
+}
+
+void SafetyWatchdog::_serviceTrips() {
+  if (_opticalTripped) {
+    if (!_opticalTripReported) {
+      Serial.printf("[Safety] Optical ISR cut-off: refill + solenoid OFF "
+                    "(t=%lu us).\n",
+                    (unsigned long)_opticalTripUs);
+      _opticalTripReported = true;
+    }
+    if (!isOpticalHigh()) {
+      _opticalTripped = false;
+      _opticalTripReported = false;
+    }
+  }
+
+  if (_floatTripped && !isReservoirFull())
+    _floatTripped = false;
+}
+
 // ============================================================================
 // EMERGENCY ACTIONS
 // ============================================================================
@@ -111,7 +283,7 @@ bool SafetyWatchdog::isReservoirFull() {
 void SafetyWatchdog::emergencyShutdown() {
   Serial.println("[EMERGENCY] >>> SHUTDOWN: All outputs OFF <<<");
   for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
-    digitalWrite(OUTPUT_PINS[i], LOW);
+    ActuatorLog::write(OUTPUT_PINS[i], LOW);
   }
   _emergency = true;
   _emergencyDraining = false;
@@ -122,11 +294,11 @@ void SafetyWatchdog::emergencyDrain() {
 
   // Shut everything off first
   for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
-    digitalWrite(OUTPUT_PINS[i], LOW);
+    ActuatorLog::write(OUTPUT_PINS[i], LOW);
   }
 
   // Open drain valve
-  digitalWrite(PIN_DRAIN, HIGH);
+  ActuatorLog::write(PIN_DRAIN, HIGH);
 
   _emergency = true;
   _emergencyDraining = true;
@@ -148,6 +320,50 @@ void SafetyWatchdog::exitMaintenance() {
   _maintenance = false;
 }
 
+// ============================================================================
+// ADAPTIVE SAMPLING
+// ============================================================================
+
+bool SafetyWatchdog::setSamplingPolicy(SamplingMode mode, uint16_t checkMs,
+                                       uint8_t pings) {
+  if ((uint8_t)mode >= SAMPLING_MODE_COUNT || checkMs < SAMPLING_MIN_CHECK_MS ||
+      checkMs > SAMPLING_MAX_CHECK_MS || pings == 0 ||
+      pings > UltrasonicSampler::RING_SIZE)
+    return false;
+
+  _policies[(uint8_t)mode] = {checkMs, pings};
+  if (mode == _samplingMode)
+    _applySamplingMode(mode);
+  return true;
+}
+
+SamplingMode SafetyWatchdog::_selectSamplingMode() {
+  if (_emergencyDraining)
+    return SamplingMode::EMERGENCY;
+
+  // Any TPA output moving water, or water at a limit switch
+  if (digitalRead(PIN_DRAIN) == HIGH || digitalRead(PIN_REFILL) == HIGH ||
+      digitalRead(PIN_SOLENOID) == HIGH || _opticalTripped || _floatTripped ||
+      isOpticalHigh())
+    return SamplingMode::ACTIVE;
+
+  // Level not known yet, or moving with every output off
+  if (!_hasSample || fabsf(getLevelRate()) >= SAMPLING_STABLE_RATE_CM_S)
+    return SamplingMode::ACTIVE;
+
+  return SamplingMode::IDLE;
+}
+
+void SafetyWatchdog::_applySamplingMode(SamplingMode mode) {
+  _samplingMode = mode;
+  const SamplingPolicy &p = _policies[(uint8_t)mode];
+  if (_sampler.isRunning())
+    _sampler.setPeriod(p.pingIntervalMs());
+  Serial.printf("[Safety] Sampling %s: check %u ms, %u pings (%u ms).\n",
+                samplingModeName(mode), p.checkMs, p.pings,
+                p.pingIntervalMs());
+}
+
 // ============================================================================
 // UPDATE (called every loop)
 // ============================================================================
@@ -155,11 +371,19 @@ void SafetyWatchdog::exitMaintenance() {
 void SafetyWatchdog::update() {
   unsigned long now = millis();
 
+  // Pick the sampling policy first: a pump switching on shortens the wait
+  SamplingMode mode = _selectSamplingMode();
+  if (mode != _samplingMode)
+    _applySamplingMode(mode);
+
   // Rate-limit safety checks
-  if ((now - _lastCheckMs) < SAFETY_CHECK_INTERVAL_MS)
+  if ((now - _lastCheckMs) < getCheckIntervalMs())
     return;
   _lastCheckMs = now;
 
+  // -- ISR cut-off latches --
+  _serviceTrips();
+
   // -- Maintenance auto-expire --
   if (_maintenance && (now - _maintenanceStart >= MAINTENANCE_DURATION_MS)) {
     Serial.println("[Safety] Maintenance timer expired.");
@@ -182,8 +406,8 @@ void SafetyWatchdog::update() {
   // -- Optical sensor: immediate stop if water at max --
   if (isOpticalHigh()) {
     // Always stop refill/solenoid when optical is triggered
-    digitalWrite(PIN_REFILL, LOW);
-    digitalWrite(PIN_SOLENOID, LOW);
+    ActuatorLog::write(PIN_REFILL, LOW);
+    ActuatorLog::write(PIN_SOLENOID, LOW);
     _overflowFlag = true;
   } else {
     _overflowFlag = false;
@@ -194,15 +418,19 @@ void SafetyWatchdog::update() {
 }
 
 void SafetyWatchdog::_checkOverflow() {
-  float dist = readUltrasonic();
+  float dist = getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
   if (dist < 0)
     return; // No valid reading
 
+  // Where the water will be at the next check, if it keeps rising
+  float predicted = predictLevel(getCheckIntervalMs());
+
   // Lower distance = higher water level
-  if (dist < LEVEL_SAFETY_MIN_CM && !_emergencyDraining) {
-    Serial.printf(
-        "[Safety] OVERFLOW! Distance=%.1f cm < %.1f cm safety limit\n", dist,
-        LEVEL_SAFETY_MIN_CM);
+  if ((dist < LEVEL_SAFETY_MIN_CM || predicted < LEVEL_SAFETY_MIN_CM) &&
+      !_emergencyDraining) {
+    Serial.printf("[Safety] OVERFLOW! Distance=%.1f cm (predicted %.1f, "
+                  "%.2f cm/s) < %.1f cm safety limit\n",
+                  dist, predicted, getLevelRate(), LEVEL_SAFETY_MIN_CM);
     emergencyDrain();
   }
 }
@@ -217,7 +445,7 @@ void SafetyWatchdog::_updateEmergencyDrain() {
   float dist = _lastDistance;
   if (dist > LEVEL_SAFETY_MIN_CM + 5.0f) {
     Serial.println("[Safety] Emergency drain: water at safe level. Stopping.");
-    digitalWrite(PIN_DRAIN, LOW);
+    ActuatorLog::write(PIN_DRAIN, LOW);
     _emergencyDraining = false;
     _emergency = false;
     return;
@@ -229,8 +457,3 @@ void SafetyWatchdog::_updateEmergencyDrain() {
     emergencyShutdown();
   }
 }
-
-float SafetyWatchdog::_medianOfFive(float *arr) {
-  std::sort(arr, arr + 5);
-  return arr[2];
-}
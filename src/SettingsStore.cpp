@@ -0,0 +1,486 @@
+#include "SettingsStore.h"
+#include "Crc32.h"
+#include "SafetyWatchdog.h" // SamplingPolicy
+#include <math.h>
+
+#ifndef UNIT_TEST
+#include "ControlLock.h"
+#endif
+
+using T = SettingType;
+using NS = SettingNs;
+
+static const char *const NS_NAMES[] = {"aqua", "notify", "pumpcal"};
+static const char *const RECORD_KEYS[] = {"rec0", "rec1"};
+
+// Same order as enum class Setting. Keys are the NVS keys of the per-key
+// layout, read once to convert it.
+static const SettingDef SETTING_DEFS[] = {
+    // ns, key, type, size, default, min, max
+    {NS::AQUA, "tpaInt", T::U16, 2, 7, 0, 365},
+    {NS::AQUA, "tpaH", T::U8, 1, 10, 0, 23},
+    {NS::AQUA, "tpaM", T::U8, 1, 0, 0, 59},
+    {NS::AQUA, "tpaRun", T::U32, 4, 0, 0, 4294967295.0},
+    {NS::AQUA, "tpaPct", T::U8, 1, 20, 0, 100},
+    {NS::AQUA, "canSf", T::U8, 1, 0, 0, 100},
+    {NS::AQUA, "lang", T::U8, 1, 0, 0, 2},
+    {NS::AQUA, "tpaPr", T::FLOAT, 4, DEFAULT_PRIME_ML, 0, 10000},
+    {NS::AQUA, "aqH", T::U16, 2, 0, 0, 1000},
+    {NS::AQUA, "aqL", T::U16, 2, 0, 0, 1000},
+    {NS::AQUA, "aqW", T::U16, 2, 0, 0, 1000},
+    {NS::AQUA, "aqMg", T::U16, 2, 0, 0, 1000},
+    {NS::AQUA, "drFR", T::FLOAT, 4, 0, 0, 1000},
+    {NS::AQUA, "rfFR", T::FLOAT, 4, 0, 0, 1000},
+    {NS::AQUA, "pRat", T::FLOAT, 4, 0, 0, 100},
+    {NS::AQUA, "resVol", T::U16, 2, 0, 0, 10000},
+    {NS::AQUA, "resSf", T::FLOAT, 4, 0, 0, 100000},
+    {NS::AQUA, "smp", T::BYTES,
+     sizeof(SamplingPolicy) * SAMPLING_MODE_COUNT, 0, 0, 0},
+    {NS::NOTIFY, "key", T::STR, 48, 0, 0, 0},
+    {NS::NOTIFY, "mask", T::U8, 1, 0xFF, 0, 0xFF},
+    {NS::NOTIFY, "repH", T::U8, 1, 8, 0, 23},
+    {NS::NOTIFY, "repM", T::U8, 1, 0, 0, 59},
+    {NS::PUMPCAL, "drainLPM", T::FLOAT, 4, 0, 0, 100},
+    {NS::PUMPCAL, "refillLPM", T::FLOAT, 4, 0, 0, 100},
+};
+static_assert(sizeof(SETTING_DEFS) / sizeof(SETTING_DEFS[0]) ==
+                  (size_t)Setting::COUNT,
+              "One SETTING_DEFS entry per Setting");
+static_assert((size_t)Setting::COUNT <= 32, "Dirty mask is 32 bits");
+static_assert(sizeof(NS_NAMES) / sizeof(NS_NAMES[0]) ==
+                  (size_t)SettingNs::COUNT,
+              "One name per SettingNs");
+
+SettingsStore::SettingsStore()
+    : _present(0), _dirty(0), _loading(false), _firstDirtyMs(0),
+      _lastChangeMs(0), _commits(0) {
+  memset(_values, 0, sizeof(_values));
+  memset(_seq, 0, sizeof(_seq));
+  memset(_slot, 0, sizeof(_slot));
+
+  uint16_t off = 0;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    _offset[i] = off;
+    off += SETTING_DEFS[i].size;
+  }
+  if (off > IMAGE_BYTES) // Caught by the first boot log / unit tests
+    Serial.printf("[Settings] ERROR: %u bytes of settings, image holds %u\n",
+                  off, IMAGE_BYTES);
+
+  // Defaults (BYTES stay absent, STR empty)
+  _loading = true;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    T type = SETTING_DEFS[i].type;
+    if (type != T::STR && type != T::BYTES)
+      _setNumber((Setting)i, SETTING_DEFS[i].def);
+  }
+  _loading = false;
+}
+
+const SettingDef &SettingsStore::getDef(Setting id) {
+  return SETTING_DEFS[(uint8_t)id];
+}
+
+uint32_t SettingsStore::_nsMask(SettingNs ns) {
+  uint32_t mask = 0;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    if (SETTING_DEFS[i].ns == ns)
+      mask |= 1UL << i;
+  }
+  return mask;
+}
+
+// ============================================================================
+// LOAD
+// ============================================================================
+
+void SettingsStore::begin() {
+  _loading = true;
+  for (uint8_t n = 0; n < NS_COUNT; n++) {
+    SettingNs ns = (SettingNs)n;
+    Preferences prefs;
+    prefs.begin(NS_NAMES[n], false);
+    bool converted = false;
+    if (_loadRecord(prefs, ns)) {
+      Serial.printf("[Settings] %s: record %u (rec%u)\n", NS_NAMES[n],
+                    (unsigned)_seq[n], _slot[n]);
+    } else if (_loadLegacy(prefs, ns)) {
+      converted = true;
+    }
+    prefs.end();
+
+    // Old layout: one record replaces the keys once it is safely written
+    if (converted) {
+      _dirty |= _nsMask(ns);
+      if (_commit(ns)) {
+        prefs.begin(NS_NAMES[n], false);
+        for (uint8_t i = 0; i < COUNT; i++) {
+          if (SETTING_DEFS[i].ns == ns)
+            prefs.remove(SETTING_DEFS[i].key);
+        }
+        prefs.end();
+        Serial.printf("[Settings] %s: per-key values converted\n",
+                      NS_NAMES[n]);
+      }
+    }
+  }
+  _loading = false;
+}
+
+bool SettingsStore::_loadRecord(Preferences &prefs, SettingNs ns) {
+  uint8_t buf[SETTINGS_RECORD_MAX];
+  int best = -1;
+  uint32_t bestSeq = 0;
+  for (uint8_t k = 0; k < 2; k++) {
+    size_t len = prefs.getBytesLength(RECORD_KEYS[k]);
+    if (len < sizeof(RecordHeader) + sizeof(uint32_t) ||
+        len > sizeof(buf) || prefs.getBytes(RECORD_KEYS[k], buf, len) != len)
+      continue;
+    RecordHeader head;
+    uint32_t crc;
+    memcpy(&head, buf, sizeof(head));
+    memcpy(&crc, buf + len - sizeof(crc), sizeof(crc));
+    if (head.magic != SETTINGS_MAGIC ||
+        len != sizeof(head) + head.len + sizeof(crc) ||
+        crc32(buf, len - sizeof(crc)) != crc) {
+      Serial.printf("[Settings] WARNING: %s %s invalid, ignoring.\n",
+                    NS_NAMES[(uint8_t)ns], RECORD_KEYS[k]);
+      continue;
+    }
+    if (best < 0 || head.seq > bestSeq) {
+      best = k;
+      bestSeq = head.seq;
+    }
+  }
+  if (best < 0)
+    return false;
+
+  size_t len = prefs.getBytes(RECORD_KEYS[best], buf, sizeof(buf));
+  _parseEntries(ns, buf + sizeof(RecordHeader),
+                len - sizeof(RecordHeader) - sizeof(uint32_t));
+  _seq[(uint8_t)ns] = bestSeq;
+  _slot[(uint8_t)ns] = best;
+  return true;
+}
+
+void SettingsStore::_parseEntries(SettingNs ns, const uint8_t *p,
+                                  size_t len) {
+  // Entry: keyLen, key, type, size, value
+  size_t pos = 0;
+  while (pos + 1 <= len) {
+    uint8_t keyLen = p[pos];
+    if (pos + 1 + keyLen + 2 > len)
+      break;
+    const char *key = (const char *)p + pos + 1;
+    T type = (T)p[pos + 1 + keyLen];
+    uint8_t size = p[pos + 2 + keyLen];
+    const uint8_t *val = p + pos + 3 + keyLen;
+    if (pos + 3 + keyLen + size > len)
+      break;
+    pos += 3 + keyLen + size;
+
+    for (uint8_t i = 0; i < COUNT; i++) {
+      const SettingDef &d = SETTING_DEFS[i];
+      if (d.ns != ns || d.type != type || strlen(d.key) != keyLen ||
+          memcmp(d.key, key, keyLen) != 0)
+        continue;
+      if (type == T::STR) {
+        char s[256];
+        memcpy(s, val, size);
+        s[size] = '\0';
+        setString((Setting)i, s);
+      } else if (type == T::BYTES) {
+        setBytes((Setting)i, val, size); // Size change: dropped
+      } else if (size == d.size) {
+        uint32_t u = 0;
+        float f;
+        switch (type) {
+        case T::U8:
+          _setNumber((Setting)i, val[0]);
+          break;
+        case T::U16:
+          memcpy(&u, val, 2);
+          _setNumber((Setting)i, u);
+          break;
+        case T::U32:
+          memcpy(&u, val, 4);
+          _setNumber((Setting)i, u);
+          break;
+        default:
+          memcpy(&f, val, 4);
+          _setNumber((Setting)i, f);
+          break;
+        }
+      }
+      break;
+    }
+  }
+}
+
+bool SettingsStore::_loadLegacy(Preferences &prefs, SettingNs ns) {
+  bool found = false;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    const SettingDef &d = SETTING_DEFS[i];
+    if (d.ns != ns || !prefs.isKey(d.key))
+      continue;
+    found = true;
+    Setting id = (Setting)i;
+    switch (d.type) {
+    case T::U8:
+      _setNumber(id, prefs.getUChar(d.key, d.def));
+      break;
+    case T::U16:
+      _setNumber(id, prefs.getUShort(d.key, d.def));
+      break;
+    case T::U32:
+      _setNumber(id, prefs.getUInt(d.key, d.def));
+      break;
+    case T::FLOAT:
+      _setNumber(id, prefs.getFloat(d.key, d.def));
+      break;
+    case T::STR:
+      setString(id, prefs.getString(d.key, ""));
+      break;
+    case T::BYTES: {
+      uint8_t buf[64];
+      if (d.size <= sizeof(buf) &&
+          prefs.getBytes(d.key, buf, sizeof(buf)) == d.size)
+        setBytes(id, buf, d.size);
+      break;
+    }
+    }
+  }
+  return found;
+}
+
+// ============================================================================
+// ACCESS
+// ============================================================================
+
+double SettingsStore::_getNumber(Setting id) const {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  uint8_t raw[4] = {};
+  portENTER_CRITICAL(&_mux);
+  memcpy(raw, _values + _offset[(uint8_t)id], d.size < 4 ? d.size : 4);
+  portEXIT_CRITICAL(&_mux);
+  uint16_t u16;
+  uint32_t u32;
+  float f;
+  switch (d.type) {
+  case T::U8:
+    return raw[0];
+  case T::U16:
+    memcpy(&u16, raw, 2);
+    return u16;
+  case T::U32:
+    memcpy(&u32, raw, 4);
+    return u32;
+  case T::FLOAT:
+    memcpy(&f, raw, 4);
+    return f;
+  default:
+    return 0;
+  }
+}
+
+bool SettingsStore::_setNumber(Setting id, double value) {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  if (isnan(value))
+    value = d.def;
+  if (value < d.min)
+    value = d.min;
+  if (value > d.max)
+    value = d.max;
+  uint8_t u8 = (uint8_t)value;
+  uint16_t u16 = (uint16_t)value;
+  uint32_t u32 = (uint32_t)value;
+  float f = (float)value;
+  switch (d.type) {
+  case T::U8:
+    return _set(id, &u8, 1);
+  case T::U16:
+    return _set(id, &u16, 2);
+  case T::U32:
+    return _set(id, &u32, 4);
+  case T::FLOAT:
+    return _set(id, &f, 4);
+  default:
+    return false; // Not a number
+  }
+}
+
+uint32_t SettingsStore::getUInt(Setting id) const {
+  return (uint32_t)_getNumber(id);
+}
+
+float SettingsStore::getFloat(Setting id) const {
+  return (float)_getNumber(id);
+}
+
+String SettingsStore::getString(Setting id) const {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  if (d.type != T::STR)
+    return String();
+  char s[256];
+  portENTER_CRITICAL(&_mux);
+  memcpy(s, _values + _offset[(uint8_t)id], d.size);
+  portEXIT_CRITICAL(&_mux);
+  s[d.size - 1] = '\0';
+  return String(s);
+}
+
+bool SettingsStore::getBytes(Setting id, void *out, size_t len) const {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  if (d.type != T::BYTES || len != d.size)
+    return false;
+  portENTER_CRITICAL(&_mux);
+  bool present = _present & (1UL << (uint8_t)id);
+  if (present)
+    memcpy(out, _values + _offset[(uint8_t)id], len);
+  portEXIT_CRITICAL(&_mux);
+  return present;
+}
+
+bool SettingsStore::setUInt(Setting id, uint32_t value) {
+  return _setNumber(id, value);
+}
+
+bool SettingsStore::setFloat(Setting id, float value) {
+  return _setNumber(id, value);
+}
+
+bool SettingsStore::setString(Setting id, const String &value) {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  if (d.type != T::STR)
+    return false;
+  char s[256] = {};
+  strncpy(s, value.c_str(), d.size - 1); // Truncated to the declared size
+  return _set(id, s, d.size);
+}
+
+bool SettingsStore::setBytes(Setting id, const void *data, size_t len) {
+  const SettingDef &d = SETTING_DEFS[(uint8_t)id];
+  if (d.type != T::BYTES || len != d.size)
+    return false;
+  return _set(id, data, len);
+}
+
+bool SettingsStore::_set(Setting id, const void *data, size_t len) {
+  uint8_t i = (uint8_t)id;
+  uint32_t bit = 1UL << i;
+  uint8_t *dst = _values + _offset[i];
+  bool changed = false;
+  portENTER_CRITICAL(&_mux);
+  if (!(_present & bit) || memcmp(dst, data, len) != 0) {
+    memcpy(dst, data, len);
+    _present |= bit;
+    changed = true;
+    if (!_loading) {
+      unsigned long now = millis();
+      if (!_dirty)
+        _firstDirtyMs = now;
+      _lastChangeMs = now;
+      _dirty |= bit;
+    }
+  }
+  portEXIT_CRITICAL(&_mux);
+  return changed;
+}
+
+// ============================================================================
+// COMMIT
+// ============================================================================
+
+void SettingsStore::update() {
+  if (!_dirty)
+    return;
+  unsigned long now = millis();
+  if (now - _lastChangeMs >= SETTINGS_COMMIT_DELAY_MS ||
+      now - _firstDirtyMs >= SETTINGS_COMMIT_MAX_MS)
+    flush();
+}
+
+bool SettingsStore::flush() {
+#ifndef UNIT_TEST
+  ControlLock lock; // One committer at a time (loop task, web handlers)
+#endif
+  bool ok = true;
+  for (uint8_t n = 0; n < NS_COUNT; n++) {
+    if (_dirty & _nsMask((SettingNs)n))
+      ok &= _commit((SettingNs)n);
+  }
+  return ok;
+}
+
+bool SettingsStore::_commit(SettingNs ns) {
+  uint8_t n = (uint8_t)ns;
+  uint32_t mask = _nsMask(ns);
+  uint8_t buf[SETTINGS_RECORD_MAX];
+  size_t pos = sizeof(RecordHeader);
+
+  // Snapshot: a change made while NVS is written marks the setting again
+  portENTER_CRITICAL(&_mux);
+  uint32_t taken = _dirty & mask;
+  _dirty &= ~taken;
+  for (uint8_t i = 0; i < COUNT; i++) {
+    const SettingDef &d = SETTING_DEFS[i];
+    if (d.ns != ns || !(_present & (1UL << i)))
+      continue;
+    uint8_t keyLen = strlen(d.key);
+    if (pos + 3 + keyLen + d.size + sizeof(uint32_t) > sizeof(buf))
+      break; // SETTINGS_RECORD_MAX too small: caught by the tests
+    buf[pos++] = keyLen;
+    memcpy(buf + pos, d.key, keyLen);
+    pos += keyLen;
+    buf[pos++] = (uint8_t)d.type;
+    buf[pos++] = d.size;
+    memcpy(buf + pos, _values + _offset[i], d.size);
+    pos += d.size;
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  RecordHeader head = {SETTINGS_MAGIC, _seq[n] + 1,
+                       (uint16_t)(pos - sizeof(RecordHeader))};
+  memcpy(buf, &head, sizeof(head));
+  uint32_t crc = crc32(buf, pos);
+  memcpy(buf + pos, &crc, sizeof(crc));
+  pos += sizeof(crc);
+
+  // Never overwrite the newest valid record
+  uint8_t slot = _seq[n] ? 1 - _slot[n] : 0;
+  Preferences prefs;
+  prefs.begin(NS_NAMES[n], false);
+  bool ok = prefs.putBytes(RECORD_KEYS[slot], buf, pos) == pos;
+  prefs.end();
+
+  if (!ok) {
+    Serial.printf("[Settings] ERROR: %s commit failed\n", NS_NAMES[n]);
+    portENTER_CRITICAL(&_mux);
+    _dirty |= taken;
+    _firstDirtyMs = _lastChangeMs = millis(); // Retry after the delay
+    portEXIT_CRITICAL(&_mux);
+    return false;
+  }
+  _seq[n] = head.seq;
+  _slot[n] = slot;
+  _commits++;
+  return true;
+}
+
+// ============================================================================
+// REPORTING
+// ============================================================================
+
+void SettingsStore::printReport() const {
+  Serial.printf("[Settings] %u settings, %lu commits\n", COUNT,
+                (unsigned long)_commits);
+  for (uint8_t n = 0; n < NS_COUNT; n++) {
+    Serial.printf("  %-8s seq %lu (rec%u)", NS_NAMES[n],
+                  (unsigned long)_seq[n], _slot[n]);
+    for (uint8_t i = 0; i < COUNT; i++) {
+      if (SETTING_DEFS[i].ns == (SettingNs)n && (_dirty & (1UL << i)))
+        Serial.printf(" *%s", SETTING_DEFS[i].key);
+    }
+    Serial.println();
+  }
+}
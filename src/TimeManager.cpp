@@ -97,9 +97,13 @@ bool TimeManager::isDailyScheduleTime(uint8_t hour, uint8_t minute) {
 }
 
 String TimeManager::getFormattedTime() {
-  DateTime dt = now();
   char buf[22];
-  snprintf(buf, sizeof(buf), "%04d/%02d/%02d %02d:%02d:%02d", dt.year(),
-           dt.month(), dt.day(), dt.hour(), dt.minute(), dt.second());
+  formatTime(buf, sizeof(buf));
   return String(buf);
 }
+
+void TimeManager::formatTime(char *out, size_t len) {
+  DateTime dt = now();
+  snprintf(out, len, "%04d/%02d/%02d %02d:%02d:%02d", dt.year(), dt.month(),
+           dt.day(), dt.hour(), dt.minute(), dt.second());
+}
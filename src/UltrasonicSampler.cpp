@@ -0,0 +1,202 @@
+#include "UltrasonicSampler.h"
+
+UltrasonicSampler::UltrasonicSampler()
+    : _trigPin(0), _echoPin(0), _running(false),
+      _periodMs(ULTRASONIC_PING_INTERVAL_MS), _timer(nullptr), _pingUs(0),
+      _riseUs(0), _awaitingEcho(false), _head(0), _count(0), _pingCount(0),
+      _missCount(0) {
+  memset(_ring, 0, sizeof(_ring));
+}
+
+bool UltrasonicSampler::begin(uint8_t trigPin, uint8_t echoPin,
+                              unsigned long periodMs) {
+  _trigPin = trigPin;
+  _echoPin = echoPin;
+  _periodMs = periodMs;
+
+  if (!_timer) {
+    esp_timer_create_args_t args = {};
+    args.callback = &UltrasonicSampler::_onPingTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "us_ping";
+    if (esp_timer_create(&args, &_timer) != ESP_OK) {
+      _timer = nullptr;
+      Serial.println("[Sampler] Timer create failed — using blocking reads.");
+      return false;
+    }
+  }
+
+  attachInterruptArg(digitalPinToInterrupt(_echoPin),
+                     &UltrasonicSampler::_onEchoEdge, this, CHANGE);
+
+  if (esp_timer_start_periodic(_timer, (uint64_t)periodMs * 1000) != ESP_OK) {
+    detachInterrupt(digitalPinToInterrupt(_echoPin));
+    Serial.println("[Sampler] Timer start failed — using blocking reads.");
+    return false;
+  }
+
+  _running = true;
+  Serial.printf("[Sampler] Ultrasonic sampling every %lu ms.\n", periodMs);
+  return true;
+}
+
+bool UltrasonicSampler::setPeriod(unsigned long periodMs) {
+  if (!isRunning())
+    return false;
+  if (periodMs == _periodMs)
+    return true;
+
+  esp_timer_stop(_timer);
+  _awaitingEcho = false; // Drop a ping in flight rather than mis-time it
+  if (esp_timer_start_periodic(_timer, (uint64_t)periodMs * 1000) != ESP_OK) {
+    detachInterrupt(digitalPinToInterrupt(_echoPin));
+    _running = false;
+    Serial.println("[Sampler] Timer restart failed — using blocking reads.");
+    return false;
+  }
+  _periodMs = periodMs;
+  return true;
+}
+
+void UltrasonicSampler::end() {
+  if (!_running)
+    return;
+  esp_timer_stop(_timer);
+  detachInterrupt(digitalPinToInterrupt(_echoPin));
+  _running = false;
+  _awaitingEcho = false;
+}
+
+// ============================================================================
+// RING BUFFER
+// ============================================================================
+
+void IRAM_ATTR UltrasonicSampler::push(uint32_t timestampMs, uint16_t echoUs) {
+  portENTER_CRITICAL_SAFE(&_mux);
+  _ring[_head].timestampMs = timestampMs;
+  _ring[_head].echoUs = echoUs;
+  _head = (_head + 1) % RING_SIZE;
+  if (_count < RING_SIZE)
+    _count++;
+  _pingCount++;
+  if (echoUs == 0)
+    _missCount++;
+  portEXIT_CRITICAL_SAFE(&_mux);
+}
+
+uint8_t UltrasonicSampler::collect(float *out, uint8_t maxCount,
+                                   unsigned long maxAgeMs, uint8_t *pings,
+                                   uint32_t *newestMs) const {
+  // Snapshot under the lock, convert outside it (no float math while locked)
+  Sample snap[RING_SIZE];
+  uint8_t n;
+  portENTER_CRITICAL(&_mux);
+  n = _count;
+  for (uint8_t i = 0; i < n; i++) {
+    snap[i] = _ring[(_head + RING_SIZE - 1 - i) % RING_SIZE]; // newest first
+  }
+  portEXIT_CRITICAL(&_mux);
+
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  uint8_t valid = 0;
+  uint8_t seen = 0;
+  for (uint8_t i = 0; i < n && valid < maxCount; i++) {
+    if ((now - snap[i].timestampMs) > maxAgeMs)
+      break; // Older entries are older still
+    seen++;
+    float cm = echoToCm(snap[i].echoUs);
+    if (cm > 0) {
+      if (valid == 0 && newestMs)
+        *newestMs = snap[i].timestampMs;
+      out[valid++] = cm;
+    }
+  }
+
+  if (pings)
+    *pings = seen;
+  return valid;
+}
+
+uint8_t UltrasonicSampler::readSince(uint32_t &cursor, Sample *out,
+                                     uint8_t maxCount) const {
+  portENTER_CRITICAL(&_mux);
+  uint32_t pending = _pingCount - cursor;
+  if (pending > _count)
+    pending = _count;
+  if (pending > maxCount)
+    pending = maxCount;
+  for (uint8_t i = 0; i < pending; i++) {
+    out[i] = _ring[(_head + RING_SIZE - pending + i) % RING_SIZE];
+  }
+  cursor = _pingCount;
+  portEXIT_CRITICAL(&_mux);
+  return (uint8_t)pending;
+}
+
+bool UltrasonicSampler::hasPingWithin(unsigned long maxAgeMs) const {
+  portENTER_CRITICAL(&_mux);
+  bool any = _count > 0;
+  uint32_t newestMs = _ring[(_head + RING_SIZE - 1) % RING_SIZE].timestampMs;
+  portEXIT_CRITICAL(&_mux);
+  uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+  return any && (now - newestMs) <= maxAgeMs;
+}
+
+float UltrasonicSampler::echoToCm(uint16_t echoUs) {
+  if (echoUs == 0)
+    return -1;
+  float distance = (echoUs * 0.0343f) / 2.0f;
+  if (distance > 0 && distance < ULTRASONIC_MAX_DISTANCE_CM)
+    return distance;
+  return -1;
+}
+
+// ============================================================================
+// TIMER + ISR
+// ============================================================================
+
+void UltrasonicSampler::_onPingTimer(void *arg) {
+  UltrasonicSampler *self = static_cast<UltrasonicSampler *>(arg);
+
+  // Previous ping never produced a falling edge: record a miss
+  if (self->_awaitingEcho) {
+    self->_awaitingEcho = false;
+    self->push((uint32_t)(self->_pingUs / 1000), 0);
+  }
+
+  // 10 us trigger pulse (runs in the esp_timer task, not an ISR)
+  digitalWrite(self->_trigPin, LOW);
+  delayMicroseconds(2);
+  digitalWrite(self->_trigPin, HIGH);
+  delayMicroseconds(10);
+  digitalWrite(self->_trigPin, LOW);
+
+  self->_riseUs = 0;
+  self->_pingUs = esp_timer_get_time();
+  self->_awaitingEcho = true;
+}
+
+void IRAM_ATTR UltrasonicSampler::_onEchoEdge(void *arg) {
+  UltrasonicSampler *self = static_cast<UltrasonicSampler *>(arg);
+  int64_t now = esp_timer_get_time();
+
+  if (digitalRead(self->_echoPin) == HIGH) {
+    self->_riseUs = now;
+    return;
+  }
+
+  // Falling edge: only count it if it closes an echo for the current ping
+  if (!self->_awaitingEcho || self->_riseUs == 0)
+    return;
+
+  int64_t width = now - self->_riseUs;
+  self->_awaitingEcho = false;
+  self->_riseUs = 0;
+
+  // Integer-only in ISR context (no FPU use); conversion happens in collect()
+  uint16_t echoUs = (width > 0 && width <= (int64_t)ULTRASONIC_PULSE_TIMEOUT_US)
+                        ? (uint16_t)width
+                        : 0;
+  self->push((uint32_t)(self->_pingUs / 1000), echoUs);
+}
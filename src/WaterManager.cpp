@@ -1,6 +1,13 @@
 #include "WaterManager.h"
+#include "ActuatorLog.h"
+#include "Crc32.h"
 #include "FertManager.h"
 #include "SafetyWatchdog.h"
+#include <Preferences.h>
+#include <climits> // ULONG_MAX
+#include <cstddef> // offsetof
+
+RTC_NOINIT_ATTR TpaCheckpoint tpaRtcCheckpoint;
 
 const char *tpaStateName(TPAState s) {
   switch (s) {
@@ -30,6 +37,7 @@ const char *tpaStateName(TPAState s) {
 WaterManager::WaterManager()
     : _state(TPAState::IDLE), _safety(nullptr), _fert(nullptr),
       _stateStartMs(0), _waitUntilMs(0), _doseCompleted(false),
+      _primeDosing(false),
       _drainTargetCm(LEVEL_DRAIN_TARGET_CM),
       _refillTargetCm(LEVEL_REFILL_TARGET_CM),
       _canisterSafeLevelCm(15.0f), // Default: 15cm (safe for most canisters)
@@ -37,7 +45,11 @@ WaterManager::WaterManager()
       _timeoutDrainMs(30UL * 1000),  // 30s safe default (uncalibrated)
       _timeoutRefillMs(15UL * 1000), // 15s safe default (uncalibrated)
       _litersPerCm(0), _aqEffectiveHeightCm(0), _calStartLevel(0),
-      _calStartMs(0), _drainFlowLPM(0), _refillFlowLPM(0) {}
+      _calStartMs(0), _drainFlowLPM(0), _refillFlowLPM(0),
+      _cutoffTimer(nullptr), _cutoffPin(0), _cutoffFired(false),
+      _cutoffFiredMs(0), _cutoffDisabled(false), _lastDrainOvershootCm(0),
+      _lastRefillOvershootCm(0), _ckptSeq(0), _mirroredSeq(0), _pending(),
+      _hasPending(false) {}
 
 void WaterManager::begin(SafetyWatchdog *safety, FertManager *fert) {
   _safety = safety;
@@ -65,14 +77,17 @@ void WaterManager::startTPA() {
 
 void WaterManager::abortTPA() {
   Serial.println("[TPA] !!! TPA ABORTED !!!");
+  _disarmCutoff();
   // Turn off all TPA-related actuators
-  digitalWrite(PIN_DRAIN, LOW);
-  digitalWrite(PIN_REFILL, LOW);
-  digitalWrite(PIN_SOLENOID, LOW);
-  digitalWrite(PIN_PRIME, LOW);
+  ActuatorLog::write(PIN_DRAIN, LOW);
+  ActuatorLog::write(PIN_REFILL, LOW);
+  ActuatorLog::write(PIN_SOLENOID, LOW);
+  ActuatorLog::write(PIN_PRIME, LOW);
+  _stopPrimeDose();
   // Canister back on for safety (SSR: LOW = ON)
-  digitalWrite(PIN_CANISTER, LOW);
+  ActuatorLog::write(PIN_CANISTER, LOW);
   _state = TPAState::ERROR;
+  _saveCheckpoint(true);
 }
 
 void WaterManager::update() {
@@ -111,6 +126,10 @@ void WaterManager::update() {
   default:
     break;
   }
+
+  // Keep the elapsed time current (RAM only; transitions saved already)
+  if (isRunning())
+    _saveCheckpoint(false);
 }
 
 // ============================================================================
@@ -118,9 +137,12 @@ void WaterManager::update() {
 // ============================================================================
 
 void WaterManager::_enterState(TPAState newState) {
+  _disarmCutoff();
+  _cutoffDisabled = false;
   _state = newState;
   _stateStartMs = millis();
   Serial.printf("[TPA] -> State: %s\n", tpaStateName(newState));
+  _saveCheckpoint(true);
 }
 
 // ============================================================================
@@ -131,7 +153,7 @@ void WaterManager::_handleCanisterOff() {
   // Step 1: Turn off canister filter (SSR: HIGH = OFF)
   if (_waitUntilMs == 0) {
     // First call: turn off canister and start the non-blocking wait
-    digitalWrite(PIN_CANISTER, HIGH);
+    ActuatorLog::write(PIN_CANISTER, HIGH);
     Serial.println("[TPA] Canister OFF. Waiting 3s for water to settle...");
     _waitUntilMs = millis() + 3000;
     return;
@@ -146,49 +168,58 @@ void WaterManager::_handleCanisterOff() {
 
 void WaterManager::_handleDraining() {
   // Step 2: Drain until ultrasonic shows target level
+  // One level sample per tick, shared with the safety watchdog's cache
+  float dist = _safety ? _safety->getLevel(LEVEL_SAMPLE_MAX_AGE_MS) : -1;
+
+  // Cut-off timer stopped the pump: confirm once the surface has settled
+  if (_cutoffFired) {
+    if (millis() - _cutoffFiredMs < TPA_CUTOFF_SETTLE_MS)
+      return;
+    unsigned long stopMs = _cutoffFiredMs;
+    _disarmCutoff();
+    if (dist >= _drainTargetCm - TPA_CUTOFF_TOLERANCE_CM) {
+      _recordOvershoot(true, _drainTargetCm, dist, "timer");
+      _captureDrainCalibration(dist, stopMs);
+      _enterState(TPAState::FILLING_RESERVOIR);
+      return;
+    }
+    Serial.printf("[TPA] Drain cut-off short (%.1f / %.1f cm). Resuming.\n",
+                  dist, _drainTargetCm);
+    _cutoffDisabled = true;
+    ActuatorLog::write(PIN_DRAIN, HIGH);
+    return;
+  }
+
   // Ensure drain pump is ON at the start of this state
-  if (digitalRead(PIN_DRAIN) == LOW) {
-    // Start drain pump on first tick
-    digitalWrite(PIN_DRAIN, HIGH);
+  if (_pumpOnIfIdle(PIN_DRAIN)) {
     Serial.printf("[TPA] Drain pump ON. Target: %.1f cm\n", _drainTargetCm);
     // Record calibration start point
     if (_safety && _litersPerCm > 0) {
-      _calStartLevel = _safety->readUltrasonic();
+      _calStartLevel = dist;
       _calStartMs = millis();
     }
   }
 
-  // Read ultrasonic
   if (_safety) {
-    float dist = _safety->readUltrasonic();
     if (dist >= _drainTargetCm) {
       // Target reached (higher distance = lower water)
+      _disarmCutoff();
       Serial.printf("[TPA] Drain target reached: %.1f cm\n", dist);
-      digitalWrite(PIN_DRAIN, LOW);
-
-      // Inline calibration: calculate drain flow rate
-      if (_calStartMs > 0 && _litersPerCm > 0) {
-        float deltaLevel = dist - _calStartLevel; // cm drained
-        float deltaLiters = deltaLevel * _litersPerCm;
-        float deltaMinutes = (float)(millis() - _calStartMs) / 60000.0f;
-        if (deltaMinutes > 0.1f && deltaLiters > 0.1f) {
-          _drainFlowLPM = deltaLiters / deltaMinutes;
-          Serial.printf(
-              "[TPA] Drain calibrated: %.2f L/min (%.1fL in %.1fmin)\n",
-              _drainFlowLPM, deltaLiters, deltaMinutes);
-        }
-      }
-
+      ActuatorLog::write(PIN_DRAIN, LOW);
+      _recordOvershoot(true, _drainTargetCm, dist, "sensor");
+      _captureDrainCalibration(dist, millis());
       _enterState(TPAState::FILLING_RESERVOIR);
       return;
     }
+
+    if (!_cutoffDisabled)
+      _armCutoff(PIN_DRAIN, dist, _drainTargetCm, _drainFlowLPM, +1);
   }
 
   // Timeout check (uses dynamic timeout)
   if (_stateElapsed() >= _timeoutDrainMs) {
     // Even on timeout, capture partial calibration data
     if (_safety && _calStartMs > 0 && _litersPerCm > 0) {
-      float dist = _safety->readUltrasonic();
       float deltaLevel = dist - _calStartLevel;
       float deltaLiters = deltaLevel * _litersPerCm;
       float deltaMinutes = (float)(millis() - _calStartMs) / 60000.0f;
@@ -204,22 +235,23 @@ void WaterManager::_handleDraining() {
 }
 
 void WaterManager::_handleFillingReservoir() {
-  // Step 3: Open solenoid until float switch indicates reservoir full
-  if (digitalRead(PIN_SOLENOID) == LOW) {
-    digitalWrite(PIN_SOLENOID, HIGH);
-    Serial.println("[TPA] Solenoid OPEN. Filling reservoir...");
-  }
-
-  if (_safety && _safety->isReservoirFull()) {
+  // Step 3: Open solenoid until float switch indicates reservoir full.
+  // Checked before (re)opening: the float ISR may already have closed it.
+  if (_safety && (_safety->isReservoirFull() || _safety->floatTripped())) {
     Serial.println("[TPA] Reservoir FULL (float switch triggered).");
-    digitalWrite(PIN_SOLENOID, LOW);
+    ActuatorLog::write(PIN_SOLENOID, LOW);
     _enterState(TPAState::DOSING_PRIME);
     return;
   }
 
+  if (digitalRead(PIN_SOLENOID) == LOW) {
+    ActuatorLog::write(PIN_SOLENOID, HIGH);
+    Serial.println("[TPA] Solenoid OPEN. Filling reservoir...");
+  }
+
   // Timeout check
   if (_stateElapsed() >= TIMEOUT_FILL_MS) {
-    digitalWrite(PIN_SOLENOID, LOW);
+    ActuatorLog::write(PIN_SOLENOID, LOW);
     _error("Reservoir fill timeout exceeded!");
     return;
   }
@@ -227,19 +259,31 @@ void WaterManager::_handleFillingReservoir() {
 
 void WaterManager::_handleDosingPrime() {
   // Step 4: Dose Prime (dechlorinator) into reservoir
-  if (!_doseCompleted) {
-    // First call: perform dosing
+  if (!_doseCompleted && !_primeDosing) {
+    // First call: start the pump; FertManager's timer stops it and takes
+    // the volume from the Prime stock
     if (_fert && _primeML > 0) {
       Serial.printf("[TPA] Dosing Prime: %.1f ml\n", _primeML);
-      bool ok = _fert->doseChannel(NUM_FERTS, _primeML); // Channel 4 = Prime
-      if (!ok) {
-        Serial.println("[TPA] WARNING: Prime dosing may have timed out.");
+      _primeDosing = _fert->startDose(NUM_FERTS, _primeML); // Ch 4 = Prime
+      if (!_primeDosing) {
+        Serial.println("[TPA] WARNING: Prime dose could not start.");
       }
-      // Deduct from Prime stock
-      float stock = _fert->getStockML(NUM_FERTS);
-      _fert->setStockML(NUM_FERTS, stock - _primeML);
-      _fert->saveState();
     }
+    if (_primeDosing)
+      return;
+  }
+
+  if (_primeDosing) {
+    if (_fert->isDosing(NUM_FERTS)) {
+      if (millis() - _stateStartMs > TIMEOUT_PRIME_MS + DOSE_STOP_GRACE_MS) {
+        _error("Prime dose did not stop in time");
+      }
+      return;
+    }
+    _primeDosing = false;
+  }
+
+  if (!_doseCompleted) {
     _doseCompleted = true;
     _waitUntilMs = millis() + 2000; // Let Prime mix
     return;
@@ -253,43 +297,79 @@ void WaterManager::_handleDosingPrime() {
   }
 }
 
+void WaterManager::_stopPrimeDose() {
+  if (_fert && _primeDosing)
+    _fert->stopDose(NUM_FERTS);
+  _primeDosing = false;
+}
+
 void WaterManager::_handleRefilling() {
   // Step 5: Refill tank until optical sensor or ultrasonic setpoint
-  if (digitalRead(PIN_REFILL) == LOW) {
-    digitalWrite(PIN_REFILL, HIGH);
+  float dist = _safety ? _safety->getLevel(LEVEL_SAMPLE_MAX_AGE_MS) : -1;
+
+  // CRITICAL SAFETY: Optical sensor = immediate stop (the ISR has usually
+  // cut the pump already; this moves the state machine on)
+  if (_safety && (_safety->isOpticalHigh() || _safety->opticalTripped())) {
+    _disarmCutoff();
+    Serial.println("[TPA] Optical sensor HIGH — refill STOPPED (max level).");
+    ActuatorLog::write(PIN_REFILL, LOW);
+    _captureRefillCalibration(millis());
+    _enterState(TPAState::CANISTER_ON);
+    return;
+  }
+
+  // Cut-off timer stopped the pump: confirm once the surface has settled
+  if (_cutoffFired) {
+    if (millis() - _cutoffFiredMs < TPA_CUTOFF_SETTLE_MS)
+      return;
+    unsigned long stopMs = _cutoffFiredMs;
+    _disarmCutoff();
+    if (dist > 0 && dist <= _refillTargetCm + TPA_CUTOFF_TOLERANCE_CM) {
+      _recordOvershoot(false, _refillTargetCm, dist, "timer");
+      _captureRefillCalibration(stopMs);
+      _enterState(TPAState::CANISTER_ON);
+      return;
+    }
+    Serial.printf("[TPA] Refill cut-off short (%.1f / %.1f cm). Resuming.\n",
+                  dist, _refillTargetCm);
+    _cutoffDisabled = true;
+    ActuatorLog::write(PIN_REFILL, HIGH);
+    return;
+  }
+
+  if (_pumpOnIfIdle(PIN_REFILL)) {
     Serial.printf("[TPA] Refill pump ON. Target: %.1f cm\n", _refillTargetCm);
     // Record calibration start point
     if (_safety && _litersPerCm > 0) {
-      _calStartLevel = _safety->readUltrasonic();
+      _calStartLevel = dist;
       _calStartMs = millis();
     }
   }
 
-  // CRITICAL SAFETY: Optical sensor = immediate stop
-  if (_safety && _safety->isOpticalHigh()) {
-    Serial.println("[TPA] Optical sensor HIGH — refill STOPPED (max level).");
-    digitalWrite(PIN_REFILL, LOW);
-    _captureRefillCalibration();
-    _enterState(TPAState::CANISTER_ON);
-    return;
-  }
-
-  // Ultrasonic setpoint check
+  // Ultrasonic setpoint check — stop on the level the water will reach by
+  // the time the pump actually stops, not the last (already late) reading
   if (_safety) {
-    float dist = _safety->readUltrasonic();
-    if (dist > 0 && dist <= _refillTargetCm) {
-      Serial.printf("[TPA] Refill setpoint reached: %.1f cm\n", dist);
-      digitalWrite(PIN_REFILL, LOW);
-      _captureRefillCalibration();
+    float predicted = _safety->predictLevel(LEVEL_PREDICT_HORIZON_MS);
+    if (dist > 0 && (dist <= _refillTargetCm || predicted <= _refillTargetCm)) {
+      _disarmCutoff();
+      Serial.printf("[TPA] Refill setpoint reached: %.1f cm (predicted %.1f)\n",
+                    dist, predicted);
+      ActuatorLog::write(PIN_REFILL, LOW);
+      _recordOvershoot(false, _refillTargetCm, dist, "sensor");
+      _captureRefillCalibration(millis());
       _enterState(TPAState::CANISTER_ON);
       return;
     }
+
+    if (!_cutoffDisabled && dist > 0)
+      _armCutoff(PIN_REFILL, dist, _refillTargetCm, _refillFlowLPM, -1);
   }
 
   // Timeout check (uses dynamic timeout)
   if (_stateElapsed() >= _timeoutRefillMs) {
-    digitalWrite(PIN_REFILL, LOW);
-    _captureRefillCalibration();
+    _disarmCutoff();
+    ActuatorLog::write(PIN_REFILL, LOW);
+    _captureRefillCalibration(millis());
     _error("Refill timeout exceeded!");
     return;
   }
@@ -297,19 +377,33 @@ void WaterManager::_handleRefilling() {
 
 void WaterManager::_handleCanisterOn() {
   // Step 6: Turn canister filter back on (SSR: LOW = ON)
-  digitalWrite(PIN_CANISTER, LOW);
+  ActuatorLog::write(PIN_CANISTER, LOW);
   Serial.println("[TPA] Canister ON. TPA cycle COMPLETE.");
 
   _state = TPAState::COMPLETE;
+  _saveCheckpoint(true);
+}
+
+void WaterManager::_captureDrainCalibration(float dist, unsigned long endMs) {
+  if (_calStartMs > 0 && _litersPerCm > 0) {
+    float deltaLevel = dist - _calStartLevel; // cm drained
+    float deltaLiters = deltaLevel * _litersPerCm;
+    float deltaMinutes = (float)(endMs - _calStartMs) / 60000.0f;
+    if (deltaMinutes > 0.1f && deltaLiters > 0.1f) {
+      _drainFlowLPM = deltaLiters / deltaMinutes;
+      Serial.printf("[TPA] Drain calibrated: %.2f L/min (%.1fL in %.1fmin)\n",
+                    _drainFlowLPM, deltaLiters, deltaMinutes);
+    }
+  }
 }
 
-void WaterManager::_captureRefillCalibration() {
+void WaterManager::_captureRefillCalibration(unsigned long endMs) {
   if (_calStartMs > 0 && _litersPerCm > 0 && _safety) {
-    float dist = _safety->readUltrasonic();
+    float dist = _safety->getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
     float deltaLevel =
         _calStartLevel - dist; // cm refilled (level goes DOWN = closer)
     float deltaLiters = deltaLevel * _litersPerCm;
-    float deltaMinutes = (float)(millis() - _calStartMs) / 60000.0f;
+    float deltaMinutes = (float)(endMs - _calStartMs) / 60000.0f;
     if (deltaMinutes > 0.1f && deltaLiters > 0.1f) {
       _refillFlowLPM = deltaLiters / deltaMinutes;
       Serial.printf("[TPA] Refill calibrated: %.2f L/min (%.1fL in %.1fmin)\n",
@@ -318,12 +412,268 @@ void WaterManager::_captureRefillCalibration() {
   }
 }
 
+// ============================================================================
+// CHECKPOINT
+// ============================================================================
+// The control task rewrites the RTC copy every tick (a RAM write and a CRC);
+// loop copies it to NVS only when the state changed, a handful of writes
+// per cycle. Outputs are all LOW after a reset, so every state is resumed
+// by re-entering it: its handler switches the pump or valve back on.
+
+bool WaterManager::_checkpointValid(const TpaCheckpoint &c) {
+  return c.magic == TPA_CKPT_MAGIC &&
+         c.crc == crc32(&c, offsetof(TpaCheckpoint, crc));
+}
+
+void WaterManager::_saveCheckpoint(bool transition) {
+  if (transition)
+    _ckptSeq++;
+  TpaCheckpoint c = {};
+  c.magic = TPA_CKPT_MAGIC;
+  c.state = (uint8_t)_state;
+  c.flags = (_primeDosing || _doseCompleted) ? TPA_CKPT_PRIME_STARTED : 0;
+  c.seq = _ckptSeq;
+  c.elapsedMs = _stateElapsed();
+  c.drainTargetCm = _drainTargetCm;
+  c.refillTargetCm = _refillTargetCm;
+  c.canisterSafeLevelCm = _canisterSafeLevelCm;
+  c.primeML = _primeML;
+  c.timeoutDrainMs = _timeoutDrainMs;
+  c.timeoutRefillMs = _timeoutRefillMs;
+  c.litersPerCm = _litersPerCm;
+  c.aqEffectiveHeightCm = _aqEffectiveHeightCm;
+  c.drainFlowLPM = _drainFlowLPM;
+  c.refillFlowLPM = _refillFlowLPM;
+  c.crc = crc32(&c, offsetof(TpaCheckpoint, crc));
+
+  portENTER_CRITICAL(&_ckptMux);
+  tpaRtcCheckpoint = c;
+  portEXIT_CRITICAL(&_ckptMux);
+}
+
+bool WaterManager::loadCheckpoint() {
+  TpaCheckpoint c = tpaRtcCheckpoint;
+  if (!_checkpointValid(c)) {
+    // Power loss (or first boot): RTC memory holds garbage
+    Preferences prefs;
+    prefs.begin("tpa", true);
+    size_t n = prefs.getBytes("ckpt", &c, sizeof(c));
+    prefs.end();
+    if (n != sizeof(c) || !_checkpointValid(c))
+      return false;
+  }
+  _ckptSeq = c.seq;
+
+  TPAState s = (TPAState)c.state;
+  if (s < TPAState::CANISTER_OFF || s > TPAState::CANISTER_ON)
+    return false;
+  _pending = c;
+  _hasPending = true;
+
+  // Step 1 switched the canister on: until the cycle resumes the tank may
+  // be drained below its intake
+  if (s != TPAState::CANISTER_ON)
+    ActuatorLog::write(PIN_CANISTER, HIGH); // SSR: HIGH = OFF
+  return true;
+}
+
+void WaterManager::resumeTPA() {
+  if (!_hasPending)
+    return;
+  _hasPending = false;
+  const TpaCheckpoint &c = _pending;
+  TPAState s = (TPAState)c.state;
+
+  _drainTargetCm = c.drainTargetCm;
+  _refillTargetCm = c.refillTargetCm;
+  _canisterSafeLevelCm = c.canisterSafeLevelCm;
+  _primeML = c.primeML;
+  _timeoutDrainMs = c.timeoutDrainMs;
+  _timeoutRefillMs = c.timeoutRefillMs;
+  _litersPerCm = c.litersPerCm;
+  _aqEffectiveHeightCm = c.aqEffectiveHeightCm;
+  if (c.drainFlowLPM > 0)
+    _drainFlowLPM = c.drainFlowLPM;
+  if (c.refillFlowLPM > 0)
+    _refillFlowLPM = c.refillFlowLPM;
+
+  Serial.printf("[TPA] ====== TPA RESUMED at %s (%lus in state) ======\n",
+                tpaStateName(s), (unsigned long)(c.elapsedMs / 1000));
+
+  bool sensorsOk = _safety && _safety->areSensorsConnected();
+  if (s != TPAState::CANISTER_ON && (!sensorsOk || _safety->isEmergency())) {
+    // Drain and refill can't be steered blind: stop here, canister back on
+    // only if the level is known to be safe
+    _error("Interrupted by a reset, cannot resume");
+    return;
+  }
+
+  _enterState(s);
+  switch (s) {
+  case TPAState::DRAINING:
+  case TPAState::FILLING_RESERVOIR:
+  case TPAState::REFILLING:
+    // The timeout keeps counting from the original start
+    _stateStartMs = millis() - c.elapsedMs;
+    break;
+  case TPAState::DOSING_PRIME:
+    if (c.flags & TPA_CKPT_PRIME_STARTED) {
+      // Stock already debited and the dose size unknown: don't dose twice
+      Serial.println("[TPA] Prime was dosing at reset. Not dosing again.");
+      _doseCompleted = true;
+      _waitUntilMs = millis() + 2000; // Let Prime mix
+    }
+    break;
+  default:
+    break; // CANISTER_OFF re-waits; CANISTER_ON completes on the next tick
+  }
+  _saveCheckpoint(false);
+}
+
+void WaterManager::mirrorCheckpoint() {
+  TpaCheckpoint c;
+  portENTER_CRITICAL(&_ckptMux);
+  c = tpaRtcCheckpoint;
+  portEXIT_CRITICAL(&_ckptMux);
+  if (!_checkpointValid(c) || c.seq == _mirroredSeq)
+    return;
+
+  Preferences prefs;
+  prefs.begin("tpa", false);
+  TPAState s = (TPAState)c.state;
+  if (s >= TPAState::CANISTER_OFF && s <= TPAState::CANISTER_ON)
+    prefs.putBytes("ckpt", &c, sizeof(c));
+  else if (prefs.isKey("ckpt"))
+    prefs.remove("ckpt"); // Cycle over: nothing to resume
+  prefs.end();
+  _mirroredSeq = c.seq;
+}
+
+// ============================================================================
+// PREDICTIVE CUT-OFF
+// ============================================================================
+
+bool WaterManager::_pumpOnIfIdle(uint8_t pin) {
+  // Locked against _onCutoffTimer so a cut-off that fires mid-tick can't be
+  // undone by the "pump still LOW → start it" check
+  bool started = false;
+  portENTER_CRITICAL(&_cutoffMux);
+  if (!_cutoffFired && digitalRead(pin) == LOW) {
+    ActuatorLog::write(pin, HIGH);
+    started = true;
+  }
+  portEXIT_CRITICAL(&_cutoffMux);
+  return started;
+}
+
+unsigned long WaterManager::_projectTimeToTargetMs(float dist, float targetCm,
+                                                   float flowLPM, int8_t dir) {
+  float remainingCm = (targetCm - dist) * dir;
+  if (remainingCm <= 0)
+    return 0;
+
+  // Calibrated pump flow converted to level speed
+  float calCmPerS = 0;
+  if (flowLPM > 0 && _litersPerCm > 0)
+    calCmPerS = flowLPM / _litersPerCm / 60.0f;
+
+  // Live slope, only if it points the way the pump is moving the water
+  float liveCmPerS = _safety ? _safety->getLevelRate() * dir : 0;
+  float conf = _safety ? _safety->getLevelConfidence() : 0;
+
+  float cmPerS = calCmPerS;
+  if (liveCmPerS > 0 && conf >= LEVEL_EST_MIN_CONFIDENCE) {
+    cmPerS = (calCmPerS > 0) ? conf * liveCmPerS + (1.0f - conf) * calCmPerS
+                             : liveCmPerS;
+  }
+  if (cmPerS <= 0)
+    return ULONG_MAX;
+
+  // dist is already getLevelAgeMs() old
+  float etaMs = remainingCm / cmPerS * 1000.0f;
+  float ageMs = _safety ? (float)_safety->getLevelAgeMs() : 0;
+  return etaMs > ageMs ? (unsigned long)(etaMs - ageMs) : 0;
+}
+
+void WaterManager::_armCutoff(uint8_t pin, float dist, float targetCm,
+                              float flowLPM, int8_t dir) {
+  unsigned long etaMs = _projectTimeToTargetMs(dist, targetCm, flowLPM, dir);
+  if (etaMs > TPA_CUTOFF_ARM_WINDOW_MS) {
+    _disarmCutoff(); // Rate dropped or unknown: leave it to the sensor
+    return;
+  }
+
+  if (!_cutoffTimer) {
+    esp_timer_create_args_t args = {};
+    args.callback = &WaterManager::_onCutoffTimer;
+    args.arg = this;
+    args.dispatch_method = ESP_TIMER_TASK;
+    args.name = "tpa_cutoff";
+    if (esp_timer_create(&args, &_cutoffTimer) != ESP_OK) {
+      _cutoffTimer = nullptr;
+      _cutoffDisabled = true; // Sensor-only for this state
+      return;
+    }
+  }
+
+  unsigned long delayMs = etaMs > TPA_CUTOFF_LEAD_MS
+                              ? etaMs - TPA_CUTOFF_LEAD_MS
+                              : 0;
+  bool wasArmed = _cutoffPin != 0;
+
+  // Refine the deadline every tick as the slope estimate improves
+  if (esp_timer_is_active(_cutoffTimer))
+    esp_timer_stop(_cutoffTimer);
+  _cutoffPin = pin;
+  esp_timer_start_once(_cutoffTimer, (uint64_t)(delayMs + 1) * 1000);
+
+  if (!wasArmed) {
+    Serial.printf("[TPA] Cut-off armed: %.1f cm to go, stop in ~%lu ms\n",
+                  (targetCm - dist) * dir, delayMs);
+  }
+}
+
+void WaterManager::_disarmCutoff() {
+  if (_cutoffTimer && esp_timer_is_active(_cutoffTimer))
+    esp_timer_stop(_cutoffTimer);
+  portENTER_CRITICAL(&_cutoffMux);
+  _cutoffPin = 0;
+  _cutoffFired = false;
+  portEXIT_CRITICAL(&_cutoffMux);
+}
+
+void WaterManager::_onCutoffTimer(void *arg) {
+  WaterManager *self = static_cast<WaterManager *>(arg);
+  portENTER_CRITICAL(&self->_cutoffMux);
+  if (self->_cutoffPin != 0) {
+    ActuatorLog::write(self->_cutoffPin, LOW);
+    self->_cutoffFired = true;
+    self->_cutoffFiredMs = millis();
+  }
+  portEXIT_CRITICAL(&self->_cutoffMux);
+}
+
+void WaterManager::_recordOvershoot(bool drain, float targetCm, float finalCm,
+                                    const char *how) {
+  // Drain: distance grows past target. Refill: distance shrinks past it.
+  float overshoot = drain ? finalCm - targetCm : targetCm - finalCm;
+  if (drain)
+    _lastDrainOvershootCm = overshoot;
+  else
+    _lastRefillOvershootCm = overshoot;
+  Serial.printf("[TPA] %s cut-off (%s): target %.1f cm, final %.1f cm, "
+                "overshoot %+.2f cm\n",
+                drain ? "Drain" : "Refill", how, targetCm, finalCm, overshoot);
+}
+
 void WaterManager::_error(const char *msg) {
   Serial.printf("[TPA] ERROR: %s\n", msg);
+  _disarmCutoff();
   // Safety: turn off all TPA actuators
-  digitalWrite(PIN_DRAIN, LOW);
-  digitalWrite(PIN_REFILL, LOW);
-  digitalWrite(PIN_SOLENOID, LOW);
+  ActuatorLog::write(PIN_DRAIN, LOW);
+  ActuatorLog::write(PIN_REFILL, LOW);
+  ActuatorLog::write(PIN_SOLENOID, LOW);
+  _stopPrimeDose();
 
   // Build detailed error message for notifications
   _lastErrorMsg = String(msg);
@@ -331,7 +681,7 @@ void WaterManager::_error(const char *msg) {
   // Only turn canister back on if water level is safe
   // (low distance = high water = safe for canister intake)
   if (_safety) {
-    float dist = _safety->readUltrasonic();
+    float dist = _safety->getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
     char buf[100];
     // Convert to percentage (low dist = high water = high %)
     float waterPct =
@@ -345,7 +695,7 @@ void WaterManager::_error(const char *msg) {
     if (waterPct < 0)
       waterPct = 0;
     if (dist > 0 && dist <= _canisterSafeLevelCm) {
-      digitalWrite(PIN_CANISTER, LOW); // SSR: LOW = ON
+      ActuatorLog::write(PIN_CANISTER, LOW); // SSR: LOW = ON
       Serial.printf(
           "[TPA] Canister ON (water level %.0f%% is safe, limit: %.0f%%).\n",
           waterPct, safePct);
@@ -366,4 +716,5 @@ void WaterManager::_error(const char *msg) {
   }
 
   _state = TPAState::ERROR;
+  _saveCheckpoint(true);
 }
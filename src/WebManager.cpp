@@ -1,7 +1,16 @@
 #include "WebManager.h"
+#include "ActuatorLog.h"
+#include "ControlLock.h"
+#include "CounterStore.h"
+#include "DoseJournal.h"
+#include "EventAgenda.h"
 #include "FertManager.h"
+#include "JsonWriter.h"
+#include "LoopProfiler.h"
+#include "LoopScheduler.h"
 #include "NotifyManager.h"
 #include "SafetyWatchdog.h"
+#include "SettingsStore.h"
 #include "TimeManager.h"
 #include "WaterManager.h"
 #include <LittleFS.h>
@@ -9,9 +18,20 @@
 
 #ifdef USE_WEBSERVER
 #include <WiFi.h>
+#include <memory>
 #endif
 
-static Preferences _prefs;
+
+/// Parse "idle" / "active" / "emergency" (case-insensitive)
+static bool parseSamplingMode(const char *name, SamplingMode &out) {
+  for (uint8_t m = 0; m < SAMPLING_MODE_COUNT; m++) {
+    if (strcasecmp(name, samplingModeName((SamplingMode)m)) == 0) {
+      out = (SamplingMode)m;
+      return true;
+    }
+  }
+  return false;
+}
 
 // ============================================================================
 // CONSTRUCTOR
@@ -24,12 +44,25 @@ WebManager::WebManager()
     :
 #endif
       _time(nullptr), _water(nullptr), _fert(nullptr), _safety(nullptr),
+      _notify(nullptr), _controlPerf(nullptr), _loopPerf(nullptr),
+      _sched(nullptr), _agenda(nullptr), _journal(nullptr),
+      _counters(nullptr), _actuators(nullptr), _settings(nullptr),
       _tpaInterval(7), _tpaHour(10), _tpaMinute(0), _tpaLastRun(0),
-      _tpaPercent(20), _canisterSafePct(0), _language(0),
+      _paramsRev(0), _tpaPercent(20), _canisterSafePct(0), _language(0),
       _primeML(DEFAULT_PRIME_ML), _aqHeight(0), _aqLength(0), _aqWidth(0),
       _aqMarginCm(0), _drainFlowRate(0), _refillFlowRate(0),
       _reservoirVolume(0), _reservoirSafetyML(0), _lastTelemetryMs(0),
-      _lastSSEMs(0) {
+      _lastLiveMs(0), _lastResyncMs(0), _sentConfigRev(0), _sentStocksRev(0),
+      _sseKick(false), _bootId(0), _configVersion(0), _cfgParamsRev(0),
+      _cfgFertRev(0), _configCacheLen(0) {
+#ifdef USE_WEBSERVER
+  _drainRunUs = 0;
+  _refillRunUs = 0;
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+    _fertRunUs[i] = 0;
+  _restartPending = false;
+  _restartAtMs = 0;
+#endif
 }
 
 // ============================================================================
@@ -52,6 +85,10 @@ void WebManager::begin(TimeManager *time, WaterManager *water,
   }
 
 #ifdef USE_WEBSERVER
+  // Versions restart at 1 every boot: the id keeps old ETags from matching
+  _bootId = esp_random();
+  _jobs.setSwitch(&WebManager::_switchJob, this);
+  _jobs.setDoneCallback(&WebManager::_onJobDone, this);
   _setupRoutes();
   _server.begin();
   String ipStr = WiFi.status() == WL_CONNECTED ? WiFi.localIP().toString()
@@ -68,7 +105,15 @@ void WebManager::begin(TimeManager *time, WaterManager *water,
 
 void WebManager::setTpaLastRun(uint32_t epoch) {
   _tpaLastRun = epoch;
+  if (_counters && _counters->writeBank(CounterBank::TPA_LAST_RUN,
+                                        &_tpaLastRun, sizeof(_tpaLastRun))) {
+    _paramsRev++;
+    return;
+  }
   _saveParams();
+  // Not debounced: a stamp lost to a power cut would repeat the TPA
+  if (_settings)
+    _settings->flush();
 }
 
 // ============================================================================
@@ -77,12 +122,49 @@ void WebManager::setTpaLastRun(uint32_t epoch) {
 
 void WebManager::update() {
 #ifdef USE_WEBSERVER
-  // Send SSE telemetry every 3 seconds to reduce network congestion
+  // Calibration runs: timer fallback, completions reported over SSE
+  _jobs.poll();
+
+  if (_restartPending && (millis() - _restartAtMs) >= WEB_RESTART_DELAY_MS) {
+    // Pending setting edits would be lost with the restart
+    if (_settings)
+      _settings->flush();
+    ESP.restart();
+  }
+
+  // SSE topics: "live" every WEB_SSE_LIVE_MS, "config" and "stocks" when
+  // their revision moves. Each event only carries the members that changed.
+  // A connecting client already has config and stocks from /api/config, so
+  // it only gets "live" in full; every WEB_SSE_RESYNC_MS (for events dropped
+  // by a full client queue) all three topics are resent. Built here, in loop
+  // only, so the static buffer has a single writer.
   unsigned long now = millis();
-  if ((now - _lastSSEMs) >= 3000 && _events.count() > 0) {
-    _lastSSEMs = now;
-    String json = _buildStatusJSON();
-    _events.send(json.c_str(), "status", millis());
+  if (_events.count() > 0) {
+    bool resync = (now - _lastResyncMs) >= WEB_SSE_RESYNC_MS;
+    bool kick = _sseKick;
+    if (resync) {
+      _lastResyncMs = now;
+      _configDelta.reset();
+      _stocksDelta.reset();
+    }
+    if (resync || kick) {
+      _sseKick = false;
+      _liveDelta.reset();
+    }
+    if (resync || kick || (now - _lastLiveMs) >= WEB_SSE_LIVE_MS) {
+      _lastLiveMs = now;
+      _sendTopic("live", _liveDelta, &WebManager::_writeLiveFields);
+    }
+    uint32_t rev = _paramsRev;
+    if (resync || rev != _sentConfigRev) {
+      _sentConfigRev = rev;
+      _sendTopic("config", _configDelta, &WebManager::_writeConfigFields);
+    }
+    rev = _fert ? _fert->getStateRevision() : 0;
+    if (resync || rev != _sentStocksRev) {
+      _sentStocksRev = rev;
+      _sendTopic("stocks", _stocksDelta, &WebManager::_writeStocksFields);
+    }
   }
 #endif
   _updateTelemetry();
@@ -92,132 +174,394 @@ void WebManager::update() {
 // STATUS JSON
 // ============================================================================
 
-String WebManager::_buildStatusJSON() {
-  String json;
-  json.reserve(1200); // Prevent heap fragmentation and speed up concatenation
-  json += "{";
+void WebManager::_writeStatusJSON(JsonWriter &w) {
+  w.beginObject();
+  _writeLiveFields(w);
+  _writeConfigFields(w);
+  _writeChannels(w);
+  w.endObject();
+}
+
+void WebManager::_writeConfigJSON(JsonWriter &w) {
+  w.beginObject();
+  w.field("version", (unsigned long)_configVersion);
+  _writeConfigFields(w);
+  _writeChannels(w);
+  w.endObject();
+}
+
+void WebManager::_writeChannels(JsonWriter &w) {
+  w.beginArray("stocks");
+  if (_fert) {
+    for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+      _writeStock(w, i);
+  }
+  w.endArray();
+  // Low stock thresholds
+  if (_fert) {
+    w.beginArray("lowStockThresholds");
+    for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+      w.value(_fert->getLowStockThreshold(i), 0);
+    w.endArray();
+  }
+}
 
+void WebManager::_syncConfigVersion() {
+  uint32_t paramsRev = _paramsRev;
+  uint32_t fertRev = _fert ? _fert->getStateRevision() : 0;
+  if (_configVersion != 0 && paramsRev == _cfgParamsRev &&
+      fertRev == _cfgFertRev)
+    return;
+  _cfgParamsRev = paramsRev;
+  _cfgFertRev = fertRev;
+  _configVersion++;
+  _configCacheLen = 0;
+}
+
+void WebManager::_sendTopic(const char *event, JsonDelta &delta,
+                            void (WebManager::*fields)(JsonWriter &)) {
+  JsonWriter w(_statusBuf, sizeof(_statusBuf));
+  w.beginObject();
+  (this->*fields)(w);
+  w.endObject();
+  if (w.overflowed()) {
+    Serial.printf("[Web] SSE %s over %u bytes, skipped.\n", event,
+                  (unsigned)sizeof(_statusBuf));
+    return;
+  }
+  if (delta.filter(_statusBuf, w.length()) > 0)
+    _events.send(_statusBuf, event, millis());
+}
+
+// Sensors, TPA state, dosing activity: changes by the second
+void WebManager::_writeLiveFields(JsonWriter &w) {
   // WiFi Connection Status
-  json += "\"wifiConnected\":" +
-          String(WiFi.status() == WL_CONNECTED ? "true" : "false") + ",";
+  w.field("wifiConnected", WiFi.status() == WL_CONNECTED);
 
   if (_time) {
-    json += "\"time\":\"" + _time->getFormattedTime() + "\",";
+    char timeBuf[22];
+    _time->formatTime(timeBuf, sizeof(timeBuf));
+    w.field("time", timeBuf);
   }
   if (_safety) {
-    json += "\"waterLevel\":" + String(_safety->getLastDistance(), 1) + ",";
-    json +=
-        "\"optical\":" + String(_safety->isOpticalHigh() ? "true" : "false") +
-        ",";
-    json +=
-        "\"float\":" + String(_safety->isReservoirFull() ? "true" : "false") +
-        ",";
-    json +=
-        "\"emergency\":" + String(_safety->isEmergency() ? "true" : "false") +
-        ",";
-    json += "\"maintenance\":" +
-            String(_safety->isMaintenanceMode() ? "true" : "false") + ",";
+    w.field("waterLevel", _safety->getLastDistance(), 1);
+    w.field("levelRate", _safety->getLevelRate(), 2);
+    w.field("levelConf", _safety->getLevelConfidence(), 2);
+    w.field("optical", _safety->isOpticalHigh());
+    w.field("float", _safety->isReservoirFull());
+    w.field("emergency", _safety->isEmergency());
+    w.field("maintenance", _safety->isMaintenanceMode());
+    const SamplingPolicy &sp =
+        _safety->getSamplingPolicy(_safety->getSamplingMode());
+    w.beginObject("sampling")
+        .field("mode", samplingModeName(_safety->getSamplingMode()))
+        .field("checkMs", sp.checkMs)
+        .field("pings", sp.pings)
+        .field("pingMs", sp.pingIntervalMs())
+        .endObject();
   }
   if (_water) {
-    json += "\"tpaState\":\"" + String(_water->getStateName()) + "\",";
-    json +=
-        "\"canister\":" + String(_water->isCanisterOn() ? "true" : "false") +
-        ",";
+    w.field("tpaState", _water->getStateName());
+    w.field("canister", _water->isCanisterOn());
+    w.field("drainOvershoot", _water->getLastDrainOvershootCm(), 2);
+    w.field("refillOvershoot", _water->getLastRefillOvershootCm(), 2);
+  }
+  if (_agenda) {
+    const AgendaEvent *next = _agenda->peek();
+    w.beginObject("agenda")
+        .field("next", next ? (unsigned long)next->dueEpoch : 0UL)
+        .field("late", (unsigned long)_agenda->getLateCount())
+        .field("missed", (unsigned long)_agenda->getMissedCount())
+        .endObject();
+  }
+  if (_fert) {
+    FertManager::DoseWindow dw = _fert->getDoseWindow();
+    w.beginObject("dosing")
+        .field("maxConcurrent", _fert->getMaxConcurrent())
+        .field("budgetMA", _fert->getCurrentBudgetMA())
+        .field("running", _fert->getRunningCount())
+        .field("queued", _fert->getQueuedCount());
+    w.beginObject("window")
+        .field("open", _fert->isDoseWindowOpen())
+        .field("startMs", (unsigned long)(dw.startUs / 1000))
+        .field("endMs", (unsigned long)(dw.endUs / 1000))
+        .field("doses", dw.doses)
+        .field("ml", dw.ml, 1)
+        .field("peakPumps", dw.peakPumps)
+        .field("peakMA", dw.peakMA)
+        .endObject()
+        .endObject();
+  }
+  // Notify status (its settings have no revision; the patch drops them
+  // while unchanged)
+  if (_notify) {
+    w.beginObject("notify")
+        .field("enabled", _notify->isEnabled())
+        .field("dailyCount", _notify->getDailyCount())
+        .field("reportHour", _notify->getDailyReportHour())
+        .field("reportMinute", _notify->getDailyReportMinute());
+    w.beginArray("types");
+    for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++)
+      w.value(_notify->isTypeEnabled((NotifyType)i));
+    w.endArray().endObject();
   }
+}
 
-  // Schedule
-  json += "\"tpaInterval\":" + String(_tpaInterval) + ",";
-  json += "\"tpaHour\":" + String(_tpaHour) + ",";
-  json += "\"tpaMinute\":" + String(_tpaMinute) + ",";
-  json += "\"tpaPercent\":" + String(_tpaPercent) + ",";
-  json += "\"canisterSafePct\":" + String(_canisterSafePct) + ",";
-  json += "\"primeMl\":" + String(_primeML, 1) + ",";
+// Schedule and aquarium parameters (revision: _paramsRev)
+void WebManager::_writeConfigFields(JsonWriter &w) {
+  w.field("tpaInterval", _tpaInterval);
+  w.field("tpaHour", _tpaHour);
+  w.field("tpaMinute", _tpaMinute);
+  w.field("tpaPercent", _tpaPercent);
+  w.field("canisterSafePct", _canisterSafePct);
+  w.field("primeMl", _primeML, 1);
   uint32_t aqVol = (uint32_t)_aqHeight * _aqLength * _aqWidth / 1000;
   float lPerCm = (float)_aqLength * _aqWidth / 1000.0;
-  json += "\"aqHeight\":" + String(_aqHeight) + ",";
-  json += "\"aqLength\":" + String(_aqLength) + ",";
-  json += "\"aqWidth\":" + String(_aqWidth) + ",";
-  json += "\"aqMarginCm\":" + String(_aqMarginCm) + ",";
-  json += "\"aquariumVolume\":" + String(aqVol) + ",";
-  json += "\"litersPerCm\":" + String(lPerCm, 2) + ",";
-  json += "\"drainFlowRate\":" + String(_drainFlowRate, 2) + ",";
-  json += "\"refillFlowRate\":" + String(_refillFlowRate, 2) + ",";
-  json += "\"primeRatio\":" + String(_primeRatio, 4) + ",";
-  json += "\"reservoirVolume\":" + String(_reservoirVolume) + ",";
-  json += "\"reservoirSafetyML\":" + String(_reservoirSafetyML, 0) + ",";
-  json += "\"tpaConfigReady\":";
-  json += (isTpaConfigReady() ? "true" : "false");
-  json += ",";
-  json += "\"language\":" + String(_language) + ",";
-  // Stocks
-  json += "\"stocks\":[";
-  if (_fert) {
-    for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
-      if (i > 0)
-        json += ",";
-      json += "{\"stock\":" + String(_fert->getStockML(i), 0) + ",\"name\":\"" +
-              _fert->getName(i) + "\"" + ",\"doses\":[" +
-              String(_fert->getDoseML(i, 0), 1) + "," +
-              String(_fert->getDoseML(i, 1), 1) + "," +
-              String(_fert->getDoseML(i, 2), 1) + "," +
-              String(_fert->getDoseML(i, 3), 1) + "," +
-              String(_fert->getDoseML(i, 4), 1) + "," +
-              String(_fert->getDoseML(i, 5), 1) + "," +
-              String(_fert->getDoseML(i, 6), 1) + "]" + ",\"sH\":[";
-      for (uint8_t d = 0; d < 7; d++) {
-        if (d > 0)
-          json += ",";
-        json += String(_fert->getSchedHour(i, d));
-      }
-      json += "],\"sM\":[";
-      for (uint8_t d = 0; d < 7; d++) {
-        if (d > 0)
-          json += ",";
-        json += String(_fert->getSchedMinute(i, d));
-      }
-      json += "]" + String(",\"fR\":") + String(_fert->getFlowRate(i), 2) +
-              ",\"pwm\":" + String(_fert->getPWM(i)) + "}";
-    }
-  }
-  json += "]";
+  w.field("aqHeight", _aqHeight);
+  w.field("aqLength", _aqLength);
+  w.field("aqWidth", _aqWidth);
+  w.field("aqMarginCm", _aqMarginCm);
+  w.field("aquariumVolume", aqVol);
+  w.field("litersPerCm", lPerCm, 2);
+  w.field("drainFlowRate", _drainFlowRate, 2);
+  w.field("refillFlowRate", _refillFlowRate, 2);
+  w.field("primeRatio", _primeRatio, 4);
+  w.field("reservoirVolume", _reservoirVolume);
+  w.field("reservoirSafetyML", _reservoirSafetyML, 0);
+  w.field("tpaConfigReady", isTpaConfigReady());
+  w.field("language", _language);
+}
 
-  // Notify status
-  if (_notify) {
-    json += ",\"notify\":{";
-    json +=
-        "\"enabled\":" + String(_notify->isEnabled() ? "true" : "false") + ",";
-    json += "\"dailyCount\":" + String(_notify->getDailyCount()) + ",";
-    json += "\"reportHour\":" + String(_notify->getDailyReportHour()) + ",";
-    json += "\"reportMinute\":" + String(_notify->getDailyReportMinute()) + ",";
-    json += "\"types\":[";
-    for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++) {
-      if (i > 0)
-        json += ",";
-      json += _notify->isTypeEnabled((NotifyType)i) ? "true" : "false";
-    }
-    json += "]}";
+// Channels keyed by index, so a dose resends one channel (revision:
+// FertManager::getStateRevision)
+void WebManager::_writeStocksFields(JsonWriter &w) {
+  if (!_fert)
+    return;
+  char key[4];
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    snprintf(key, sizeof(key), "%u", i);
+    w.key(key);
+    _writeStock(w, i);
   }
+  w.beginArray("lowStockThresholds");
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+    w.value(_fert->getLowStockThreshold(i), 0);
+  w.endArray();
+}
 
-  // Low stock thresholds
-  if (_fert) {
-    json += ",\"lowStockThresholds\":[";
-    for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
-      if (i > 0)
-        json += ",";
-      json += String(_fert->getLowStockThreshold(i), 0);
-    }
-    json += "]";
+void WebManager::_writeStock(JsonWriter &w, uint8_t i) {
+  w.beginObject()
+      .field("stock", _fert->getStockML(i), 0)
+      .field("name", _fert->getName(i));
+  w.beginArray("doses");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(_fert->getDoseML(i, d), 1);
+  w.endArray().beginArray("sH");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(_fert->getSchedHour(i, d));
+  w.endArray().beginArray("sM");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(_fert->getSchedMinute(i, d));
+  // Full plan, [minuteOfWeek, centiMl] pairs (split daily doses)
+  w.endArray().beginArray("sch");
+  for (uint8_t k = 0; k < _fert->getScheduleCount(i); k++) {
+    FertManager::DoseSlot slot = _fert->getScheduleSlot(i, k);
+    w.value(slot.minuteOfWeek).value(slot.centiMl);
   }
+  w.endArray()
+      .field("fR", _fert->getFlowRate(i), 2)
+      .field("pwm", _fert->getPWM(i))
+      .field("mA", _fert->getPumpCurrentMA(i))
+      .field("runS", (unsigned long)(_fert->getPumpRuntimeMs(i) / 1000))
+      .endObject();
+}
 
+// ============================================================================
+// PROFILING
+// ============================================================================
+
+String WebManager::_buildPerfJSON() {
+  String json;
+  json.reserve(2048);
+  json += "{\"bucketBase\":2,\"profilers\":[";
+  if (_controlPerf)
+    _controlPerf->appendJSON(json);
+  if (_controlPerf && _loopPerf)
+    json += ",";
+  if (_loopPerf)
+    _loopPerf->appendJSON(json);
+  json += "],\"jobs\":";
+  if (_sched)
+    _sched->appendJSON(json);
+  else
+    json += "[]";
   json += "}";
   return json;
 }
 
+void WebManager::_printDosing() {
+  if (!_fert)
+    return;
+  Serial.printf("[Dosing] Budget: %d pumps, %u mA (0 = no limit). "
+                "Running %d, queued %d\n",
+                _fert->getMaxConcurrent(), _fert->getCurrentBudgetMA(),
+                _fert->getRunningCount(), _fert->getQueuedCount());
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    Serial.printf("  CH%d  %4u mA at full duty, pwm %3d → %4u mA\n", i + 1,
+                  _fert->getPumpCurrentMA(i), _fert->getPWM(i),
+                  _fert->getLoadMA(i));
+  }
+  FertManager::DoseWindow w = _fert->getDoseWindow();
+  if (w.doses) {
+    Serial.printf("  Window%s: %lu → %lu ms, %d doses, %.1f ml, "
+                  "peak %d pumps / %u mA\n",
+                  _fert->isDoseWindowOpen() ? " (open)" : "",
+                  (unsigned long)(w.startUs / 1000),
+                  (unsigned long)(w.endUs / 1000), w.doses, w.ml, w.peakPumps,
+                  w.peakMA);
+  }
+}
+
+void WebManager::_printJournal() {
+  if (!_journal || !_journal->isReady()) {
+    Serial.println("[Journal] Not mounted");
+    return;
+  }
+  uint32_t newest = _journal->getNewestEpoch();
+  Serial.printf("[Journal] %d segment(s), %lu dose(s), %lu → %lu\n",
+                _journal->getSegmentCount(),
+                (unsigned long)_journal->getEntryCount(),
+                (unsigned long)_journal->getOldestEpoch(),
+                (unsigned long)newest);
+  DoseJournal::Query q;
+  _journal->beginQuery(q, newest > 86400 ? newest - 86400 : 0, UINT32_MAX);
+  DoseJournal::Record recs[8];
+  size_t n;
+  while ((n = _journal->read(q, recs, 8)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      DateTime t(recs[i].epoch);
+      Serial.printf("  %04d/%02d/%02d %02d:%02d:%02d  CH%d %6.2f/%6.2f ml "
+                    "%6lu ms pwm %3d %s%s\n",
+                    t.year(), t.month(), t.day(), t.hour(), t.minute(),
+                    t.second(), recs[i].channel + 1, recs[i].deliveredMl,
+                    recs[i].requestedMl, (unsigned long)recs[i].durationMs,
+                    recs[i].pwm, DoseJournal::resultName(recs[i].result),
+                    (recs[i].flags & DoseJournal::FLAG_SCHEDULED)
+                        ? ""
+                        : " unscheduled");
+    }
+  }
+}
+
+void WebManager::_printAgenda() {
+  if (!_agenda)
+    return;
+  AgendaEvent events[AGENDA_CAPACITY];
+  uint8_t n = _agenda->snapshot(events, AGENDA_CAPACITY);
+  Serial.printf("[Agenda] %d events, %lu late, %lu missed\n", n,
+                (unsigned long)_agenda->getLateCount(),
+                (unsigned long)_agenda->getMissedCount());
+  for (uint8_t i = 0; i < n; i++) {
+    DateTime due(events[i].dueEpoch);
+    Serial.printf("  %04d/%02d/%02d %02d:%02d  %s", due.year(), due.month(),
+                  due.day(), due.hour(), due.minute(),
+                  agendaKindName(events[i].kind));
+    if (events[i].kind == AgendaKind::FERT_DOSE)
+      Serial.printf(" CH%d", events[i].arg + 1);
+    Serial.println();
+  }
+  const AgendaEvent &m = _agenda->getLastMissed();
+  if (m.dueEpoch) {
+    DateTime due(m.dueEpoch);
+    Serial.printf("  last missed: %s/%d due %04d/%02d/%02d %02d:%02d\n",
+                  agendaKindName(m.kind), m.arg, due.year(), due.month(),
+                  due.day(), due.hour(), due.minute());
+  }
+}
+
+void WebManager::_resetPerf() {
+  if (_controlPerf)
+    _controlPerf->reset();
+  if (_loopPerf)
+    _loopPerf->reset();
+  if (_sched)
+    _sched->resetStats();
+}
+
 // ============================================================================
 // WEB ROUTES
 // ============================================================================
 
 #ifdef USE_WEBSERVER
+/// State of one /api/fert/history response. The chunk filler emits whole
+/// JSON lines; one that does not fit the TCP buffer is finished next call.
+struct HistoryStream {
+  DoseJournal *journal;
+  DoseJournal::Query query;
+  DoseJournal::Record recs[8];
+  uint8_t recCount = 0;
+  uint8_t recNext = 0;
+  uint32_t sent = 0;
+  uint8_t phase = 0; // 0 header, 1 entries, 2 footer, 3 end
+  char line[160];
+  size_t lineLen = 0;
+  size_t lineOff = 0;
+
+  /// Format the next line; false once the response is complete
+  bool nextLine() {
+    lineOff = 0;
+    lineLen = 0;
+    if (phase == 0) {
+      lineLen = snprintf(line, sizeof(line),
+                         "{\"from\":%lu,\"to\":%lu,\"entries\":[",
+                         (unsigned long)query.from, (unsigned long)query.to);
+      phase = 1;
+      return true;
+    }
+    if (phase == 1) {
+      if (recNext == recCount) {
+        recCount = journal->read(query, recs, 8);
+        recNext = 0;
+      }
+      if (recCount == 0) {
+        phase = 2;
+        return nextLine();
+      }
+      const DoseJournal::Record &r = recs[recNext++];
+      lineLen = snprintf(
+          line, sizeof(line),
+          "%s{\"t\":%lu,\"ch\":%u,\"req\":%.2f,\"ml\":%.2f,\"ms\":%lu,"
+          "\"pwm\":%u,\"result\":\"%s\",\"scheduled\":%s}",
+          sent ? "," : "", (unsigned long)r.epoch, r.channel, r.requestedMl,
+          r.deliveredMl, (unsigned long)r.durationMs, r.pwm,
+          DoseJournal::resultName(r.result),
+          (r.flags & DoseJournal::FLAG_SCHEDULED) ? "true" : "false");
+      sent++;
+      return true;
+    }
+    if (phase == 2) {
+      lineLen = snprintf(line, sizeof(line), "],\"count\":%lu}",
+                         (unsigned long)sent);
+      phase = 3;
+      return true;
+    }
+    return false;
+  }
+
+  size_t fill(uint8_t *buf, size_t maxLen) {
+    size_t w = 0;
+    while (w < maxLen) {
+      if (lineOff == lineLen && !nextLine())
+        break;
+      size_t n = min(maxLen - w, lineLen - lineOff);
+      memcpy(buf + w, line + lineOff, n);
+      lineOff += n;
+      w += n;
+    }
+    return w;
+  }
+};
+
 void WebManager::_setupRoutes() {
   // ---- Dashboard React App (LittleFS) ----
   _server.serveStatic("/", LittleFS, "/").setDefaultFile("index.html");
@@ -225,20 +569,139 @@ void WebManager::_setupRoutes() {
   // ---- SSE Events ----
   _events.onConnect([this](AsyncEventSourceClient *client) {
     Serial.println("[Web] SSE client connected");
-    client->send(_buildStatusJSON().c_str(), "status", millis());
+    _sseKick = true; // Full "live" on the next update()
   });
   _server.addHandler(&_events);
 
-  // ---- GET /api/status ----
+  // ---- GET /api/live (sensors, TPA state, dosing: small, never cached) ----
+  _server.on("/api/live", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    AsyncResponseStream *response =
+        request->beginResponseStream("application/json");
+    JsonWriter w(*response);
+    w.beginObject();
+    _writeLiveFields(w);
+    w.endObject();
+    request->send(response);
+  });
+
+  // ---- GET /api/config (parameters + channels, ETag/304) ----
+  // Built once per version and served from _configCache until a setter
+  // moves a revision. Requests run on the async_tcp task only, so the
+  // cache has a single writer; each reply gets its own copy, so a rebuild
+  // can't change a body still being sent.
+  _server.on("/api/config", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    _syncConfigVersion();
+    char etag[24];
+    snprintf(etag, sizeof(etag), "\"%08lx-%lu\"", (unsigned long)_bootId,
+             (unsigned long)_configVersion);
+
+    if (request->hasHeader("If-None-Match") &&
+        strstr(request->getHeader("If-None-Match")->value().c_str(), etag)) {
+      AsyncWebServerResponse *response = request->beginResponse(304);
+      response->addHeader("ETag", etag);
+      request->send(response);
+      return;
+    }
+
+    if (_configCacheLen == 0) {
+      JsonWriter w(_configCache, sizeof(_configCache));
+      _writeConfigJSON(w);
+      if (w.overflowed())
+        Serial.printf("[Web] /api/config over %u bytes, not cached.\n",
+                      (unsigned)sizeof(_configCache));
+      else
+        _configCacheLen = w.length();
+    }
+
+    AsyncWebServerResponse *response;
+    if (_configCacheLen > 0) {
+      response =
+          request->beginResponse(200, "application/json", _configCache);
+    } else {
+      AsyncResponseStream *stream =
+          request->beginResponseStream("application/json");
+      JsonWriter w(*stream);
+      _writeConfigJSON(w);
+      response = stream;
+    }
+    response->addHeader("ETag", etag);
+    response->addHeader("Cache-Control", "no-cache");
+    request->send(response);
+  });
+
+  // ---- GET /api/status (live + config in one document, kept for scripts) ----
   _server.on("/api/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
-    request->send(200, "application/json", _buildStatusJSON());
+    AsyncResponseStream *response =
+        request->beginResponseStream("application/json");
+    JsonWriter w(*response);
+    _writeStatusJSON(w);
+    request->send(response);
+  });
+
+  // ---- GET /api/perf (?reset=1 clears after reporting) ----
+  _server.on("/api/perf", HTTP_GET, [this](AsyncWebServerRequest *request) {
+    String json = _buildPerfJSON();
+    if (request->hasParam("reset"))
+      _resetPerf();
+    request->send(200, "application/json", json);
   });
 
+  // ---- GET /api/actuators (on-time, cycles, recent runs per output) ----
+  _server.on("/api/actuators", HTTP_GET,
+             [this](AsyncWebServerRequest *request) {
+               String json;
+               json.reserve(2048);
+               json += "{\"actuators\":";
+               if (_actuators)
+                 _actuators->appendJSON(json);
+               else
+                 json += "[]";
+               json += "}";
+               request->send(200, "application/json", json);
+             });
+
+  // ---- GET /api/fert/history (?from=&to= epoch, ?ch= 0..NUM_FERTS) ----
+  // Streamed from the dose journal in chunks; never buffered whole
+  _server.on(
+      "/api/fert/history", HTTP_GET, [this](AsyncWebServerRequest *request) {
+        if (!_journal || !_journal->isReady()) {
+          request->send(503, "application/json",
+                        "{\"error\":\"journal unavailable\"}");
+          return;
+        }
+        uint32_t from = 0, to = UINT32_MAX;
+        uint8_t ch = DoseJournal::ALL_CHANNELS;
+        if (request->hasParam("from"))
+          from = strtoul(request->getParam("from")->value().c_str(), NULL, 10);
+        if (request->hasParam("to"))
+          to = strtoul(request->getParam("to")->value().c_str(), NULL, 10);
+        if (request->hasParam("ch")) {
+          long c = request->getParam("ch")->value().toInt();
+          if (c < 0 || c > NUM_FERTS) {
+            request->send(400, "application/json",
+                          "{\"error\":\"invalid channel\"}");
+            return;
+          }
+          ch = (uint8_t)c;
+        }
+
+        auto stream = std::make_shared<HistoryStream>();
+        stream->journal = _journal;
+        _journal->beginQuery(stream->query, from, to, ch);
+        request->send(request->beginChunkedResponse(
+            "application/json",
+            [stream](uint8_t *buf, size_t maxLen, size_t index) -> size_t {
+              return stream->fill(buf, maxLen);
+            }));
+      });
+
   // ---- POST /api/tpa/start ----
   _server.on("/api/tpa/start", HTTP_POST,
              [this](AsyncWebServerRequest *request) {
-               if (_water)
+               if (_water) {
+                 ControlLock lock;
                  _water->startTPA();
+               }
                Serial.println("[Web] TPA started via dashboard");
                request->send(200, "application/json", "{\"ok\":true}");
              });
@@ -246,8 +709,10 @@ void WebManager::_setupRoutes() {
   // ---- POST /api/tpa/abort ----
   _server.on("/api/tpa/abort", HTTP_POST,
              [this](AsyncWebServerRequest *request) {
-               if (_water)
+               if (_water) {
+                 ControlLock lock;
                  _water->abortTPA();
+               }
                Serial.println("[Web] TPA aborted via dashboard");
                request->send(200, "application/json", "{\"ok\":true}");
              });
@@ -257,10 +722,12 @@ void WebManager::_setupRoutes() {
       "/api/tpa/config", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
+        float s = -1;
+        JsonField fields[] = {JsonField::number("reservoirSafetyML", s)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         bool changed = false;
 
-        float s = _extractFloat(body, "reservoirSafetyML");
         if (s >= 0) {
           _reservoirSafetyML = s;
           changed = true;
@@ -279,14 +746,18 @@ void WebManager::_setupRoutes() {
       "/api/tpa/pump", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        String pStr = _extractString(body, "pump");
-        int st = _extractInt(body, "state");
-
-        if (pStr == "drain") {
-          digitalWrite(PIN_DRAIN, st == 1 ? HIGH : LOW);
-        } else if (pStr == "refill") {
-          digitalWrite(PIN_REFILL, st == 1 ? HIGH : LOW);
+        char pump[8] = "";
+        int st = -1;
+        JsonField fields[] = {JsonField::string("pump", pump, sizeof(pump)),
+                              JsonField::integer("state", st)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+
+        ControlLock lock;
+        if (strcmp(pump, "drain") == 0) {
+          ActuatorLog::write(PIN_DRAIN, st == 1 ? HIGH : LOW);
+        } else if (strcmp(pump, "refill") == 0) {
+          ActuatorLog::write(PIN_REFILL, st == 1 ? HIGH : LOW);
         }
         request->send(200, "application/json", "{\"ok\":true}");
       });
@@ -297,35 +768,38 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
+        int h = -1, l = -1, w = -1, rv = -1, mg = -1;
+        float ratio = -1;
+        JsonField fields[] = {JsonField::integer("aqHeight", h),
+                              JsonField::integer("aqLength", l),
+                              JsonField::integer("aqWidth", w),
+                              JsonField::number("primeRatio", ratio),
+                              JsonField::integer("reservoirVolume", rv),
+                              JsonField::integer("aqMarginCm", mg)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         bool changed = false;
 
-        int h = _extractInt(body, "aqHeight");
         if (h > 0) {
           _aqHeight = h;
           changed = true;
         }
-        int l = _extractInt(body, "aqLength");
         if (l > 0) {
           _aqLength = l;
           changed = true;
         }
-        int w = _extractInt(body, "aqWidth");
         if (w > 0) {
           _aqWidth = w;
           changed = true;
         }
-        float ratio = _extractFloat(body, "primeRatio");
         if (ratio >= 0) {
           _primeRatio = ratio;
           changed = true;
         }
-        int rv = _extractInt(body, "reservoirVolume");
         if (rv >= 0) {
           _reservoirVolume = rv;
           changed = true;
         }
-        int mg = _extractInt(body, "aqMarginCm");
         if (mg >= 0) {
           _aqMarginCm = mg;
           changed = true;
@@ -352,24 +826,41 @@ void WebManager::_setupRoutes() {
       "/api/tpa/run3s", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        String pStr = _extractString(body, "pump");
+        char pump[8] = "";
+        JsonField fields[] = {JsonField::string("pump", pump, sizeof(pump))};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         uint8_t pin = 0;
-        if (pStr == "drain")
+        if (strcmp(pump, "drain") == 0)
           pin = PIN_DRAIN;
-        else if (pStr == "refill")
+        else if (strcmp(pump, "refill") == 0)
           pin = PIN_REFILL;
+        if (pin == 0) {
+          request->send(400, "application/json",
+                        "{\"error\":\"Unknown pump\"}");
+          return;
+        }
 
-        if (pin > 0) {
-          digitalWrite(pin, HIGH);
-          unsigned long start = millis();
-          while ((millis() - start) < 3000) {
-            delay(10);
-          }
-          digitalWrite(pin, LOW);
-          Serial.printf("[Web] %s pump ran for 3s\n", pStr.c_str());
+        // Clearer than "Pump busy"; _switchJob() checks again under the
+        // lock when the job switches the pump on
+        const char *why;
+        {
+          ControlLock lock;
+          why = _pinRunRefusal(pin);
         }
-        request->send(200, "application/json", "{\"ok\":true}");
+        if (why) {
+          char buf[64];
+          snprintf(buf, sizeof(buf), "{\"error\":\"%s\"}", why);
+          request->send(409, "application/json", buf);
+          return;
+        }
+
+        // Switched off by the job timer; completion comes over SSE
+        uint32_t id = _jobs.start(JobTarget::PIN, pin, CALIBRATION_RUN_MS);
+        _sendJobReply(request, id);
+        if (id)
+          Serial.printf("[Web] %s pump run #%lu started\n", pump,
+                        (unsigned long)id);
       });
 
   // ---- POST /api/tpa/calibrate (JSON: {"pump":"drain"|"refill","ml":150}) --
@@ -378,20 +869,28 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        String pStr = _extractString(body, "pump");
-        float ml = _extractFloat(body, "ml");
-        if (ml > 0.1f) {
-          float rate = ml / 3.0f;
-          if (pStr == "drain") {
+        char pump[8] = "";
+        float ml = -1;
+        JsonField fields[] = {JsonField::string("pump", pump, sizeof(pump)),
+                              JsonField::number("ml", ml)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+        bool drain = strcmp(pump, "drain") == 0;
+        if (ml > 0.1f && (drain || strcmp(pump, "refill") == 0)) {
+          // Measured on-time of the last run, not the nominal 3 s
+          uint32_t ranUs = drain ? _drainRunUs : _refillRunUs;
+          if (ranUs == 0) {
+            request->send(409, "application/json",
+                          "{\"error\":\"Run the pump first\"}");
+            return;
+          }
+          float rate = ml * 1000000.0f / ranUs;
+          if (drain)
             _drainFlowRate = rate;
-            Serial.printf("[Web] Drain flow rate calibrated: %.2f mL/s\n",
-                          rate);
-          } else if (pStr == "refill") {
+          else
             _refillFlowRate = rate;
-            Serial.printf("[Web] Refill flow rate calibrated: %.2f mL/s\n",
-                          rate);
-          }
+          Serial.printf("[Web] %s flow rate calibrated: %.2f mL/s (%lu ms)\n",
+                        pump, rate, (unsigned long)(ranUs / 1000));
           _saveParams();
         }
         request->send(200, "application/json", "{\"ok\":true}");
@@ -401,6 +900,7 @@ void WebManager::_setupRoutes() {
   _server.on("/api/maintenance/toggle", HTTP_POST,
              [this](AsyncWebServerRequest *request) {
                if (_safety) {
+                 ControlLock lock;
                  if (_safety->isMaintenanceMode()) {
                    _safety->exitMaintenance();
                    Serial.println("[Web] Maintenance OFF");
@@ -415,12 +915,43 @@ void WebManager::_setupRoutes() {
   // ---- POST /api/emergency/stop ----
   _server.on("/api/emergency/stop", HTTP_POST,
              [this](AsyncWebServerRequest *request) {
-               if (_safety)
+               if (_safety) {
+                 ControlLock lock;
                  _safety->emergencyShutdown();
+               }
                Serial.println("[Web] EMERGENCY STOP via dashboard!");
                request->send(200, "application/json", "{\"ok\":true}");
              });
 
+  // ---- POST /api/sampling (per-mode sensor sampling policy) ----
+  _server.on(
+      "/api/sampling", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
+      [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+             size_t index, size_t total) {
+        char modeName[12] = "";
+        int checkMs = -1, pings = -1;
+        JsonField fields[] = {
+            JsonField::string("mode", modeName, sizeof(modeName)),
+            JsonField::integer("checkMs", checkMs),
+            JsonField::integer("pings", pings)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+        SamplingMode mode;
+        bool ok = false;
+        if (_safety && parseSamplingMode(modeName, mode) &&
+            checkMs > 0 && checkMs <= 0xFFFF && pings > 0 && pings <= 0xFF) {
+          ControlLock lock;
+          ok = _safety->setSamplingPolicy(mode, checkMs, pings);
+        }
+        if (ok) {
+          _saveParams();
+          request->send(200, "application/json", "{\"ok\":true}");
+        } else {
+          request->send(400, "application/json",
+                        "{\"error\":\"Invalid sampling policy\"}");
+        }
+      });
+
   // ---- GET /api/wifi/scan ----
   _server.on("/api/wifi/scan", HTTP_GET, [](AsyncWebServerRequest *request) {
     int n = WiFi.scanComplete();
@@ -449,7 +980,7 @@ void WebManager::_setupRoutes() {
   });
 
   // ---- POST /api/wifi (Form Data: ssid, pass) ----
-  _server.on("/api/wifi", HTTP_POST, [](AsyncWebServerRequest *request) {
+  _server.on("/api/wifi", HTTP_POST, [this](AsyncWebServerRequest *request) {
     if (request->hasParam("ssid", true) && request->hasParam("pass", true)) {
       String ssid = request->getParam("ssid", true)->value();
       String pass = request->getParam("pass", true)->value();
@@ -464,9 +995,9 @@ void WebManager::_setupRoutes() {
           "[Web] WiFi credentials updated via dashboard. Restarting...");
       request->send(200, "application/json", "{\"ok\":true}");
 
-      // Give the server time to send the response before rebooting
-      delay(500);
-      ESP.restart();
+      // Restarted by update() once the response had time to go out
+      _restartAtMs = millis();
+      _restartPending = true;
     } else {
       request->send(400, "application/json", "{\"error\":\"Missing params\"}");
     }
@@ -477,35 +1008,37 @@ void WebManager::_setupRoutes() {
       "/api/schedule", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
+        int inv = -1, hh = -1, mm = -1, pct = -1, csp = -1, lang = -1;
+        JsonField fields[] = {JsonField::integer("tpaInterval", inv),
+                              JsonField::integer("tpaHour", hh),
+                              JsonField::integer("tpaMinute", mm),
+                              JsonField::integer("tpaPercent", pct),
+                              JsonField::integer("canisterSafePct", csp),
+                              JsonField::integer("language", lang)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         bool changed = false;
 
-        int inv = _extractInt(body, "tpaInterval");
         if (inv >= 0) {
           _tpaInterval = inv;
           changed = true;
         }
-        int hh = _extractInt(body, "tpaHour");
         if (hh >= 0 && hh <= 23) {
           _tpaHour = hh;
           changed = true;
         }
-        int mm = _extractInt(body, "tpaMinute");
         if (mm >= 0 && mm <= 59) {
           _tpaMinute = mm;
           changed = true;
         }
-        int pct = _extractInt(body, "tpaPercent");
         if (pct > 0 && pct <= 100) {
           _tpaPercent = pct;
           changed = true;
         }
-        int csp = _extractInt(body, "canisterSafePct");
         if (csp > 0 && csp <= 100) {
           _canisterSafePct = csp;
           changed = true;
         }
-        int lang = _extractInt(body, "language");
         if (lang >= 0 && lang < 3) {
           _language = lang;
           if (_notify)
@@ -528,22 +1061,56 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
+        int ch = -1;
         float doses[7] = {0};
-        bool hasDoses = _extractFloatArray(body, "doses", doses, 7);
-
         // Per-day times (new format: hours[] and minutes[] arrays)
         float hours[7] = {-1, -1, -1, -1, -1, -1, -1};
         float minutes[7] = {-1, -1, -1, -1, -1, -1, -1};
-        bool hasHours = _extractFloatArray(body, "hours", hours, 7);
-        bool hasMinutes = _extractFloatArray(body, "minutes", minutes, 7);
-
         // Backward compat: single hour/minute applies to all days
-        int singleH = _extractInt(body, "hour");
-        int singleM = _extractInt(body, "minute");
-
-        if (ch >= 0 && ch <= 4 && hasDoses && _fert) {
+        int singleH = -1, singleM = -1;
+        // Full plan (replaces the per-day fields): [minuteOfWeek, centiMl]
+        // pairs, several per day allowed
+        float sch[2 * FERT_SCHEDULE_SLOTS];
+        float lt = -1;
+        JsonField fields[] = {
+            JsonField::integer("channel", ch),
+            JsonField::array("doses", doses, 7),
+            JsonField::array("hours", hours, 7),
+            JsonField::array("minutes", minutes, 7),
+            JsonField::integer("hour", singleH),
+            JsonField::integer("minute", singleM),
+            JsonField::array("sch", sch, 2 * FERT_SCHEDULE_SLOTS),
+            JsonField::number("lowStockThreshold", lt)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+        bool hasDoses = fields[1].found;
+        bool hasHours = fields[2].found;
+        bool hasMinutes = fields[3].found;
+        bool hasSch = fields[6].found;
+        uint16_t schLen = fields[6].count; // May exceed the table
+
+        // Fert state and its counters are saved by the loop and the control
+        // task (Prime dose) too
+        ControlLock lock;
+        if (ch >= 0 && ch <= NUM_FERTS && hasSch && _fert) {
+          FertManager::DoseSlot slots[FERT_SCHEDULE_SLOTS];
+          bool ok = schLen % 2 == 0 && schLen <= 2 * FERT_SCHEDULE_SLOTS;
+          for (uint8_t k = 0; ok && k < schLen / 2; k++) {
+            float mow = sch[2 * k], centi = sch[2 * k + 1];
+            ok = mow >= 0 && mow < FertManager::MINUTES_PER_WEEK &&
+                 centi >= 0 && centi <= 0xFFFF;
+            slots[k].minuteOfWeek = (uint16_t)mow;
+            slots[k].centiMl = (uint16_t)centi;
+          }
+          if (!ok || !_fert->setSchedule(ch, slots, schLen / 2)) {
+            request->send(400, "application/json",
+                          "{\"error\":\"invalid schedule\"}");
+            return;
+          }
+          _fert->saveState();
+          Serial.printf("[Web] CH%d Schedule updated (%u entries)\n", ch + 1,
+                        schLen / 2);
+        } else if (ch >= 0 && ch <= NUM_FERTS && hasDoses && _fert) {
           for (uint8_t d = 0; d < 7; d++) {
             _fert->setDoseML(ch, d, doses[d]);
           }
@@ -568,8 +1135,7 @@ void WebManager::_setupRoutes() {
         }
 
         // Low stock threshold (optional)
-        float lt = _extractFloat(body, "lowStockThreshold");
-        if (lt >= 0 && ch >= 0 && ch <= 4 && _fert) {
+        if (lt >= 0 && ch >= 0 && ch <= NUM_FERTS && _fert) {
           _fert->setLowStockThreshold(ch, lt);
         }
 
@@ -581,11 +1147,14 @@ void WebManager::_setupRoutes() {
       "/api/fert/pump", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-        int st = _extractInt(body, "state");
+        int ch = -1, st = -1;
+        JsonField fields[] = {JsonField::integer("channel", ch),
+                              JsonField::integer("state", st)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
 
-        if (ch >= 0 && ch <= 4 && _fert) {
+        if (ch >= 0 && ch <= NUM_FERTS && _fert) {
+          ControlLock lock; // Stops a running dose on OFF
           _fert->manualPump(ch, st == 1);
         }
         request->send(200, "application/json", "{\"ok\":true}");
@@ -596,19 +1165,25 @@ void WebManager::_setupRoutes() {
       "/api/fert/run3s", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-
-        if (ch >= 0 && ch <= 4 && _fert) {
-          // Block and pulse
-          _fert->manualPump(ch, true);
-          unsigned long start = millis();
-          while ((millis() - start) < 3000) {
-            delay(10);
-          }
-          _fert->manualPump(ch, false);
+        int ch = -1;
+        JsonField fields[] = {JsonField::integer("channel", ch)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+
+        if (ch < 0 || ch > NUM_FERTS || !_fert) {
+          request->send(400, "application/json",
+                        "{\"error\":\"Invalid channel\"}");
+          return;
         }
-        request->send(200, "application/json", "{\"ok\":true}");
+        // Clearer than "Pump busy"; beginManualRun() refuses a dosing
+        // channel under the dose lock as well
+        if (_fert->isDosing(ch)) {
+          request->send(409, "application/json",
+                        "{\"error\":\"Channel is dosing\"}");
+          return;
+        }
+        _sendJobReply(request, _jobs.start(JobTarget::FERT, ch,
+                                           CALIBRATION_RUN_MS));
       });
 
   // ---- Pump Calibration: Save Flow Rate ----
@@ -617,25 +1192,28 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-
-        int startIdx = body.indexOf("\"ml\":");
-        if (startIdx != -1 && ch >= 0 && ch <= 4 && _fert) {
-          startIdx += 5;
-          int endIdx = body.indexOf(",", startIdx);
-          if (endIdx == -1)
-            endIdx = body.indexOf("}", startIdx);
-          if (endIdx != -1) {
-            float measuredML = body.substring(startIdx, endIdx).toFloat();
-            if (measuredML > 0.1f) {
-              float newRate = measuredML / 3.0f; // 3 seconds baseline
-              _fert->setFlowRate(ch, newRate);
-              _fert->saveState();
-              Serial.printf("[Web] CH%d flow rate calibrated to %.2f mL/s\n",
-                            ch + 1, newRate);
-            }
+        int ch = -1;
+        float measuredML = -1;
+        JsonField fields[] = {JsonField::integer("channel", ch),
+                              JsonField::number("ml", measuredML)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+
+        if (measuredML > 0.1f && ch >= 0 && ch <= NUM_FERTS && _fert) {
+          // Measured on-time of the last run, not the nominal 3 s
+          uint32_t ranUs = _fertRunUs[ch];
+          if (ranUs == 0) {
+            request->send(409, "application/json",
+                          "{\"error\":\"Run the pump first\"}");
+            return;
           }
+          float newRate = measuredML * 1000000.0f / ranUs;
+          ControlLock lock; // Saved with the counters (EEPROM/NVS)
+          _fert->setFlowRate(ch, newRate);
+          _fert->saveState();
+          Serial.printf("[Web] CH%d flow rate calibrated to %.2f mL/s "
+                        "(%lu ms)\n",
+                        ch + 1, newRate, (unsigned long)(ranUs / 1000));
         }
         request->send(200, "application/json", "{\"ok\":true}");
       });
@@ -648,10 +1226,14 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-        float ml = _extractFloat(body, "ml");
-        if (ch >= 0 && ch <= 4 && ml > 0 && _fert) {
+        int ch = -1;
+        float ml = -1;
+        JsonField fields[] = {JsonField::integer("channel", ch),
+                              JsonField::number("ml", ml)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+        if (ch >= 0 && ch <= NUM_FERTS && ml > 0 && _fert) {
+          ControlLock lock; // Stock is shared with the TPA Prime dose
           _fert->resetStock(ch, ml);
           Serial.printf("[Web] Stock CH%d reset to %.0f ml\n", ch + 1, ml);
         }
@@ -664,12 +1246,16 @@ void WebManager::_setupRoutes() {
       "/api/fert/name", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-        String nameStr = _extractString(body, "name");
+        int ch = -1;
+        char name[32] = "";
+        JsonField fields[] = {JsonField::integer("channel", ch),
+                              JsonField::string("name", name, sizeof(name))};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
 
-        if (ch >= 0 && ch <= 4 && nameStr.length() > 0 && _fert) {
-          _fert->setName(ch, nameStr);
+        if (ch >= 0 && ch <= NUM_FERTS && name[0] && _fert) {
+          ControlLock lock;
+          _fert->setName(ch, name);
         }
         request->send(200, "application/json", "{\"ok\":true}");
       });
@@ -679,17 +1265,57 @@ void WebManager::_setupRoutes() {
       "/api/fert/pwm", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        int ch = _extractInt(body, "channel");
-        int pwmValue = _extractInt(body, "pwm");
+        int ch = -1, pwmValue = -1;
+        JsonField fields[] = {JsonField::integer("channel", ch),
+                              JsonField::integer("pwm", pwmValue)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
 
-        if (ch >= 0 && ch <= 4 && pwmValue >= 0 && pwmValue <= 255 && _fert) {
+        if (ch >= 0 && ch <= NUM_FERTS && pwmValue >= 0 && pwmValue <= 255 &&
+            _fert) {
+          ControlLock lock;
           _fert->setPWM(ch, pwmValue);
           Serial.printf("[Web] CH%d PWM set to %d\n", ch + 1, pwmValue);
         }
         request->send(200, "application/json", "{\"ok\":true}");
       });
 
+  // ---- POST /api/fert/power (JSON body: {"maxConcurrent": 2, "budgetMA":
+  // 1000} and/or {"channel": 0, "pumpMA": 300})
+  _server.on(
+      "/api/fert/power", HTTP_POST, [](AsyncWebServerRequest *request) {},
+      NULL,
+      [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
+             size_t index, size_t total) {
+        int maxC = -1, budget = -1, ch = -1, pumpMA = -1;
+        JsonField fields[] = {JsonField::integer("maxConcurrent", maxC),
+                              JsonField::integer("budgetMA", budget),
+                              JsonField::integer("channel", ch),
+                              JsonField::integer("pumpMA", pumpMA)};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
+        bool ok = false;
+
+        if (_fert && maxC >= 1 && maxC <= NUM_FERTS + 1 && budget >= 0 &&
+            budget <= 0xFFFF) {
+          ControlLock lock;
+          _fert->setDoseBudget(maxC, budget);
+          ok = true;
+        }
+        if (_fert && ch >= 0 && ch <= NUM_FERTS && pumpMA >= 0 &&
+            pumpMA <= 0xFFFF) {
+          ControlLock lock;
+          _fert->setPumpCurrentMA(ch, pumpMA);
+          ok = true;
+        }
+        if (ok) {
+          request->send(200, "application/json", "{\"ok\":true}");
+        } else {
+          request->send(400, "application/json",
+                        "{\"error\":\"Invalid power budget\"}");
+        }
+      });
+
   // ---- GET /api/notify/status ----
   _server.on(
       "/api/notify/status", HTTP_GET, [this](AsyncWebServerRequest *request) {
@@ -726,8 +1352,10 @@ void WebManager::_setupRoutes() {
       "/api/notify/key", HTTP_POST, [](AsyncWebServerRequest *request) {}, NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
-        String body = String((char *)data).substring(0, len);
-        String key = _extractString(body, "key");
+        char key[48] = ""; // As much as the settings registry stores
+        JsonField fields[] = {JsonField::string("key", key, sizeof(key))};
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         if (_notify) {
           _notify->setPrivateKey(key);
         }
@@ -740,25 +1368,35 @@ void WebManager::_setupRoutes() {
       NULL,
       [this](AsyncWebServerRequest *request, uint8_t *data, size_t len,
              size_t index, size_t total) {
+        // Per-type toggles, then the daily report time
+        static const char *const typeKeys[] = {
+            "tpaComplete",  "tpaError",  "fertLowStock", "emergency",
+            "fertComplete", "dailyLevel"};
+        static_assert(sizeof(typeKeys) / sizeof(typeKeys[0]) ==
+                          NOTIFY_TYPE_COUNT,
+                      "one key per notification type");
+        int types[NOTIFY_TYPE_COUNT];
+        int rH = -1, rM = -1;
+        JsonField fields[NOTIFY_TYPE_COUNT + 2];
+        for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++) {
+          types[i] = -1;
+          fields[i] = JsonField::integer(typeKeys[i], types[i]);
+        }
+        fields[NOTIFY_TYPE_COUNT] = JsonField::integer("reportHour", rH);
+        fields[NOTIFY_TYPE_COUNT + 1] = JsonField::integer("reportMinute", rM);
+        if (!_parseBody(request, data, len, index, total, fields))
+          return;
         if (!_notify) {
           request->send(200, "application/json", "{\"ok\":true}");
           return;
         }
-        String body = String((char *)data).substring(0, len);
 
-        // Per-type toggles
-        const char *typeKeys[] = {"tpaComplete", "tpaError",     "fertLowStock",
-                                  "emergency",   "fertComplete", "dailyLevel"};
         for (uint8_t i = 0; i < NOTIFY_TYPE_COUNT; i++) {
-          int val = _extractInt(body, typeKeys[i]);
-          if (val == 0 || val == 1) {
-            _notify->setTypeEnabled((NotifyType)i, val == 1);
+          if (types[i] == 0 || types[i] == 1) {
+            _notify->setTypeEnabled((NotifyType)i, types[i] == 1);
           }
         }
 
-        // Daily report time
-        int rH = _extractInt(body, "reportHour");
-        int rM = _extractInt(body, "reportMinute");
         if (rH >= 0 && rH <= 23 && rM >= 0 && rM <= 59) {
           _notify->setDailyReportHour(rH, rM);
         }
@@ -776,67 +1414,120 @@ void WebManager::_setupRoutes() {
 }
 #endif
 
+#ifdef USE_WEBSERVER
 // ============================================================================
-// SIMPLE JSON EXTRACTORS (avoid ArduinoJson dependency)
+// REQUEST BODIES (single pass, no String copies)
 // ============================================================================
 
-int WebManager::_extractInt(const String &json, const char *key) {
-  String search = String("\"") + key + "\":";
-  int idx = json.indexOf(search);
-  if (idx < 0)
-    return -1;
-  idx += search.length();
-  return json.substring(idx).toInt();
+bool WebManager::_parseBody(AsyncWebServerRequest *request,
+                            const uint8_t *data, size_t len, size_t index,
+                            size_t total, JsonField *fields,
+                            uint8_t fieldCount) {
+  const uint8_t *body;
+  size_t bodyLen;
+  switch (_bodies.feed(request, data, len, index, total, millis(), body,
+                       bodyLen)) {
+  case BodyArena::COMPLETE:
+    break;
+  case BodyArena::TOO_LARGE:
+    request->send(413, "application/json", "{\"error\":\"Body too large\"}");
+    return false;
+  case BodyArena::BUSY:
+    request->send(503, "application/json", "{\"error\":\"Busy\"}");
+    return false;
+  default: // PARTIAL, DROPPED
+    return false;
+  }
+  if (!jsonParseObject(body, bodyLen, fields, fieldCount)) {
+    request->send(400, "application/json", "{\"error\":\"Invalid JSON\"}");
+    return false;
+  }
+  return true;
 }
 
-float WebManager::_extractFloat(const String &json, const char *key) {
-  String search = String("\"") + key + "\":";
-  int idx = json.indexOf(search);
-  if (idx < 0)
-    return -1;
-  idx += search.length();
-  return json.substring(idx).toFloat();
-}
+// ============================================================================
+// CALIBRATION RUNS (timed actuator jobs)
+// ============================================================================
 
-String WebManager::_extractString(const String &json, const char *key) {
-  String search = String("\"") + key + "\":\"";
-  int startIdx = json.indexOf(search);
-  if (startIdx < 0)
-    return "";
-  startIdx += search.length();
-  int endIdx = json.indexOf("\"", startIdx);
-  if (endIdx < 0)
-    return "";
-  return json.substring(startIdx, endIdx);
+void WebManager::_sendJobReply(AsyncWebServerRequest *request, uint32_t id) {
+  if (id == 0) {
+    request->send(409, "application/json", "{\"error\":\"Pump busy\"}");
+    return;
+  }
+  char buf[48];
+  snprintf(buf, sizeof(buf), "{\"ok\":true,\"job\":%lu,\"ms\":%lu}",
+           (unsigned long)id, (unsigned long)CALIBRATION_RUN_MS);
+  request->send(202, "application/json", buf);
 }
 
-bool WebManager::_extractFloatArray(const String &json, const char *key,
-                                    float *outArray, uint8_t expectedSize) {
-  String search = String("\"") + key + "\":[";
-  int startIdx = json.indexOf(search);
-  if (startIdx < 0)
-    return false;
-  startIdx += search.length();
-
-  int endIdx = json.indexOf("]", startIdx);
-  if (endIdx < 0)
-    return false;
+const char *WebManager::_pinRunRefusal(uint8_t pin) const {
+  if (_water && _water->isRunning())
+    return "TPA running";
+  if (_safety && _safety->isEmergency())
+    return "Safety emergency";
+  if (pin == PIN_REFILL && _safety && _safety->isOpticalHigh())
+    return "Water level high";
+  return nullptr;
+}
 
-  String arrayStr = json.substring(startIdx, endIdx);
-  int lastComma = 0;
-  for (uint8_t i = 0; i < expectedSize; i++) {
-    int nextComma = arrayStr.indexOf(",", lastComma);
-    if (nextComma == -1) {
-      outArray[i] = arrayStr.substring(lastComma).toFloat();
-      break;
-    } else {
-      outArray[i] = arrayStr.substring(lastComma, nextComma).toFloat();
-      lastComma = nextComma + 1;
+bool WebManager::_switchJob(JobTarget target, uint8_t index, bool on,
+                            void *ctx) {
+  WebManager *self = static_cast<WebManager *>(ctx);
+  if (target == JobTarget::PIN) {
+    if (on) {
+      // async_tcp: the control task must not start a TPA cycle or trip
+      // the safety cut-off between the check and the write
+      ControlLock lock;
+      if (self->_pinRunRefusal(index))
+        return false;
+      ActuatorLog::write(index, HIGH);
+      return true;
     }
+    // esp_timer task: no ControlLock, a control tick would hold up every
+    // timer (dose stops included). A TPA cycle started during the run and
+    // now draining/refilling owns the pump; in any other state it is off.
+    TPAState st = self->_water ? self->_water->getState() : TPAState::IDLE;
+    bool owned = (index == PIN_DRAIN && st == TPAState::DRAINING) ||
+                 (index == PIN_REFILL && st == TPAState::REFILLING);
+    if (!owned)
+      ActuatorLog::write(index, LOW);
+    return true;
   }
+  if (!self->_fert)
+    return false;
+  if (on)
+    return self->_fert->beginManualRun(index);
+  self->_fert->endManualRun(index);
   return true;
 }
 
+void WebManager::_onJobDone(const ActuatorJobs::Job &job, void *ctx) {
+  WebManager *self = static_cast<WebManager *>(ctx);
+  const char *pump = "fert";
+  if (job.target == JobTarget::FERT) {
+    if (job.index <= NUM_FERTS)
+      self->_fertRunUs[job.index] = job.actualUs;
+  } else if (job.index == PIN_DRAIN) {
+    self->_drainRunUs = job.actualUs;
+    pump = "drain";
+  } else if (job.index == PIN_REFILL) {
+    self->_refillRunUs = job.actualUs;
+    pump = "refill";
+  }
+
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+      .field("job", (unsigned long)job.id)
+      .field("pump", pump)
+      .field("channel", job.target == JobTarget::FERT ? job.index : -1)
+      .field("plannedMs", (unsigned long)job.plannedMs)
+      .field("ms", job.actualUs / 1000.0f, 1)
+      .endObject();
+  self->_events.send(w.c_str(), "job", millis());
+}
+#endif
+
 // ============================================================================
 // TELEMETRY (Serial)
 // ============================================================================
@@ -859,6 +1550,11 @@ void WebManager::_updateTelemetry() {
     Serial.printf("  Emergency: %s | Maintenance: %s\n",
                   _safety->isEmergency() ? "YES" : "no",
                   _safety->isMaintenanceMode() ? "YES" : "no");
+    const SamplingPolicy &sp =
+        _safety->getSamplingPolicy(_safety->getSamplingMode());
+    Serial.printf("  Sampling: %s (check %u ms, %u pings)\n",
+                  samplingModeName(_safety->getSamplingMode()), sp.checkMs,
+                  sp.pings);
   }
   if (_water) {
     Serial.printf("  TPA State: %s | Canister: %s\n", _water->getStateName(),
@@ -879,25 +1575,40 @@ void WebManager::_updateTelemetry() {
 // ============================================================================
 
 void WebManager::_loadParams() {
-  _prefs.begin("aqua", true);
-  _tpaInterval = _prefs.getUShort("tpaInt", 7);
-  _tpaHour = _prefs.getUChar("tpaH", 10);
-  _tpaMinute = _prefs.getUChar("tpaM", 0);
-  _tpaLastRun = _prefs.getUInt("tpaRun", 0);
-  _tpaPercent = _prefs.getUChar("tpaPct", 20);
-  _canisterSafePct = _prefs.getUChar("canSf", 0);
-  _language = _prefs.getUChar("lang", 0);
-  _primeML = _prefs.getFloat("tpaPr", DEFAULT_PRIME_ML);
-  _aqHeight = _prefs.getUShort("aqH", 0);
-  _aqLength = _prefs.getUShort("aqL", 0);
-  _aqWidth = _prefs.getUShort("aqW", 0);
-  _aqMarginCm = _prefs.getUShort("aqMg", 0);
-  _drainFlowRate = _prefs.getFloat("drFR", 0);
-  _refillFlowRate = _prefs.getFloat("rfFR", 0);
-  _primeRatio = _prefs.getFloat("pRat", 0);
-  _reservoirVolume = _prefs.getUShort("resVol", 0);
-  _reservoirSafetyML = _prefs.getFloat("resSf", 0);
-  _prefs.end();
+  _paramsRev++;
+  if (_settings) {
+    const SettingsStore &st = *_settings;
+    _tpaInterval = st.getUInt(Setting::TPA_INTERVAL);
+    _tpaHour = st.getUInt(Setting::TPA_HOUR);
+    _tpaMinute = st.getUInt(Setting::TPA_MINUTE);
+    _tpaLastRun = st.getUInt(Setting::TPA_LAST_RUN);
+    _tpaPercent = st.getUInt(Setting::TPA_PERCENT);
+    _canisterSafePct = st.getUInt(Setting::CANISTER_SAFE_PCT);
+    _language = st.getUInt(Setting::LANGUAGE);
+    _primeML = st.getFloat(Setting::PRIME_ML);
+    _aqHeight = st.getUInt(Setting::AQ_HEIGHT);
+    _aqLength = st.getUInt(Setting::AQ_LENGTH);
+    _aqWidth = st.getUInt(Setting::AQ_WIDTH);
+    _aqMarginCm = st.getUInt(Setting::AQ_MARGIN);
+    _drainFlowRate = st.getFloat(Setting::DRAIN_FLOW);
+    _refillFlowRate = st.getFloat(Setting::REFILL_FLOW);
+    _primeRatio = st.getFloat(Setting::PRIME_RATIO);
+    _reservoirVolume = st.getUInt(Setting::RESERVOIR_VOLUME);
+    _reservoirSafetyML = st.getFloat(Setting::RESERVOIR_SAFETY);
+    SamplingPolicy sp[SAMPLING_MODE_COUNT];
+    if (_safety && st.getBytes(Setting::SAMPLING, sp, sizeof(sp))) {
+      for (uint8_t m = 0; m < SAMPLING_MODE_COUNT; m++)
+        _safety->setSamplingPolicy((SamplingMode)m, sp[m].checkMs,
+                                   sp[m].pings);
+    }
+  }
+
+  // The EEPROM copy is newer unless the store was just (re)formatted
+  if (_counters && _counters->isReady() &&
+      !_counters->readBank(CounterBank::TPA_LAST_RUN, &_tpaLastRun,
+                           sizeof(_tpaLastRun)))
+    _counters->writeBank(CounterBank::TPA_LAST_RUN, &_tpaLastRun,
+                         sizeof(_tpaLastRun));
 
   // Auto-calculate primeML from reservoirVolume × ratio if both are set
   if (_reservoirVolume > 0 && _primeRatio > 0) {
@@ -906,25 +1617,35 @@ void WebManager::_loadParams() {
 }
 
 void WebManager::_saveParams() {
-  _prefs.begin("aqua", false);
-  _prefs.putUShort("tpaInt", _tpaInterval);
-  _prefs.putUChar("tpaH", _tpaHour);
-  _prefs.putUChar("tpaM", _tpaMinute);
-  _prefs.putUInt("tpaRun", _tpaLastRun);
-  _prefs.putUChar("tpaPct", _tpaPercent);
-  _prefs.putUChar("canSf", _canisterSafePct);
-  _prefs.putUChar("lang", _language);
-  _prefs.putFloat("tpaPr", _primeML);
-  _prefs.putUShort("aqH", _aqHeight);
-  _prefs.putUShort("aqL", _aqLength);
-  _prefs.putUShort("aqW", _aqWidth);
-  _prefs.putUShort("aqMg", _aqMarginCm);
-  _prefs.putFloat("drFR", _drainFlowRate);
-  _prefs.putFloat("rfFR", _refillFlowRate);
-  _prefs.putFloat("pRat", _primeRatio);
-  _prefs.putUShort("resVol", _reservoirVolume);
-  _prefs.putFloat("resSf", _reservoirSafetyML);
-  _prefs.end();
+  _paramsRev++;
+  if (!_settings)
+    return;
+  // Only values that differ are marked; SettingsStore::update() commits
+  // them in one record once the edits pause
+  SettingsStore &st = *_settings;
+  st.setUInt(Setting::TPA_INTERVAL, _tpaInterval);
+  st.setUInt(Setting::TPA_HOUR, _tpaHour);
+  st.setUInt(Setting::TPA_MINUTE, _tpaMinute);
+  st.setUInt(Setting::TPA_LAST_RUN, _tpaLastRun);
+  st.setUInt(Setting::TPA_PERCENT, _tpaPercent);
+  st.setUInt(Setting::CANISTER_SAFE_PCT, _canisterSafePct);
+  st.setUInt(Setting::LANGUAGE, _language);
+  st.setFloat(Setting::PRIME_ML, _primeML);
+  st.setUInt(Setting::AQ_HEIGHT, _aqHeight);
+  st.setUInt(Setting::AQ_LENGTH, _aqLength);
+  st.setUInt(Setting::AQ_WIDTH, _aqWidth);
+  st.setUInt(Setting::AQ_MARGIN, _aqMarginCm);
+  st.setFloat(Setting::DRAIN_FLOW, _drainFlowRate);
+  st.setFloat(Setting::REFILL_FLOW, _refillFlowRate);
+  st.setFloat(Setting::PRIME_RATIO, _primeRatio);
+  st.setUInt(Setting::RESERVOIR_VOLUME, _reservoirVolume);
+  st.setFloat(Setting::RESERVOIR_SAFETY, _reservoirSafetyML);
+  if (_safety) {
+    SamplingPolicy sp[SAMPLING_MODE_COUNT];
+    for (uint8_t m = 0; m < SAMPLING_MODE_COUNT; m++)
+      sp[m] = _safety->getSamplingPolicy((SamplingMode)m);
+    st.setBytes(Setting::SAMPLING, sp, sizeof(sp));
+  }
 }
 
 // ============================================================================
@@ -940,6 +1661,9 @@ void WebManager::processSerialCommands() {
   if (cmd.length() == 0)
     return;
 
+  // Commands may touch TPA/safety state owned by the control task
+  ControlLock lock;
+
   if (cmd == "help" || cmd == "?") {
     _printHelp();
   } else if (cmd == "status") {
@@ -974,11 +1698,13 @@ void WebManager::processSerialCommands() {
     Serial.println(
         "[CMD] dose is obsolete. Use individual channel scheduling via web.");
   } else if (cmd.startsWith("reset_stock ")) {
-    int ch = cmd.substring(12, 13).toInt();
-    float ml = cmd.substring(14).toFloat();
-    if (ch >= 1 && ch <= 5 && ml > 0) {
+    // reset_stock CH ML (CH 1..NUM_FERTS, NUM_FERTS + 1 = prime)
+    int sp = cmd.indexOf(' ', 12);
+    long ch = sp > 0 ? cmd.substring(12, sp).toInt() : 0;
+    float ml = sp > 0 ? cmd.substring(sp + 1).toFloat() : 0;
+    if (_fert && ch >= 1 && ch <= NUM_FERTS + 1 && ml > 0) {
       _fert->resetStock(ch - 1, ml);
-      Serial.printf("[CMD] Stock CH%d reset to %.0f ml\n", ch, ml);
+      Serial.printf("[CMD] Stock CH%ld reset to %.0f ml\n", ch, ml);
     }
   } else if (cmd == "drain_target") {
     if (_safety) {
@@ -998,11 +1724,75 @@ void WebManager::processSerialCommands() {
       Serial.printf("[CMD] Refill target set to %.1f cm\n", cm);
     }
   } else if (cmd == "canister_on") {
-    digitalWrite(PIN_CANISTER, LOW); // SSR: LOW = ON
+    ActuatorLog::write(PIN_CANISTER, LOW); // SSR: LOW = ON
     Serial.println("[CMD] Canister ON.");
   } else if (cmd == "canister_off") {
-    digitalWrite(PIN_CANISTER, HIGH); // SSR: HIGH = OFF
+    ActuatorLog::write(PIN_CANISTER, HIGH); // SSR: HIGH = OFF
     Serial.println("[CMD] Canister OFF.");
+  } else if (cmd == "sampling") {
+    if (_safety) {
+      Serial.printf("[CMD] Sampling mode: %s\n",
+                    samplingModeName(_safety->getSamplingMode()));
+      for (uint8_t m = 0; m < SAMPLING_MODE_COUNT; m++) {
+        const SamplingPolicy &sp =
+            _safety->getSamplingPolicy((SamplingMode)m);
+        Serial.printf("  %-9s check %u ms, %u pings (every %u ms)\n",
+                      samplingModeName((SamplingMode)m), sp.checkMs, sp.pings,
+                      sp.pingIntervalMs());
+      }
+    }
+  } else if (cmd.startsWith("sampling ")) {
+    // sampling MODE CHECK_MS PINGS
+    int s1 = cmd.indexOf(' ', 9);
+    int s2 = s1 > 0 ? cmd.indexOf(' ', s1 + 1) : -1;
+    long checkMs = s2 > 0 ? cmd.substring(s1 + 1, s2).toInt() : 0;
+    long pings = s2 > 0 ? cmd.substring(s2 + 1).toInt() : 0;
+    SamplingMode mode;
+    if (_safety && s2 > 0 &&
+        parseSamplingMode(cmd.substring(9, s1).c_str(), mode) &&
+        checkMs > 0 && checkMs <= 0xFFFF && pings > 0 && pings <= 0xFF &&
+        _safety->setSamplingPolicy(mode, checkMs, pings)) {
+      _saveParams();
+      Serial.printf("[CMD] Sampling %s updated\n", samplingModeName(mode));
+    } else {
+      Serial.println("[CMD] Usage: sampling idle|active|emergency MS PINGS");
+    }
+  } else if (cmd == "perf") {
+    if (_controlPerf)
+      _controlPerf->printReport();
+    if (_loopPerf)
+      _loopPerf->printReport();
+    if (_sched)
+      _sched->printReport();
+  } else if (cmd == "dosing") {
+    _printDosing();
+  } else if (cmd.startsWith("dosing ")) {
+    // dosing MAX_PUMPS BUDGET_MA
+    int sp = cmd.indexOf(' ', 7);
+    long maxC = sp > 0 ? cmd.substring(7, sp).toInt() : 0;
+    long budget = sp > 0 ? cmd.substring(sp + 1).toInt() : -1;
+    if (_fert && maxC >= 1 && maxC <= NUM_FERTS + 1 && budget >= 0 &&
+        budget <= 0xFFFF) {
+      _fert->setDoseBudget(maxC, budget);
+    } else {
+      Serial.println("[CMD] Usage: dosing MAX_PUMPS BUDGET_MA (0 = no limit)");
+    }
+  } else if (cmd == "agenda") {
+    _printAgenda();
+  } else if (cmd == "journal") {
+    _printJournal();
+  } else if (cmd == "counters") {
+    if (_counters)
+      _counters->printReport();
+  } else if (cmd == "actuators") {
+    if (_actuators)
+      _actuators->printReport();
+  } else if (cmd == "settings") {
+    if (_settings)
+      _settings->printReport();
+  } else if (cmd == "perf reset") {
+    _resetPerf();
+    Serial.println("[CMD] Profiler statistics cleared.");
   } else if (cmd == "emergency_stop") {
     if (_safety)
       _safety->emergencyShutdown();
@@ -1060,6 +1850,14 @@ void WebManager::_printHelp() {
   Serial.println("  set_drain CM  — Set drain target");
   Serial.println("  set_refill CM — Set refill target");
   Serial.println("  canister_on/off — Canister relay");
+  Serial.println("  sampling [MODE MS PINGS] — Show/set sensor sampling");
+  Serial.println("  dosing [N MA] — Pump power budget / last dosing window");
+  Serial.println("  agenda        — Upcoming scheduled events");
+  Serial.println("  journal       — Dose journal stats and last 24 h of doses");
+  Serial.println("  counters      — EEPROM counter store banks and writes");
+  Serial.println("  actuators     — On-time, cycles and recent runs per output");
+  Serial.println("  settings      — Settings records, commits, pending edits");
+  Serial.println("  perf [reset]  — Loop stage timings (or clear them)");
   Serial.println("  emergency_stop — All outputs OFF");
   Serial.println("  pushsafer_key KEY — Set Pushsafer key");
   Serial.println("  test_notify   — Send test notification");
@@ -10,13 +10,28 @@
 //   - WaterManager:   TPA state machine (6 states)
 //   - FertManager:    Daily dosing with NVS deduplication
 //   - WebManager:     Embedded web dashboard + Serial command interface
+//
+// Tasks:
+//   - control (prio 5, core 1): SafetyWatchdog + WaterManager, fixed period
+//   - loopTask (prio 1, core 1): scheduling, web/serial, OLED, bookkeeping,
+//                                run as LoopScheduler jobs
+//   - notify   (prio 1, core 0): Pushsafer HTTPS delivery
 // =============================================================================
 
+#include "ActuatorLog.h"
 #include "Config.h"
+#include "ControlLock.h"
+#include "CounterStore.h"
 #include "DisplayManager.h"
+#include "DoseJournal.h"
+#include "EventAgenda.h"
 #include "FertManager.h"
+#include "LoopProfiler.h"
+#include "LoopScheduler.h"
 #include "NotifyManager.h"
+#include "PumpOutput.h"
 #include "SafetyWatchdog.h"
+#include "SettingsStore.h"
 #include "TimeManager.h"
 #include "WaterManager.h"
 #include "WebManager.h"
@@ -33,19 +48,422 @@ FertManager fertMgr;
 WebManager webMgr;
 DisplayManager displayMgr;
 NotifyManager notifyMgr;
+DoseJournal doseJournal;
+CounterStore counterStore; // AT24C32 on the DS3231 module
+ActuatorLog actuatorLog;   // On-time/cycles of OUTPUT_PINS (all writes)
+SettingsStore settings;    // aqua, notify, pumpcal configuration
+Pca9685PumpOutput fertExpander(Wire); // Fert pumps if FERT_OUTPUT is PCA9685
+
+// ---- Profiling (stage order = index into the name tables) ----
+enum ControlStage : uint8_t { CTRL_SAFETY = 0, CTRL_WATER, CTRL_STAGES };
+enum LoopStage : uint8_t {
+  LOOP_TIME = 0,
+  LOOP_SERIAL,
+  LOOP_WEB,
+  LOOP_FERT,
+  LOOP_NOTIFY,
+  LOOP_SCHED,
+  LOOP_DISPLAY,
+  LOOP_STAGES
+};
+static const char *const CONTROL_STAGE_NAMES[] = {"safety", "water"};
+static const char *const LOOP_STAGE_NAMES[] = {
+    "time", "serial", "web", "fert", "notify", "sched", "display"};
+LoopProfiler controlPerf("control", CONTROL_STAGE_NAMES, CTRL_STAGES);
+LoopProfiler loopPerf("loop", LOOP_STAGE_NAMES, LOOP_STAGES);
+
+// ---- loopTask jobs (registered in setup) ----
+LoopScheduler scheduler;
 
 // ---- Scheduling state ----
-bool fertDoneThisMinute = false; // Prevent re-triggering within same minute
-uint8_t lastFertMinute = 255;
-bool tpaDoneThisMinute = false;
-uint8_t lastTPAMinute = 255;
-bool emergencyNotified = false;   // Prevent repeated emergency notifications
+EventAgenda agenda;          // Next due time of every scheduled job
+// Schedule revisions and report time the agenda was built from, compared
+// one by one
+uint32_t agendaFertRev = 0;
+uint32_t agendaParamsRev = 0;
+uint16_t agendaReportMinute = 0; // Report hour * 60 + minute
+uint32_t agendaLastCheck = 0; // RTC epoch of the last agenda check
+unsigned long agendaLastCheckMs = 0; // millis() of the last agenda check
+bool agendaBuilt = false;
+volatile bool emergencyNotified = false; // Set by control task
 bool tpaCompleteNotified = false; // Prevent repeated TPA complete notifications
 bool tpaErrorNotified = false;    // Prevent repeated TPA error notifications
 
-// ---- WiFi Retry State ----
-unsigned long lastWiFiRetryTime = 0;
-const unsigned long WIFI_RETRY_INTERVAL_MS = 30000; // 30 seconds
+// =============================================================================
+// CONTROL TASK
+// =============================================================================
+// Owns the flood-critical path. Runs at a fixed period regardless of how long
+// web, I2C or TLS work takes in loop(), and is the task the TWDT watches
+// most closely: a hung sensor read or state handler reboots into safe GPIO.
+static void controlTask(void *) {
+  esp_task_wdt_add(NULL);
+  TickType_t lastWake = xTaskGetTickCount();
+
+  for (;;) {
+    // Blocking sensor fallback, if any, before the lock: web handlers wait
+    // on it
+    safety.prefetchBurst();
+    {
+      ControlLock lock;
+      controlPerf.beginIteration();
+      {
+        PerfScope p(controlPerf, CTRL_SAFETY);
+        safety.update();
+      }
+
+      // In emergency the TPA state machine is frozen; outputs stay as the
+      // emergency action left them
+      if (safety.isEmergency()) {
+        if (!emergencyNotified) {
+          notifyMgr.notifyEmergency("Sistema em estado de emergência!");
+          emergencyNotified = true;
+        }
+      } else {
+        emergencyNotified = false;
+        PerfScope p(controlPerf, CTRL_WATER);
+        waterMgr.update();
+      }
+      controlPerf.endIteration();
+    }
+
+    esp_task_wdt_reset();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS));
+  }
+}
+
+// =============================================================================
+// LOOP JOBS (run by the scheduler in loopTask)
+// =============================================================================
+// In emergency only serial and web stay alive; everything else is skipped.
+
+static void serialJob() {
+  PerfScope p(loopPerf, LOOP_SERIAL);
+  webMgr.processSerialCommands();
+}
+
+static void webJob() {
+  PerfScope p(loopPerf, LOOP_WEB);
+  webMgr.update(); // handle SSE and HTTP clients
+}
+
+static void timeJob() {
+  if (safety.isEmergency())
+    return;
+  PerfScope p(loopPerf, LOOP_TIME);
+  timeMgr.update(); // periodic NTP re-sync
+}
+
+// Journal records taken by onDoseDone under the lock; written after it so a
+// flash write never holds up the control task
+static DoseJournal::Record journalPending[NUM_FERTS + 1];
+static uint8_t journalPendingCount = 0;
+
+/// Deliver dose completions; pumps themselves are stopped by FertManager's
+/// timer. Runs in emergency too so nothing keeps pumping.
+static void dosingJob() {
+  PerfScope p(loopPerf, LOOP_FERT);
+  {
+    ControlLock lock; // The control task starts/stops the Prime dose
+    if (safety.isEmergency() && fertMgr.isAnyDosing())
+      fertMgr.stopAllDoses();
+    fertMgr.pollDoses(); // One completion per channel at most
+  }
+  for (uint8_t i = 0; i < journalPendingCount; i++)
+    doseJournal.append(journalPending[i]);
+  journalPendingCount = 0;
+}
+
+static void onDoseDone(uint8_t ch, const FertManager::DoseStatus &st, void *) {
+  if (st.scheduled && !st.aborted)
+    notifyMgr.notifyFertComplete(ch, st.deliveredMl);
+
+  if (journalPendingCount < NUM_FERTS + 1) {
+    DoseJournal::Record &r = journalPending[journalPendingCount++];
+    memset(&r, 0, sizeof(r));
+    r.epoch = timeMgr.now().unixtime() - st.actualUs / 1000000UL;
+    r.durationMs = st.actualUs / 1000;
+    r.requestedMl = st.ml;
+    r.deliveredMl = st.deliveredMl;
+    r.channel = ch;
+    r.pwm = fertMgr.getPWM(ch);
+    r.result = (uint8_t)(st.aborted ? DoseJournal::Result::ABORTED
+                                    : DoseJournal::Result::OK);
+    r.flags = st.scheduled ? DoseJournal::FLAG_SCHEDULED : 0;
+  }
+}
+
+static void wifiRetryJob() {
+  if (safety.isEmergency() || WiFi.status() == WL_CONNECTED)
+    return;
+  Serial.println("\n[WiFi] Connection lost/failed. Retrying connection...");
+
+  // If AP is active, we don't want to kill it, just ask STA to reconnect
+  WiFi.reconnect();
+}
+
+// ---- Event agenda (fert, TPA, daily report, midnight) ----
+
+/// Start a scheduled TPA with targets derived from the current level
+/// @return false if the TPA config is incomplete
+static bool startScheduledTPA() {
+  if (!webMgr.isTpaConfigReady()) {
+    Serial.println("[Main] TPA schedule triggered but config "
+                   "incomplete - skipping.");
+    return false;
+  }
+
+  // Level read, targets and start must not interleave with a tick
+  ControlLock lock;
+
+  // Compute dynamic drain/refill targets
+  float currentLevel = safety.getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+  float lPerCm = webMgr.getLitersPerCm();
+  float aqVol = (float)webMgr.getAquariumVolume();
+  float drainLiters = aqVol * webMgr.getTpaPercent() / 100.0f;
+
+  // Cap by reservoir available volume (minus safety margin)
+  float resAvail = (float)webMgr.getReservoirVolume() -
+                   webMgr.getReservoirSafetyML() / 1000.0f;
+  if (resAvail > 0 && drainLiters > resAvail) {
+    drainLiters = resAvail;
+    Serial.printf("[Main] TPA capped to %.1f L (reservoir limit)\n",
+                  drainLiters);
+  }
+
+  float cmToDrain = (lPerCm > 0) ? drainLiters / lPerCm : 0;
+  waterMgr.setDrainTargetCm(currentLevel + cmToDrain);
+  waterMgr.setRefillTargetCm(currentLevel);
+  waterMgr.setLitersPerCm(lPerCm); // For inline calibration
+
+  // Compute canister safe level from percentage
+  float effH = (float)webMgr.getAquariumVolume() / lPerCm; // effective height
+  float canisterSafeCm =
+      effH * (100.0f - webMgr.getCanisterSafePct()) / 100.0f;
+  waterMgr.setCanisterSafeLevelCm(canisterSafeCm);
+  waterMgr.setAqEffectiveHeightCm(effH);
+
+  // Dynamic timeouts (if calibrated)
+  float drainLPM = waterMgr.getDrainFlowLPM();
+  float refillLPM = waterMgr.getRefillFlowLPM();
+  if (drainLPM > 0) {
+    unsigned long t =
+        (unsigned long)((drainLiters / drainLPM) * 1.5f * 60000.0f);
+    waterMgr.setTimeoutDrainMs(t);
+    Serial.printf("[Main] Drain timeout: %lums (calibrated)\n", t);
+  }
+  if (refillLPM > 0) {
+    unsigned long t =
+        (unsigned long)((drainLiters / refillLPM) * 1.5f * 60000.0f);
+    waterMgr.setTimeoutRefillMs(t);
+    Serial.printf("[Main] Refill timeout: %lums (calibrated)\n", t);
+  }
+
+  Serial.printf(
+      "[Main] TPA: %.1f L = %.1f cm, drain to %.1f, refill to %.1f\n",
+      drainLiters, cmToDrain, currentLevel + cmToDrain, currentLevel);
+  waterMgr.startTPA();
+  webMgr.setTpaLastRun(timeMgr.now().unixtime());
+  return true;
+}
+
+/// Next TPA at or after fromEpoch: every tpaInterval days at tpaHour:tpaMinute
+static uint32_t nextTPAEpoch(uint32_t fromEpoch) {
+  uint16_t interval = webMgr.getTpaInterval();
+  if (interval == 0)
+    return 0;
+
+  // 43200 seconds = 12 hours. We grant a 12h leeway so that DST shifts or
+  // small clock drifts don't cause it to miss a day.
+  uint32_t lastRun = webMgr.getTpaLastRun();
+  uint32_t earliest = lastRun ? lastRun + interval * 86400UL - 43200 : 0;
+  return EventAgenda::nextDaily(earliest > fromEpoch ? earliest : fromEpoch,
+                                webMgr.getTpaHour(), webMgr.getTpaMinute());
+}
+
+/// Next occurrence of one job at or after fromEpoch (0 = not scheduled)
+static uint32_t nextAgendaEpoch(AgendaKind kind, uint8_t arg,
+                                uint32_t fromEpoch) {
+  switch (kind) {
+  case AgendaKind::FERT_DOSE:
+    return fertMgr.nextDoseEpoch(arg, fromEpoch);
+  case AgendaKind::TPA:
+    return nextTPAEpoch(fromEpoch);
+  case AgendaKind::DAILY_REPORT:
+    return EventAgenda::nextDaily(fromEpoch, notifyMgr.getDailyReportHour(),
+                                  notifyMgr.getDailyReportMinute());
+  case AgendaKind::NEW_DAY:
+    return EventAgenda::nextDaily(fromEpoch, 0, 0);
+  }
+  return 0;
+}
+
+/// Recompute every job's next due time
+static void rebuildAgenda(uint32_t fromEpoch) {
+  agenda.clear();
+  for (uint8_t ch = 0; ch < NUM_FERTS + 1; ch++) {
+    agenda.push(nextAgendaEpoch(AgendaKind::FERT_DOSE, ch, fromEpoch),
+                AgendaKind::FERT_DOSE, ch);
+  }
+  const AgendaKind daily[] = {AgendaKind::TPA, AgendaKind::DAILY_REPORT,
+                              AgendaKind::NEW_DAY};
+  for (AgendaKind k : daily)
+    agenda.push(nextAgendaEpoch(k, 0, fromEpoch), k);
+}
+
+/// Rebuild if any schedule changed or the RTC was stepped; O(1) otherwise
+static void refreshAgenda(uint32_t nowEpoch) {
+  uint32_t fertRev = fertMgr.getScheduleRevision();
+  uint32_t paramsRev = webMgr.getParamsRevision();
+  uint16_t reportMinute = notifyMgr.getDailyReportHour() * 60U +
+                          notifyMgr.getDailyReportMinute();
+
+  // A clock step (NTP sync, manual set) moves RTC time by more than the
+  // real time elapsed; events it skips over are not "missed"
+  uint32_t elapsedS = (millis() - agendaLastCheckMs) / 1000;
+  bool clockStep = agendaBuilt && (nowEpoch + 60 < agendaLastCheck ||
+                                   nowEpoch - agendaLastCheck > elapsedS + 120);
+  if (agendaBuilt && fertRev == agendaFertRev &&
+      paramsRev == agendaParamsRev && reportMinute == agendaReportMinute &&
+      !clockStep)
+    return;
+
+  // Events up to the last check already ran; start after that minute so a
+  // schedule edit cannot re-fire them
+  uint32_t from = nowEpoch - nowEpoch % 60;
+  if (agendaBuilt && !clockStep)
+    from = agendaLastCheck - agendaLastCheck % 60 + 60;
+  if (clockStep)
+    Serial.println("[Agenda] RTC stepped - rebuilding schedule.");
+  rebuildAgenda(from);
+  agendaFertRev = fertRev;
+  agendaParamsRev = paramsRev;
+  agendaReportMinute = reportMinute;
+  agendaBuilt = true;
+}
+
+/// Run one due event; late events still run, missed ones are only re-armed
+static void runAgendaEvent(const AgendaEvent &ev, AgendaTiming timing,
+                           uint32_t nowEpoch) {
+  if (timing != AgendaTiming::MISSED) {
+    switch (ev.kind) {
+    case AgendaKind::FERT_DOSE: {
+      PerfScope p(loopPerf, LOOP_FERT);
+      ControlLock lock; // Stock is shared with the TPA Prime dose
+      fertMgr.runScheduledDose(ev.arg, DateTime(ev.dueEpoch));
+      break;
+    }
+    case AgendaKind::TPA: {
+      PerfScope p(loopPerf, LOOP_SCHED);
+      if (waterMgr.isRunning())
+        Serial.println("[Main] TPA schedule reached while a TPA is running.");
+      else
+        startScheduledTPA(); // Success bumps the params revision
+      break;
+    }
+    case AgendaKind::DAILY_REPORT: {
+      PerfScope p(loopPerf, LOOP_NOTIFY);
+      notifyMgr.notifyDailyLevel(safety.getLastDistance());
+      break;
+    }
+    case AgendaKind::NEW_DAY:
+      notifyMgr.startNewDay();
+      break;
+    }
+  }
+
+  // Re-arm after this occurrence's minute; a missed job skips ahead to now
+  // so a long outage reports it once rather than once per lost day
+  uint32_t from = ev.dueEpoch + 60;
+  uint32_t nowMinute = nowEpoch - nowEpoch % 60;
+  if (timing == AgendaTiming::MISSED && from < nowMinute)
+    from = nowMinute;
+  agenda.push(nextAgendaEpoch(ev.kind, ev.arg, from), ev.kind, ev.arg);
+}
+
+/// Fertilization, notifications and TPA schedule (not in maintenance)
+static void calendarJob() {
+  if (safety.isEmergency() || safety.isMaintenanceMode())
+    return;
+
+  uint32_t nowEpoch;
+  {
+    PerfScope p(loopPerf, LOOP_TIME); // RTC read over I2C
+    nowEpoch = timeMgr.now().unixtime();
+  }
+
+  {
+    PerfScope p(loopPerf, LOOP_SCHED);
+    refreshAgenda(nowEpoch);
+  }
+  AgendaEvent ev;
+  AgendaTiming timing;
+  while (agenda.popDue(nowEpoch, ev, timing))
+    runAgendaEvent(ev, timing, nowEpoch);
+  agendaLastCheck = nowEpoch;
+  agendaLastCheckMs = millis();
+
+  // --- Check low stock after fertilization ---
+  PerfScope p(loopPerf, LOOP_NOTIFY);
+  for (uint8_t ch = 0; ch < NUM_FERTS + 1; ch++) {
+    if (fertMgr.isLowStock(ch)) {
+      notifyMgr.notifyFertLowStock(ch, fertMgr.getStockML(ch),
+                                   fertMgr.getLowStockThreshold(ch));
+    }
+  }
+}
+
+/// TPA bookkeeping (state machine runs in controlTask). Done here: needs
+/// the RTC (I2C) and NVS, which must not stall the control tick
+static void tpaBookkeepingJob() {
+  // Power-loss copy of the TPA checkpoint; also in emergency, so an aborted
+  // cycle is not resumed after a power cut
+  waterMgr.mirrorCheckpoint();
+  if (safety.isEmergency())
+    return;
+  PerfScope p(loopPerf, LOOP_NOTIFY);
+  {
+    // The counter store is shared with doses saved by the control task
+    ControlLock lock;
+    actuatorLog.update(); // Periodic totals save (I2C/NVS, same constraints)
+  }
+  settings.update(); // Debounced settings commit
+  TPAState tpaState = waterMgr.getState();
+  if (tpaState == TPAState::COMPLETE && !tpaCompleteNotified) {
+    waterMgr.setLastTPATime(timeMgr.getFormattedTime());
+
+    // Save calibrated flow rates for next TPA
+    if (waterMgr.getDrainFlowLPM() > 0 || waterMgr.getRefillFlowLPM() > 0) {
+      if (waterMgr.getDrainFlowLPM() > 0)
+        settings.setFloat(Setting::DRAIN_LPM, waterMgr.getDrainFlowLPM());
+      if (waterMgr.getRefillFlowLPM() > 0)
+        settings.setFloat(Setting::REFILL_LPM, waterMgr.getRefillFlowLPM());
+      Serial.printf("[Main] Calibration saved: drain=%.2f refill=%.2f L/min\n",
+                    waterMgr.getDrainFlowLPM(), waterMgr.getRefillFlowLPM());
+    }
+
+    notifyMgr.notifyTPAComplete();
+    tpaCompleteNotified = true;
+  } else if (tpaState == TPAState::ERROR && !tpaErrorNotified) {
+    String reason;
+    {
+      ControlLock lock; // String is written by the control task
+      reason = waterMgr.getLastErrorMsg();
+    }
+    notifyMgr.notifyTPAError(reason.c_str());
+    tpaErrorNotified = true;
+  } else if (waterMgr.isRunning()) {
+    // Reset flags while TPA is actively running
+    tpaCompleteNotified = false;
+    tpaErrorNotified = false;
+  }
+}
+
+static void displayJob() {
+  if (safety.isEmergency())
+    return;
+  PerfScope p(loopPerf, LOOP_DISPLAY);
+  displayMgr.update();
+}
 
 // =============================================================================
 // SETUP
@@ -54,12 +472,16 @@ void setup() {
   // --- Step 1: Initialize all output pins LOW FIRST (safety critical) ---
   for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++) {
     pinMode(OUTPUT_PINS[i], OUTPUT);
-    digitalWrite(OUTPUT_PINS[i], LOW);
+    ActuatorLog::write(OUTPUT_PINS[i], LOW);
   }
 
+  // --- Step 1b: TPA cut short by a reset? (keeps the canister off) ---
+  bool tpaPending = waterMgr.loadCheckpoint();
+
   // --- Step 2: Serial ---
   Serial.begin(115200);
-  delay(2000);
+  if (!tpaPending)
+    delay(2000); // Time to attach a monitor; a pending TPA can't wait
   Serial.println("\n==========================================");
   Serial.println("  AQUARIUM AUTOMATION - ESP32 Firmware");
   Serial.println("  v3.0.0 - Web Dashboard");
@@ -79,11 +501,28 @@ void setup() {
         Serial.print(" (DS3231 RTC)");
       if (addr == 0x57)
         Serial.print(" (DS3231 EEPROM)");
+      if (addr == PCA9685_I2C_ADDR)
+        Serial.print(" (PCA9685 PWM)");
       Serial.println();
       devCount++;
     }
   }
   Serial.printf("[I2C] Scan complete: %d device(s) found.\n", devCount);
+  Wire.setClock(I2C_CLOCK_HZ);
+
+  // Settings registry: every namespace it owns in one pass, before the
+  // managers read their configuration
+  settings.begin();
+
+  // EEPROM counter store: before any manager loads its counters
+  counterStore.begin(Wire);
+  actuatorLog.setCounterStore(&counterStore);
+  actuatorLog.begin();
+
+  // The expander keeps its outputs through an ESP32 reset: pumps off now,
+  // not once FertManager starts after WiFi
+  if (FERT_OUTPUT == FertOutput::PCA9685)
+    fertExpander.begin(NUM_FERTS + 1);
 
   // --- Step 2c: OLED Display (early init for boot screen) ---
   displayMgr.initHardware();
@@ -95,8 +534,56 @@ void setup() {
   } else {
     Serial.println("[LittleFS] Mounted successfully.");
   }
+  doseJournal.begin(LittleFS);
+
+  // --- Step 3: Sensors, dosing and TPA (before WiFi) ---
+  // Everything the control task drives, so it starts ahead of the 30+ s
+  // WiFi sequence and an interrupted TPA resumes within a second of boot
+  displayMgr.showBootStatus("Sensors");
+  safety.begin();
+
+  fertMgr.setCounterStore(&counterStore);
+  if (FERT_OUTPUT == FertOutput::PCA9685)
+    fertMgr.setOutput(&fertExpander);
+  fertMgr.begin();
+  fertMgr.setDoseCallback(onDoseDone, nullptr);
+
+  waterMgr.begin(&safety, &fertMgr);
 
-  // --- Step 3: WiFi (must be before NTP/WebServer) ---
+  // Load calibrated pump flow rates
+  {
+    float drainLPM = settings.getFloat(Setting::DRAIN_LPM);
+    float refillLPM = settings.getFloat(Setting::REFILL_LPM);
+    if (drainLPM > 0) {
+      waterMgr.setDrainFlowLPM(drainLPM);
+      Serial.printf("[Main] Loaded drain calibration: %.2f L/min\n", drainLPM);
+    }
+    if (refillLPM > 0) {
+      waterMgr.setRefillFlowLPM(refillLPM);
+      Serial.printf("[Main] Loaded refill calibration: %.2f L/min\n",
+                    refillLPM);
+    }
+    if (drainLPM <= 0 && refillLPM <= 0) {
+      Serial.println(
+          "[Main] No pump calibration found. Using safe defaults (30s/15s).");
+    }
+  }
+  waterMgr.resumeTPA(); // No-op unless Step 1b found a checkpoint
+
+  // --- Step 3b: Control task + Task Watchdog ---
+  // Ultrasonic sampling is interrupt-driven and notifications run in their
+  // own task, so neither the control task nor loop() blocks for long. Both
+  // are subscribed to the TWDT and must check in every TASK_WDT_TIMEOUT_S;
+  // a panic reboot re-runs Step 1 and leaves every output LOW.
+  esp_task_wdt_init(TASK_WDT_TIMEOUT_S, true);
+  ControlLock::init();
+  notifyMgr.startTask(); // Before the first tick: never send HTTPS inline
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr,
+                          CONTROL_TASK_PRIORITY, nullptr, CONTROL_TASK_CORE);
+  Serial.printf("[WDT] Task watchdog armed (%lus). Control task every %lums.\n",
+                (unsigned long)TASK_WDT_TIMEOUT_S, CONTROL_TASK_PERIOD_MS);
+
+  // --- Step 4: WiFi (must be before NTP/WebServer) ---
   displayMgr.showBootStatus("WiFi scan");
   Preferences wifiPref;
   wifiPref.begin("wifi", true); // true = readonly
@@ -233,45 +720,20 @@ void setup() {
     // Removed immediate WiFi.begin() because it disrupts the SoftAP network.
   }
 
-  // --- Step 4: Safety Watchdog (sensors) ---
-  displayMgr.showBootStatus("Sensors");
-  safety.begin();
-
   // --- Step 5: Time Manager (RTC + NTP — needs WiFi) ---
   displayMgr.showBootStatus("RTC + NTP");
   timeMgr.begin();
 
-  // --- Step 5: Fertilizer Manager (NVS state) ---
-  fertMgr.begin();
-
-  // --- Step 6: Water Manager (TPA state machine) ---
-  waterMgr.begin(&safety, &fertMgr);
-
-  // Load calibrated pump flow rates from NVS
-  {
-    Preferences calPref;
-    calPref.begin("pumpcal", true); // read-only
-    float drainLPM = calPref.getFloat("drainLPM", 0);
-    float refillLPM = calPref.getFloat("refillLPM", 0);
-    calPref.end();
-    if (drainLPM > 0) {
-      waterMgr.setDrainFlowLPM(drainLPM);
-      Serial.printf("[Main] Loaded drain calibration: %.2f L/min\n", drainLPM);
-    }
-    if (refillLPM > 0) {
-      waterMgr.setRefillFlowLPM(refillLPM);
-      Serial.printf("[Main] Loaded refill calibration: %.2f L/min\n",
-                    refillLPM);
-    }
-    if (drainLPM <= 0 && refillLPM <= 0) {
-      Serial.println(
-          "[Main] No pump calibration found. Using safe defaults (30s/15s).");
-    }
-  }
-
   // --- Step 7: Web Dashboard + Serial UI ---
   displayMgr.showBootStatus("Web server");
+  webMgr.setCounterStore(&counterStore);
+  webMgr.setSettings(&settings);
   webMgr.begin(&timeMgr, &waterMgr, &fertMgr, &safety, &notifyMgr);
+  webMgr.setProfilers(&controlPerf, &loopPerf);
+  webMgr.setScheduler(&scheduler);
+  webMgr.setAgenda(&agenda);
+  webMgr.setJournal(&doseJournal);
+  webMgr.setActuatorLog(&actuatorLog);
 
   // --- Step 7b: OLED Display (full init with managers) ---
   displayMgr.begin(&timeMgr, &waterMgr, &fertMgr, &safety, &webMgr);
@@ -279,22 +741,36 @@ void setup() {
   delay(1000); // pause to show final boot log
 
   // --- Step 8: Canister filter ON by default ---
-  digitalWrite(PIN_CANISTER, LOW); // SSR: LOW = relay ON
-  Serial.println("[Main] Canister filter ON (default).\n");
+  {
+    ControlLock lock; // A resumed TPA may be holding it off
+    if (!waterMgr.isRunning()) {
+      ActuatorLog::write(PIN_CANISTER, LOW); // SSR: LOW = relay ON
+      Serial.println("[Main] Canister filter ON (default).\n");
+    }
+  }
 
   // --- Step 9: Notifications ---
-  notifyMgr.begin();
-  notifyMgr.setLanguage(webMgr.getLanguage());
-
-  // --- Step 10: Disable Task Watchdog ---
-  // The Arduino framework's task WDT conflicts with our long-running loop
-  // (ultrasonic pulseIn blocks ~300ms, I2C transfers, etc). The system already
-  // has a comprehensive SafetyWatchdog (sensors, emergency shutdown, overflow
-  // detection) so the task WDT is redundant. Disable it to prevent false
-  // reboots.
-  disableLoopWDT();
-  disableCore0WDT();
-  Serial.println("[WDT] Task watchdog disabled (SafetyWatchdog active).");
+  notifyMgr.setSettings(&settings);
+  {
+    ControlLock lock; // The control task may already be notifying
+    notifyMgr.begin();
+    notifyMgr.setLanguage(webMgr.getLanguage());
+  }
+
+  // --- Step 10: loopTask on the Task Watchdog (control task: Step 3b) ---
+  enableLoopWDT();
+
+  // --- Step 11: loopTask jobs (priority: higher runs first when both due) ---
+  scheduler.addJob("serial", serialJob, SCHED_SERIAL_PERIOD_MS, 4);
+  scheduler.addJob("web", webJob, SCHED_WEB_PERIOD_MS, 3);
+  scheduler.addJob("dosing", dosingJob, SCHED_DOSING_PERIOD_MS, 3);
+  scheduler.addJob("tpa_book", tpaBookkeepingJob,
+                   SCHED_TPA_BOOKKEEPING_PERIOD_MS, 3);
+  scheduler.addJob("calendar", calendarJob, SCHED_CALENDAR_PERIOD_MS, 2);
+  scheduler.addJob("display", displayJob, SCHED_DISPLAY_PERIOD_MS, 1,
+                   2 * SCHED_DISPLAY_PERIOD_MS);
+  scheduler.addJob("time", timeJob, SCHED_TIME_PERIOD_MS, 1);
+  scheduler.addJob("wifi", wifiRetryJob, SCHED_WIFI_RETRY_PERIOD_MS, 0);
 
   Serial.println("[Main] === System Ready ===\n");
 }
@@ -303,193 +779,11 @@ void setup() {
 // LOOP
 // =============================================================================
 void loop() {
-  // ---- 1. SAFETY (highest priority, runs every 500ms) ----
-  safety.update();
-
-  // If in emergency, skip all scheduling and just process commands
-  if (safety.isEmergency()) {
-    if (!emergencyNotified) {
-      notifyMgr.notifyEmergency("Sistema em estado de emergência!");
-      emergencyNotified = true;
-    }
-    webMgr.processSerialCommands();
-    webMgr.update(); // keep web server alive
-    delay(100);
-    return;
-  } else {
-    emergencyNotified = false;
-  }
-
-  // ---- 2. TIME SYNC (periodic NTP re-sync) ----
-  timeMgr.update();
-
-  // ---- 3. SERIAL COMMANDS + WEB ----
-  webMgr.processSerialCommands();
-  webMgr.update(); // handle SSE and HTTP clients
-
-  // ---- 4. WIFI RETRY LOGIC (Every 30 seconds) ----
-  if (WiFi.status() != WL_CONNECTED) {
-    if (millis() - lastWiFiRetryTime >= WIFI_RETRY_INTERVAL_MS) {
-      Serial.println("\n[WiFi] Connection lost/failed. Retrying connection...");
-
-      // If AP is active, we don't want to kill it, just ask STA to reconnect
-      WiFi.reconnect();
-
-      lastWiFiRetryTime = millis();
-    }
-  }
-
-  // ---- 5. SCHEDULING (only if not in maintenance and not running TPA) ----
-  if (!safety.isMaintenanceMode()) {
-
-    DateTime now = timeMgr.now();
-    uint8_t currentMinute = now.minute();
-
-    // --- Fertilization schedule (Independent per Channel) ---
-    fertMgr.update(now);
-
-    // --- Check low stock after fertilization ---
-    for (uint8_t ch = 0; ch < NUM_FERTS + 1; ch++) {
-      if (fertMgr.isLowStock(ch)) {
-        notifyMgr.notifyFertLowStock(ch, fertMgr.getStockML(ch),
-                                     fertMgr.getLowStockThreshold(ch));
-      }
-    }
-
-    // --- Notifications: daily level report + midnight reset ---
-    notifyMgr.update(now.hour(), now.minute());
-    if (now.hour() == notifyMgr.getDailyReportHour() &&
-        now.minute() == notifyMgr.getDailyReportMinute()) {
-      float level = safety.getLastDistance();
-      notifyMgr.notifyDailyLevel(level);
-    }
-
-    // --- TPA schedule ---
-    if (currentMinute != lastTPAMinute) {
-      tpaDoneThisMinute = false;
-      lastTPAMinute = currentMinute;
-
-      // Evaluate interval-based execution
-      bool isTPADay = false;
-      uint16_t interval = webMgr.getTpaInterval();
-      if (interval > 0) {
-        unsigned long lastRun = webMgr.getTpaLastRun();
-        unsigned long nowEpoch = timeMgr.now().unixtime();
-
-        // 43200 seconds = 12 hours. We grant a 12h leeway so that DST shifts
-        // or small clock drifts don't cause it to miss a day. The precise
-        // trigger happens below by strictly matching hour and minute.
-        if (lastRun == 0 ||
-            nowEpoch >= (lastRun + (interval * 86400) - 43200)) {
-          isTPADay = true;
-        }
-      }
-
-      // Determine if a TPA should start (evaluated only once per minute)
-      if (!waterMgr.isRunning() && isTPADay) {
-        if (timeMgr.isDailyScheduleTime(webMgr.getTpaHour(),
-                                        webMgr.getTpaMinute())) {
-          if (!webMgr.isTpaConfigReady()) {
-            Serial.println("[Main] TPA schedule triggered but config "
-                           "incomplete - skipping.");
-          } else {
-            // Compute dynamic drain/refill targets
-            float currentLevel = safety.readUltrasonic();
-            float lPerCm = webMgr.getLitersPerCm();
-            float aqVol = (float)webMgr.getAquariumVolume();
-            float drainLiters = aqVol * webMgr.getTpaPercent() / 100.0f;
-
-            // Cap by reservoir available volume (minus safety margin)
-            float resAvail = (float)webMgr.getReservoirVolume() -
-                             webMgr.getReservoirSafetyML() / 1000.0f;
-            if (resAvail > 0 && drainLiters > resAvail) {
-              drainLiters = resAvail;
-              Serial.printf("[Main] TPA capped to %.1f L (reservoir limit)\n",
-                            drainLiters);
-            }
-
-            float cmToDrain = (lPerCm > 0) ? drainLiters / lPerCm : 0;
-            waterMgr.setDrainTargetCm(currentLevel + cmToDrain);
-            waterMgr.setRefillTargetCm(currentLevel);
-            waterMgr.setLitersPerCm(lPerCm); // For inline calibration
-
-            // Compute canister safe level from percentage
-            float effH =
-                (float)webMgr.getAquariumVolume() / lPerCm; // effective height
-            float canisterSafeCm =
-                effH * (100.0f - webMgr.getCanisterSafePct()) / 100.0f;
-            waterMgr.setCanisterSafeLevelCm(canisterSafeCm);
-            waterMgr.setAqEffectiveHeightCm(effH);
-
-            // Dynamic timeouts (if calibrated)
-            float drainLPM = waterMgr.getDrainFlowLPM();
-            float refillLPM = waterMgr.getRefillFlowLPM();
-            if (drainLPM > 0) {
-              unsigned long t =
-                  (unsigned long)((drainLiters / drainLPM) * 1.5f * 60000.0f);
-              waterMgr.setTimeoutDrainMs(t);
-              Serial.printf("[Main] Drain timeout: %lums (calibrated)\n", t);
-            }
-            if (refillLPM > 0) {
-              unsigned long t =
-                  (unsigned long)((drainLiters / refillLPM) * 1.5f * 60000.0f);
-              waterMgr.setTimeoutRefillMs(t);
-              Serial.printf("[Main] Refill timeout: %lums (calibrated)\n", t);
-            }
-
-            Serial.printf(
-                "[Main] TPA: %.1f L = %.1f cm, drain to %.1f, refill to %.1f\n",
-                drainLiters, cmToDrain, currentLevel + cmToDrain, currentLevel);
-            waterMgr.startTPA();
-            webMgr.setTpaLastRun(timeMgr.now().unixtime());
-            tpaDoneThisMinute = true;
-          }
-        }
-      }
-    }
-  }
-
-  // ---- 5. TPA STATE MACHINE ----
-  waterMgr.update();
-
-  // If TPA just completed, record timestamp, save calibration, and notify
-  if (waterMgr.getState() == TPAState::COMPLETE) {
-    waterMgr.setLastTPATime(timeMgr.getFormattedTime());
-
-    // Save calibrated flow rates for next TPA
-    if (waterMgr.getDrainFlowLPM() > 0 || waterMgr.getRefillFlowLPM() > 0) {
-      Preferences calPref;
-      calPref.begin("pumpcal", false);
-      if (waterMgr.getDrainFlowLPM() > 0)
-        calPref.putFloat("drainLPM", waterMgr.getDrainFlowLPM());
-      if (waterMgr.getRefillFlowLPM() > 0)
-        calPref.putFloat("refillLPM", waterMgr.getRefillFlowLPM());
-      calPref.end();
-      Serial.printf("[Main] Calibration saved: drain=%.2f refill=%.2f L/min\n",
-                    waterMgr.getDrainFlowLPM(), waterMgr.getRefillFlowLPM());
-    }
-
-    if (!tpaCompleteNotified) {
-      notifyMgr.notifyTPAComplete();
-      tpaCompleteNotified = true;
-    }
-  } else if (waterMgr.getState() == TPAState::ERROR) {
-    if (!tpaErrorNotified) {
-      notifyMgr.notifyTPAError(waterMgr.getLastErrorMsg().c_str());
-      tpaErrorNotified = true;
-    }
-  } else if (waterMgr.isRunning()) {
-    // Reset flags while TPA is actively running
-    tpaCompleteNotified = false;
-    tpaErrorNotified = false;
-  }
-
-  // ---- 6. WEB DASHBOARD + TELEMETRY ----
-  webMgr.update();
-
-  // ---- 7. OLED DISPLAY ----
-  displayMgr.update();
+  // SAFETY + TPA run in controlTask; everything here is a scheduler job
+  loopPerf.beginIteration();
+  scheduler.runDue();
+  loopPerf.endIteration(); // Busy time only: the sleep below is not counted
 
-  // ---- 8. YIELD ----
-  delay(50); // ~20 Hz loop: enough for safety, yields to FreeRTOS IDLE
+  // Sleep until the next release instead of a fixed delay(50)
+  delay(scheduler.msUntilNext());
 }
@@ -5,10 +5,18 @@ uint8_t mock_pin_mode[NUM_MOCK_PINS] = {0};
 uint8_t mock_pin_state[NUM_MOCK_PINS] = {0};
 uint8_t mock_pin_read_value[NUM_MOCK_PINS] = {0};
 
+// ---- GPIO interrupt mock state ----
+static void (*mock_isr[NUM_MOCK_PINS])(void) = {nullptr};
+static void (*mock_isr_arg[NUM_MOCK_PINS])(void *) = {nullptr};
+static void *mock_isr_ctx[NUM_MOCK_PINS] = {nullptr};
+
 void mock_reset_pins() {
   memset(mock_pin_mode, 0, sizeof(mock_pin_mode));
   memset(mock_pin_state, 0, sizeof(mock_pin_state));
   memset(mock_pin_read_value, 0, sizeof(mock_pin_read_value));
+  memset(mock_ledc_duty, 0, sizeof(mock_ledc_duty));
+  for (uint8_t i = 0; i < NUM_MOCK_PINS; i++)
+    detachInterrupt(i);
 }
 
 void pinMode(uint8_t pin, uint8_t mode) {
@@ -29,6 +37,40 @@ uint8_t digitalRead(uint8_t pin) {
   return LOW;
 }
 
+// ---- GPIO interrupts ----
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (pin < NUM_MOCK_PINS) {
+    mock_isr[pin] = isr;
+    mock_isr_arg[pin] = nullptr;
+  }
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg,
+                        int mode) {
+  if (pin < NUM_MOCK_PINS) {
+    mock_isr[pin] = nullptr;
+    mock_isr_arg[pin] = isr;
+    mock_isr_ctx[pin] = arg;
+  }
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < NUM_MOCK_PINS) {
+    mock_isr[pin] = nullptr;
+    mock_isr_arg[pin] = nullptr;
+    mock_isr_ctx[pin] = nullptr;
+  }
+}
+
+void mock_trigger_interrupt(uint8_t pin) {
+  if (pin >= NUM_MOCK_PINS)
+    return;
+  if (mock_isr[pin])
+    mock_isr[pin]();
+  else if (mock_isr_arg[pin])
+    mock_isr_arg[pin](mock_isr_ctx[pin]);
+}
+
 // ---- Timing ----
 unsigned long mock_millis_value = 0;
 unsigned long millis() { return mock_millis_value; }
@@ -36,9 +78,19 @@ void delay(unsigned long ms) { mock_millis_value += ms; }
 void delayMicroseconds(unsigned int us) { /* no-op */ }
 void yield() { /* no-op */ }
 
+uint32_t esp_random() {
+  static uint32_t x = 0x12345678;
+  x ^= x << 13; // xorshift32
+  x ^= x >> 17;
+  x ^= x << 5;
+  return x;
+}
+
 // ---- pulseIn ----
 unsigned long mock_pulseIn_value = 0;
+int mock_pulseIn_calls = 0;
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout) {
+  mock_pulseIn_calls++;
   return mock_pulseIn_value;
 }
 
@@ -49,7 +101,11 @@ MockSerial Serial;
 MockWiFiClass WiFi;
 
 // ---- LEDC (PWM) stubs ----
+uint32_t mock_ledc_duty[NUM_MOCK_LEDC] = {0};
 void ledcSetup(uint8_t channel, double freq, uint8_t resolution) {}
 void ledcAttachPin(uint8_t pin, uint8_t channel) {}
-void ledcWrite(uint8_t channel, uint32_t duty) {}
+void ledcWrite(uint8_t channel, uint32_t duty) {
+  if (channel < NUM_MOCK_LEDC)
+    mock_ledc_duty[channel] = duty;
+}
 void ledcDetachPin(uint8_t pin) {}
@@ -24,6 +24,23 @@ typedef bool boolean;
 #define OUTPUT 1
 #define INPUT_PULLUP 2
 
+// ---- Interrupt modes (ESP32 values) ----
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// ---- ESP32 attributes / critical sections (single-threaded host: no-ops) ----
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR
+typedef int portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED 0
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+#define portENTER_CRITICAL_SAFE(mux) ((void)(mux))
+#define portEXIT_CRITICAL_SAFE(mux) ((void)(mux))
+
 // ---- Math helpers ----
 #ifndef min
 template <typename T> T min(T a, T b) { return (a < b) ? a : b; }
@@ -32,6 +49,19 @@ template <typename T> T min(T a, T b) { return (a < b) ? a : b; }
 template <typename T> T max(T a, T b) { return (a > b) ? a : b; }
 #endif
 
+// ---- Print (base of streams such as AsyncResponseStream) ----
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buf, size_t len) {
+    size_t n = 0;
+    while (len--)
+      n += write(*buf++);
+    return n;
+  }
+};
+
 // ---- String class (Arduino-compatible) — MUST be before MockSerial ----
 class String {
 public:
@@ -39,7 +69,17 @@ public:
   String(const char *s) : _str(s ? s : "") {}
   String(const std::string &s) : _str(s) {}
   String(int val) : _str(std::to_string(val)) {}
+  String(unsigned int val) : _str(std::to_string(val)) {}
+  String(long val) : _str(std::to_string(val)) {}
+  String(unsigned long val) : _str(std::to_string(val)) {}
   String(float val) : _str(std::to_string(val)) {}
+  String(float val, unsigned char decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, val);
+    _str = buf;
+  }
+
+  void reserve(unsigned int size) { _str.reserve(size); }
 
   const char *c_str() const { return _str.c_str(); }
   int length() const { return (int)_str.length(); }
@@ -65,6 +105,13 @@ public:
       return false;
     return _str.compare(_str.size() - s.size(), s.size(), s) == 0;
   }
+  int indexOf(const char *s, int from = 0) const {
+    auto i = _str.find(s, from);
+    return i == std::string::npos ? -1 : (int)i;
+  }
+  int indexOf(const String &s, int from = 0) const {
+    return indexOf(s.c_str(), from);
+  }
   int toInt() const { return atoi(_str.c_str()); }
   float toFloat() const { return (float)atof(_str.c_str()); }
 
@@ -113,6 +160,14 @@ void pinMode(uint8_t pin, uint8_t mode);
 void digitalWrite(uint8_t pin, uint8_t val);
 uint8_t digitalRead(uint8_t pin);
 
+// ---- GPIO interrupts ----
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+/// Invoke the ISR attached to a pin (simulates an edge)
+void mock_trigger_interrupt(uint8_t pin);
+
 // ---- Timing ----
 extern unsigned long mock_millis_value;
 unsigned long millis();
@@ -120,7 +175,12 @@ void delay(unsigned long ms);
 void delayMicroseconds(unsigned int us);
 void yield();
 
+// ---- Hardware RNG (deterministic sequence on the host) ----
+uint32_t esp_random();
+
 // ---- LEDC (PWM) stubs ----
+#define NUM_MOCK_LEDC 16
+extern uint32_t mock_ledc_duty[NUM_MOCK_LEDC]; // Last duty per channel
 void ledcSetup(uint8_t channel, double freq, uint8_t resolution);
 void ledcAttachPin(uint8_t pin, uint8_t channel);
 void ledcWrite(uint8_t channel, uint32_t duty);
@@ -128,6 +188,7 @@ void ledcDetachPin(uint8_t pin);
 
 // ---- pulseIn ----
 extern unsigned long mock_pulseIn_value;
+extern int mock_pulseIn_calls;
 unsigned long pulseIn(uint8_t pin, uint8_t state, unsigned long timeout);
 
 // ---- Serial Mock ----
@@ -0,0 +1,142 @@
+#include "FS.h"
+#include "LittleFS.h"
+
+#include <algorithm>
+#include <cstring>
+
+LittleFSFS LittleFS;
+bool fs::FS::mock_failWrites = false;
+
+std::map<std::string, std::vector<uint8_t>> &fs::FS::mock_files() {
+  static std::map<std::string, std::vector<uint8_t>> files;
+  return files;
+}
+
+std::set<std::string> &fs::FS::_dirs() {
+  static std::set<std::string> dirs;
+  return dirs;
+}
+
+void fs::FS::mock_clear() {
+  mock_files().clear();
+  _dirs().clear();
+  mock_failWrites = false;
+}
+
+// ---- File ----
+
+size_t fs::File::write(const uint8_t *buf, size_t len) {
+  if (!_open || !_writable || FS::mock_failWrites)
+    return 0;
+  std::vector<uint8_t> &data = FS::mock_files()[_path];
+  if (_pos > data.size())
+    _pos = data.size();
+  if (_pos + len > data.size())
+    data.resize(_pos + len);
+  memcpy(data.data() + _pos, buf, len);
+  _pos += len;
+  return len;
+}
+
+size_t fs::File::read(uint8_t *buf, size_t len) {
+  if (!_open || _dir)
+    return 0;
+  auto it = FS::mock_files().find(_path);
+  if (it == FS::mock_files().end() || _pos >= it->second.size())
+    return 0;
+  size_t n = std::min(len, it->second.size() - _pos);
+  memcpy(buf, it->second.data() + _pos, n);
+  _pos += n;
+  return n;
+}
+
+bool fs::File::seek(uint32_t pos, SeekMode mode) {
+  if (!_open)
+    return false;
+  size_t base = mode == SeekSet ? 0 : mode == SeekCur ? _pos : size();
+  if (base + pos > size())
+    return false;
+  _pos = base + pos;
+  return true;
+}
+
+size_t fs::File::size() const {
+  auto it = FS::mock_files().find(_path);
+  return it == FS::mock_files().end() ? 0 : it->second.size();
+}
+
+const char *fs::File::name() const {
+  size_t slash = _path.rfind('/');
+  return _path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+}
+
+fs::File fs::File::openNextFile() {
+  File f;
+  while (_dir && _next < _children.size()) {
+    const std::string &p = _children[_next++];
+    if (FS::mock_files().count(p)) {
+      f._path = p;
+      f._open = true;
+      break;
+    }
+  }
+  return f;
+}
+
+// ---- FS ----
+
+fs::File fs::FS::open(const char *path, const char *mode, const bool create) {
+  File f;
+  std::string p(path);
+  if (_dirs().count(p)) {
+    f._path = p;
+    f._open = true;
+    f._dir = true;
+    std::string prefix = p + "/";
+    for (auto &kv : mock_files()) {
+      if (kv.first.compare(0, prefix.size(), prefix) == 0 &&
+          kv.first.find('/', prefix.size()) == std::string::npos)
+        f._children.push_back(kv.first);
+    }
+    return f;
+  }
+
+  auto it = mock_files().find(p);
+  if (mode[0] == 'r') {
+    if (it == mock_files().end())
+      return f;
+  } else if (mode[0] == 'w') {
+    mock_files()[p].clear();
+  } else {
+    mock_files()[p]; // Append creates
+  }
+  f._path = p;
+  f._open = true;
+  f._writable = mode[0] != 'r';
+  f._pos = mode[0] == 'a' ? mock_files()[p].size() : 0;
+  return f;
+}
+
+bool fs::FS::exists(const char *path) {
+  return mock_files().count(path) || _dirs().count(path);
+}
+
+bool fs::FS::remove(const char *path) {
+  return mock_files().erase(path) > 0;
+}
+
+bool fs::FS::rename(const char *from, const char *to) {
+  auto it = mock_files().find(from);
+  if (it == mock_files().end())
+    return false;
+  mock_files()[to] = it->second;
+  mock_files().erase(from);
+  return true;
+}
+
+bool fs::FS::mkdir(const char *path) {
+  _dirs().insert(path);
+  return true;
+}
+
+bool fs::FS::rmdir(const char *path) { return _dirs().erase(path) > 0; }
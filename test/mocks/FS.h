@@ -0,0 +1,79 @@
+#pragma once
+// ============================================================================
+// FS.h Mock for Native Unit Tests
+// In-memory flat file store with the subset of the ESP32 fs::FS / fs::File
+// API the firmware uses. Writes land immediately (no caching), so tests can
+// corrupt or truncate a file through mock_files() to simulate power loss.
+// ============================================================================
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+namespace fs {
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+class File {
+public:
+  File() {}
+
+  operator bool() const { return _open; }
+  size_t write(const uint8_t *buf, size_t len);
+  size_t read(uint8_t *buf, size_t len);
+  bool seek(uint32_t pos, SeekMode mode = SeekSet);
+  size_t position() const { return _pos; }
+  size_t size() const;
+  void flush() {}
+  void close() { _open = false; }
+
+  bool isDirectory() const { return _dir; }
+  const char *path() const { return _path.c_str(); }
+  const char *name() const; // Basename, as in arduino-esp32 2.x
+  File openNextFile();
+
+private:
+  friend class FS;
+  std::string _path;
+  bool _open = false;
+  bool _dir = false;
+  bool _writable = false;
+  size_t _pos = 0;
+  std::vector<std::string> _children;
+  size_t _next = 0;
+};
+
+class FS {
+public:
+  File open(const char *path, const char *mode = FILE_READ,
+            const bool create = false);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+  bool mkdir(const char *path);
+  bool rmdir(const char *path);
+
+  // ---- Test helpers ----
+  static std::map<std::string, std::vector<uint8_t>> &mock_files();
+  static void mock_clear();
+  static bool mock_failWrites; // write() returns 0 while set
+
+private:
+  static std::set<std::string> &_dirs();
+};
+
+} // namespace fs
+
+using fs::File;
+using fs::FS;
+using fs::SeekCur;
+using fs::SeekEnd;
+using fs::SeekMode;
+using fs::SeekSet;
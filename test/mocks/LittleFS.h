@@ -0,0 +1,14 @@
+#pragma once
+// ============================================================================
+// LittleFS.h Mock for Native Unit Tests
+// ============================================================================
+
+#include "FS.h"
+
+class LittleFSFS : public fs::FS {
+public:
+  bool begin(bool formatOnFail = false) { return true; }
+  void end() {}
+};
+
+extern LittleFSFS LittleFS;
@@ -3,8 +3,11 @@
 
 std::map<std::string, Preferences::MockValue> Preferences::_store;
 std::map<std::string, std::string> Preferences::_strStore;
+std::map<std::string, std::vector<uint8_t>> Preferences::_bytesStore;
+uint32_t Preferences::mock_writeCount = 0;
 
 void Preferences::putString(const char *key, const String &val) {
+  mock_writeCount++;
   _strStore[_makeKey(key)] = val.c_str();
 }
 
@@ -8,6 +8,7 @@
 #include <cstring>
 #include <map>
 #include <string>
+#include <vector>
 
 #include "Arduino.h"
 
@@ -18,16 +19,36 @@ public:
 
   // ---- Write ----
   void putUInt(const char *key, uint32_t val) {
+    mock_writeCount++;
     _store[_makeKey(key)].u32 = val;
   }
-  void putFloat(const char *key, float val) { _store[_makeKey(key)].f = val; }
+  void putFloat(const char *key, float val) {
+    mock_writeCount++;
+    _store[_makeKey(key)].f = val;
+  }
   void putUChar(const char *key, uint8_t val) {
+    mock_writeCount++;
     _store[_makeKey(key)].u8 = val;
   }
+  void putUShort(const char *key, uint16_t val) {
+    mock_writeCount++;
+    _store[_makeKey(key)].u16 = val;
+  }
   void putString(const char *key, const char *val) {
+    mock_writeCount++;
     _strStore[_makeKey(key)] = val ? val : "";
   }
   void putString(const char *key, const String &val);
+  size_t putBytes(const char *key, const void *val, size_t len) {
+    mock_writeCount++;
+    const uint8_t *p = static_cast<const uint8_t *>(val);
+    _bytesStore[_makeKey(key)].assign(p, p + len);
+    return len;
+  }
+  bool remove(const char *key) {
+    std::string k = _makeKey(key);
+    return (_store.erase(k) + _strStore.erase(k) + _bytesStore.erase(k)) > 0;
+  }
 
   // ---- Read ----
   uint32_t getUInt(const char *key, uint32_t defaultVal = 0) {
@@ -42,14 +63,42 @@ public:
     auto it = _store.find(_makeKey(key));
     return (it != _store.end()) ? it->second.u8 : defaultVal;
   }
+  uint16_t getUShort(const char *key, uint16_t defaultVal = 0) {
+    auto it = _store.find(_makeKey(key));
+    return (it != _store.end()) ? it->second.u16 : defaultVal;
+  }
   String getString(const char *key, const String &defaultVal = String());
   String getString(const char *key, const char *defaultVal);
+  size_t getBytesLength(const char *key) {
+    auto it = _bytesStore.find(_makeKey(key));
+    return (it != _bytesStore.end()) ? it->second.size() : 0;
+  }
+  size_t getBytes(const char *key, void *buf, size_t maxLen) {
+    auto it = _bytesStore.find(_makeKey(key));
+    if (it == _bytesStore.end() || it->second.size() > maxLen)
+      return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+  bool isKey(const char *key) {
+    std::string k = _makeKey(key);
+    return _store.count(k) || _strStore.count(k) || _bytesStore.count(k);
+  }
 
   // ---- Mock control ----
   static void mock_clearAll() {
     _store.clear();
     _strStore.clear();
+    _bytesStore.clear();
+    mock_writeCount = 0;
+  }
+  /// Raw access to a stored blob (corruption tests)
+  static std::vector<uint8_t> *mock_bytes(const char *ns, const char *key) {
+    auto it = _bytesStore.find(std::string(ns) + "." + key);
+    return (it != _bytesStore.end()) ? &it->second : nullptr;
   }
+  /// Number of put*() calls since mock_clearAll()
+  static uint32_t mock_writeCount;
 
 private:
   std::string _namespace;
@@ -58,11 +107,13 @@ private:
     uint32_t u32;
     float f;
     uint8_t u8;
+    uint16_t u16;
     MockValue() : u32(0) {}
   };
 
   static std::map<std::string, MockValue> _store;
   static std::map<std::string, std::string> _strStore;
+  static std::map<std::string, std::vector<uint8_t>> _bytesStore;
 
   std::string _makeKey(const char *key) { return _namespace + "." + key; }
 };
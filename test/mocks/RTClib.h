@@ -70,6 +70,18 @@ public:
   uint8_t second() const { return _second; }
   uint8_t dayOfTheWeek() const { return _dayOfWeek; }
 
+  uint32_t unixtime() const {
+    uint32_t days = 0;
+    for (uint16_t y = 1970; y < _year; y++)
+      days += (y % 4 == 0) ? 366 : 365;
+    static const uint8_t daysInMonth[] = {31, 28, 31, 30, 31, 30,
+                                          31, 31, 30, 31, 30, 31};
+    for (uint8_t m = 1; m < _month; m++)
+      days += daysInMonth[m - 1] + (m == 2 && _year % 4 == 0 ? 1 : 0);
+    days += _day - 1;
+    return ((days * 24 + _hour) * 60 + _minute) * 60UL + _second;
+  }
+
 private:
   uint16_t _year;
   uint8_t _month, _day, _hour, _minute, _second, _dayOfWeek;
@@ -1,2 +1,87 @@
 #include "Wire.h"
-MockWire Wire;
+#include <cstring>
+
+TwoWire Wire;
+
+uint8_t TwoWire::mock_eeprom[TwoWire::MOCK_EEPROM_SIZE];
+uint32_t TwoWire::mock_eepromPageWrites[TwoWire::MOCK_EEPROM_SIZE / 32];
+bool TwoWire::mock_eepromPresent = false;
+bool TwoWire::mock_eepromFailWrites = false;
+uint16_t TwoWire::_ptr = 0;
+uint8_t TwoWire::mock_pca[TwoWire::MOCK_PCA_CHIPS][256];
+uint32_t TwoWire::mock_pcaWrites = 0;
+bool TwoWire::mock_pcaPresent = false;
+
+void TwoWire::mock_resetEeprom() {
+  memset(mock_eeprom, 0xFF, sizeof(mock_eeprom));
+  memset(mock_eepromPageWrites, 0, sizeof(mock_eepromPageWrites));
+  mock_eepromPresent = true;
+  mock_eepromFailWrites = false;
+  _ptr = 0;
+}
+
+void TwoWire::mock_resetPca() {
+  memset(mock_pca, 0, sizeof(mock_pca));
+  mock_pcaWrites = 0;
+  mock_pcaPresent = true;
+}
+
+uint16_t TwoWire::mock_pcaLevel(uint8_t ch) {
+  const uint8_t *r = mock_pca[ch / 16] + 6 + 4 * (ch % 16);
+  if (r[3] & 0x10)
+    return 0;
+  if (r[1] & 0x10)
+    return 4096;
+  return ((r[3] & 0x0F) << 8) | r[2];
+}
+
+uint8_t TwoWire::endTransmission(bool sendStop) {
+  if (_txAddr >= MOCK_PCA_ADDR && _txAddr < MOCK_PCA_ADDR + MOCK_PCA_CHIPS) {
+    if (!mock_pcaPresent)
+      return 2;
+    if (_tx.size() < 2)
+      return 0;
+    uint8_t *regs = mock_pca[_txAddr - MOCK_PCA_ADDR];
+    uint8_t reg = _tx[0];
+    for (size_t i = 1; i < _tx.size(); i++) {
+      regs[reg] = _tx[i];
+      if (reg >= 0xFA && reg <= 0xFD) // ALL_LED_*: broadcast to LEDn
+        for (uint8_t o = 0; o < 16; o++)
+          regs[6 + 4 * o + (reg - 0xFA)] = _tx[i];
+      if (regs[0] & 0x20) // MODE1.AI
+        reg++;
+    }
+    mock_pcaWrites++;
+    return 0;
+  }
+  if (_txAddr != MOCK_EEPROM_ADDR || !mock_eepromPresent)
+    return 2; // NACK on address
+  if (_tx.size() < 2)
+    return 0; // Probe / ack poll
+  uint16_t addr = ((_tx[0] << 8) | _tx[1]) % MOCK_EEPROM_SIZE;
+  size_t len = _tx.size() - 2;
+  if (len == 0) {
+    _ptr = addr; // Dummy write before a random read
+    return 0;
+  }
+  if (mock_eepromFailWrites)
+    return 3; // NACK on data
+  uint16_t page = addr & ~31;
+  for (size_t i = 0; i < len; i++)
+    mock_eeprom[page + ((addr - page + i) & 31)] = _tx[2 + i];
+  mock_eepromPageWrites[page / 32]++;
+  _ptr = page + ((addr - page + len) & 31);
+  return 0;
+}
+
+uint8_t TwoWire::requestFrom(uint16_t addr, uint8_t len, bool sendStop) {
+  _rx.clear();
+  _rxPos = 0;
+  if (addr != MOCK_EEPROM_ADDR || !mock_eepromPresent)
+    return 0;
+  for (uint8_t i = 0; i < len; i++) {
+    _rx.push_back(mock_eeprom[_ptr]);
+    _ptr = (_ptr + 1) % MOCK_EEPROM_SIZE;
+  }
+  return len;
+}
@@ -1,12 +1,65 @@
 #pragma once
 // ============================================================================
 // Wire.h Mock for Native Unit Tests
+// Emulates an AT24C32 EEPROM at 0x57 (2-byte address, 32-byte pages that
+// wrap in-page, sequential reads) and two PCA9685 PWM expanders at
+// 0x40/0x41 (register writes, auto-increment). Every other address NACKs.
 // ============================================================================
 
-class MockWire {
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TwoWire {
 public:
   void begin() {}
   void begin(int sda, int scl) {}
+  void setClock(uint32_t hz) {}
+
+  void beginTransmission(uint16_t addr) {
+    _txAddr = addr;
+    _tx.clear();
+  }
+  size_t write(uint8_t b) {
+    _tx.push_back(b);
+    return 1;
+  }
+  size_t write(const uint8_t *buf, size_t len) {
+    _tx.insert(_tx.end(), buf, buf + len);
+    return len;
+  }
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint16_t addr, uint8_t len, bool sendStop = true);
+  int available() const { return (int)(_rx.size() - _rxPos); }
+  int read() { return _rxPos < _rx.size() ? _rx[_rxPos++] : -1; }
+
+  // ---- AT24C32 emulation ----
+  static constexpr uint16_t MOCK_EEPROM_ADDR = 0x57;
+  static constexpr uint16_t MOCK_EEPROM_SIZE = 4096;
+  static uint8_t mock_eeprom[MOCK_EEPROM_SIZE];
+  static uint32_t mock_eepromPageWrites[MOCK_EEPROM_SIZE / 32];
+  static bool mock_eepromPresent;
+  static bool mock_eepromFailWrites; // Data writes NACK while set
+  static void mock_resetEeprom();    // Blank (0xFF), present, counts 0
+
+  // ---- PCA9685 emulation ----
+  static constexpr uint16_t MOCK_PCA_ADDR = 0x40;
+  static constexpr uint8_t MOCK_PCA_CHIPS = 2;
+  static uint8_t mock_pca[MOCK_PCA_CHIPS][256]; // Register files
+  static uint32_t mock_pcaWrites;               // Register-write transactions
+  static bool mock_pcaPresent;
+  static void mock_resetPca(); // Registers 0, present, count 0
+  /// Output level of expander channel ch: 0 (full off) .. 4096 (full on)
+  static uint16_t mock_pcaLevel(uint8_t ch);
+
+private:
+  uint16_t _txAddr = 0;
+  std::vector<uint8_t> _tx;
+  std::vector<uint8_t> _rx;
+  size_t _rxPos = 0;
+  static uint16_t _ptr;
 };
 
-extern MockWire Wire;
+typedef TwoWire MockWire;
+
+extern TwoWire Wire;
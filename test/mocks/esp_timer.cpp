@@ -0,0 +1,112 @@
+#include "esp_timer.h"
+#include "Arduino.h"
+
+struct mock_esp_timer {
+  esp_timer_cb_t callback;
+  void *arg;
+  bool active;
+  bool periodic;
+  uint64_t periodUs;
+  int64_t deadlineUs;
+};
+
+int64_t mock_esp_timer_extra_us = 0;
+
+static const int MOCK_MAX_TIMERS = 32;
+static mock_esp_timer *mock_timers[MOCK_MAX_TIMERS] = {nullptr};
+
+int64_t esp_timer_get_time() {
+  return (int64_t)mock_millis_value * 1000 + mock_esp_timer_extra_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                           esp_timer_handle_t *out_handle) {
+  if (!args || !args->callback || !out_handle)
+    return ESP_ERR_INVALID_ARG;
+  for (int i = 0; i < MOCK_MAX_TIMERS; i++) {
+    if (!mock_timers[i]) {
+      mock_timers[i] = new mock_esp_timer{args->callback, args->arg, false,
+                                          false, 0, 0};
+      *out_handle = mock_timers[i];
+      return ESP_OK;
+    }
+  }
+  return ESP_FAIL;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us) {
+  if (!timer)
+    return ESP_ERR_INVALID_ARG;
+  if (timer->active)
+    return ESP_ERR_INVALID_STATE;
+  timer->active = true;
+  timer->periodic = false;
+  timer->deadlineUs = esp_timer_get_time() + (int64_t)timeout_us;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer,
+                                   uint64_t period_us) {
+  if (!timer)
+    return ESP_ERR_INVALID_ARG;
+  if (timer->active)
+    return ESP_ERR_INVALID_STATE;
+  timer->active = true;
+  timer->periodic = true;
+  timer->periodUs = period_us;
+  timer->deadlineUs = esp_timer_get_time() + (int64_t)period_us;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer)
+    return ESP_ERR_INVALID_ARG;
+  if (!timer->active)
+    return ESP_ERR_INVALID_STATE;
+  timer->active = false;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer) {
+  if (!timer)
+    return ESP_ERR_INVALID_ARG;
+  for (int i = 0; i < MOCK_MAX_TIMERS; i++) {
+    if (mock_timers[i] == timer) {
+      mock_timers[i] = nullptr;
+      delete timer;
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_INVALID_ARG;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer) {
+  return timer && timer->active;
+}
+
+int mock_esp_timer_run_due() {
+  int fired = 0;
+  int64_t now = esp_timer_get_time();
+  for (int i = 0; i < MOCK_MAX_TIMERS; i++) {
+    mock_esp_timer *t = mock_timers[i];
+    if (!t || !t->active || t->deadlineUs > now)
+      continue;
+    if (t->periodic) {
+      t->deadlineUs += (int64_t)t->periodUs;
+    } else {
+      t->active = false;
+    }
+    t->callback(t->arg);
+    fired++;
+  }
+  return fired;
+}
+
+int mock_esp_timer_active_count() {
+  int n = 0;
+  for (int i = 0; i < MOCK_MAX_TIMERS; i++) {
+    if (mock_timers[i] && mock_timers[i]->active)
+      n++;
+  }
+  return n;
+}
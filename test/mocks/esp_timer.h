@@ -0,0 +1,49 @@
+#pragma once
+// ============================================================================
+// esp_timer.h Mock for Native Unit Tests
+// Timers never fire on their own: tests call mock_esp_timer_run_due() after
+// advancing mock_millis_value to dispatch any callback whose deadline passed.
+// ============================================================================
+
+#include <cstdint>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_INVALID_ARG 0x102
+#define ESP_ERR_INVALID_STATE 0x103
+#endif
+
+typedef void (*esp_timer_cb_t)(void *arg);
+typedef struct mock_esp_timer *esp_timer_handle_t;
+
+typedef enum { ESP_TIMER_TASK = 0 } esp_timer_dispatch_t;
+
+typedef struct {
+  esp_timer_cb_t callback;
+  void *arg;
+  esp_timer_dispatch_t dispatch_method;
+  const char *name;
+  bool skip_unhandled_events;
+} esp_timer_create_args_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args,
+                           esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer,
+                                   uint64_t period_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+bool esp_timer_is_active(esp_timer_handle_t timer);
+
+/// Microseconds since boot: mock_millis_value * 1000 + mock_esp_timer_extra_us
+int64_t esp_timer_get_time();
+
+// ---- Mock control ----
+extern int64_t mock_esp_timer_extra_us;
+/// Fire every armed timer whose deadline is <= esp_timer_get_time().
+/// Returns the number of callbacks dispatched.
+int mock_esp_timer_run_due();
+/// Number of timers currently armed
+int mock_esp_timer_active_count();
@@ -0,0 +1,219 @@
+// ============================================================================
+// ActuatorJobs Unit Tests
+// Tests: start returns at once with the output on, timer stop with measured
+//        on-time, completion delivered once, busy target and full table
+//        refused, switch-on refused by the output, jobs stopped in deadline
+//        order, poll() fallback when the timer is late
+// ============================================================================
+
+#include "ActuatorJobs.h"
+#include "Arduino.h"
+#include <esp_timer.h>
+#include <unity.h>
+
+// Output recorder: on/off state per (target, index) and switch count;
+// refuseOn makes it turn switch-ons down
+static bool pinOn[64];
+static bool fertOn[64];
+static int switches;
+static bool refuseOn;
+static bool recordSwitch(JobTarget target, uint8_t index, bool on, void *) {
+  if (on && refuseOn)
+    return false;
+  if (target == JobTarget::PIN)
+    pinOn[index] = on;
+  else
+    fertOn[index] = on;
+  switches++;
+  return true;
+}
+
+// Completion recorder
+static int doneCalls;
+static ActuatorJobs::Job doneJob;
+static void recordDone(const ActuatorJobs::Job &job, void *) {
+  doneCalls++;
+  doneJob = job;
+}
+
+static void setupJobs(ActuatorJobs &jobs) {
+  jobs.setSwitch(recordSwitch, nullptr);
+  jobs.setDoneCallback(recordDone, nullptr);
+}
+
+void setUp() {
+  mock_millis_value = 1000;
+  mock_esp_timer_extra_us = 0;
+  memset(pinOn, 0, sizeof(pinOn));
+  memset(fertOn, 0, sizeof(fertOn));
+  switches = 0;
+  refuseOn = false;
+  doneCalls = 0;
+  doneJob = {};
+}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Timed runs
+// ----------------------------------------------------------------------------
+
+void test_start_returns_with_output_on() {
+  ActuatorJobs jobs;
+  setupJobs(jobs);
+  uint32_t id = jobs.start(JobTarget::PIN, PIN_DRAIN, 3000);
+  TEST_ASSERT_NOT_EQUAL(0, id);
+  TEST_ASSERT_TRUE(pinOn[PIN_DRAIN]);
+  TEST_ASSERT_TRUE(jobs.isRunning(JobTarget::PIN, PIN_DRAIN));
+  TEST_ASSERT_EQUAL_UINT8(1, jobs.getRunningCount());
+  TEST_ASSERT_EQUAL(1, mock_esp_timer_active_count());
+
+  // Not due yet: nothing stops
+  mock_millis_value += 2999;
+  TEST_ASSERT_EQUAL(0, mock_esp_timer_run_due());
+  jobs.poll();
+  TEST_ASSERT_TRUE(pinOn[PIN_DRAIN]);
+  TEST_ASSERT_EQUAL(0, doneCalls);
+}
+
+void test_timer_stops_and_measures_on_time() {
+  ActuatorJobs jobs;
+  setupJobs(jobs);
+  uint32_t id = jobs.start(JobTarget::FERT, 2, 3000);
+
+  // The timer fires 2 ms late: the measured time shows it
+  mock_millis_value += 3002;
+  TEST_ASSERT_EQUAL(1, mock_esp_timer_run_due());
+  TEST_ASSERT_FALSE(fertOn[2]);
+  TEST_ASSERT_FALSE(jobs.isRunning(JobTarget::FERT, 2));
+  TEST_ASSERT_EQUAL(0, mock_esp_timer_active_count());
+
+  // Delivered by poll(), once
+  TEST_ASSERT_EQUAL(0, doneCalls);
+  jobs.poll();
+  TEST_ASSERT_EQUAL(1, doneCalls);
+  TEST_ASSERT_EQUAL_UINT32(id, doneJob.id);
+  TEST_ASSERT_TRUE(doneJob.target == JobTarget::FERT);
+  TEST_ASSERT_EQUAL_UINT8(2, doneJob.index);
+  TEST_ASSERT_EQUAL_UINT32(3000, doneJob.plannedMs);
+  TEST_ASSERT_EQUAL_UINT32(3002000, doneJob.actualUs);
+  jobs.poll();
+  TEST_ASSERT_EQUAL(1, doneCalls);
+  TEST_ASSERT_EQUAL(2, switches);
+}
+
+// ----------------------------------------------------------------------------
+// Admission
+// ----------------------------------------------------------------------------
+
+void test_busy_target_and_full_table_refused() {
+  ActuatorJobs jobs;
+  TEST_ASSERT_EQUAL_UINT32(0, jobs.start(JobTarget::PIN, PIN_DRAIN, 3000));
+  setupJobs(jobs);
+
+  uint32_t first = jobs.start(JobTarget::PIN, PIN_DRAIN, 3000);
+  TEST_ASSERT_NOT_EQUAL(0, first);
+  TEST_ASSERT_EQUAL_UINT32(0, jobs.start(JobTarget::PIN, PIN_DRAIN, 3000));
+  // Same index on the other target is a different output
+  uint32_t fert = jobs.start(JobTarget::FERT, PIN_DRAIN, 3000);
+  TEST_ASSERT_NOT_EQUAL(0, fert);
+  TEST_ASSERT_NOT_EQUAL(first, fert);
+
+  for (uint8_t ch = 0; ch < ACTUATOR_JOB_SLOTS - 2; ch++)
+    TEST_ASSERT_NOT_EQUAL(0, jobs.start(JobTarget::FERT, ch, 3000));
+  TEST_ASSERT_EQUAL_UINT32(0, jobs.start(JobTarget::PIN, PIN_REFILL, 3000));
+
+  // A finished job frees its target and slot once delivered
+  mock_millis_value += 3000;
+  mock_esp_timer_run_due();
+  TEST_ASSERT_EQUAL_UINT32(0, jobs.start(JobTarget::PIN, PIN_REFILL, 3000));
+  jobs.poll();
+  TEST_ASSERT_EQUAL(ACTUATOR_JOB_SLOTS, doneCalls);
+  uint32_t again = jobs.start(JobTarget::PIN, PIN_DRAIN, 3000);
+  TEST_ASSERT_NOT_EQUAL(0, again);
+  TEST_ASSERT_NOT_EQUAL(first, again);
+}
+
+void test_refused_switch_on_frees_slot() {
+  ActuatorJobs jobs;
+  setupJobs(jobs);
+
+  // Output owned elsewhere (channel dosing): no job, nothing armed
+  refuseOn = true;
+  TEST_ASSERT_EQUAL_UINT32(0, jobs.start(JobTarget::FERT, 2, 3000));
+  TEST_ASSERT_FALSE(jobs.isRunning(JobTarget::FERT, 2));
+  TEST_ASSERT_EQUAL(0, jobs.getRunningCount());
+  TEST_ASSERT_EQUAL(0, mock_esp_timer_active_count());
+  jobs.poll();
+  TEST_ASSERT_EQUAL(0, doneCalls);
+
+  refuseOn = false;
+  TEST_ASSERT_NOT_EQUAL(0, jobs.start(JobTarget::FERT, 2, 3000));
+  TEST_ASSERT_TRUE(fertOn[2]);
+}
+
+// ----------------------------------------------------------------------------
+// Scheduling
+// ----------------------------------------------------------------------------
+
+void test_jobs_stop_in_deadline_order() {
+  ActuatorJobs jobs;
+  setupJobs(jobs);
+  jobs.start(JobTarget::PIN, PIN_DRAIN, 3000);
+  mock_millis_value += 1000;
+  jobs.start(JobTarget::PIN, PIN_REFILL, 500);
+
+  // Refill is due first; the timer is re-armed for the drain
+  mock_millis_value += 500;
+  TEST_ASSERT_EQUAL(1, mock_esp_timer_run_due());
+  TEST_ASSERT_FALSE(pinOn[PIN_REFILL]);
+  TEST_ASSERT_TRUE(pinOn[PIN_DRAIN]);
+  TEST_ASSERT_EQUAL(1, mock_esp_timer_active_count());
+  jobs.poll();
+  TEST_ASSERT_EQUAL(1, doneCalls);
+  TEST_ASSERT_EQUAL_UINT32(500000, doneJob.actualUs);
+
+  mock_millis_value += 1500;
+  TEST_ASSERT_EQUAL(1, mock_esp_timer_run_due());
+  TEST_ASSERT_FALSE(pinOn[PIN_DRAIN]);
+  jobs.poll();
+  TEST_ASSERT_EQUAL(2, doneCalls);
+  TEST_ASSERT_EQUAL_UINT32(3000000, doneJob.actualUs);
+}
+
+void test_poll_stops_when_timer_late() {
+  ActuatorJobs jobs;
+  setupJobs(jobs);
+  jobs.start(JobTarget::FERT, 0, 3000);
+
+  // Timer task starved: poll() from the loop stops the pump
+  mock_millis_value += 3100;
+  jobs.poll();
+  TEST_ASSERT_FALSE(fertOn[0]);
+  TEST_ASSERT_EQUAL(1, doneCalls);
+  TEST_ASSERT_EQUAL_UINT32(3100000, doneJob.actualUs);
+
+  // The timer firing afterwards finds nothing to stop
+  mock_esp_timer_run_due();
+  TEST_ASSERT_EQUAL(2, switches);
+  jobs.poll();
+  TEST_ASSERT_EQUAL(1, doneCalls);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Timed runs
+  RUN_TEST(test_start_returns_with_output_on);
+  RUN_TEST(test_timer_stops_and_measures_on_time);
+
+  // Admission
+  RUN_TEST(test_busy_target_and_full_table_refused);
+  RUN_TEST(test_refused_switch_on_frees_slot);
+
+  // Scheduling
+  RUN_TEST(test_jobs_stop_in_deadline_order);
+  RUN_TEST(test_poll_stops_when_timer_late);
+
+  return UNITY_END();
+}
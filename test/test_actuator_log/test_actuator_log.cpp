@@ -0,0 +1,209 @@
+// ============================================================================
+// ActuatorLog Unit Tests
+// Tests: edge accounting (on-time, cycles, repeated writes, active-LOW
+//        canister, non-actuator pins), run history, running stretch,
+//        LEDC pump outputs, persistence (EEPROM, NVS fallback, interval)
+// ============================================================================
+
+#include "ActuatorLog.h"
+#include "Arduino.h"
+#include "CounterStore.h"
+#include "PumpOutput.h"
+#include <Wire.h>
+#include <esp_timer.h>
+#include <unity.h>
+
+static const uint8_t DRAIN = 5;    // Index of PIN_DRAIN in OUTPUT_PINS
+static const uint8_t CANISTER = 8; // Index of PIN_CANISTER
+
+void setUp() {
+  mock_reset_pins();
+  mock_millis_value = 0;
+  mock_esp_timer_extra_us = 0;
+  Preferences::mock_clearAll();
+  TwoWire::mock_resetEeprom();
+}
+
+void tearDown() {}
+
+// Run the drain pump for ms starting now
+static void runDrain(uint32_t ms) {
+  ActuatorLog::write(PIN_DRAIN, HIGH);
+  mock_millis_value += ms;
+  ActuatorLog::write(PIN_DRAIN, LOW);
+}
+
+// ----------------------------------------------------------------------------
+// Edge accounting
+// ----------------------------------------------------------------------------
+
+void test_edges_accumulate_on_time_and_cycles() {
+  ActuatorLog log;
+  TEST_ASSERT_EQUAL_INT8(DRAIN, ActuatorLog::indexOf(PIN_DRAIN));
+  runDrain(1500);
+  mock_millis_value += 1000;
+  runDrain(500);
+
+  ActuatorLog::Stats s = log.getStats(DRAIN);
+  TEST_ASSERT_FALSE(s.on);
+  TEST_ASSERT_EQUAL_UINT32(2, s.cycles);
+  TEST_ASSERT_EQUAL_UINT32(2000, (uint32_t)s.onMs);
+  TEST_ASSERT_EQUAL_UINT8(2, s.recent);
+  TEST_ASSERT_EQUAL_UINT32(500, s.recentMs[0]); // Newest first
+  TEST_ASSERT_EQUAL_UINT32(1500, s.recentMs[1]);
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_DRAIN]); // Pin really written
+}
+
+void test_repeated_writes_are_not_edges() {
+  ActuatorLog log;
+  ActuatorLog::write(PIN_REFILL, LOW); // Already off
+  ActuatorLog::write(PIN_REFILL, HIGH);
+  mock_millis_value = 100;
+  ActuatorLog::write(PIN_REFILL, HIGH);
+  mock_millis_value = 300;
+  ActuatorLog::write(PIN_REFILL, LOW);
+  ActuatorLog::write(PIN_REFILL, LOW);
+
+  ActuatorLog::Stats s = log.getStats(ActuatorLog::indexOf(PIN_REFILL));
+  TEST_ASSERT_EQUAL_UINT32(1, s.cycles);
+  TEST_ASSERT_EQUAL_UINT32(300, (uint32_t)s.onMs);
+}
+
+void test_canister_is_active_low() {
+  ActuatorLog log;
+  ActuatorLog::write(PIN_CANISTER, LOW); // SSR: LOW = ON
+  TEST_ASSERT_TRUE(log.getStats(CANISTER).on);
+  mock_millis_value = 4000;
+  ActuatorLog::write(PIN_CANISTER, HIGH);
+  ActuatorLog::Stats s = log.getStats(CANISTER);
+  TEST_ASSERT_FALSE(s.on);
+  TEST_ASSERT_EQUAL_UINT32(4000, (uint32_t)s.onMs);
+}
+
+void test_other_pins_only_written() {
+  ActuatorLog log;
+  TEST_ASSERT_EQUAL_INT8(-1, ActuatorLog::indexOf(PIN_TRIG));
+  ActuatorLog::write(PIN_TRIG, HIGH);
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_TRIG]);
+  for (uint8_t i = 0; i < NUM_OUTPUT_PINS; i++)
+    TEST_ASSERT_EQUAL_UINT32(0, log.getStats(i).cycles);
+}
+
+// ----------------------------------------------------------------------------
+// History and running stretch
+// ----------------------------------------------------------------------------
+
+void test_history_keeps_newest_runs() {
+  ActuatorLog log;
+  for (uint32_t n = 1; n <= ACTUATOR_HISTORY + 3; n++)
+    runDrain(n * 100);
+
+  ActuatorLog::Stats s = log.getStats(DRAIN);
+  TEST_ASSERT_EQUAL_UINT8(ACTUATOR_HISTORY, s.recent);
+  TEST_ASSERT_EQUAL_UINT32((ACTUATOR_HISTORY + 3) * 100, s.recentMs[0]);
+  TEST_ASSERT_EQUAL_UINT32(400, s.recentMs[ACTUATOR_HISTORY - 1]);
+  // Runs getting longer: recent average above the lifetime one
+  TEST_ASSERT_TRUE(s.recentAvgMs() > s.lifetimeAvgMs());
+  TEST_ASSERT_EQUAL_UINT32(600, s.lifetimeAvgMs()); // (100 + ... + 1100) / 11
+}
+
+void test_running_stretch_counts_in_totals_only() {
+  ActuatorLog log;
+  runDrain(1000);
+  ActuatorLog::write(PIN_DRAIN, HIGH);
+  mock_millis_value += 250;
+
+  ActuatorLog::Stats s = log.getStats(DRAIN);
+  TEST_ASSERT_TRUE(s.on);
+  TEST_ASSERT_EQUAL_UINT32(250, s.currentMs);
+  TEST_ASSERT_EQUAL_UINT32(1250, (uint32_t)s.onMs);
+  TEST_ASSERT_EQUAL_UINT32(2, s.cycles);
+  TEST_ASSERT_EQUAL_UINT32(1000, s.lifetimeAvgMs()); // Finished runs only
+  TEST_ASSERT_EQUAL_UINT8(1, s.recent);
+}
+
+void test_ledc_pump_duty_is_accounted() {
+  ActuatorLog log;
+  LedcPumpOutput out;
+  out.begin(NUM_FERTS + 1);
+  out.set(1, 128); // Any duty above 0 is on
+  mock_millis_value = 700;
+  out.set(1, 0);
+  out.set(NUM_FERTS, 255); // Prime
+  TEST_ASSERT_EQUAL_UINT32(700, (uint32_t)log.getStats(1).onMs);
+  TEST_ASSERT_TRUE(log.getStats(ActuatorLog::indexOf(PIN_PRIME)).on);
+}
+
+// ----------------------------------------------------------------------------
+// Persistence
+// ----------------------------------------------------------------------------
+
+void test_totals_survive_reboot_in_eeprom() {
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    ActuatorLog log;
+    log.setCounterStore(&cs);
+    log.begin();
+    runDrain(3000);
+    log.save();
+  }
+  Preferences::mock_writeCount = 0;
+
+  mock_millis_value = 0;
+  CounterStore cs;
+  cs.begin(Wire);
+  ActuatorLog log;
+  log.setCounterStore(&cs);
+  runDrain(1000); // Before begin(): boot-time switching is kept
+  log.begin();
+  ActuatorLog::Stats s = log.getStats(DRAIN);
+  TEST_ASSERT_EQUAL_UINT32(4000, (uint32_t)s.onMs);
+  TEST_ASSERT_EQUAL_UINT32(2, s.cycles);
+  TEST_ASSERT_EQUAL_UINT8(1, s.recent); // History is RAM only
+  TEST_ASSERT_EQUAL(0, Preferences::mock_writeCount);
+}
+
+void test_nvs_fallback_and_save_interval() {
+  TwoWire::mock_eepromPresent = false;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    ActuatorLog log;
+    log.setCounterStore(&cs);
+    log.begin();
+    runDrain(2000);
+
+    Preferences::mock_writeCount = 0;
+    log.update(); // Interval not reached
+    TEST_ASSERT_EQUAL(0, Preferences::mock_writeCount);
+    mock_millis_value += ACTUATOR_SAVE_INTERVAL_MS;
+    log.update();
+    TEST_ASSERT_EQUAL(1, Preferences::mock_writeCount);
+  }
+
+  ActuatorLog log;
+  log.begin();
+  TEST_ASSERT_EQUAL_UINT32(2000, (uint32_t)log.getStats(DRAIN).onMs);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Edge accounting
+  RUN_TEST(test_edges_accumulate_on_time_and_cycles);
+  RUN_TEST(test_repeated_writes_are_not_edges);
+  RUN_TEST(test_canister_is_active_low);
+  RUN_TEST(test_other_pins_only_written);
+
+  // History and running stretch
+  RUN_TEST(test_history_keeps_newest_runs);
+  RUN_TEST(test_running_stretch_counts_in_totals_only);
+  RUN_TEST(test_ledc_pump_duty_is_accounted);
+
+  // Persistence
+  RUN_TEST(test_totals_survive_reboot_in_eeprom);
+  RUN_TEST(test_nvs_fallback_and_save_interval);
+
+  return UNITY_END();
+}
@@ -0,0 +1,272 @@
+// ============================================================================
+// CounterStore Unit Tests
+// Tests: EEPROM probe, NVS reconciliation (id / fallback flag), record round
+//        trip, slot rotation (wear), torn-write recovery, write failure,
+//        multi-page records (larger channel counts)
+// ============================================================================
+
+#include "Arduino.h"
+#include "CounterStore.h"
+#include <Wire.h>
+#include <unity.h>
+
+static uint32_t bankPageWrites(uint8_t bank) {
+  uint32_t total = 0;
+  for (uint8_t s = 0; s < COUNTER_SLOTS_PER_BANK; s++)
+    total += TwoWire::mock_eepromPageWrites[1 + bank * COUNTER_SLOTS_PER_BANK +
+                                            s];
+  return total;
+}
+
+static uint8_t nvsFlag() {
+  Preferences p;
+  p.begin("counters", true);
+  uint8_t v = p.getUChar("nvsNew", 0);
+  p.end();
+  return v;
+}
+
+void setUp() {
+  mock_millis_value = 0;
+  Preferences::mock_clearAll();
+  TwoWire::mock_resetEeprom();
+}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Probe / reconcile
+// ----------------------------------------------------------------------------
+
+void test_missing_eeprom_flags_nvs() {
+  TwoWire::mock_eepromPresent = false;
+  CounterStore cs;
+  TEST_ASSERT_FALSE(cs.begin(Wire));
+  TEST_ASSERT_FALSE(cs.isReady());
+  TEST_ASSERT_EQUAL_UINT8(1, nvsFlag());
+
+  uint32_t v = 5;
+  TEST_ASSERT_FALSE(cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+}
+
+void test_blank_eeprom_is_formatted() {
+  CounterStore cs;
+  TEST_ASSERT_TRUE(cs.begin(Wire));
+  TEST_ASSERT_NOT_EQUAL(0, cs.getStoreId());
+  TEST_ASSERT_EQUAL_UINT8(0, nvsFlag());
+
+  // Fresh store: owners must seed from NVS
+  uint32_t v;
+  TEST_ASSERT_FALSE(cs.readBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+
+  Preferences p;
+  p.begin("counters", true);
+  TEST_ASSERT_EQUAL_UINT32(cs.getStoreId(), p.getUInt("id", 0));
+}
+
+void test_record_survives_reboot() {
+  float stock[NUM_FERTS + 1] = {100, 200, 300, 400, 500};
+  uint32_t id;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    id = cs.getStoreId();
+    TEST_ASSERT_TRUE(
+        cs.writeBank(CounterBank::FERT_STOCK, stock, sizeof(stock)));
+    stock[2] = 250;
+    TEST_ASSERT_TRUE(
+        cs.writeBank(CounterBank::FERT_STOCK, stock, sizeof(stock)));
+  }
+
+  CounterStore cs;
+  TEST_ASSERT_TRUE(cs.begin(Wire));
+  TEST_ASSERT_EQUAL_UINT32(id, cs.getStoreId()); // Not reformatted
+  float out[NUM_FERTS + 1] = {};
+  TEST_ASSERT_TRUE(cs.readBank(CounterBank::FERT_STOCK, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_FLOAT(250.0f, out[2]);
+  TEST_ASSERT_EQUAL_FLOAT(500.0f, out[4]);
+  TEST_ASSERT_EQUAL_UINT32(2, cs.getBankSeq(CounterBank::FERT_STOCK));
+
+  // Wrong size (layout change) is not returned
+  TEST_ASSERT_FALSE(cs.readBank(CounterBank::FERT_STOCK, out, 4));
+}
+
+void test_foreign_eeprom_is_reformatted() {
+  uint32_t v = 1234;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  }
+  // Same module moved to a controller with a different NVS
+  Preferences p;
+  p.begin("counters", false);
+  p.putUInt("id", 0xDEADBEEF);
+  p.end();
+
+  CounterStore cs;
+  TEST_ASSERT_TRUE(cs.begin(Wire));
+  TEST_ASSERT_NOT_EQUAL(0xDEADBEEF, cs.getStoreId());
+  TEST_ASSERT_FALSE(cs.readBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+}
+
+void test_nvs_newer_wins() {
+  uint32_t v = 1234;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  }
+  // Booted once without the EEPROM: counters went to NVS
+  TwoWire::mock_eepromPresent = false;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+  }
+  TwoWire::mock_eepromPresent = true;
+
+  CounterStore cs;
+  TEST_ASSERT_TRUE(cs.begin(Wire));
+  TEST_ASSERT_FALSE(cs.readBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+  TEST_ASSERT_EQUAL_UINT8(0, nvsFlag());
+}
+
+// ----------------------------------------------------------------------------
+// Wear and power loss
+// ----------------------------------------------------------------------------
+
+void test_writes_rotate_across_slots() {
+  CounterStore cs;
+  cs.begin(Wire);
+  uint8_t bank = (uint8_t)CounterBank::FERT_RUNTIME;
+  for (uint32_t i = 1; i <= 2 * COUNTER_SLOTS_PER_BANK; i++) {
+    mock_millis_value += EEPROM_WRITE_CYCLE_MS;
+    cs.writeBank(CounterBank::FERT_RUNTIME, &i, sizeof(i));
+  }
+  // Every page of the bank took exactly its share
+  for (uint8_t s = 0; s < COUNTER_SLOTS_PER_BANK; s++)
+    TEST_ASSERT_EQUAL_UINT32(
+        2, TwoWire::mock_eepromPageWrites[1 + bank * COUNTER_SLOTS_PER_BANK +
+                                          s]);
+  TEST_ASSERT_EQUAL_UINT32(0, bankPageWrites(0)); // Other banks untouched
+}
+
+void test_unchanged_record_not_rewritten() {
+  CounterStore cs;
+  cs.begin(Wire);
+  uint32_t v = 42;
+  cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  uint32_t writes = cs.getWriteCount();
+  TEST_ASSERT_TRUE(cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+  TEST_ASSERT_EQUAL_UINT32(writes, cs.getWriteCount());
+}
+
+void test_torn_slot_falls_back_to_previous() {
+  uint8_t bank = (uint8_t)CounterBank::TPA_LAST_RUN;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    for (uint32_t v = 1; v <= 3; v++)
+      cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  }
+  // Power cut during the third write (slot 2): garbage in its payload
+  uint16_t addr = (1 + bank * COUNTER_SLOTS_PER_BANK + 2) * EEPROM_PAGE_SIZE;
+  TwoWire::mock_eeprom[addr + 8] ^= 0xFF;
+
+  CounterStore cs;
+  cs.begin(Wire);
+  uint32_t v = 0;
+  TEST_ASSERT_TRUE(cs.readBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+  TEST_ASSERT_EQUAL_UINT32(2, v);
+
+  // The next write reuses the torn slot with a higher seq
+  v = 9;
+  cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  CounterStore again;
+  again.begin(Wire);
+  again.readBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v));
+  TEST_ASSERT_EQUAL_UINT32(9, v);
+}
+
+void test_write_failure_hands_over_to_nvs() {
+  CounterStore cs;
+  cs.begin(Wire);
+  TwoWire::mock_eepromFailWrites = true;
+  uint32_t v = 7;
+  TEST_ASSERT_FALSE(cs.writeBank(CounterBank::TPA_LAST_RUN, &v, sizeof(v)));
+  TEST_ASSERT_FALSE(cs.isReady());
+  TEST_ASSERT_EQUAL_UINT8(1, nvsFlag());
+}
+
+// ----------------------------------------------------------------------------
+// Multi-page records
+// ----------------------------------------------------------------------------
+
+void test_large_record_spans_pages() {
+  float stock[17]; // 16 ferts + prime: 68 B, 3 pages per slot
+  for (uint8_t i = 0; i < 17; i++)
+    stock[i] = i * 10.0f;
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    for (uint8_t n = 0; n < 6; n++) { // Wraps after 5 slots
+      stock[16] = n;
+      mock_millis_value += EEPROM_WRITE_CYCLE_MS;
+      TEST_ASSERT_TRUE(
+          cs.writeBank(CounterBank::FERT_STOCK, stock, sizeof(stock)));
+    }
+  }
+  TEST_ASSERT_EQUAL_UINT32(6, bankPageWrites(0) / 3);
+
+  CounterStore cs;
+  cs.begin(Wire);
+  TEST_ASSERT_EQUAL(sizeof(stock), cs.getBankLength(CounterBank::FERT_STOCK));
+  float out[17] = {};
+  TEST_ASSERT_TRUE(cs.readBank(CounterBank::FERT_STOCK, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_FLOAT(5.0f, out[16]);
+  TEST_ASSERT_EQUAL_FLOAT(150.0f, out[15]);
+}
+
+void test_torn_multi_page_slot_keeps_previous() {
+  float stock[17] = {};
+  {
+    CounterStore cs;
+    cs.begin(Wire);
+    stock[16] = 1;
+    cs.writeBank(CounterBank::FERT_STOCK, stock, sizeof(stock)); // Pages 0-2
+    stock[16] = 2;
+    cs.writeBank(CounterBank::FERT_STOCK, stock, sizeof(stock)); // Pages 3-5
+  }
+  // Power cut after the second slot's first page: its last page is stale
+  uint16_t addr = (1 + 5) * EEPROM_PAGE_SIZE;
+  TwoWire::mock_eeprom[addr + 10] ^= 0xFF;
+
+  CounterStore cs;
+  cs.begin(Wire);
+  float out[17] = {};
+  TEST_ASSERT_TRUE(cs.readBank(CounterBank::FERT_STOCK, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_FLOAT(1.0f, out[16]);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Probe / reconcile
+  RUN_TEST(test_missing_eeprom_flags_nvs);
+  RUN_TEST(test_blank_eeprom_is_formatted);
+  RUN_TEST(test_record_survives_reboot);
+  RUN_TEST(test_foreign_eeprom_is_reformatted);
+  RUN_TEST(test_nvs_newer_wins);
+
+  // Wear and power loss
+  RUN_TEST(test_writes_rotate_across_slots);
+  RUN_TEST(test_unchanged_record_not_rewritten);
+  RUN_TEST(test_torn_slot_falls_back_to_previous);
+  RUN_TEST(test_write_failure_hands_over_to_nvs);
+
+  // Multi-page records
+  RUN_TEST(test_large_record_spans_pages);
+  RUN_TEST(test_torn_multi_page_slot_keeps_previous);
+
+  return UNITY_END();
+}
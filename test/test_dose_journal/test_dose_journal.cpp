@@ -0,0 +1,274 @@
+// ============================================================================
+// DoseJournal Unit Tests
+// Tests: append/read round trip, time and channel range queries, segment
+//        rotation, index rebuild at boot, torn-write recovery, batching
+// ============================================================================
+
+#include "Arduino.h"
+#include "DoseJournal.h"
+#include <LittleFS.h>
+#include <unity.h>
+
+static DoseJournal::Record makeRec(uint32_t epoch, uint8_t ch = 0,
+                                   float ml = 5.0f) {
+  DoseJournal::Record r = {};
+  r.epoch = epoch;
+  r.durationMs = (uint32_t)(ml / FLOW_RATE_ML_PER_SEC * 1000);
+  r.requestedMl = ml;
+  r.deliveredMl = ml;
+  r.channel = ch;
+  r.pwm = 255;
+  r.result = (uint8_t)DoseJournal::Result::OK;
+  r.flags = DoseJournal::FLAG_SCHEDULED;
+  return r;
+}
+
+// Drain a query in batches of `batch`; returns the number of records
+static size_t readAll(DoseJournal &j, uint32_t from, uint32_t to, uint8_t ch,
+                      DoseJournal::Record *out, size_t cap, size_t batch = 16) {
+  DoseJournal::Query q;
+  j.beginQuery(q, from, to, ch);
+  size_t total = 0;
+  while (!q.done && total < cap) {
+    size_t n = j.read(q, out + total, min(batch, cap - total));
+    total += n;
+  }
+  return total;
+}
+
+static std::string segPath(uint16_t seq) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%s/%05u.jnl", JOURNAL_DIR, seq);
+  return buf;
+}
+
+void setUp() { fs::FS::mock_clear(); }
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Append / read
+// ----------------------------------------------------------------------------
+
+void test_empty_journal() {
+  DoseJournal j;
+  TEST_ASSERT_TRUE(j.begin(LittleFS));
+  TEST_ASSERT_TRUE(LittleFS.exists(JOURNAL_DIR));
+  TEST_ASSERT_EQUAL(0, j.getEntryCount());
+
+  DoseJournal::Record out[4];
+  DoseJournal::Query q;
+  j.beginQuery(q, 0, UINT32_MAX);
+  TEST_ASSERT_EQUAL(0, j.read(q, out, 4));
+  TEST_ASSERT_TRUE(q.done);
+}
+
+void test_append_round_trip() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  DoseJournal::Record r = makeRec(1000, 2, 7.5f);
+  r.deliveredMl = 3.0f;
+  r.result = (uint8_t)DoseJournal::Result::ABORTED;
+  r.pwm = 128;
+  TEST_ASSERT_TRUE(j.append(r));
+  TEST_ASSERT_TRUE(j.append(makeRec(2000, 4)));
+
+  DoseJournal::Record out[4];
+  TEST_ASSERT_EQUAL(2, readAll(j, 0, UINT32_MAX, DoseJournal::ALL_CHANNELS,
+                               out, 4));
+  TEST_ASSERT_EQUAL_UINT32(1000, out[0].epoch);
+  TEST_ASSERT_EQUAL_UINT8(2, out[0].channel);
+  TEST_ASSERT_EQUAL_FLOAT(7.5f, out[0].requestedMl);
+  TEST_ASSERT_EQUAL_FLOAT(3.0f, out[0].deliveredMl);
+  TEST_ASSERT_EQUAL_UINT8(128, out[0].pwm);
+  TEST_ASSERT_EQUAL_STRING("aborted", DoseJournal::resultName(out[0].result));
+  TEST_ASSERT_TRUE(DoseJournal::isValid(out[0]));
+  TEST_ASSERT_EQUAL_UINT32(2000, out[1].epoch);
+
+  // One fixed-size record per dose on disk
+  TEST_ASSERT_EQUAL(2 * sizeof(DoseJournal::Record),
+                    fs::FS::mock_files()[segPath(0)].size());
+  TEST_ASSERT_EQUAL(24, sizeof(DoseJournal::Record));
+}
+
+void test_range_and_channel_filter() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  for (uint32_t i = 0; i < 50; i++)
+    j.append(makeRec(1000 + i * 60, i % 5));
+
+  DoseJournal::Record out[64];
+  // [1600, 1900] holds epochs 1600..1900 step 60 -> i = 10..15
+  size_t n = readAll(j, 1600, 1900, DoseJournal::ALL_CHANNELS, out, 64);
+  TEST_ASSERT_EQUAL(6, n);
+  TEST_ASSERT_EQUAL_UINT32(1600, out[0].epoch);
+  TEST_ASSERT_EQUAL_UINT32(1900, out[5].epoch);
+
+  n = readAll(j, 0, UINT32_MAX, 3, out, 64);
+  TEST_ASSERT_EQUAL(10, n);
+  for (size_t i = 0; i < n; i++)
+    TEST_ASSERT_EQUAL_UINT8(3, out[i].channel);
+
+  TEST_ASSERT_EQUAL(0, readAll(j, 5000, 6000, DoseJournal::ALL_CHANNELS,
+                               out, 64));
+}
+
+void test_small_batches_match_one_read() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  uint32_t total = JOURNAL_SEGMENT_ENTRIES + 20; // Spans two segments
+  for (uint32_t i = 0; i < total; i++)
+    j.append(makeRec(10000 + i, i % 5));
+  TEST_ASSERT_EQUAL(2, j.getSegmentCount());
+
+  static DoseJournal::Record a[JOURNAL_SEGMENT_ENTRIES + 32];
+  static DoseJournal::Record b[JOURNAL_SEGMENT_ENTRIES + 32];
+  size_t na = readAll(j, 10000 + 500, 10000 + 515, 1, a, 600, 600);
+  size_t nb = readAll(j, 10000 + 500, 10000 + 515, 1, b, 600, 1);
+  TEST_ASSERT_EQUAL(na, nb);
+  TEST_ASSERT_EQUAL(3, na); // 501, 506, 511 (i % 5 == 1)
+  for (size_t i = 0; i < na; i++)
+    TEST_ASSERT_EQUAL_UINT32(a[i].epoch, b[i].epoch);
+  TEST_ASSERT_EQUAL_UINT32(10501, a[0].epoch);
+  // 513 crosses into the second segment
+  na = readAll(j, 10505, 10515, DoseJournal::ALL_CHANNELS, a, 600, 1);
+  TEST_ASSERT_EQUAL(11, na);
+  TEST_ASSERT_EQUAL_UINT32(10515, a[10].epoch);
+}
+
+void test_unsorted_segment_still_matches() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  // Clock stepped back mid-segment: bisecting would skip 1500
+  j.append(makeRec(1000));
+  j.append(makeRec(3000));
+  j.append(makeRec(1500));
+  j.append(makeRec(4000));
+
+  DoseJournal::Record out[8];
+  size_t n = readAll(j, 1200, 3500, DoseJournal::ALL_CHANNELS, out, 8);
+  TEST_ASSERT_EQUAL(2, n);
+  TEST_ASSERT_EQUAL_UINT32(3000, out[0].epoch);
+  TEST_ASSERT_EQUAL_UINT32(1500, out[1].epoch);
+  TEST_ASSERT_EQUAL_UINT32(1000, j.getOldestEpoch());
+  TEST_ASSERT_EQUAL_UINT32(4000, j.getNewestEpoch());
+}
+
+// ----------------------------------------------------------------------------
+// Segments
+// ----------------------------------------------------------------------------
+
+void test_rotation_drops_oldest_segment() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  uint32_t total = JOURNAL_SEGMENT_ENTRIES * JOURNAL_MAX_SEGMENTS + 10;
+  for (uint32_t i = 0; i < total; i++)
+    j.append(makeRec(i + 1));
+
+  TEST_ASSERT_EQUAL(JOURNAL_MAX_SEGMENTS, j.getSegmentCount());
+  TEST_ASSERT_FALSE(LittleFS.exists(segPath(0).c_str()));
+  TEST_ASSERT_TRUE(LittleFS.exists(segPath(JOURNAL_MAX_SEGMENTS).c_str()));
+  TEST_ASSERT_EQUAL_UINT32(
+      (uint32_t)JOURNAL_SEGMENT_ENTRIES * (JOURNAL_MAX_SEGMENTS - 1) + 10,
+      j.getEntryCount());
+  TEST_ASSERT_EQUAL_UINT32(JOURNAL_SEGMENT_ENTRIES + 1, j.getOldestEpoch());
+  TEST_ASSERT_EQUAL_UINT32(total, j.getNewestEpoch());
+}
+
+void test_begin_rebuilds_index() {
+  {
+    DoseJournal j;
+    j.begin(LittleFS);
+    for (uint32_t i = 0; i < JOURNAL_SEGMENT_ENTRIES + 5; i++)
+      j.append(makeRec(5000 + i, 1));
+  }
+
+  DoseJournal j;
+  TEST_ASSERT_TRUE(j.begin(LittleFS));
+  TEST_ASSERT_EQUAL(2, j.getSegmentCount());
+  TEST_ASSERT_EQUAL_UINT32(JOURNAL_SEGMENT_ENTRIES + 5, j.getEntryCount());
+  TEST_ASSERT_EQUAL_UINT32(5000, j.getOldestEpoch());
+
+  // Appends continue in the open (newest) segment
+  j.append(makeRec(9000, 1));
+  TEST_ASSERT_EQUAL(2, j.getSegmentCount());
+  TEST_ASSERT_EQUAL(6 * sizeof(DoseJournal::Record),
+                    fs::FS::mock_files()[segPath(1)].size());
+}
+
+void test_torn_tail_is_ignored() {
+  {
+    DoseJournal j;
+    j.begin(LittleFS);
+    for (uint32_t i = 0; i < 3; i++)
+      j.append(makeRec(100 + i));
+  }
+  // Power cut mid-write: half a record at the end
+  std::vector<uint8_t> &data = fs::FS::mock_files()[segPath(0)];
+  data.insert(data.end(), 10, 0xAB);
+
+  DoseJournal j;
+  j.begin(LittleFS);
+  TEST_ASSERT_EQUAL_UINT32(3, j.getEntryCount());
+
+  // Never appended after the torn bytes: a new segment is opened
+  TEST_ASSERT_TRUE(j.append(makeRec(200)));
+  TEST_ASSERT_EQUAL(2, j.getSegmentCount());
+  DoseJournal::Record out[8];
+  TEST_ASSERT_EQUAL(4, readAll(j, 0, UINT32_MAX, DoseJournal::ALL_CHANNELS,
+                               out, 8));
+  TEST_ASSERT_EQUAL_UINT32(200, out[3].epoch);
+}
+
+void test_corrupt_record_truncates_segment() {
+  {
+    DoseJournal j;
+    j.begin(LittleFS);
+    for (uint32_t i = 0; i < 5; i++)
+      j.append(makeRec(100 + i));
+  }
+  fs::FS::mock_files()[segPath(0)][2 * sizeof(DoseJournal::Record) + 4] ^= 1;
+
+  DoseJournal j;
+  j.begin(LittleFS);
+  TEST_ASSERT_EQUAL_UINT32(2, j.getEntryCount());
+  TEST_ASSERT_EQUAL_UINT32(101, j.getNewestEpoch());
+}
+
+void test_failed_write_not_indexed() {
+  DoseJournal j;
+  j.begin(LittleFS);
+  j.append(makeRec(100));
+  fs::FS::mock_failWrites = true;
+  TEST_ASSERT_FALSE(j.append(makeRec(200)));
+  fs::FS::mock_failWrites = false;
+  TEST_ASSERT_EQUAL_UINT32(1, j.getEntryCount());
+  TEST_ASSERT_EQUAL(1, j.getSegmentCount());
+}
+
+void test_append_before_begin_fails() {
+  DoseJournal j;
+  TEST_ASSERT_FALSE(j.isReady());
+  TEST_ASSERT_FALSE(j.append(makeRec(100)));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Append / read
+  RUN_TEST(test_empty_journal);
+  RUN_TEST(test_append_round_trip);
+  RUN_TEST(test_range_and_channel_filter);
+  RUN_TEST(test_small_batches_match_one_read);
+  RUN_TEST(test_unsorted_segment_still_matches);
+
+  // Segments
+  RUN_TEST(test_rotation_drops_oldest_segment);
+  RUN_TEST(test_begin_rebuilds_index);
+  RUN_TEST(test_torn_tail_is_ignored);
+  RUN_TEST(test_corrupt_record_truncates_segment);
+  RUN_TEST(test_failed_write_not_indexed);
+  RUN_TEST(test_append_before_begin_fails);
+
+  return UNITY_END();
+}
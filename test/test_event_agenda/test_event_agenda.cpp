@@ -0,0 +1,177 @@
+// ============================================================================
+// EventAgenda Unit Tests
+// Tests: min-heap order, O(1) due check, late/missed detection, time helpers
+// ============================================================================
+
+#include "Arduino.h"
+#include "EventAgenda.h"
+#include <unity.h>
+
+static const uint32_t TUESDAY = 1771891200; // 2026-02-24 00:00 (RTC epoch)
+static const uint32_t HOUR = 3600;
+
+void setUp() {}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Heap
+// ----------------------------------------------------------------------------
+
+void test_pop_returns_earliest_first() {
+  EventAgenda agenda;
+  agenda.push(TUESDAY + 9 * HOUR, AgendaKind::FERT_DOSE, 2);
+  agenda.push(TUESDAY + 8 * HOUR, AgendaKind::DAILY_REPORT);
+  agenda.push(TUESDAY + 10 * HOUR, AgendaKind::TPA);
+  agenda.push(TUESDAY + 9 * HOUR, AgendaKind::FERT_DOSE, 0);
+  TEST_ASSERT_EQUAL_UINT8(4, agenda.size());
+
+  AgendaEvent ev;
+  AgendaTiming timing;
+  uint32_t now = TUESDAY + 12 * HOUR;
+  const uint32_t expectDue[] = {8 * HOUR, 9 * HOUR, 9 * HOUR, 10 * HOUR};
+  const uint8_t expectArg[] = {0, 0, 2, 0};
+  for (uint8_t i = 0; i < 4; i++) {
+    TEST_ASSERT_TRUE(agenda.popDue(now, ev, timing));
+    TEST_ASSERT_EQUAL_UINT32(TUESDAY + expectDue[i], ev.dueEpoch);
+    TEST_ASSERT_EQUAL_UINT8(expectArg[i], ev.arg);
+  }
+  TEST_ASSERT_FALSE(agenda.popDue(now, ev, timing));
+}
+
+void test_is_due_checks_head_only() {
+  EventAgenda agenda;
+  TEST_ASSERT_FALSE(agenda.isDue(TUESDAY));
+  agenda.push(TUESDAY + 9 * HOUR, AgendaKind::TPA);
+  TEST_ASSERT_FALSE(agenda.isDue(TUESDAY + 9 * HOUR - 1));
+  TEST_ASSERT_TRUE(agenda.isDue(TUESDAY + 9 * HOUR));
+
+  AgendaEvent ev;
+  AgendaTiming timing;
+  TEST_ASSERT_FALSE(agenda.popDue(TUESDAY, ev, timing)); // Not due: kept
+  TEST_ASSERT_EQUAL_UINT8(1, agenda.size());
+}
+
+void test_push_rejects_never_and_overflow() {
+  EventAgenda agenda;
+  TEST_ASSERT_FALSE(agenda.push(0, AgendaKind::TPA));
+  for (uint8_t i = 0; i < AGENDA_CAPACITY; i++)
+    TEST_ASSERT_TRUE(agenda.push(TUESDAY + i, AgendaKind::FERT_DOSE, i));
+  TEST_ASSERT_FALSE(agenda.push(TUESDAY, AgendaKind::TPA));
+  agenda.clear();
+  TEST_ASSERT_EQUAL_UINT8(0, agenda.size());
+  TEST_ASSERT_NULL(agenda.peek());
+}
+
+void test_snapshot_is_sorted_and_non_destructive() {
+  EventAgenda agenda;
+  agenda.push(TUESDAY + 3 * HOUR, AgendaKind::TPA);
+  agenda.push(TUESDAY + 1 * HOUR, AgendaKind::NEW_DAY);
+  agenda.push(TUESDAY + 2 * HOUR, AgendaKind::DAILY_REPORT);
+
+  AgendaEvent out[AGENDA_CAPACITY];
+  TEST_ASSERT_EQUAL_UINT8(3, agenda.snapshot(out, AGENDA_CAPACITY));
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 1 * HOUR, out[0].dueEpoch);
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 2 * HOUR, out[1].dueEpoch);
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 3 * HOUR, out[2].dueEpoch);
+  TEST_ASSERT_EQUAL_UINT8(3, agenda.size());
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 1 * HOUR, agenda.peek()->dueEpoch);
+}
+
+// ----------------------------------------------------------------------------
+// Lateness
+// ----------------------------------------------------------------------------
+
+void test_on_time_within_scheduled_minute() {
+  EventAgenda agenda;
+  agenda.push(TUESDAY + 9 * HOUR, AgendaKind::FERT_DOSE, 1);
+  AgendaEvent ev;
+  AgendaTiming timing;
+  TEST_ASSERT_TRUE(agenda.popDue(TUESDAY + 9 * HOUR + 59, ev, timing));
+  TEST_ASSERT_EQUAL(AgendaTiming::ON_TIME, timing);
+  TEST_ASSERT_EQUAL_UINT32(0, agenda.getLateCount());
+  TEST_ASSERT_EQUAL_UINT32(0, agenda.getMissedCount());
+}
+
+void test_past_minute_is_late_then_missed() {
+  EventAgenda agenda;
+  agenda.push(TUESDAY + 9 * HOUR, AgendaKind::FERT_DOSE, 1);
+  agenda.push(TUESDAY + 10 * HOUR, AgendaKind::TPA);
+  AgendaEvent ev;
+  AgendaTiming timing;
+
+  // Loop blocked past the dose minute: still within the grace window
+  uint32_t now = TUESDAY + 9 * HOUR + 60;
+  TEST_ASSERT_TRUE(agenda.popDue(now, ev, timing));
+  TEST_ASSERT_EQUAL(AgendaTiming::LATE, timing);
+  TEST_ASSERT_EQUAL_UINT32(1, agenda.getLateCount());
+
+  // TPA found beyond the grace window: skipped and remembered
+  now = TUESDAY + 10 * HOUR + AGENDA_LATE_GRACE_S + 1;
+  TEST_ASSERT_TRUE(agenda.popDue(now, ev, timing));
+  TEST_ASSERT_EQUAL(AgendaTiming::MISSED, timing);
+  TEST_ASSERT_EQUAL_UINT32(1, agenda.getMissedCount());
+  TEST_ASSERT_EQUAL(AgendaKind::TPA, agenda.getLastMissed().kind);
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 10 * HOUR,
+                           agenda.getLastMissed().dueEpoch);
+}
+
+// ----------------------------------------------------------------------------
+// Time helpers
+// ----------------------------------------------------------------------------
+
+void test_next_daily_today_or_tomorrow() {
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 9 * HOUR + 1800,
+                           EventAgenda::nextDaily(TUESDAY + 8 * HOUR, 9, 30));
+  // Exactly at the slot counts as due now
+  TEST_ASSERT_EQUAL_UINT32(
+      TUESDAY + 9 * HOUR + 1800,
+      EventAgenda::nextDaily(TUESDAY + 9 * HOUR + 1800, 9, 30));
+  // Past the slot: tomorrow
+  TEST_ASSERT_EQUAL_UINT32(
+      TUESDAY + 86400 + 9 * HOUR + 1800,
+      EventAgenda::nextDaily(TUESDAY + 9 * HOUR + 1860, 9, 30));
+}
+
+void test_next_weekly_uses_per_day_times_and_mask() {
+  uint8_t hour[7] = {8, 8, 8, 8, 8, 8, 8};
+  uint8_t minute[7] = {0, 0, 0, 0, 0, 0, 0};
+  hour[2] = 20; // Tuesday dose in the evening
+
+  // Tuesday morning: Tuesday's own slot (20:00) is next
+  TEST_ASSERT_EQUAL_UINT32(TUESDAY + 20 * HOUR,
+                           EventAgenda::nextWeekly(TUESDAY + HOUR, hour,
+                                                   minute));
+  // Only Sundays enabled: 2026-03-01 08:00
+  TEST_ASSERT_EQUAL_UINT32(
+      TUESDAY + 5 * 86400 + 8 * HOUR,
+      EventAgenda::nextWeekly(TUESDAY + HOUR, hour, minute, 1 << 0));
+  // Only Tuesday, slot already passed: same weekday next week
+  TEST_ASSERT_EQUAL_UINT32(
+      TUESDAY + 7 * 86400 + 20 * HOUR,
+      EventAgenda::nextWeekly(TUESDAY + 21 * HOUR, hour, minute, 1 << 2));
+  // No day enabled
+  TEST_ASSERT_EQUAL_UINT32(0,
+                           EventAgenda::nextWeekly(TUESDAY, hour, minute, 0));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Heap
+  RUN_TEST(test_pop_returns_earliest_first);
+  RUN_TEST(test_is_due_checks_head_only);
+  RUN_TEST(test_push_rejects_never_and_overflow);
+  RUN_TEST(test_snapshot_is_sorted_and_non_destructive);
+
+  // Lateness
+  RUN_TEST(test_on_time_within_scheduled_minute);
+  RUN_TEST(test_past_minute_is_late_then_missed);
+
+  // Time helpers
+  RUN_TEST(test_next_daily_today_or_tomorrow);
+  RUN_TEST(test_next_weekly_uses_per_day_times_and_mask);
+
+  UNITY_END();
+  return 0;
+}
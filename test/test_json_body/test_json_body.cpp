@@ -0,0 +1,426 @@
+// ============================================================================
+// JsonBody Unit Tests
+// Tests: typed fields, skipped members, string decoding, arrays, bodies
+//        without terminator, malformed input, chunk reassembly, host
+//        benchmark against the old String extractors (heap calls and
+//        microseconds per request)
+// ============================================================================
+
+#include "Arduino.h"
+#include "Config.h"
+#include "JsonBody.h"
+#include <chrono>
+#include <new>
+#include <unity.h>
+
+// Every heap allocation in the process goes through here
+static size_t heapCalls = 0;
+
+void *operator new(size_t n) {
+  heapCalls++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void setUp() { heapCalls = 0; }
+
+void tearDown() {}
+
+static bool parse(const char *json, JsonField *fields, uint8_t count) {
+  return jsonParseObject((const uint8_t *)json, strlen(json), fields, count);
+}
+
+// ----------------------------------------------------------------------------
+// Fields
+// ----------------------------------------------------------------------------
+
+void test_typed_fields_and_skipped_members() {
+  int ch = -1, st = -1, big = -1, absent = -1, asText = -1;
+  float ml = -1, flag = -1, nul = -1;
+  JsonField f[] = {JsonField::integer("channel", ch),
+                   JsonField::integer("state", st),
+                   JsonField::integer("big", big),
+                   JsonField::integer("absent", absent),
+                   JsonField::integer("asText", asText),
+                   JsonField::number("ml", ml),
+                   JsonField::number("flag", flag),
+                   JsonField::number("nul", nul)};
+  TEST_ASSERT_TRUE(parse(" {\"x\":{\"channel\":9,\"a\":[1,{\"b\":\"}\"}]},"
+                         "\"channel\" : 2 ,\"state\":true,\"ml\":-1.25e1,"
+                         "\"big\":1e12,\"asText\":\"3\",\"flag\":false,"
+                         "\"nul\":null,\"y\":[[],\"]\"]}\n",
+                         f, 8));
+  TEST_ASSERT_EQUAL(2, ch);
+  TEST_ASSERT_EQUAL(1, st);
+  TEST_ASSERT_EQUAL_FLOAT(-12.5f, ml);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, flag);
+  // Out of range, wrong type, null, absent: left as preset
+  TEST_ASSERT_EQUAL(-1, big);
+  TEST_ASSERT_EQUAL(-1, asText);
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, nul);
+  TEST_ASSERT_EQUAL(-1, absent);
+  TEST_ASSERT_TRUE(f[0].found);
+  TEST_ASSERT_FALSE(f[2].found);
+  TEST_ASSERT_FALSE(f[3].found);
+  TEST_ASSERT_FALSE(f[4].found);
+
+  // Fractions truncate like String::toInt(); the last duplicate wins
+  TEST_ASSERT_TRUE(parse("{\"channel\":3.9,\"channel\":4.7}", f, 8));
+  TEST_ASSERT_EQUAL(4, ch);
+}
+
+void test_string_decoding() {
+  char name[16], key[8], other[8] = "keep";
+  JsonField f[] = {JsonField::string("name", name, sizeof(name)),
+                   JsonField::string("key", key, sizeof(key)),
+                   JsonField::string("other", other, sizeof(other))};
+  TEST_ASSERT_TRUE(
+      parse("{\"name\":\"Pot\\u00e1ssio \\\"K\\\"\",\"key\":\"a\\/b\\n\","
+            "\"other\":5}",
+            f, 3));
+  TEST_ASSERT_EQUAL_STRING("Pot\xc3\xa1ssio \"K\"", name);
+  TEST_ASSERT_EQUAL(13, f[0].count);
+  TEST_ASSERT_EQUAL_STRING("a/b\n", key);
+  TEST_ASSERT_FALSE(f[2].found);
+  TEST_ASSERT_EQUAL_STRING("keep", other);
+
+  // Raw UTF-8 and a surrogate pair; a cut never splits a character
+  TEST_ASSERT_TRUE(parse("{\"key\":\"ab\xc3\xa1\xc3\xa1\"}", f, 3));
+  TEST_ASSERT_EQUAL_STRING("ab\xc3\xa1\xc3\xa1", key);
+  TEST_ASSERT_TRUE(parse("{\"key\":\"abcd\xc3\xa1\xc3\xa1\"}", f, 3));
+  TEST_ASSERT_EQUAL_STRING("abcd\xc3\xa1", key);
+  TEST_ASSERT_TRUE(parse("{\"key\":\"\\ud83d\\udca7x\"}", f, 3));
+  TEST_ASSERT_EQUAL_STRING("\xf0\x9f\x92\xa7x", key);
+  TEST_ASSERT_TRUE(parse("{\"key\":\"\\udca7\"}", f, 3));
+  TEST_ASSERT_EQUAL_STRING("\xef\xbf\xbd", key);
+}
+
+void test_float_arrays() {
+  float a[4] = {-1, -1, -1, -1};
+  float b[2] = {-1, -1};
+  float e[1] = {-1};
+  JsonField f[] = {JsonField::array("a", a, 4), JsonField::array("b", b, 2),
+                   JsonField::array("e", e, 1)};
+  TEST_ASSERT_TRUE(parse("{\"a\":[1, 2.5 ,-3,4e-1,5,6],\"b\":[7,\"x\"],"
+                         "\"e\":[ ]}",
+                         f, 3));
+  // Six in the body, four stored
+  TEST_ASSERT_TRUE(f[0].found);
+  TEST_ASSERT_EQUAL(6, f[0].count);
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, a[1]);
+  TEST_ASSERT_EQUAL_FLOAT(-3.0f, a[2]);
+  TEST_ASSERT_EQUAL_FLOAT(0.4f, a[3]);
+  // A string element: missing
+  TEST_ASSERT_FALSE(f[1].found);
+  TEST_ASSERT_TRUE(f[2].found);
+  TEST_ASSERT_EQUAL(0, f[2].count);
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, e[0]);
+}
+
+// ----------------------------------------------------------------------------
+// Input bounds
+// ----------------------------------------------------------------------------
+
+void test_body_without_terminator() {
+  // The request buffer continues past len with unrelated bytes
+  const char raw[] = "{\"channel\":12}3456\"garbage";
+  int ch = -1;
+  JsonField f[] = {JsonField::integer("channel", ch)};
+  TEST_ASSERT_TRUE(jsonParseObject((const uint8_t *)raw, 14, f, 1));
+  TEST_ASSERT_EQUAL(12, ch);
+
+  // Cut inside the number: only the bytes up to len are read
+  const char cut[] = "{\"channel\":12";
+  TEST_ASSERT_FALSE(jsonParseObject((const uint8_t *)cut, 12, f, 1));
+}
+
+void test_malformed_bodies_rejected() {
+  int ch = -1;
+  JsonField f[] = {JsonField::integer("channel", ch)};
+  const char *bad[] = {"",
+                       "[1]",
+                       "{\"channel\":1",
+                       "{\"channel\" 1}",
+                       "{\"channel\":1,}",
+                       "{channel:1}",
+                       "{\"channel\":01x}",
+                       "{\"channel\":-}",
+                       "{\"channel\":1.}",
+                       "{\"channel\":tru}",
+                       "{\"s\":\"a\nb\"}",
+                       "{\"s\":\"\\x\"}",
+                       "{\"s\":\"\\u12g4\"}",
+                       "{\"o\":{\"a\":1}",
+                       "{} x"};
+  for (const char *b : bad)
+    TEST_ASSERT_FALSE_MESSAGE(parse(b, f, 1), b);
+  ch = -1;
+  TEST_ASSERT_TRUE(parse("{}", f, 1));
+  TEST_ASSERT_EQUAL(-1, ch);
+}
+
+// ----------------------------------------------------------------------------
+// Chunk reassembly
+// ----------------------------------------------------------------------------
+
+void test_arena_reassembles_chunks() {
+  static BodyArena arena;
+  const uint8_t *body;
+  size_t len;
+  const char *json = "{\"channel\":3,\"ml\":12.5}";
+  const uint8_t *d = (const uint8_t *)json;
+  size_t total = strlen(json);
+  int reqA, reqB, reqC; // Stand-ins for request objects
+
+  // One chunk: handed back in place, no slot
+  TEST_ASSERT_EQUAL(BodyArena::COMPLETE,
+                    arena.feed(&reqA, d, total, 0, total, 0, body, len));
+  TEST_ASSERT_EQUAL_PTR(d, body);
+  TEST_ASSERT_EQUAL(0, arena.slotsInUse());
+
+  // Two bodies interleaved
+  TEST_ASSERT_EQUAL(BodyArena::PARTIAL,
+                    arena.feed(&reqA, d, 5, 0, total, 0, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::PARTIAL,
+                    arena.feed(&reqB, d, 10, 0, total, 0, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::BUSY,
+                    arena.feed(&reqC, d, 1, 0, total, 0, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::PARTIAL,
+                    arena.feed(&reqA, d + 5, 5, 5, total, 0, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::COMPLETE, arena.feed(&reqA, d + 10, total - 10,
+                                                    10, total, 0, body, len));
+  TEST_ASSERT_EQUAL(total, len);
+  TEST_ASSERT_EQUAL_MEMORY(json, body, total);
+  int ch = -1;
+  float ml = -1;
+  JsonField f[] = {JsonField::integer("channel", ch),
+                   JsonField::number("ml", ml)};
+  TEST_ASSERT_TRUE(jsonParseObject(body, len, f, 2));
+  TEST_ASSERT_EQUAL(3, ch);
+  TEST_ASSERT_EQUAL_FLOAT(12.5f, ml);
+  TEST_ASSERT_EQUAL(1, arena.slotsInUse());
+
+  // A gap drops the body; later chunks are ignored
+  TEST_ASSERT_EQUAL(BodyArena::DROPPED,
+                    arena.feed(&reqB, d + 12, 3, 12, total, 0, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::DROPPED,
+                    arena.feed(&reqB, d + 15, 3, 15, total, 0, body, len));
+  TEST_ASSERT_EQUAL(0, arena.slotsInUse());
+
+  // Oversized bodies are refused on their first chunk
+  TEST_ASSERT_EQUAL(BodyArena::TOO_LARGE, arena.feed(&reqC, d, 5, 0,
+                                                     WEB_BODY_MAX + 1, 0,
+                                                     body, len));
+
+  // Slots of vanished requests are reclaimed once stale
+  arena.feed(&reqA, d, 5, 0, total, 1000, body, len);
+  arena.feed(&reqB, d, 5, 0, total, 1000, body, len);
+  TEST_ASSERT_EQUAL(BodyArena::BUSY, arena.feed(&reqC, d, 5, 0, total,
+                                                1000 + WEB_BODY_STALE_MS - 1,
+                                                body, len));
+  TEST_ASSERT_EQUAL(BodyArena::PARTIAL,
+                    arena.feed(&reqC, d, 5, 0, total,
+                               1000 + WEB_BODY_STALE_MS, body, len));
+  TEST_ASSERT_EQUAL(BodyArena::DROPPED,
+                    arena.feed(&reqA, d + 5, 5, 5, total,
+                               1000 + WEB_BODY_STALE_MS, body, len));
+  TEST_ASSERT_EQUAL(0, heapCalls);
+}
+
+// ----------------------------------------------------------------------------
+// Host benchmark: fert schedule and aquarium bodies parsed the old way
+// (String copy, one indexOf/substring scan per field, as WebManager did)
+// and with one jsonParseObject pass
+// ----------------------------------------------------------------------------
+
+static int legacyInt(const String &json, const char *key) {
+  String search = String("\"") + key + "\":";
+  int idx = json.indexOf(search);
+  if (idx < 0)
+    return -1;
+  idx += search.length();
+  return json.substring(idx).toInt();
+}
+
+static float legacyFloat(const String &json, const char *key) {
+  String search = String("\"") + key + "\":";
+  int idx = json.indexOf(search);
+  if (idx < 0)
+    return -1;
+  idx += search.length();
+  return json.substring(idx).toFloat();
+}
+
+static bool legacyFloatArray(const String &json, const char *key,
+                             float *outArray, uint8_t expectedSize,
+                             uint8_t *outCount = nullptr) {
+  String search = String("\"") + key + "\":[";
+  int startIdx = json.indexOf(search);
+  if (startIdx < 0)
+    return false;
+  startIdx += search.length();
+  int endIdx = json.indexOf("]", startIdx);
+  if (endIdx < 0)
+    return false;
+  String arrayStr = json.substring(startIdx, endIdx);
+  arrayStr.trim();
+  uint8_t count = 0;
+  int lastComma = 0;
+  for (uint8_t i = 0; i < expectedSize && arrayStr.length() > 0; i++) {
+    int nextComma = arrayStr.indexOf(",", lastComma);
+    count++;
+    if (nextComma == -1) {
+      outArray[i] = arrayStr.substring(lastComma).toFloat();
+      break;
+    } else {
+      outArray[i] = arrayStr.substring(lastComma, nextComma).toFloat();
+      lastComma = nextComma + 1;
+    }
+  }
+  if (outCount)
+    *outCount = count;
+  return true;
+}
+
+/// Values both parsers must agree on
+struct Parsed {
+  int ch, h, l, w, rv, mg;
+  float ratio, lt;
+  float doses[7], hours[7];
+  float sch[2 * FERT_SCHEDULE_SLOTS];
+  unsigned schLen;
+};
+
+static void legacyParse(const uint8_t *data, size_t len, Parsed &p) {
+  String body = String((const char *)data).substring(0, len);
+  p.ch = legacyInt(body, "channel");
+  legacyFloatArray(body, "doses", p.doses, 7);
+  legacyFloatArray(body, "hours", p.hours, 7);
+  float sch[2 * FERT_SCHEDULE_SLOTS + 1];
+  uint8_t n = 0;
+  legacyFloatArray(body, "sch", sch, 2 * FERT_SCHEDULE_SLOTS + 1, &n);
+  memcpy(p.sch, sch, sizeof(p.sch));
+  p.schLen = n;
+  p.lt = legacyFloat(body, "lowStockThreshold");
+  p.h = legacyInt(body, "aqHeight");
+  p.l = legacyInt(body, "aqLength");
+  p.w = legacyInt(body, "aqWidth");
+  p.ratio = legacyFloat(body, "primeRatio");
+  p.rv = legacyInt(body, "reservoirVolume");
+  p.mg = legacyInt(body, "aqMarginCm");
+}
+
+static void singlePassParse(const uint8_t *data, size_t len, Parsed &p) {
+  p.ch = p.h = p.l = p.w = p.rv = p.mg = -1;
+  p.ratio = p.lt = -1;
+  JsonField f[] = {
+      JsonField::integer("channel", p.ch),
+      JsonField::array("doses", p.doses, 7),
+      JsonField::array("hours", p.hours, 7),
+      JsonField::array("sch", p.sch, 2 * FERT_SCHEDULE_SLOTS),
+      JsonField::number("lowStockThreshold", p.lt),
+      JsonField::integer("aqHeight", p.h),
+      JsonField::integer("aqLength", p.l),
+      JsonField::integer("aqWidth", p.w),
+      JsonField::number("primeRatio", p.ratio),
+      JsonField::integer("reservoirVolume", p.rv),
+      JsonField::integer("aqMarginCm", p.mg),
+  };
+  jsonParseObject(data, len, f, sizeof(f) / sizeof(f[0]));
+  p.schLen = f[3].count;
+}
+
+void test_benchmark_against_string_extractors() {
+  const int RUNS = 2000;
+  char body[WEB_BODY_MAX];
+  int n = snprintf(body, sizeof(body),
+                   "{\"channel\":2,\"doses\":[1.5,2,2.5,3,3.5,4,4.5],"
+                   "\"hours\":[9,9,10,10,11,11,12],\"sch\":[");
+  for (uint8_t k = 0; k < FERT_SCHEDULE_SLOTS; k++)
+    n += snprintf(body + n, sizeof(body) - n, "%s%u,%u", k ? "," : "",
+                  540 + 720 * k, 125 + k);
+  n += snprintf(body + n, sizeof(body) - n,
+                "],\"lowStockThreshold\":50,\"aqHeight\":50,"
+                "\"aqLength\":100,\"aqWidth\":40,\"primeRatio\":0.25,"
+                "\"reservoirVolume\":20,\"aqMarginCm\":3}");
+  // Request buffers are not NUL-terminated; the old code relied on one
+  const uint8_t *data = (const uint8_t *)body;
+
+  Parsed a, b;
+  legacyParse(data, n, a);
+  singlePassParse(data, n, b);
+  TEST_ASSERT_EQUAL(a.ch, b.ch);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(a.doses, b.doses, 7);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(a.hours, b.hours, 7);
+  TEST_ASSERT_EQUAL(2 * FERT_SCHEDULE_SLOTS, b.schLen);
+  TEST_ASSERT_EQUAL(a.schLen, b.schLen);
+  TEST_ASSERT_EQUAL_FLOAT_ARRAY(a.sch, b.sch, 2 * FERT_SCHEDULE_SLOTS);
+  TEST_ASSERT_EQUAL_FLOAT(a.lt, b.lt);
+  TEST_ASSERT_EQUAL(a.h, b.h);
+  TEST_ASSERT_EQUAL(a.l, b.l);
+  TEST_ASSERT_EQUAL(a.w, b.w);
+  TEST_ASSERT_EQUAL_FLOAT(a.ratio, b.ratio);
+  TEST_ASSERT_EQUAL(a.rv, b.rv);
+  TEST_ASSERT_EQUAL(a.mg, b.mg);
+
+  heapCalls = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  int sink = 0;
+  for (int r = 0; r < RUNS; r++) {
+    legacyParse(data, n, a);
+    sink += a.ch;
+  }
+  auto t1 = std::chrono::steady_clock::now();
+  size_t legacyHeap = heapCalls;
+
+  heapCalls = 0;
+  for (int r = 0; r < RUNS; r++) {
+    singlePassParse(data, n, b);
+    sink += b.ch;
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  size_t singleHeap = heapCalls;
+
+  double legacyUs =
+      std::chrono::duration<double, std::micro>(t1 - t0).count() / RUNS;
+  double singleUs =
+      std::chrono::duration<double, std::micro>(t2 - t1).count() / RUNS;
+  printf("[Bench] %d-byte body, 11 fields, %d parses (host, "
+         "std::string-backed String)\n",
+         n, RUNS);
+  printf("[Bench]   String extractors: %8.2f us/parse, %6.1f heap "
+         "calls/parse\n",
+         legacyUs, (double)legacyHeap / RUNS);
+  printf("[Bench]   jsonParseObject  : %8.2f us/parse, %6.1f heap "
+         "calls/parse\n",
+         singleUs, (double)singleHeap / RUNS);
+
+  TEST_ASSERT_TRUE(sink > 0);
+  TEST_ASSERT_EQUAL(0, singleHeap);
+  TEST_ASSERT_TRUE(legacyHeap > 20 * (size_t)RUNS);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Fields
+  RUN_TEST(test_typed_fields_and_skipped_members);
+  RUN_TEST(test_string_decoding);
+  RUN_TEST(test_float_arrays);
+
+  // Input bounds
+  RUN_TEST(test_body_without_terminator);
+  RUN_TEST(test_malformed_bodies_rejected);
+
+  // Chunk reassembly
+  RUN_TEST(test_arena_reassembles_chunks);
+
+  // Host benchmark
+  RUN_TEST(test_benchmark_against_string_extractors);
+
+  return UNITY_END();
+}
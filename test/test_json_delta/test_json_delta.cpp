@@ -0,0 +1,270 @@
+// ============================================================================
+// JsonDelta Unit Tests
+// Tests: first document kept whole, unchanged document suppressed, changed
+//        members only (nested values, commas/braces inside strings),
+//        reset/resync, members added and removed, members past the table,
+//        SSE traffic of patched topics vs the full status every 3 s
+// ============================================================================
+
+#include "Arduino.h"
+#include "Config.h"
+#include "JsonDelta.h"
+#include "JsonWriter.h"
+#include <unity.h>
+
+void setUp() {}
+
+void tearDown() {}
+
+/// Copy json into buf and filter it; returns the patch ("" if none)
+static const char *patch(JsonDelta &d, const char *json) {
+  static char buf[512];
+  size_t len = strlen(json);
+  memcpy(buf, json, len + 1);
+  size_t n = d.filter(buf, len);
+  if (n == 0)
+    buf[0] = '\0';
+  return buf;
+}
+
+// ----------------------------------------------------------------------------
+// Patches
+// ----------------------------------------------------------------------------
+
+void test_first_document_kept_then_unchanged_suppressed() {
+  JsonDelta d;
+  const char *doc = "{\"a\":1,\"b\":\"x\",\"c\":[1,2]}";
+  TEST_ASSERT_EQUAL_STRING(doc, patch(d, doc));
+  TEST_ASSERT_EQUAL_STRING("", patch(d, doc));
+
+  // An empty object is still sent once
+  JsonDelta e;
+  TEST_ASSERT_EQUAL_STRING("{}", patch(e, "{}"));
+  TEST_ASSERT_EQUAL_STRING("", patch(e, "{}"));
+}
+
+void test_only_changed_members_sent() {
+  JsonDelta d;
+  patch(d, "{\"t\":\"12:00:00\",\"s\":\"a,}\\\"b\",\"o\":{\"x\":[1,{\"y\":2}]},"
+           "\"n\":5}");
+  // Nested change: the whole member goes
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"t\":\"12:00:01\",\"o\":{\"x\":[1,{\"y\":3}]}}",
+      patch(d, "{\"t\":\"12:00:01\",\"s\":\"a,}\\\"b\",\"o\":{\"x\":[1,{\"y\":"
+               "3}]},\"n\":5}"));
+  // Last member only
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"n\":6}", patch(d, "{\"t\":\"12:00:01\",\"s\":\"a,}\\\"b\",\"o\":{"
+                            "\"x\":[1,{\"y\":3}]},\"n\":6}"));
+}
+
+void test_reset_resends_everything() {
+  JsonDelta d;
+  const char *doc = "{\"a\":1,\"b\":2}";
+  patch(d, doc);
+  d.reset();
+  TEST_ASSERT_EQUAL_STRING(doc, patch(d, doc));
+  TEST_ASSERT_EQUAL_STRING("", patch(d, doc));
+}
+
+void test_members_added_and_removed() {
+  JsonDelta d;
+  patch(d, "{\"a\":1,\"b\":2}");
+  TEST_ASSERT_EQUAL_STRING("{\"c\":3}", patch(d, "{\"a\":1,\"b\":2,\"c\":3}"));
+  // A member that disappears shifts the rest: they count as changed
+  TEST_ASSERT_EQUAL_STRING("{\"c\":3}", patch(d, "{\"a\":1,\"c\":3}"));
+  TEST_ASSERT_EQUAL_STRING("", patch(d, "{\"a\":1,\"c\":3}"));
+  // Not an object: nothing to send
+  TEST_ASSERT_EQUAL_STRING("", patch(d, "[1]"));
+}
+
+void test_members_past_table_always_sent() {
+  char doc[512];
+  JsonWriter w(doc, sizeof(doc));
+  char key[4];
+  w.beginObject();
+  for (uint8_t i = 0; i < JsonDelta::MAX_MEMBERS + 2; i++) {
+    snprintf(key, sizeof(key), "%u", i);
+    w.field(key, i);
+  }
+  w.endObject();
+  TEST_ASSERT_FALSE(w.overflowed());
+
+  JsonDelta d;
+  char copy[512];
+  memcpy(copy, doc, w.length() + 1);
+  TEST_ASSERT_EQUAL(w.length(), d.filter(copy, w.length()));
+  memcpy(copy, doc, w.length() + 1);
+  d.filter(copy, w.length());
+  TEST_ASSERT_EQUAL_STRING("{\"40\":40,\"41\":41}", copy);
+}
+
+// ----------------------------------------------------------------------------
+// Traffic: one minute of dashboard updates. Before, the full status every
+// 3 s; now "live" patches every second, "stocks" on one dose and "config"
+// once, after the resync every topic gets on connect.
+// ----------------------------------------------------------------------------
+
+static void writeLive(JsonWriter &w, unsigned s) {
+  char t[32];
+  snprintf(t, sizeof(t), "2026/10/16 12:%02u:%02u", s / 60, s % 60);
+  w.field("wifiConnected", true).field("time", t);
+  // Level drifts every 10 s while a TPA is not running
+  w.field("waterLevel", 12.5f + (s / 10) * 0.1f, 1);
+  w.field("levelRate", s / 10 % 2 ? 0.01f : 0.0f, 2);
+  w.field("levelConf", 0.95f, 2);
+  w.field("optical", false).field("float", true);
+  w.field("emergency", false).field("maintenance", false);
+  w.beginObject("sampling")
+      .field("mode", "idle")
+      .field("checkMs", 1000)
+      .field("pings", 5)
+      .field("pingMs", 60)
+      .endObject();
+  w.field("tpaState", "IDLE").field("canister", true);
+  w.field("drainOvershoot", 0.12f, 2).field("refillOvershoot", 0.08f, 2);
+  w.beginObject("agenda")
+      .field("next", 1792152000UL)
+      .field("late", 0UL)
+      .field("missed", 0UL)
+      .endObject();
+  w.beginObject("dosing")
+      .field("maxConcurrent", 2)
+      .field("budgetMA", 1000)
+      .field("running", 0)
+      .field("queued", 0);
+  w.beginObject("window")
+      .field("open", false)
+      .field("startMs", 0UL)
+      .field("endMs", 0UL)
+      .field("doses", 0)
+      .field("ml", 0.0f, 1)
+      .field("peakPumps", 0)
+      .field("peakMA", 0)
+      .endObject()
+      .endObject();
+  w.beginObject("notify")
+      .field("enabled", true)
+      .field("dailyCount", 3)
+      .field("reportHour", 8)
+      .field("reportMinute", 0);
+  w.beginArray("types");
+  for (uint8_t i = 0; i < 6; i++)
+    w.value(true);
+  w.endArray().endObject();
+}
+
+static void writeConfig(JsonWriter &w) {
+  w.field("tpaInterval", 7).field("tpaHour", 10).field("tpaMinute", 0);
+  w.field("tpaPercent", 20).field("canisterSafePct", 70);
+  w.field("primeMl", 4.5f, 1).field("aqHeight", 50).field("aqLength", 100);
+  w.field("aqWidth", 40).field("aqMarginCm", 3);
+  w.field("aquariumVolume", 200u).field("litersPerCm", 4.0f, 2);
+  w.field("drainFlowRate", 25.0f, 2).field("refillFlowRate", 22.5f, 2);
+  w.field("primeRatio", 0.0225f, 4).field("reservoirVolume", 20);
+  w.field("reservoirSafetyML", 500.0f, 0).field("tpaConfigReady", true);
+  w.field("language", 1);
+}
+
+static void writeStock(JsonWriter &w, uint8_t i, float stock) {
+  w.beginObject().field("stock", stock, 0).field("name", "Macro NPK");
+  w.beginArray("doses");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(2.5f, 1);
+  w.endArray().beginArray("sH");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(9);
+  w.endArray().beginArray("sM");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(0);
+  w.endArray().beginArray("sch");
+  for (uint8_t d = 0; d < 7; d++)
+    w.value(540 + 1440 * d).value(250);
+  w.endArray().field("fR", 1.25f, 2).field("pwm", 200).field("mA", 310);
+  w.field("runS", 86400UL + i).endObject();
+}
+
+static void writeStocks(JsonWriter &w, float firstStock) {
+  char key[4];
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    snprintf(key, sizeof(key), "%u", i);
+    w.key(key);
+    writeStock(w, i, i == 0 ? firstStock : 480.0f);
+  }
+  w.beginArray("lowStockThresholds");
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+    w.value(50.0f, 0);
+  w.endArray();
+}
+
+static size_t sendTopic(JsonDelta &d, char *buf, size_t size, unsigned s,
+                        int topic, float firstStock) {
+  JsonWriter w(buf, size);
+  w.beginObject();
+  if (topic == 0)
+    writeLive(w, s);
+  else if (topic == 1)
+    writeConfig(w);
+  else
+    writeStocks(w, firstStock);
+  w.endObject();
+  TEST_ASSERT_FALSE(w.overflowed());
+  return d.filter(buf, w.length());
+}
+
+void test_patched_topics_traffic() {
+  static char buf[WEB_STATUS_JSON_MAX];
+  const unsigned SECONDS = 60;
+
+  // Full status (all three topics in one document) every 3 s
+  size_t fullBytes = 0;
+  for (unsigned s = 0; s < SECONDS; s += 3) {
+    JsonWriter w(buf, sizeof(buf));
+    w.beginObject();
+    writeLive(w, s);
+    writeConfig(w);
+    w.beginArray("stocks");
+    for (uint8_t i = 0; i < NUM_FERTS + 1; i++)
+      writeStock(w, i, s < 30 ? 480.0f : 477.5f);
+    w.endArray().endObject();
+    fullBytes += w.length();
+  }
+
+  JsonDelta live, config, stocks;
+  size_t resyncBytes = sendTopic(live, buf, sizeof(buf), 0, 0, 480.0f) +
+                       sendTopic(config, buf, sizeof(buf), 0, 1, 480.0f) +
+                       sendTopic(stocks, buf, sizeof(buf), 0, 2, 480.0f);
+  size_t patchBytes = 0;
+  for (unsigned s = 1; s < SECONDS; s++) {
+    patchBytes += sendTopic(live, buf, sizeof(buf), s, 0, 0);
+    if (s == 30) {
+      // A dose on channel 1: only that channel goes out
+      size_t n = sendTopic(stocks, buf, sizeof(buf), s, 2, 477.5f);
+      TEST_ASSERT_EQUAL('0', buf[2]);
+      TEST_ASSERT_NULL(strstr(buf, "\"1\":"));
+      patchBytes += n;
+    }
+  }
+
+  printf("[Traffic] %us: full status every 3 s %u bytes; resync %u + "
+         "patches %u bytes (%.1fx fewer after connect)\n",
+         SECONDS, (unsigned)fullBytes, (unsigned)resyncBytes,
+         (unsigned)patchBytes, (double)fullBytes / patchBytes);
+  TEST_ASSERT_TRUE(patchBytes * 10 < fullBytes);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Patches
+  RUN_TEST(test_first_document_kept_then_unchanged_suppressed);
+  RUN_TEST(test_only_changed_members_sent);
+  RUN_TEST(test_reset_resends_everything);
+  RUN_TEST(test_members_added_and_removed);
+  RUN_TEST(test_members_past_table_always_sent);
+
+  // Traffic
+  RUN_TEST(test_patched_topics_traffic);
+
+  return UNITY_END();
+}
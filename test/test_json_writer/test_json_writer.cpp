@@ -0,0 +1,329 @@
+// ============================================================================
+// JsonWriter Unit Tests
+// Tests: commas and nesting, number formatting, string escaping, buffer
+//        overflow, Print sink, host benchmark against String concatenation
+//        (heap calls and microseconds per status build)
+// ============================================================================
+
+#include "Arduino.h"
+#include "Config.h"
+#include "JsonWriter.h"
+#include <chrono>
+#include <new>
+#include <unity.h>
+
+// Every heap allocation in the process goes through here
+static size_t heapCalls = 0;
+
+void *operator new(size_t n) {
+  heapCalls++;
+  void *p = malloc(n ? n : 1);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+void setUp() { heapCalls = 0; }
+
+void tearDown() {}
+
+/// Print collecting into a fixed buffer
+class BufPrint : public Print {
+public:
+  char text[512] = {};
+  size_t len = 0;
+  size_t calls = 0;
+  size_t write(uint8_t c) override { return write(&c, 1); }
+  size_t write(const uint8_t *buf, size_t n) override {
+    calls++;
+    memcpy(text + len, buf, n);
+    len += n;
+    return n;
+  }
+};
+
+// ----------------------------------------------------------------------------
+// Structure and values
+// ----------------------------------------------------------------------------
+
+void test_commas_and_nesting() {
+  char buf[128];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject()
+      .field("a", 1)
+      .beginArray("b")
+      .value(true)
+      .beginObject()
+      .endObject()
+      .beginArray()
+      .endArray()
+      .endArray()
+      .beginObject("c")
+      .field("d", "x")
+      .endObject()
+      .key("e")
+      .nullValue()
+      .key("f")
+      .raw("[1,2]")
+      .endObject();
+  TEST_ASSERT_EQUAL_STRING(
+      "{\"a\":1,\"b\":[true,{},[]],\"c\":{\"d\":\"x\"},\"e\":null,"
+      "\"f\":[1,2]}",
+      w.c_str());
+  TEST_ASSERT_FALSE(w.overflowed());
+  TEST_ASSERT_EQUAL(strlen(buf), w.length());
+}
+
+void test_number_formatting() {
+  char buf[160];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginArray()
+      .value(-42)
+      .value(0u)
+      .value(4294967295UL)
+      .value(18446744073709551615ULL)
+      .value((long long)-9000000000LL)
+      .value((uint8_t)7)
+      .value(12.5f, 1)
+      .value(0.37f)
+      .value(2.0f, 0)
+      .value(-0.04f, 1) // Rounds to zero: no sign
+      .value(-3.25f, 1)
+      .value(0.000125f, 6)
+      .value(NAN)
+      .value(INFINITY, 1)
+      .endArray();
+  TEST_ASSERT_EQUAL_STRING("[-42,0,4294967295,18446744073709551615,"
+                           "-9000000000,7,12.5,0.37,2,0.0,-3.3,0.000125,"
+                           "null,null]",
+                           w.c_str());
+}
+
+void test_string_escaping() {
+  char buf[96];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject().field("n\"k", "a\"b\\c\nd\te\x01").endObject();
+  TEST_ASSERT_EQUAL_STRING("{\"n\\\"k\":\"a\\\"b\\\\c\\nd\\te\\u0001\"}",
+                           w.c_str());
+}
+
+void test_overflow_is_flagged_and_terminated() {
+  char buf[8];
+  JsonWriter w(buf, sizeof(buf));
+  w.beginObject().field("level", 123).endObject();
+  TEST_ASSERT_TRUE(w.overflowed());
+  TEST_ASSERT_EQUAL(7, w.length());
+  TEST_ASSERT_EQUAL_STRING("{\"level", buf);
+
+  w.reset();
+  w.value(1);
+  TEST_ASSERT_FALSE(w.overflowed());
+  TEST_ASSERT_EQUAL_STRING("1", buf);
+}
+
+void test_print_sink_matches_buffer() {
+  BufPrint out;
+  JsonWriter s(out);
+  char buf[64];
+  JsonWriter b(buf, sizeof(buf));
+  JsonWriter *both[] = {&s, &b};
+  for (JsonWriter *w : both)
+    w->beginObject().field("x", 1.5f, 1).field("y", "z").endObject();
+
+  TEST_ASSERT_EQUAL_STRING(buf, out.text);
+  TEST_ASSERT_EQUAL(b.length(), s.length());
+  TEST_ASSERT_EQUAL(0, heapCalls);
+}
+
+// ----------------------------------------------------------------------------
+// Host benchmark: status payload built the old way (String per field, as
+// WebManager did) and with JsonWriter into a reused buffer
+// ----------------------------------------------------------------------------
+
+struct BenchStock {
+  float stock;
+  const char *name;
+  float doses[7];
+  uint8_t sH[7], sM[7];
+  uint16_t sch[FERT_SCHEDULE_SLOTS][2];
+  uint8_t schCount;
+  float fR;
+  uint8_t pwm;
+  uint16_t mA;
+  unsigned long runS;
+};
+
+static BenchStock benchStocks[NUM_FERTS + 1];
+
+static void fillBenchStocks() {
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    BenchStock &s = benchStocks[i];
+    s.stock = 480.0f + i;
+    s.name = i < NUM_FERTS ? "Macro NPK" : "Prime";
+    for (uint8_t d = 0; d < 7; d++) {
+      s.doses[d] = 2.5f + d;
+      s.sH[d] = 9 + d;
+      s.sM[d] = 5 * d;
+    }
+    s.schCount = FERT_SCHEDULE_SLOTS;
+    for (uint8_t k = 0; k < s.schCount; k++) {
+      s.sch[k][0] = 540 + 720 * k;
+      s.sch[k][1] = 125;
+    }
+    s.fR = 1.25f;
+    s.pwm = 200;
+    s.mA = 310;
+    s.runS = 86400UL + i;
+  }
+}
+
+static String legacyStatus() {
+  String json;
+  json.reserve(1200);
+  json += "{";
+  json += "\"wifiConnected\":" + String(true ? "true" : "false") + ",";
+  json += "\"time\":\"" + String("2026/10/16 12:00:00") + "\",";
+  json += "\"waterLevel\":" + String(12.5f, 1) + ",";
+  json += "\"levelRate\":" + String(0.25f, 2) + ",";
+  json += "\"tpaState\":\"" + String("IDLE") + "\",";
+  json += "\"tpaInterval\":" + String(7) + ",";
+  json += "\"tpaHour\":" + String(10) + ",";
+  json += "\"primeMl\":" + String(4.5f, 1) + ",";
+  json += "\"aquariumVolume\":" + String(240u) + ",";
+  json += "\"litersPerCm\":" + String(4.75f, 2) + ",";
+  json += "\"language\":" + String(1) + ",";
+  json += "\"stocks\":[";
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    const BenchStock &s = benchStocks[i];
+    if (i > 0)
+      json += ",";
+    json += "{\"stock\":" + String(s.stock, 0) + ",\"name\":\"" +
+            String(s.name) + "\"" + ",\"doses\":[" + String(s.doses[0], 1) +
+            "," + String(s.doses[1], 1) + "," + String(s.doses[2], 1) + "," +
+            String(s.doses[3], 1) + "," + String(s.doses[4], 1) + "," +
+            String(s.doses[5], 1) + "," + String(s.doses[6], 1) + "]" +
+            ",\"sH\":[";
+    for (uint8_t d = 0; d < 7; d++) {
+      if (d > 0)
+        json += ",";
+      json += String(s.sH[d]);
+    }
+    json += "],\"sM\":[";
+    for (uint8_t d = 0; d < 7; d++) {
+      if (d > 0)
+        json += ",";
+      json += String(s.sM[d]);
+    }
+    json += "],\"sch\":[";
+    for (uint8_t k = 0; k < s.schCount; k++) {
+      if (k > 0)
+        json += ",";
+      json += String(s.sch[k][0]) + "," + String(s.sch[k][1]);
+    }
+    json += "]" + String(",\"fR\":") + String(s.fR, 2) +
+            ",\"pwm\":" + String(s.pwm) + ",\"mA\":" + String(s.mA) +
+            ",\"runS\":" + String(s.runS) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+static void writerStatus(JsonWriter &w) {
+  w.beginObject();
+  w.field("wifiConnected", true);
+  w.field("time", "2026/10/16 12:00:00");
+  w.field("waterLevel", 12.5f, 1);
+  w.field("levelRate", 0.25f, 2);
+  w.field("tpaState", "IDLE");
+  w.field("tpaInterval", 7);
+  w.field("tpaHour", 10);
+  w.field("primeMl", 4.5f, 1);
+  w.field("aquariumVolume", 240u);
+  w.field("litersPerCm", 4.75f, 2);
+  w.field("language", 1);
+  w.beginArray("stocks");
+  for (uint8_t i = 0; i < NUM_FERTS + 1; i++) {
+    const BenchStock &s = benchStocks[i];
+    w.beginObject().field("stock", s.stock, 0).field("name", s.name);
+    w.beginArray("doses");
+    for (uint8_t d = 0; d < 7; d++)
+      w.value(s.doses[d], 1);
+    w.endArray().beginArray("sH");
+    for (uint8_t d = 0; d < 7; d++)
+      w.value(s.sH[d]);
+    w.endArray().beginArray("sM");
+    for (uint8_t d = 0; d < 7; d++)
+      w.value(s.sM[d]);
+    w.endArray().beginArray("sch");
+    for (uint8_t k = 0; k < s.schCount; k++)
+      w.value(s.sch[k][0]).value(s.sch[k][1]);
+    w.endArray();
+    w.field("fR", s.fR, 2).field("pwm", s.pwm).field("mA", s.mA);
+    w.field("runS", s.runS).endObject();
+  }
+  w.endArray().endObject();
+}
+
+void test_benchmark_against_string_concat() {
+  const int RUNS = 2000;
+  fillBenchStocks();
+  static char buf[WEB_STATUS_JSON_MAX];
+
+  // Same text both ways
+  String legacy = legacyStatus();
+  JsonWriter w(buf, sizeof(buf));
+  writerStatus(w);
+  TEST_ASSERT_FALSE(w.overflowed());
+  TEST_ASSERT_EQUAL_STRING(legacy.c_str(), w.c_str());
+
+  heapCalls = 0;
+  auto t0 = std::chrono::steady_clock::now();
+  size_t sink = 0;
+  for (int r = 0; r < RUNS; r++)
+    sink += legacyStatus().length();
+  auto t1 = std::chrono::steady_clock::now();
+  size_t legacyHeap = heapCalls;
+
+  heapCalls = 0;
+  for (int r = 0; r < RUNS; r++) {
+    w.reset();
+    writerStatus(w);
+    sink += w.length();
+  }
+  auto t2 = std::chrono::steady_clock::now();
+  size_t writerHeap = heapCalls;
+
+  double legacyUs =
+      std::chrono::duration<double, std::micro>(t1 - t0).count() / RUNS;
+  double writerUs =
+      std::chrono::duration<double, std::micro>(t2 - t1).count() / RUNS;
+  printf("[Bench] %u-byte status, %d builds (host, std::string-backed "
+         "String)\n",
+         (unsigned)w.length(), RUNS);
+  printf("[Bench]   String concat: %8.2f us/build, %6.1f heap calls/build\n",
+         legacyUs, (double)legacyHeap / RUNS);
+  printf("[Bench]   JsonWriter   : %8.2f us/build, %6.1f heap calls/build\n",
+         writerUs, (double)writerHeap / RUNS);
+
+  TEST_ASSERT_TRUE(sink > 0);
+  TEST_ASSERT_EQUAL(0, writerHeap);
+  TEST_ASSERT_TRUE(legacyHeap > 100 * (size_t)RUNS);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Structure and values
+  RUN_TEST(test_commas_and_nesting);
+  RUN_TEST(test_number_formatting);
+  RUN_TEST(test_string_escaping);
+  RUN_TEST(test_overflow_is_flagged_and_terminated);
+  RUN_TEST(test_print_sink_matches_buffer);
+
+  // Host benchmark
+  RUN_TEST(test_benchmark_against_string_concat);
+
+  return UNITY_END();
+}
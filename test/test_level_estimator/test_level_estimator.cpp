@@ -0,0 +1,154 @@
+// ============================================================================
+// LevelEstimator Unit Tests
+// Tests: seeding, smoothing, rate tracking, outlier gating, confidence
+// ============================================================================
+
+#include "Arduino.h"
+#include "LevelEstimator.h"
+#include <unity.h>
+
+void setUp() {}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Seeding
+// ----------------------------------------------------------------------------
+
+void test_first_sample_seeds_level() {
+  LevelEstimator est;
+  TEST_ASSERT_FALSE(est.isValid());
+  TEST_ASSERT_EQUAL_FLOAT(-1.0f, est.level());
+
+  est.update(20.0f, 1000);
+  TEST_ASSERT_TRUE(est.isValid());
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, est.level());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, est.rate());
+  TEST_ASSERT_EQUAL(1000, est.lastUpdateMs());
+}
+
+void test_reset_clears_state() {
+  LevelEstimator est;
+  est.update(20.0f, 1000);
+  est.reset();
+  TEST_ASSERT_FALSE(est.isValid());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, est.confidence(1000));
+}
+
+// ----------------------------------------------------------------------------
+// Filtering
+// ----------------------------------------------------------------------------
+
+void test_noise_is_smoothed() {
+  LevelEstimator est;
+  uint32_t t = 0;
+  for (uint8_t i = 0; i < 40; i++, t += 30) {
+    est.update((i % 2) ? 20.5f : 19.5f, t); // ±0.5 cm jitter
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.3f, 20.0f, est.level());
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 0.0f, est.rate());
+}
+
+void test_tracks_constant_rate() {
+  LevelEstimator est;
+  // Distance shrinking 2 cm/s (water rising), one ping every 30 ms
+  uint32_t t = 0;
+  for (uint16_t i = 0; i < 200; i++, t += 30) {
+    est.update(30.0f - 2.0f * t / 1000.0f, t);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, -2.0f, est.rate());
+
+  // Predict one second past the last sample
+  float expected = 30.0f - 2.0f * (t - 30 + 1000) / 1000.0f;
+  TEST_ASSERT_FLOAT_WITHIN(0.2f, expected, est.predict(t - 30 + 1000));
+}
+
+// ----------------------------------------------------------------------------
+// Outlier gating
+// ----------------------------------------------------------------------------
+
+void test_single_outlier_rejected() {
+  LevelEstimator est;
+  for (uint32_t t = 0; t < 300; t += 30)
+    est.update(20.0f, t);
+
+  TEST_ASSERT_FALSE(est.update(3.0f, 300)); // Spurious echo
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f, est.level());
+  TEST_ASSERT_EQUAL(270, est.lastUpdateMs());
+
+  TEST_ASSERT_TRUE(est.update(20.0f, 330));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f, est.level());
+}
+
+void test_repeated_outliers_reseed() {
+  LevelEstimator est;
+  for (uint32_t t = 0; t < 300; t += 30)
+    est.update(20.0f, t);
+
+  // The level really jumped (e.g. sensor moved): re-seed after N rejects
+  uint32_t t = 300;
+  for (uint8_t i = 0; i < LEVEL_EST_MAX_REJECTS - 1; i++, t += 30)
+    TEST_ASSERT_FALSE(est.update(30.0f, t));
+  TEST_ASSERT_TRUE(est.update(30.0f, t));
+  TEST_ASSERT_EQUAL_FLOAT(30.0f, est.level());
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, est.rate());
+}
+
+// ----------------------------------------------------------------------------
+// Confidence
+// ----------------------------------------------------------------------------
+
+void test_confidence_warms_up_and_decays() {
+  LevelEstimator est;
+  est.update(20.0f, 0);
+  float early = est.confidence(0);
+
+  uint32_t t = 30;
+  for (uint8_t i = 0; i < LEVEL_EST_WARMUP; i++, t += 30)
+    est.update(20.0f, t);
+  float warm = est.confidence(t - 30);
+
+  TEST_ASSERT_TRUE(early < LEVEL_EST_MIN_CONFIDENCE);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1.0f, warm);
+
+  // No new samples: confidence fades out
+  TEST_ASSERT_TRUE(est.confidence(t + LEVEL_EST_STALE_MS / 2) < warm);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, est.confidence(t + LEVEL_EST_STALE_MS));
+}
+
+void test_outlier_lowers_confidence() {
+  LevelEstimator est;
+  uint32_t t = 0;
+  for (; t < 300; t += 30)
+    est.update(20.0f, t);
+  float before = est.confidence(t);
+  est.update(5.0f, t);
+  TEST_ASSERT_TRUE(est.confidence(t) < before);
+}
+
+// ============================================================================
+// MAIN
+// ============================================================================
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Seeding
+  RUN_TEST(test_first_sample_seeds_level);
+  RUN_TEST(test_reset_clears_state);
+
+  // Filtering
+  RUN_TEST(test_noise_is_smoothed);
+  RUN_TEST(test_tracks_constant_rate);
+
+  // Outlier gating
+  RUN_TEST(test_single_outlier_rejected);
+  RUN_TEST(test_repeated_outliers_reseed);
+
+  // Confidence
+  RUN_TEST(test_confidence_warms_up_and_decays);
+  RUN_TEST(test_outlier_lowers_confidence);
+
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,178 @@
+// ============================================================================
+// LoopProfiler Unit Tests
+// Tests: per-stage statistics, log2 histogram, worst iteration, reset, JSON
+// ============================================================================
+
+#include "Arduino.h"
+#include "LoopProfiler.h"
+#include <esp_timer.h>
+#include <unity.h>
+
+static const char *const STAGE_NAMES[] = {"alpha", "beta", "gamma"};
+
+void setUp() {
+  mock_millis_value = 0;
+  mock_esp_timer_extra_us = 0;
+}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Stage statistics
+// ----------------------------------------------------------------------------
+
+void test_record_tracks_min_avg_max() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  perf.record(1, 100);
+  perf.record(1, 300);
+  perf.record(1, 200);
+
+  LoopProfiler::StageStats s = perf.getStage(1);
+  TEST_ASSERT_EQUAL_UINT32(3, s.count);
+  TEST_ASSERT_EQUAL_UINT32(100, s.minUs);
+  TEST_ASSERT_EQUAL_UINT32(200, s.avgUs());
+  TEST_ASSERT_EQUAL_UINT32(300, s.maxUs);
+  TEST_ASSERT_EQUAL_UINT32(200, s.lastUs);
+
+  // Untouched stage reports zeros, not the UINT32_MAX sentinel
+  LoopProfiler::StageStats empty = perf.getStage(0);
+  TEST_ASSERT_EQUAL_UINT32(0, empty.count);
+  TEST_ASSERT_EQUAL_UINT32(0, empty.minUs);
+  TEST_ASSERT_EQUAL_UINT32(0, empty.avgUs());
+}
+
+void test_record_ignores_unknown_stage() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  perf.record(3, 100);
+  perf.record(PERF_MAX_STAGES, 100);
+  for (uint8_t i = 0; i < 3; i++)
+    TEST_ASSERT_EQUAL_UINT32(0, perf.getStage(i).count);
+}
+
+void test_histogram_buckets_are_log2() {
+  TEST_ASSERT_EQUAL_UINT8(0, LoopProfiler::bucketFor(0));
+  TEST_ASSERT_EQUAL_UINT8(1, LoopProfiler::bucketFor(1));
+  TEST_ASSERT_EQUAL_UINT8(2, LoopProfiler::bucketFor(3));
+  TEST_ASSERT_EQUAL_UINT8(10, LoopProfiler::bucketFor(1000));
+  TEST_ASSERT_EQUAL_UINT8(11, LoopProfiler::bucketFor(1024));
+  TEST_ASSERT_EQUAL_UINT8(PERF_HIST_BUCKETS - 1,
+                          LoopProfiler::bucketFor(UINT32_MAX));
+
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  perf.record(0, 1000);
+  perf.record(0, 1023);
+  perf.record(0, 5000000);
+  LoopProfiler::StageStats s = perf.getStage(0);
+  TEST_ASSERT_EQUAL_UINT32(2, s.hist[10]);
+  TEST_ASSERT_EQUAL_UINT32(1, s.hist[PERF_HIST_BUCKETS - 1]);
+}
+
+// ----------------------------------------------------------------------------
+// Iterations
+// ----------------------------------------------------------------------------
+
+void test_worst_iteration_keeps_stage_breakdown() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+
+  perf.beginIteration();
+  perf.record(0, 100);
+  mock_esp_timer_extra_us = 500;
+  perf.endIteration();
+
+  mock_millis_value = 1000;
+  mock_esp_timer_extra_us = 0;
+  perf.beginIteration();
+  perf.record(1, 2000);
+  perf.record(1, 1000); // Same stage twice in one iteration accumulates
+  perf.record(2, 50);
+  mock_esp_timer_extra_us = 4000;
+  perf.endIteration();
+
+  mock_millis_value = 2000;
+  mock_esp_timer_extra_us = 0;
+  perf.beginIteration();
+  mock_esp_timer_extra_us = 10;
+  perf.endIteration();
+
+  TEST_ASSERT_EQUAL_UINT32(3, perf.getIterations());
+  LoopProfiler::Iteration w = perf.getWorst();
+  TEST_ASSERT_EQUAL_UINT32(4000, w.totalUs);
+  TEST_ASSERT_EQUAL_UINT32(1000, w.atMs);
+  TEST_ASSERT_EQUAL_UINT32(0, w.stageUs[0]);
+  TEST_ASSERT_EQUAL_UINT32(3000, w.stageUs[1]);
+  TEST_ASSERT_EQUAL_UINT32(50, w.stageUs[2]);
+}
+
+void test_end_without_begin_is_ignored() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  perf.endIteration();
+  TEST_ASSERT_EQUAL_UINT32(0, perf.getIterations());
+}
+
+void test_perf_scope_times_enclosed_block() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  {
+    PerfScope scope(perf, 2);
+    mock_esp_timer_extra_us = 750;
+  }
+  LoopProfiler::StageStats s = perf.getStage(2);
+  TEST_ASSERT_EQUAL_UINT32(1, s.count);
+  TEST_ASSERT_EQUAL_UINT32(750, s.lastUs);
+}
+
+void test_reset_clears_everything() {
+  LoopProfiler perf("t", STAGE_NAMES, 3);
+  perf.beginIteration();
+  perf.record(0, 100);
+  mock_esp_timer_extra_us = 200;
+  perf.endIteration();
+
+  perf.reset();
+  TEST_ASSERT_EQUAL_UINT32(0, perf.getIterations());
+  TEST_ASSERT_EQUAL_UINT32(0, perf.getWorst().totalUs);
+  LoopProfiler::StageStats s = perf.getStage(0);
+  TEST_ASSERT_EQUAL_UINT32(0, s.count);
+  TEST_ASSERT_EQUAL_UINT32(0, s.hist[7]);
+
+  // Min tracking restarts after a reset
+  perf.record(0, 40);
+  TEST_ASSERT_EQUAL_UINT32(40, perf.getStage(0).minUs);
+}
+
+// ----------------------------------------------------------------------------
+// Reports
+// ----------------------------------------------------------------------------
+
+void test_append_json_lists_stages() {
+  LoopProfiler perf("ctl", STAGE_NAMES, 3);
+  perf.record(1, 42);
+
+  String json;
+  perf.appendJSON(json);
+  const char *s = json.c_str();
+  TEST_ASSERT_NOT_NULL(strstr(s, "\"name\":\"ctl\""));
+  TEST_ASSERT_NOT_NULL(strstr(s, "\"name\":\"beta\",\"count\":1,\"minUs\":42"));
+  TEST_ASSERT_NOT_NULL(strstr(s, "\"name\":\"gamma\""));
+  TEST_ASSERT_TRUE(s[strlen(s) - 1] == '}');
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Stage statistics
+  RUN_TEST(test_record_tracks_min_avg_max);
+  RUN_TEST(test_record_ignores_unknown_stage);
+  RUN_TEST(test_histogram_buckets_are_log2);
+
+  // Iterations
+  RUN_TEST(test_worst_iteration_keeps_stage_breakdown);
+  RUN_TEST(test_end_without_begin_is_ignored);
+  RUN_TEST(test_perf_scope_times_enclosed_block);
+  RUN_TEST(test_reset_clears_everything);
+
+  // Reports
+  RUN_TEST(test_append_json_lists_stages);
+
+  UNITY_END();
+  return 0;
+}
@@ -0,0 +1,233 @@
+// ============================================================================
+// LoopScheduler Unit Tests
+// Tests: periodic release, priority order, deadline misses, sleep time
+// ============================================================================
+
+#include "Arduino.h"
+#include "LoopScheduler.h"
+#include <unity.h>
+
+// Execution log shared by the job callbacks
+static char runLog[32];
+static uint8_t runLen;
+static unsigned long jobCostMs; // Simulated run time of job 'a'
+
+static void logRun(char c) {
+  if (runLen < sizeof(runLog) - 1)
+    runLog[runLen++] = c;
+  runLog[runLen] = '\0';
+}
+
+static void jobA() {
+  logRun('a');
+  mock_millis_value += jobCostMs;
+}
+static void jobB() { logRun('b'); }
+static void jobC() { logRun('c'); }
+
+void setUp() {
+  mock_millis_value = 1000;
+  runLen = 0;
+  runLog[0] = '\0';
+  jobCostMs = 0;
+}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// Release and ordering
+// ----------------------------------------------------------------------------
+
+void test_new_jobs_run_immediately_then_on_period() {
+  LoopScheduler sched;
+  TEST_ASSERT_EQUAL_INT8(0, sched.addJob("a", jobA, 100, 1));
+  TEST_ASSERT_EQUAL_INT8(1, sched.addJob("b", jobB, 250, 1));
+
+  TEST_ASSERT_EQUAL_UINT8(2, sched.runDue());
+  TEST_ASSERT_EQUAL_UINT8(0, sched.runDue()); // Each job once per release
+
+  mock_millis_value += 99;
+  TEST_ASSERT_EQUAL_UINT8(0, sched.runDue());
+  mock_millis_value += 1;
+  TEST_ASSERT_EQUAL_UINT8(1, sched.runDue());
+  mock_millis_value += 150; // a (release 1200) and b (1250) both due
+  TEST_ASSERT_EQUAL_UINT8(2, sched.runDue());
+  TEST_ASSERT_EQUAL_STRING("abaab", runLog);
+}
+
+void test_higher_priority_runs_first() {
+  LoopScheduler sched;
+  sched.addJob("a", jobA, 100, 1);
+  sched.addJob("b", jobB, 100, 5);
+  sched.addJob("c", jobC, 100, 3);
+
+  sched.runDue();
+  TEST_ASSERT_EQUAL_STRING("bca", runLog);
+}
+
+void test_equal_priority_earliest_release_first() {
+  LoopScheduler sched;
+  sched.addJob("a", jobA, 100, 2);
+  mock_millis_value += 10;
+  sched.addJob("b", jobB, 100, 2);
+
+  mock_millis_value += 200;
+  sched.runDue();
+  TEST_ASSERT_EQUAL_STRING("ab", runLog);
+}
+
+void test_trigger_releases_job_early() {
+  LoopScheduler sched;
+  int8_t b = sched.addJob("b", jobB, 1000, 1);
+  sched.runDue();
+
+  mock_millis_value += 10;
+  sched.trigger(b);
+  TEST_ASSERT_EQUAL_UINT8(1, sched.runDue());
+  TEST_ASSERT_EQUAL_STRING("bb", runLog);
+}
+
+void test_add_job_rejects_invalid_and_overflow() {
+  LoopScheduler sched;
+  TEST_ASSERT_EQUAL_INT8(-1, sched.addJob("z", jobB, 0, 1));
+  TEST_ASSERT_EQUAL_INT8(-1, sched.addJob("z", nullptr, 10, 1));
+  for (uint8_t i = 0; i < SCHED_MAX_JOBS; i++)
+    TEST_ASSERT_EQUAL_INT8(i, sched.addJob("b", jobB, 10, 1));
+  TEST_ASSERT_EQUAL_INT8(-1, sched.addJob("b", jobB, 10, 1));
+  TEST_ASSERT_EQUAL_UINT8(SCHED_MAX_JOBS, sched.getJobCount());
+}
+
+// ----------------------------------------------------------------------------
+// Deadlines
+// ----------------------------------------------------------------------------
+
+void test_late_start_counts_deadline_miss() {
+  LoopScheduler sched;
+  sched.addJob("a", jobA, 100, 5);     // Runs first, takes 30 ms
+  sched.addJob("b", jobB, 100, 1, 20); // Allowed 20 ms of lateness
+  sched.addJob("c", jobC, 100, 1, 50); // Allowed 50 ms
+  jobCostMs = 30;
+
+  sched.runDue();
+  TEST_ASSERT_EQUAL_STRING("abc", runLog);
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getJob(0).misses);
+  TEST_ASSERT_EQUAL_UINT32(1, sched.getJob(1).misses);
+  TEST_ASSERT_EQUAL_UINT32(30, sched.getJob(1).maxLateMs);
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getJob(2).misses);
+  TEST_ASSERT_EQUAL_UINT32(1, sched.getTotalMisses());
+}
+
+void test_overrun_drops_missed_releases_without_burst() {
+  LoopScheduler sched;
+  sched.addJob("b", jobB, 100, 1);
+  sched.runDue(); // Release at 1000
+
+  // Loop blocked for 350 ms: releases at 1100, 1200, 1300 are due
+  mock_millis_value += 350;
+  TEST_ASSERT_EQUAL_UINT8(1, sched.runDue());
+  TEST_ASSERT_EQUAL_UINT8(0, sched.runDue());
+  // Late run (250 ms > deadline) plus two dropped releases
+  TEST_ASSERT_EQUAL_UINT32(3, sched.getJob(0).misses);
+
+  // Period grid is kept: next release at 1400
+  TEST_ASSERT_EQUAL_UINT32(50, sched.msUntilNext());
+}
+
+void test_reset_stats_keeps_schedule() {
+  LoopScheduler sched;
+  sched.addJob("b", jobB, 100, 1);
+  sched.runDue();
+  mock_millis_value += 500;
+  sched.runDue();
+  TEST_ASSERT_TRUE(sched.getJob(0).misses > 0);
+
+  sched.resetStats();
+  LoopScheduler::JobStats s = sched.getJob(0);
+  TEST_ASSERT_EQUAL_UINT32(0, s.runs);
+  TEST_ASSERT_EQUAL_UINT32(0, s.misses);
+  TEST_ASSERT_EQUAL_UINT32(0, s.maxLateMs);
+  TEST_ASSERT_EQUAL_UINT32(100, s.periodMs);
+  TEST_ASSERT_EQUAL_UINT32(100, sched.msUntilNext());
+}
+
+// ----------------------------------------------------------------------------
+// Sleep time
+// ----------------------------------------------------------------------------
+
+void test_ms_until_next_tracks_earliest_release() {
+  LoopScheduler sched;
+  TEST_ASSERT_EQUAL_UINT32(SCHED_MAX_SLEEP_MS, sched.msUntilNext());
+
+  sched.addJob("a", jobA, 300, 1);
+  sched.addJob("b", jobB, 120, 1);
+  TEST_ASSERT_EQUAL_UINT32(0, sched.msUntilNext()); // Both due now
+
+  sched.runDue();
+  TEST_ASSERT_EQUAL_UINT32(120, sched.msUntilNext());
+  mock_millis_value += 100;
+  TEST_ASSERT_EQUAL_UINT32(20, sched.msUntilNext());
+}
+
+void test_ms_until_next_is_capped() {
+  LoopScheduler sched;
+  sched.addJob("a", jobA, 30000, 1);
+  sched.runDue();
+  TEST_ASSERT_EQUAL_UINT32(SCHED_MAX_SLEEP_MS, sched.msUntilNext());
+}
+
+void test_survives_millis_wraparound() {
+  mock_millis_value = 0xFFFFFFFFUL - 50;
+  LoopScheduler sched;
+  sched.addJob("b", jobB, 100, 1);
+  sched.runDue();
+  TEST_ASSERT_EQUAL_UINT32(100, sched.msUntilNext());
+
+  mock_millis_value = 49; // 100 ms later, across the wrap
+  TEST_ASSERT_EQUAL_UINT8(1, sched.runDue());
+  TEST_ASSERT_EQUAL_UINT32(0, sched.getJob(0).misses);
+}
+
+// ----------------------------------------------------------------------------
+// Reports
+// ----------------------------------------------------------------------------
+
+void test_append_json_lists_jobs() {
+  LoopScheduler sched;
+  sched.addJob("serial", jobB, 50, 4);
+  sched.addJob("web", jobC, 100, 3);
+  sched.runDue();
+
+  String json;
+  sched.appendJSON(json);
+  const char *s = json.c_str();
+  TEST_ASSERT_NOT_NULL(strstr(s, "\"name\":\"serial\",\"priority\":4"));
+  TEST_ASSERT_NOT_NULL(strstr(s, "\"name\":\"web\""));
+  TEST_ASSERT_TRUE(s[0] == '[' && s[strlen(s) - 1] == ']');
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Release and ordering
+  RUN_TEST(test_new_jobs_run_immediately_then_on_period);
+  RUN_TEST(test_higher_priority_runs_first);
+  RUN_TEST(test_equal_priority_earliest_release_first);
+  RUN_TEST(test_trigger_releases_job_early);
+  RUN_TEST(test_add_job_rejects_invalid_and_overflow);
+
+  // Deadlines
+  RUN_TEST(test_late_start_counts_deadline_miss);
+  RUN_TEST(test_overrun_drops_missed_releases_without_burst);
+  RUN_TEST(test_reset_stats_keeps_schedule);
+
+  // Sleep time
+  RUN_TEST(test_ms_until_next_tracks_earliest_release);
+  RUN_TEST(test_ms_until_next_is_capped);
+  RUN_TEST(test_survives_millis_wraparound);
+
+  // Reports
+  RUN_TEST(test_append_json_lists_jobs);
+
+  UNITY_END();
+  return 0;
+}
@@ -1,11 +1,13 @@
 // ============================================================================
 // NotifyManager Unit Tests
-// Tests: rate limiting, cooldown, per-type toggles, daily counter
+// Tests: rate limiting, cooldown, per-type toggles, daily counter,
+//        persistence through the settings registry
 // ============================================================================
 
 #include "Arduino.h"
 #include "NotifyManager.h"
 #include "Preferences.h"
+#include "SettingsStore.h"
 #include <unity.h>
 
 void setUp() {
@@ -112,6 +114,35 @@ void test_key_cleared() {
   TEST_ASSERT_FALSE(nm.isEnabled());
 }
 
+// --- Config survives a reboot (settings registry) ---
+
+void test_config_persisted_in_registry() {
+  {
+    SettingsStore st;
+    st.begin();
+    NotifyManager nm;
+    nm.setSettings(&st);
+    nm.begin();
+    nm.setPrivateKey("KEY_42");
+    nm.setTypeEnabled(NOTIFY_DAILY_LEVEL, false);
+    nm.setDailyReportHour(19, 45);
+    TEST_ASSERT_EQUAL(0, Preferences::mock_writeCount); // Debounced
+    TEST_ASSERT_TRUE(st.flush());
+    TEST_ASSERT_EQUAL(1, Preferences::mock_writeCount); // One record
+  }
+
+  SettingsStore st;
+  st.begin();
+  NotifyManager nm;
+  nm.setSettings(&st);
+  nm.begin();
+  TEST_ASSERT_EQUAL_STRING("KEY_42", nm.getPrivateKey().c_str());
+  TEST_ASSERT_FALSE(nm.isTypeEnabled(NOTIFY_DAILY_LEVEL));
+  TEST_ASSERT_TRUE(nm.isTypeEnabled(NOTIFY_EMERGENCY));
+  TEST_ASSERT_EQUAL(19, nm.getDailyReportHour());
+  TEST_ASSERT_EQUAL(45, nm.getDailyReportMinute());
+}
+
 int main(int argc, char **argv) {
   UNITY_BEGIN();
 
@@ -125,6 +156,7 @@ int main(int argc, char **argv) {
   RUN_TEST(test_all_types_enabled_by_default);
   RUN_TEST(test_invalid_type_returns_false);
   RUN_TEST(test_key_cleared);
+  RUN_TEST(test_config_persisted_in_registry);
 
   UNITY_END();
   return 0;
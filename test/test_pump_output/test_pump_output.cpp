@@ -0,0 +1,107 @@
+// ============================================================================
+// PumpOutput Unit Tests
+// Tests: PCA9685 init (outputs off, prescale), batched register bursts,
+//        duty encoding, two-chip span, failed write retry, LEDC backend
+// ============================================================================
+
+#include "Arduino.h"
+#include "PumpOutput.h"
+#include <Wire.h>
+#include <unity.h>
+
+void setUp() {
+  mock_reset_pins();
+  TwoWire::mock_resetPca();
+}
+
+void tearDown() {}
+
+// ----------------------------------------------------------------------------
+// PCA9685
+// ----------------------------------------------------------------------------
+
+void test_begin_turns_outputs_off() {
+  // Left running by the previous boot
+  for (uint8_t o = 0; o < 16; o++)
+    TwoWire::mock_pca[0][6 + 4 * o + 1] = 0x10;
+  TEST_ASSERT_EQUAL_UINT16(4096, TwoWire::mock_pcaLevel(3));
+
+  Pca9685PumpOutput out(Wire);
+  TEST_ASSERT_TRUE(out.begin(5));
+  for (uint8_t ch = 0; ch < 16; ch++)
+    TEST_ASSERT_EQUAL_UINT16(0, TwoWire::mock_pcaLevel(ch));
+  TEST_ASSERT_EQUAL_UINT8(5, TwoWire::mock_pca[0][0xFE]);  // 1 kHz
+  TEST_ASSERT_EQUAL_UINT8(0x20, TwoWire::mock_pca[0][0]); // Awake, AI
+}
+
+void test_flush_sends_one_burst_per_chip() {
+  Pca9685PumpOutput out(Wire);
+  out.begin(5);
+  uint32_t writes = TwoWire::mock_pcaWrites;
+
+  out.set(0, 255);
+  out.set(3, 128);
+  out.set(4, 0); // Unchanged: not staged
+  TEST_ASSERT_EQUAL_UINT16(0, TwoWire::mock_pcaLevel(0)); // Nothing yet
+  TEST_ASSERT_TRUE(out.flush());
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, TwoWire::mock_pcaWrites);
+  TEST_ASSERT_EQUAL_UINT16(4096, TwoWire::mock_pcaLevel(0));
+  TEST_ASSERT_EQUAL_UINT16(2056, TwoWire::mock_pcaLevel(3));
+  TEST_ASSERT_EQUAL_UINT16(0, TwoWire::mock_pcaLevel(4));
+
+  // Nothing staged: no bus traffic
+  TEST_ASSERT_TRUE(out.flush());
+  TEST_ASSERT_EQUAL_UINT32(writes + 1, TwoWire::mock_pcaWrites);
+}
+
+void test_channels_span_two_chips() {
+  Pca9685PumpOutput out(Wire);
+  TEST_ASSERT_TRUE(out.begin(20));
+  uint32_t writes = TwoWire::mock_pcaWrites;
+  out.set(2, 255);
+  out.set(18, 255); // Second chip, output 2
+  out.flush();
+  TEST_ASSERT_EQUAL_UINT32(writes + 2, TwoWire::mock_pcaWrites);
+  TEST_ASSERT_EQUAL_UINT16(4096, TwoWire::mock_pcaLevel(2));
+  TEST_ASSERT_EQUAL_UINT16(4096, TwoWire::mock_pcaLevel(18));
+  TEST_ASSERT_EQUAL_UINT16(0, TwoWire::mock_pcaLevel(17));
+}
+
+void test_failed_write_is_retried() {
+  Pca9685PumpOutput out(Wire);
+  out.begin(5);
+  out.set(1, 255);
+  TwoWire::mock_pcaPresent = false;
+  TEST_ASSERT_FALSE(out.flush());
+
+  TwoWire::mock_pcaPresent = true;
+  TEST_ASSERT_TRUE(out.flush());
+  TEST_ASSERT_EQUAL_UINT16(4096, TwoWire::mock_pcaLevel(1));
+}
+
+// ----------------------------------------------------------------------------
+// LEDC
+// ----------------------------------------------------------------------------
+
+void test_ledc_writes_through() {
+  LedcPumpOutput out;
+  TEST_ASSERT_TRUE(out.begin(NUM_FERTS + 1));
+  out.set(NUM_FERTS, 200);
+  TEST_ASSERT_EQUAL_UINT32(200, mock_ledc_duty[NUM_FERTS]);
+  TEST_ASSERT_TRUE(out.flush());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // PCA9685
+  RUN_TEST(test_begin_turns_outputs_off);
+  RUN_TEST(test_flush_sends_one_burst_per_chip);
+  RUN_TEST(test_channels_span_two_chips);
+  RUN_TEST(test_failed_write_is_retried);
+
+  // LEDC
+  RUN_TEST(test_ledc_writes_through);
+
+  return UNITY_END();
+}
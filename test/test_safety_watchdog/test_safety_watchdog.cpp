@@ -1,10 +1,12 @@
 // ============================================================================
 // SafetyWatchdog Unit Tests
-// Tests: sensor reads, emergency actions, maintenance mode, GPIO state
+// Tests: sensor reads (burst prefetched outside ControlLock), emergency
+//        actions, maintenance mode, GPIO state
 // ============================================================================
 
 #include "Arduino.h"
 #include "SafetyWatchdog.h"
+#include <climits>
 #include <unity.h>
 
 void setUp() {
@@ -147,7 +149,7 @@ void test_maintenance_auto_expires() {
   TEST_ASSERT_TRUE(sw.isMaintenanceMode());
 
   // Advance past 30 minutes + safety check interval
-  mock_millis_value = MAINTENANCE_DURATION_MS + SAFETY_CHECK_INTERVAL_MS + 1;
+  mock_millis_value = MAINTENANCE_DURATION_MS + SAMPLING_MAX_CHECK_MS + 1;
 
   sw.update(); // Should auto-expire
 
@@ -161,7 +163,7 @@ void test_maintenance_persists_within_duration() {
   sw.enterMaintenance();
 
   // Advance only 15 minutes
-  mock_millis_value = 15UL * 60 * 1000 + SAFETY_CHECK_INTERVAL_MS + 1;
+  mock_millis_value = 15UL * 60 * 1000 + SAMPLING_MAX_CHECK_MS + 1;
 
   sw.update();
 
@@ -200,6 +202,127 @@ void test_ultrasonic_no_reading_returns_last() {
   TEST_ASSERT_FLOAT_WITHIN(2.0f, 15.0f, dist);
 }
 
+void test_prefetched_burst_used_under_lock() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 875; // ~15cm
+  sw.begin();
+  sw.update();
+
+  // Sampler stalled (its timer never fires): the control task takes the
+  // burst before ControlLock, update() then reads without blocking
+  mock_pulseIn_value = 1166; // ~20cm
+  mock_millis_value += 1000;
+  mock_pulseIn_calls = 0;
+  sw.prefetchBurst();
+  TEST_ASSERT_NOT_EQUAL(0, mock_pulseIn_calls);
+  mock_pulseIn_calls = 0;
+  unsigned long before = mock_millis_value;
+  sw.update();
+  TEST_ASSERT_EQUAL(0, mock_pulseIn_calls);
+  TEST_ASSERT_EQUAL(before, mock_millis_value);
+  TEST_ASSERT_TRUE(sw.getLastDistance() > 15.5f);
+
+  // Check not due yet: nothing to prefetch
+  sw.prefetchBurst();
+  TEST_ASSERT_EQUAL(0, mock_pulseIn_calls);
+
+  // A prefetch left unconsumed too long is dropped, not replayed
+  mock_millis_value += 1000;
+  sw.prefetchBurst();
+  mock_millis_value += LEVEL_SAMPLE_MAX_AGE_MS + 1;
+  mock_pulseIn_calls = 0;
+  sw.readUltrasonic();
+  TEST_ASSERT_NOT_EQUAL(0, mock_pulseIn_calls);
+}
+
+// ----------------------------------------------------------------------------
+// Level cache
+// ----------------------------------------------------------------------------
+
+void test_get_level_reuses_fresh_sample() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 875; // ~15cm
+  sw.begin();
+
+  float first = sw.getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+  unsigned long t = mock_millis_value;
+
+  mock_pulseIn_value = 1750; // ~30cm, but the cached sample is still fresh
+  float second = sw.getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+
+  TEST_ASSERT_EQUAL(t, mock_millis_value); // No new ping burst
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, first, second);
+}
+
+void test_get_level_rereads_when_stale() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 875; // ~15cm
+  sw.begin();
+  sw.getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+
+  mock_pulseIn_value = 1750; // ~30cm
+  mock_millis_value += LEVEL_SAMPLE_MAX_AGE_MS + 1;
+  float dist = sw.getLevel(LEVEL_SAMPLE_MAX_AGE_MS);
+  TEST_ASSERT_FLOAT_WITHIN(2.0f, 30.0f, dist);
+}
+
+void test_level_age_reported() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 0; // No echo: no sample yet
+  sw.begin();
+  TEST_ASSERT_EQUAL(ULONG_MAX, sw.getLevelAgeMs());
+
+  mock_pulseIn_value = 875;
+  sw.readUltrasonic();
+  // Age is measured from the newest ping, not from when the burst returned
+  unsigned long age = sw.getLevelAgeMs();
+  TEST_ASSERT_TRUE(age <= ULTRASONIC_WINDOW_MS);
+  mock_millis_value += 120;
+  TEST_ASSERT_EQUAL(age + 120, sw.getLevelAgeMs());
+}
+
+static unsigned long echoForCm(float cm) {
+  return (unsigned long)(cm * 2.0f / 0.0343f + 0.5f);
+}
+
+void test_predicted_overflow_trips_before_reading() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = echoForCm(10.2f);
+  sw.begin();
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+  digitalWrite(PIN_REFILL, HIGH); // Refill running: active sampling
+
+  // Water rising 0.5 cm per safety check (~1.25 cm/s incl. the burst)
+  float cm = 10.2f;
+  while (!sw.isEmergency() && cm > 0) {
+    cm -= 0.5f;
+    mock_pulseIn_value = echoForCm(cm);
+    mock_millis_value += SAMPLING_ACTIVE_CHECK_MS;
+    sw.update();
+  }
+
+  TEST_ASSERT_TRUE(sw.isEmergency());
+  TEST_ASSERT_TRUE(sw.getLevelRate() < -0.5f);
+  // Tripped on the predicted level, one check before the reading crossed
+  TEST_ASSERT_TRUE(sw.getLastDistance() >= LEVEL_SAFETY_MIN_CM);
+}
+
+void test_steady_level_near_limit_does_not_trip() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = echoForCm(5.5f);
+  sw.begin();
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+
+  for (uint8_t i = 0; i < 10; i++) {
+    mock_millis_value += SAMPLING_IDLE_CHECK_MS;
+    sw.update();
+  }
+
+  TEST_ASSERT_FALSE(sw.isEmergency());
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 0.0f, sw.getLevelRate());
+  TEST_ASSERT_TRUE(sw.getLevelConfidence() >= LEVEL_EST_MIN_CONFIDENCE);
+}
+
 // ----------------------------------------------------------------------------
 // Optical Overflow Flag
 // ----------------------------------------------------------------------------
@@ -215,7 +338,7 @@ void test_optical_flag_set_on_update() {
   // Optical sensor triggered
   mock_pin_read_value[PIN_OPTICAL] = LOW;
 
-  mock_millis_value = SAFETY_CHECK_INTERVAL_MS + 1;
+  mock_millis_value = SAMPLING_ACTIVE_CHECK_MS + 1;
   sw.update();
 
   TEST_ASSERT_TRUE(sw.overflowDetected());
@@ -233,12 +356,160 @@ void test_no_overflow_when_optical_clear() {
   mock_pulseIn_value = 1750;
   mock_pin_read_value[PIN_OPTICAL] = HIGH; // Normal
 
-  mock_millis_value = SAFETY_CHECK_INTERVAL_MS + 1;
+  mock_millis_value = SAMPLING_IDLE_CHECK_MS + 1;
   sw.update();
 
   TEST_ASSERT_FALSE(sw.overflowDetected());
 }
 
+// ----------------------------------------------------------------------------
+// ISR cut-offs
+// ----------------------------------------------------------------------------
+
+void test_optical_isr_cuts_refill_and_solenoid() {
+  SafetyWatchdog sw;
+  sw.begin();
+  digitalWrite(PIN_REFILL, HIGH);
+  digitalWrite(PIN_SOLENOID, HIGH);
+  digitalWrite(PIN_DRAIN, HIGH);
+
+  mock_pin_read_value[PIN_OPTICAL] = LOW; // Water reached the sensor
+  mock_trigger_interrupt(PIN_OPTICAL);
+
+  // No update() needed: the ISR acted on its own
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_SOLENOID]);
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_DRAIN]); // Drain untouched
+  TEST_ASSERT_TRUE(sw.opticalTripped());
+}
+
+void test_optical_isr_ignores_glitch_and_maintenance() {
+  SafetyWatchdog sw;
+  sw.begin();
+  digitalWrite(PIN_REFILL, HIGH);
+
+  // Edge but the pin already reads HIGH again: glitch
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+  mock_trigger_interrupt(PIN_OPTICAL);
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_FALSE(sw.opticalTripped());
+
+  // Maintenance: sensor handling is expected to trip it
+  sw.enterMaintenance();
+  mock_pin_read_value[PIN_OPTICAL] = LOW;
+  mock_trigger_interrupt(PIN_OPTICAL);
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_FALSE(sw.opticalTripped());
+}
+
+void test_optical_trip_clears_when_sensor_normal() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 1750; // ~30cm — safe
+  sw.begin();
+
+  mock_pin_read_value[PIN_OPTICAL] = LOW;
+  mock_trigger_interrupt(PIN_OPTICAL);
+  mock_millis_value = SAMPLING_ACTIVE_CHECK_MS + 1;
+  sw.update();
+  TEST_ASSERT_TRUE(sw.opticalTripped()); // Still wet
+
+  // Latch keeps the watchdog in active mode until it is serviced
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+  mock_millis_value += SAMPLING_ACTIVE_CHECK_MS + 1;
+  sw.update();
+  TEST_ASSERT_FALSE(sw.opticalTripped());
+}
+
+void test_float_isr_closes_solenoid_only() {
+  SafetyWatchdog sw;
+  sw.begin();
+  digitalWrite(PIN_SOLENOID, HIGH);
+  digitalWrite(PIN_REFILL, HIGH);
+
+  mock_pin_read_value[PIN_FLOAT] = LOW; // Reservoir full
+  mock_trigger_interrupt(PIN_FLOAT);
+
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_SOLENOID]);
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_TRUE(sw.floatTripped());
+}
+
+// ----------------------------------------------------------------------------
+// Adaptive sampling
+// ----------------------------------------------------------------------------
+
+void test_sampling_mode_follows_system_state() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 1750; // ~30cm, steady
+  mock_pin_read_value[PIN_OPTICAL] = HIGH; // Below max level
+  sw.begin();
+
+  sw.update();
+  TEST_ASSERT_EQUAL(SamplingMode::IDLE, sw.getSamplingMode());
+  TEST_ASSERT_EQUAL(SAMPLING_IDLE_CHECK_MS, sw.getCheckIntervalMs());
+
+  digitalWrite(PIN_DRAIN, HIGH);
+  sw.update();
+  TEST_ASSERT_EQUAL(SamplingMode::ACTIVE, sw.getSamplingMode());
+  TEST_ASSERT_EQUAL(SAMPLING_ACTIVE_CHECK_MS, sw.getCheckIntervalMs());
+
+  sw.emergencyDrain();
+  sw.update();
+  TEST_ASSERT_EQUAL(SamplingMode::EMERGENCY, sw.getSamplingMode());
+  TEST_ASSERT_EQUAL(SAMPLING_EMERGENCY_CHECK_MS, sw.getCheckIntervalMs());
+}
+
+void test_idle_checks_slowly_with_fewer_pings() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 1750;
+  mock_pin_read_value[PIN_OPTICAL] = HIGH; // Below max level
+  sw.begin();
+  unsigned long t0 = mock_millis_value;
+
+  // Idle: nothing read before the idle period elapses
+  mock_millis_value = t0 + SAMPLING_ACTIVE_CHECK_MS + 1;
+  sw.update();
+  TEST_ASSERT_EQUAL(t0 + SAMPLING_ACTIVE_CHECK_MS + 1, mock_millis_value);
+
+  // Idle check: blocking fallback burst takes SAMPLING_IDLE_PINGS pings
+  mock_millis_value = t0 + SAMPLING_IDLE_CHECK_MS + 1;
+  unsigned long before = mock_millis_value;
+  sw.update();
+  TEST_ASSERT_EQUAL(before + SAMPLING_IDLE_PINGS * 30, mock_millis_value);
+
+  // Pump on: checked on the next tick, with the larger active burst
+  digitalWrite(PIN_REFILL, HIGH);
+  mock_millis_value += SAMPLING_ACTIVE_CHECK_MS;
+  before = mock_millis_value;
+  sw.update();
+  TEST_ASSERT_EQUAL(before + SAMPLING_ACTIVE_PINGS * 30, mock_millis_value);
+}
+
+void test_sampling_policy_is_configurable() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 1750;
+  mock_pin_read_value[PIN_OPTICAL] = HIGH; // Below max level
+  sw.begin();
+  sw.update(); // Idle
+
+  TEST_ASSERT_TRUE(sw.setSamplingPolicy(SamplingMode::IDLE, 5000, 2));
+  TEST_ASSERT_EQUAL(5000, sw.getCheckIntervalMs());
+  TEST_ASSERT_EQUAL(2, sw.getSamplingPolicy(SamplingMode::IDLE).pings);
+  TEST_ASSERT_EQUAL(2500,
+                    sw.getSamplingPolicy(SamplingMode::IDLE).pingIntervalMs());
+
+  // Out of range: rejected, policy unchanged
+  TEST_ASSERT_FALSE(sw.setSamplingPolicy(SamplingMode::IDLE, 10, 2));
+  TEST_ASSERT_FALSE(sw.setSamplingPolicy(SamplingMode::IDLE, 1000, 0));
+  TEST_ASSERT_EQUAL(5000, sw.getCheckIntervalMs());
+
+  // Ping period never drops below the sensor's minimum
+  TEST_ASSERT_TRUE(sw.setSamplingPolicy(SamplingMode::EMERGENCY, 60, 5));
+  TEST_ASSERT_EQUAL(ULTRASONIC_PING_INTERVAL_MS,
+                    sw.getSamplingPolicy(SamplingMode::EMERGENCY)
+                        .pingIntervalMs());
+}
+
 // ============================================================================
 // MAIN
 // ============================================================================
@@ -269,11 +540,30 @@ int main(int argc, char **argv) {
   // Ultrasonic
   RUN_TEST(test_ultrasonic_valid_reading);
   RUN_TEST(test_ultrasonic_no_reading_returns_last);
+  RUN_TEST(test_prefetched_burst_used_under_lock);
+
+  // Level cache
+  RUN_TEST(test_get_level_reuses_fresh_sample);
+  RUN_TEST(test_get_level_rereads_when_stale);
+  RUN_TEST(test_level_age_reported);
+  RUN_TEST(test_predicted_overflow_trips_before_reading);
+  RUN_TEST(test_steady_level_near_limit_does_not_trip);
 
   // Overflow flags
   RUN_TEST(test_optical_flag_set_on_update);
   RUN_TEST(test_no_overflow_when_optical_clear);
 
+  // ISR cut-offs
+  RUN_TEST(test_optical_isr_cuts_refill_and_solenoid);
+  RUN_TEST(test_optical_isr_ignores_glitch_and_maintenance);
+  RUN_TEST(test_optical_trip_clears_when_sensor_normal);
+  RUN_TEST(test_float_isr_closes_solenoid_only);
+
+  // Adaptive sampling
+  RUN_TEST(test_sampling_mode_follows_system_state);
+  RUN_TEST(test_idle_checks_slowly_with_fewer_pings);
+  RUN_TEST(test_sampling_policy_is_configurable);
+
   UNITY_END();
   return 0;
 }
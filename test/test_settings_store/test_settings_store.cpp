@@ -0,0 +1,278 @@
+// ============================================================================
+// SettingsStore Unit Tests
+// Tests: defaults, range clamping, change detection, debounced commit
+//        (quiet time, longest deferral, flush), double-buffered records
+//        (alternation, torn write), per-key layout conversion, record
+//        entries added/removed by firmware updates
+// ============================================================================
+
+#include "Arduino.h"
+#include "Crc32.h"
+#include "Preferences.h"
+#include "SafetyWatchdog.h"
+#include "SettingsStore.h"
+#include <unity.h>
+
+void setUp() {
+  mock_millis_value = 0;
+  Preferences::mock_clearAll();
+}
+
+void tearDown() {}
+
+// Let the debounce expire and commit
+static void settle(SettingsStore &st) {
+  mock_millis_value += SETTINGS_COMMIT_DELAY_MS;
+  st.update();
+}
+
+// ----------------------------------------------------------------------------
+// Values
+// ----------------------------------------------------------------------------
+
+void test_defaults_without_nvs() {
+  SettingsStore st;
+  st.begin();
+  TEST_ASSERT_EQUAL_UINT32(7, st.getUInt(Setting::TPA_INTERVAL));
+  TEST_ASSERT_EQUAL_UINT32(10, st.getUInt(Setting::TPA_HOUR));
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_PRIME_ML, st.getFloat(Setting::PRIME_ML));
+  TEST_ASSERT_EQUAL_UINT32(0xFF, st.getUInt(Setting::NOTIFY_MASK));
+  TEST_ASSERT_EQUAL_STRING("", st.getString(Setting::NOTIFY_KEY).c_str());
+  SamplingPolicy sp[SAMPLING_MODE_COUNT];
+  TEST_ASSERT_FALSE(st.getBytes(Setting::SAMPLING, sp, sizeof(sp)));
+
+  // First boot costs no flash write
+  TEST_ASSERT_FALSE(st.isDirty());
+  TEST_ASSERT_EQUAL(0, Preferences::mock_writeCount);
+}
+
+void test_values_clamped_to_range() {
+  SettingsStore st;
+  st.begin();
+  st.setUInt(Setting::TPA_HOUR, 30);
+  TEST_ASSERT_EQUAL_UINT32(23, st.getUInt(Setting::TPA_HOUR));
+  st.setFloat(Setting::PRIME_RATIO, -2.0f);
+  TEST_ASSERT_EQUAL_FLOAT(0.0f, st.getFloat(Setting::PRIME_RATIO));
+  st.setFloat(Setting::PRIME_ML, NAN);
+  TEST_ASSERT_EQUAL_FLOAT(DEFAULT_PRIME_ML, st.getFloat(Setting::PRIME_ML));
+  st.setUInt(Setting::TPA_LAST_RUN, 0xFFFFFFF0UL); // Full uint32_t range
+  TEST_ASSERT_EQUAL_UINT32(0xFFFFFFF0UL, st.getUInt(Setting::TPA_LAST_RUN));
+
+  // Strings are cut to the declared size
+  String longKey;
+  for (uint8_t i = 0; i < 60; i++)
+    longKey += 'k';
+  st.setString(Setting::NOTIFY_KEY, longKey);
+  TEST_ASSERT_EQUAL(SettingsStore::getDef(Setting::NOTIFY_KEY).size - 1,
+                    st.getString(Setting::NOTIFY_KEY).length());
+}
+
+void test_unchanged_value_not_dirty() {
+  SettingsStore st;
+  st.begin();
+  TEST_ASSERT_FALSE(st.setUInt(Setting::TPA_INTERVAL, 7));
+  TEST_ASSERT_FALSE(st.isDirty());
+  TEST_ASSERT_TRUE(st.setUInt(Setting::TPA_INTERVAL, 14));
+  TEST_ASSERT_TRUE(st.isDirty());
+}
+
+// ----------------------------------------------------------------------------
+// Debounced commit
+// ----------------------------------------------------------------------------
+
+void test_burst_of_edits_is_one_write() {
+  {
+    SettingsStore st;
+    st.begin();
+    for (uint16_t h = 1; h <= 10; h++) { // Dims, schedule... within 1 s
+      st.setUInt(Setting::AQ_HEIGHT, 40 + h);
+      st.setUInt(Setting::TPA_HOUR, h);
+      mock_millis_value += 100;
+      st.update();
+    }
+    st.setString(Setting::NOTIFY_KEY, "abc123");
+    TEST_ASSERT_EQUAL(0, Preferences::mock_writeCount);
+
+    settle(st);
+    TEST_ASSERT_FALSE(st.isDirty());
+    TEST_ASSERT_EQUAL(2, Preferences::mock_writeCount); // aqua + notify
+    TEST_ASSERT_EQUAL_UINT32(2, st.getCommitCount());
+  }
+
+  SettingsStore st;
+  st.begin();
+  TEST_ASSERT_EQUAL_UINT32(50, st.getUInt(Setting::AQ_HEIGHT));
+  TEST_ASSERT_EQUAL_UINT32(10, st.getUInt(Setting::TPA_HOUR));
+  TEST_ASSERT_EQUAL_STRING("abc123",
+                           st.getString(Setting::NOTIFY_KEY).c_str());
+  TEST_ASSERT_EQUAL_UINT32(7, st.getUInt(Setting::TPA_INTERVAL)); // Default
+}
+
+void test_commit_not_deferred_forever() {
+  SettingsStore st;
+  st.begin();
+  // An edit every second never leaves a quiet gap
+  uint32_t v = 1;
+  while (mock_millis_value < SETTINGS_COMMIT_MAX_MS) {
+    st.setUInt(Setting::AQ_LENGTH, v++);
+    mock_millis_value += 1000;
+    st.update();
+  }
+  TEST_ASSERT_EQUAL(1, Preferences::mock_writeCount);
+}
+
+void test_flush_commits_now() {
+  SettingsStore st;
+  st.begin();
+  st.setFloat(Setting::DRAIN_LPM, 2.5f);
+  TEST_ASSERT_TRUE(st.flush());
+  TEST_ASSERT_EQUAL(1, Preferences::mock_writeCount); // pumpcal only
+
+  SettingsStore again;
+  again.begin();
+  TEST_ASSERT_EQUAL_FLOAT(2.5f, again.getFloat(Setting::DRAIN_LPM));
+}
+
+// ----------------------------------------------------------------------------
+// Double-buffered records
+// ----------------------------------------------------------------------------
+
+void test_records_alternate_keys() {
+  SettingsStore st;
+  st.begin();
+  st.setUInt(Setting::TPA_MINUTE, 15);
+  st.flush();
+  TEST_ASSERT_NOT_NULL(Preferences::mock_bytes("aqua", "rec0"));
+  TEST_ASSERT_NULL(Preferences::mock_bytes("aqua", "rec1"));
+  st.setUInt(Setting::TPA_MINUTE, 30);
+  st.flush();
+  TEST_ASSERT_NOT_NULL(Preferences::mock_bytes("aqua", "rec1"));
+  st.setUInt(Setting::TPA_MINUTE, 45);
+  st.flush();
+
+  // rec0 holds the newest (seq 3) and wins over rec1 (seq 2)
+  SettingsStore again;
+  again.begin();
+  TEST_ASSERT_EQUAL_UINT32(45, again.getUInt(Setting::TPA_MINUTE));
+}
+
+void test_torn_record_keeps_previous() {
+  SettingsStore st;
+  st.begin();
+  st.setUInt(Setting::TPA_PERCENT, 30);
+  st.flush(); // rec0
+  st.setUInt(Setting::TPA_PERCENT, 40);
+  st.flush(); // rec1
+
+  // Power cut while rec1 was written
+  std::vector<uint8_t> *raw = Preferences::mock_bytes("aqua", "rec1");
+  (*raw)[raw->size() / 2] ^= 0xFF;
+
+  SettingsStore again;
+  again.begin();
+  TEST_ASSERT_EQUAL_UINT32(30, again.getUInt(Setting::TPA_PERCENT));
+
+  // The next commit overwrites the torn key, not the good one
+  again.setUInt(Setting::TPA_PERCENT, 50);
+  again.flush();
+  SettingsStore third;
+  third.begin();
+  TEST_ASSERT_EQUAL_UINT32(50, third.getUInt(Setting::TPA_PERCENT));
+  TEST_ASSERT_NOT_NULL(Preferences::mock_bytes("aqua", "rec0"));
+}
+
+// ----------------------------------------------------------------------------
+// Layout changes
+// ----------------------------------------------------------------------------
+
+void test_per_key_layout_converted() {
+  SamplingPolicy sp[SAMPLING_MODE_COUNT] = {{1500, 4}, {200, 5}, {100, 3}};
+  Preferences p;
+  p.begin("aqua", false);
+  p.putUShort("tpaInt", 10);
+  p.putUChar("tpaH", 9);
+  p.putFloat("pRat", 0.5f);
+  p.putBytes("smp", sp, sizeof(sp));
+  p.end();
+  p.begin("notify", false);
+  p.putString("key", "legacyKey");
+  p.putUChar("mask", 0x05);
+  p.end();
+  Preferences::mock_writeCount = 0;
+
+  SettingsStore st;
+  st.begin();
+  TEST_ASSERT_EQUAL_UINT32(10, st.getUInt(Setting::TPA_INTERVAL));
+  TEST_ASSERT_EQUAL_UINT32(9, st.getUInt(Setting::TPA_HOUR));
+  TEST_ASSERT_EQUAL_UINT32(0, st.getUInt(Setting::TPA_MINUTE)); // Default
+  TEST_ASSERT_EQUAL_FLOAT(0.5f, st.getFloat(Setting::PRIME_RATIO));
+  TEST_ASSERT_EQUAL_STRING("legacyKey",
+                           st.getString(Setting::NOTIFY_KEY).c_str());
+  TEST_ASSERT_EQUAL_UINT32(0x05, st.getUInt(Setting::NOTIFY_MASK));
+  SamplingPolicy out[SAMPLING_MODE_COUNT];
+  TEST_ASSERT_TRUE(st.getBytes(Setting::SAMPLING, out, sizeof(out)));
+  TEST_ASSERT_EQUAL_UINT16(1500, out[0].checkMs);
+
+  // One record per converted namespace; the old keys are gone
+  TEST_ASSERT_EQUAL(2, Preferences::mock_writeCount);
+  p.begin("aqua", true);
+  TEST_ASSERT_FALSE(p.isKey("tpaInt"));
+  TEST_ASSERT_TRUE(p.isKey("rec0"));
+  p.end();
+
+  SettingsStore again;
+  again.begin();
+  TEST_ASSERT_EQUAL_UINT32(10, again.getUInt(Setting::TPA_INTERVAL));
+  TEST_ASSERT_TRUE(again.getBytes(Setting::SAMPLING, out, sizeof(out)));
+}
+
+void test_unknown_and_missing_entries() {
+  SettingsStore st;
+  st.begin();
+  st.setUInt(Setting::REPORT_HOUR, 21);
+  st.flush();
+
+  // A record from another firmware: extra entry "old" and no "repM"
+  std::vector<uint8_t> *raw = Preferences::mock_bytes("notify", "rec0");
+  std::vector<uint8_t> rec;
+  const uint8_t head[] = {0x52, 0x53, 1, 0, 0, 0, 0, 0}; // "SR", seq 1
+  rec.insert(rec.end(), head, head + sizeof(head));
+  const uint8_t entries[] = {3,   'o', 'l', 'd', (uint8_t)SettingType::U16,
+                             2,   1,   2,         4,
+                             'r', 'e', 'p', 'H', (uint8_t)SettingType::U8,
+                             1,   22};
+  rec.insert(rec.end(), entries, entries + sizeof(entries));
+  rec[6] = sizeof(entries);
+  uint32_t crc = crc32(rec.data(), rec.size());
+  rec.insert(rec.end(), (uint8_t *)&crc, (uint8_t *)&crc + 4);
+  *raw = rec;
+
+  SettingsStore again;
+  again.begin();
+  TEST_ASSERT_EQUAL_UINT32(22, again.getUInt(Setting::REPORT_HOUR));
+  TEST_ASSERT_EQUAL_UINT32(0, again.getUInt(Setting::REPORT_MINUTE));
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Values
+  RUN_TEST(test_defaults_without_nvs);
+  RUN_TEST(test_values_clamped_to_range);
+  RUN_TEST(test_unchanged_value_not_dirty);
+
+  // Debounced commit
+  RUN_TEST(test_burst_of_edits_is_one_write);
+  RUN_TEST(test_commit_not_deferred_forever);
+  RUN_TEST(test_flush_commits_now);
+
+  // Double-buffered records
+  RUN_TEST(test_records_alternate_keys);
+  RUN_TEST(test_torn_record_keeps_previous);
+
+  // Layout changes
+  RUN_TEST(test_per_key_layout_converted);
+  RUN_TEST(test_unknown_and_missing_entries);
+
+  return UNITY_END();
+}
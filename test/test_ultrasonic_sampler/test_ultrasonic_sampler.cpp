@@ -0,0 +1,189 @@
+// ============================================================================
+// UltrasonicSampler Unit Tests
+// Tests: timer-driven pings, echo ISR capture, ring buffer windowing
+// ============================================================================
+
+#include "Arduino.h"
+#include "SafetyWatchdog.h"
+#include "UltrasonicSampler.h"
+#include <esp_timer.h>
+#include <unity.h>
+
+void setUp() {
+  mock_reset_pins();
+  mock_millis_value = 0;
+  mock_esp_timer_extra_us = 0;
+  mock_pulseIn_value = 0;
+}
+
+void tearDown() {}
+
+// Helper: fire the ping timer, then simulate an echo of echoUs width
+static void pingWithEcho(uint16_t echoUs,
+                         unsigned long periodMs = ULTRASONIC_PING_INTERVAL_MS) {
+  mock_millis_value += periodMs;
+  mock_esp_timer_extra_us = 0;
+  mock_esp_timer_run_due(); // Trigger pulse
+  mock_pin_read_value[PIN_ECHO] = HIGH;
+  mock_esp_timer_extra_us = 200; // Echo starts 200 us after the trigger
+  mock_trigger_interrupt(PIN_ECHO);
+  mock_pin_read_value[PIN_ECHO] = LOW;
+  mock_esp_timer_extra_us = 200 + echoUs;
+  mock_trigger_interrupt(PIN_ECHO);
+  mock_esp_timer_extra_us = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Engine
+// ----------------------------------------------------------------------------
+
+void test_begin_starts_timer_and_attaches_isr() {
+  UltrasonicSampler s;
+  TEST_ASSERT_TRUE(s.begin(PIN_TRIG, PIN_ECHO, ULTRASONIC_PING_INTERVAL_MS));
+  TEST_ASSERT_TRUE(s.isRunning());
+  s.end();
+  TEST_ASSERT_FALSE(s.isRunning());
+}
+
+void test_echo_is_captured_into_ring() {
+  UltrasonicSampler s;
+  s.begin(PIN_TRIG, PIN_ECHO, ULTRASONIC_PING_INTERVAL_MS);
+
+  pingWithEcho(875); // ~15 cm
+
+  float out[5];
+  uint8_t pings = 0;
+  uint8_t n = s.collect(out, 5, ULTRASONIC_WINDOW_MS, &pings);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(1, pings);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 15.0f, out[0]);
+  s.end();
+}
+
+void test_missing_echo_counts_as_miss() {
+  UltrasonicSampler s;
+  s.begin(PIN_TRIG, PIN_ECHO, ULTRASONIC_PING_INTERVAL_MS);
+
+  // Two pings, no echo edges at all
+  mock_millis_value += ULTRASONIC_PING_INTERVAL_MS;
+  mock_esp_timer_run_due();
+  mock_millis_value += ULTRASONIC_PING_INTERVAL_MS;
+  mock_esp_timer_run_due(); // Closes the first ping as a miss
+
+  float out[5];
+  uint8_t pings = 0;
+  TEST_ASSERT_EQUAL(0, s.collect(out, 5, ULTRASONIC_WINDOW_MS, &pings));
+  TEST_ASSERT_EQUAL(1, pings);
+  TEST_ASSERT_EQUAL(1, s.getMissCount());
+  s.end();
+}
+
+void test_set_period_retunes_ping_timer() {
+  UltrasonicSampler s;
+  s.begin(PIN_TRIG, PIN_ECHO, ULTRASONIC_PING_INTERVAL_MS);
+  TEST_ASSERT_TRUE(s.setPeriod(100));
+  TEST_ASSERT_EQUAL(100, s.getPeriodMs());
+
+  // Old period elapsed: no ping yet
+  mock_millis_value += ULTRASONIC_PING_INTERVAL_MS;
+  TEST_ASSERT_EQUAL(0, mock_esp_timer_run_due());
+
+  pingWithEcho(875, 100 - ULTRASONIC_PING_INTERVAL_MS);
+  TEST_ASSERT_EQUAL(1, s.getPingCount());
+
+  s.end();
+  TEST_ASSERT_FALSE(s.setPeriod(50)); // Not running
+}
+
+// ----------------------------------------------------------------------------
+// Ring buffer
+// ----------------------------------------------------------------------------
+
+void test_collect_returns_newest_first() {
+  UltrasonicSampler s;
+  mock_millis_value = 1000;
+  s.push(900, 583);  // ~10 cm
+  s.push(930, 875);  // ~15 cm
+  s.push(960, 1166); // ~20 cm
+
+  float out[5];
+  uint8_t n = s.collect(out, 5, 500);
+  TEST_ASSERT_EQUAL(3, n);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 20.0f, out[0]);
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 10.0f, out[2]);
+}
+
+void test_collect_ignores_stale_samples() {
+  UltrasonicSampler s;
+  mock_millis_value = 1000;
+  s.push(100, 583); // Way outside the window
+  s.push(990, 875);
+
+  float out[5];
+  uint8_t pings = 0;
+  uint8_t n = s.collect(out, 5, ULTRASONIC_WINDOW_MS, &pings);
+  TEST_ASSERT_EQUAL(1, n);
+  TEST_ASSERT_EQUAL(1, pings);
+}
+
+void test_ring_overwrites_oldest() {
+  UltrasonicSampler s;
+  mock_millis_value = 1000;
+  for (uint8_t i = 0; i < UltrasonicSampler::RING_SIZE + 4; i++) {
+    s.push(900 + i, 583);
+  }
+  float out[UltrasonicSampler::RING_SIZE + 4];
+  uint8_t n = s.collect(out, UltrasonicSampler::RING_SIZE + 4, 500);
+  TEST_ASSERT_EQUAL(UltrasonicSampler::RING_SIZE, n);
+}
+
+void test_echo_to_cm_rejects_out_of_range() {
+  TEST_ASSERT_TRUE(UltrasonicSampler::echoToCm(0) < 0);
+  TEST_ASSERT_TRUE(UltrasonicSampler::echoToCm(30000) < 0); // > 400 cm
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 15.0f, UltrasonicSampler::echoToCm(875));
+}
+
+// ----------------------------------------------------------------------------
+// SafetyWatchdog integration
+// ----------------------------------------------------------------------------
+
+void test_watchdog_reads_from_sampler_without_blocking() {
+  SafetyWatchdog sw;
+  mock_pulseIn_value = 875; // Initial blocking probe sees ~15 cm
+  sw.begin();
+  TEST_ASSERT_TRUE(sw.isSamplerRunning());
+
+  unsigned long period =
+      sw.getSamplingPolicy(sw.getSamplingMode()).pingIntervalMs();
+  for (uint8_t i = 0; i < ULTRASONIC_SAMPLES; i++) {
+    pingWithEcho(1166, period); // ~20 cm
+  }
+
+  mock_pulseIn_value = 0; // A blocking read would fail now
+  unsigned long before = mock_millis_value;
+  float dist = sw.readUltrasonic();
+  TEST_ASSERT_EQUAL(before, mock_millis_value); // No delay() was called
+  TEST_ASSERT_FLOAT_WITHIN(0.5f, 20.0f, dist);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+
+  // Engine
+  RUN_TEST(test_begin_starts_timer_and_attaches_isr);
+  RUN_TEST(test_echo_is_captured_into_ring);
+  RUN_TEST(test_missing_echo_counts_as_miss);
+  RUN_TEST(test_set_period_retunes_ping_timer);
+
+  // Ring buffer
+  RUN_TEST(test_collect_returns_newest_first);
+  RUN_TEST(test_collect_ignores_stale_samples);
+  RUN_TEST(test_ring_overwrites_oldest);
+  RUN_TEST(test_echo_to_cm_rejects_out_of_range);
+
+  // SafetyWatchdog integration
+  RUN_TEST(test_watchdog_reads_from_sampler_without_blocking);
+
+  UNITY_END();
+  return 0;
+}
@@ -1,12 +1,14 @@
 // ============================================================================
 // WaterManager Unit Tests
-// Tests: state machine transitions, safety aborts, timeout handling
+// Tests: state machine transitions, safety aborts, timeout handling,
+//        checkpoint resume after a reset
 // ============================================================================
 
 #include "Arduino.h"
 #include "FertManager.h"
 #include "SafetyWatchdog.h"
 #include "WaterManager.h"
+#include <esp_timer.h>
 #include <unity.h>
 
 static SafetyWatchdog safety;
@@ -20,6 +22,7 @@ void setUp() {
   mock_pin_read_value[PIN_OPTICAL] = HIGH; // Normal
   mock_pin_read_value[PIN_FLOAT] = HIGH;   // Reservoir empty
   Preferences::mock_clearAll();
+  memset(&tpaRtcCheckpoint, 0, sizeof(tpaRtcCheckpoint));
 
   safety = SafetyWatchdog();
   safety.begin();
@@ -37,6 +40,9 @@ WaterManager makeWM() {
   return wm;
 }
 
+// Helper: advance the clock past the level cache so the next tick re-reads
+void expireLevelCache() { mock_millis_value += LEVEL_SAMPLE_MAX_AGE_MS + 1; }
+
 // Helper: advance to DRAINING (water stays high, won't finish draining)
 void goToDraining(WaterManager &wm) {
   mock_pulseIn_value = 400; // ~6.9cm — water very high, far from 20cm target
@@ -55,6 +61,7 @@ void goToFilling(WaterManager &wm) {
 
   // Now ultrasonic shows level past target (>= 20cm → 1400us ≈ 24cm)
   mock_pulseIn_value = 1400;
+  expireLevelCache();
   wm.update(); // Target reached → FILLING_RESERVOIR
   TEST_ASSERT_EQUAL(TPAState::FILLING_RESERVOIR, wm.getState());
 }
@@ -68,15 +75,36 @@ void goToDosingPrime(WaterManager &wm) {
   TEST_ASSERT_EQUAL(TPAState::DOSING_PRIME, wm.getState());
 }
 
+// Helper: from DOSING_PRIME, let the Prime pump run out and the mix wait pass
+void finishPrimeDose(WaterManager &wm) {
+  wm.update(); // Starts the Prime pump (stopped by FertManager's timer)
+  mock_millis_value += fert.getDoseStatus(NUM_FERTS).plannedUs / 1000 + 1;
+  fert.pollDoses(); // Stops the overdue pump without firing sampler timers
+  wm.update();               // Dose over, sets _waitUntilMs = millis() + 2000
+  mock_millis_value += 2001; // Advance past the 2s mixing wait
+  wm.update();               // Wait elapsed → REFILLING
+}
+
 // Helper: advance to REFILLING
 void goToRefilling(WaterManager &wm) {
   goToDosingPrime(wm);
-  wm.update();               // Doses prime, sets _waitUntilMs = millis() + 2000
-  mock_millis_value += 2001; // Advance past the 2s mixing wait
-  wm.update();               // Wait elapsed → REFILLING
+  finishPrimeDose(wm);
   TEST_ASSERT_EQUAL(TPAState::REFILLING, wm.getState());
 }
 
+// Helper: reset the board — outputs LOW, clock back to 0, managers rebuilt.
+// RTC slow memory (tpaRtcCheckpoint) and NVS survive.
+void reboot() {
+  mock_reset_pins();
+  mock_millis_value = 0;
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+  mock_pin_read_value[PIN_FLOAT] = HIGH;
+  safety = SafetyWatchdog();
+  safety.begin();
+  fert = FertManager();
+  fert.begin();
+}
+
 // --- Initial State ---
 
 void test_initial_state_is_idle() {
@@ -143,6 +171,7 @@ void test_draining_stops_at_target() {
   wm.update(); // Pump on, reads ~6.9cm → stays DRAINING
 
   mock_pulseIn_value = 1400; // ~24cm → >= 20 target
+  expireLevelCache();
   wm.update();
 
   TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_DRAIN]);
@@ -191,6 +220,46 @@ void test_fill_timeout_causes_error() {
   TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_SOLENOID]);
 }
 
+// --- Prime dosing ---
+
+void test_prime_dose_does_not_block() {
+  WaterManager wm = makeWM();
+  goToDosingPrime(wm);
+  float stock = fert.getStockML(NUM_FERTS);
+
+  unsigned long t = mock_millis_value;
+  wm.update(); // Pump on, returns at once
+  TEST_ASSERT_EQUAL(t, mock_millis_value);
+  TEST_ASSERT_TRUE(fert.isDosing(NUM_FERTS));
+  TEST_ASSERT_EQUAL(255, mock_ledc_duty[NUM_FERTS]);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, stock - DEFAULT_PRIME_ML,
+                           fert.getStockML(NUM_FERTS));
+
+  // Still dosing: state holds, no mix wait yet
+  mock_millis_value += 1000;
+  wm.update();
+  TEST_ASSERT_EQUAL(TPAState::DOSING_PRIME, wm.getState());
+
+  mock_millis_value += 6000;
+  mock_esp_timer_run_due();
+  TEST_ASSERT_EQUAL(0, mock_ledc_duty[NUM_FERTS]);
+  wm.update(); // Dose over → mix wait
+  mock_millis_value += 2001;
+  wm.update();
+  TEST_ASSERT_EQUAL(TPAState::REFILLING, wm.getState());
+}
+
+void test_abort_stops_prime_dose() {
+  WaterManager wm = makeWM();
+  goToDosingPrime(wm);
+  wm.update();
+  TEST_ASSERT_TRUE(fert.isDosing(NUM_FERTS));
+
+  wm.abortTPA();
+  TEST_ASSERT_FALSE(fert.isDosing(NUM_FERTS));
+  TEST_ASSERT_EQUAL(0, mock_ledc_duty[NUM_FERTS]);
+}
+
 // --- Abort ---
 
 void test_abort_stops_all_and_restores_canister() {
@@ -218,6 +287,22 @@ void test_emergency_during_tpa_aborts() {
 
 // --- Refilling ---
 
+void test_filling_ends_on_float_isr_trip() {
+  WaterManager wm = makeWM();
+  goToFilling(wm);
+  wm.update(); // Opens solenoid
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_SOLENOID]);
+
+  mock_pin_read_value[PIN_FLOAT] = LOW;
+  mock_trigger_interrupt(PIN_FLOAT);
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_SOLENOID]); // Closed by the ISR
+
+  mock_pin_read_value[PIN_FLOAT] = HIGH; // Float bobs back down
+  wm.update();
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_SOLENOID]); // Not reopened
+  TEST_ASSERT_EQUAL(TPAState::DOSING_PRIME, wm.getState());
+}
+
 void test_refill_stops_on_optical_sensor() {
   WaterManager wm = makeWM();
   goToRefilling(wm);
@@ -232,6 +317,26 @@ void test_refill_stops_on_optical_sensor() {
   TEST_ASSERT_EQUAL(TPAState::CANISTER_ON, wm.getState());
 }
 
+void test_refill_stops_on_optical_isr_trip() {
+  WaterManager wm = makeWM();
+  goToRefilling(wm);
+
+  mock_pulseIn_value = 1400; // 24cm — far from 10cm target
+  wm.update();               // Pump ON
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+
+  // Water touches the sensor between ticks: the ISR cuts the pump at once
+  mock_pin_read_value[PIN_OPTICAL] = LOW;
+  mock_trigger_interrupt(PIN_OPTICAL);
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+
+  // Even if the sensor dries again before the tick, the pump stays off
+  mock_pin_read_value[PIN_OPTICAL] = HIGH;
+  wm.update();
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_EQUAL(TPAState::CANISTER_ON, wm.getState());
+}
+
 void test_refill_stops_at_setpoint() {
   WaterManager wm = makeWM();
   goToRefilling(wm);
@@ -240,9 +345,106 @@ void test_refill_stops_at_setpoint() {
   wm.update();               // Pump ON
 
   mock_pulseIn_value = 500; // ~8.6cm → <= 10cm setpoint
+  expireLevelCache();
+  wm.update();
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_EQUAL(TPAState::CANISTER_ON, wm.getState());
+}
+
+void test_refill_stops_early_on_predicted_level() {
+  WaterManager wm = makeWM();
+  goToRefilling(wm);
+
+  // Water rising ~1 cm per tick: stop before the reading reaches the target
+  float cm = 15.5f;
+  mock_pulseIn_value = (unsigned long)(cm * 2.0f / 0.0343f);
+  wm.update(); // Pump ON
+  while (wm.getState() == TPAState::REFILLING && cm > 5.0f) {
+    cm -= 1.0f;
+    mock_pulseIn_value = (unsigned long)(cm * 2.0f / 0.0343f);
+    expireLevelCache();
+    wm.update();
+  }
+
+  TEST_ASSERT_EQUAL(TPAState::CANISTER_ON, wm.getState());
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_TRUE(safety.getLastDistance() > 10.0f);
+}
+
+// --- Predictive cut-off timer ---
+
+static unsigned long echoForCm(float cm) {
+  return (unsigned long)(cm * 2.0f / 0.0343f + 0.5f);
+}
+
+// Helper: fire due timers, then consume the sampler pings they produced so
+// the next level read after the settle wait comes from the mock pulseIn
+void fireCutoffTimer(unsigned long afterMs) {
+  mock_millis_value += afterMs;
+  mock_esp_timer_run_due();
+  safety.readUltrasonic();
+}
+
+void test_drain_cutoff_timer_stops_pump_at_projected_time() {
+  WaterManager wm = makeWM();
+  wm.setLitersPerCm(1.0f);
+  wm.setDrainFlowLPM(60.0f); // 1 L/s = 1 cm/s
+  wm.setTimeoutDrainMs(300000);
+  goToDraining(wm);
+  wm.update(); // Pump ON at ~6.9cm — ~13s to go, not armed yet
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_DRAIN]);
+  int armedBefore = mock_esp_timer_active_count();
+
+  mock_pulseIn_value = echoForCm(18.5f); // 1.5cm (~1.5s) from 20cm target
+  expireLevelCache();
+  wm.update();
+  TEST_ASSERT_EQUAL(armedBefore + 1, mock_esp_timer_active_count());
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_DRAIN]);
+
+  fireCutoffTimer(1500);
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_DRAIN]); // Stopped by the timer
+  TEST_ASSERT_EQUAL(TPAState::DRAINING, wm.getState());
+
+  // Confirm after the surface settles
+  mock_pulseIn_value = echoForCm(20.2f);
+  expireLevelCache();
   wm.update();
+  TEST_ASSERT_EQUAL(TPAState::DRAINING, wm.getState()); // Still settling
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_DRAIN]);    // Not restarted
+  mock_millis_value += TPA_CUTOFF_SETTLE_MS;
+  wm.update();
+  TEST_ASSERT_EQUAL(TPAState::FILLING_RESERVOIR, wm.getState());
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.2f, wm.getLastDrainOvershootCm());
+}
+
+void test_refill_cutoff_short_resumes_pump() {
+  WaterManager wm = makeWM();
+  wm.setLitersPerCm(1.0f);
+  wm.setRefillFlowLPM(60.0f); // 1 cm/s
+  wm.setTimeoutRefillMs(300000);
+  goToRefilling(wm);
+
+  mock_pulseIn_value = echoForCm(11.5f); // 1.5cm from 10cm target
+  expireLevelCache();
+  wm.update(); // Pump ON, cut-off armed
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+
+  fireCutoffTimer(1500);
   TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+
+  // Settled well short of the target: pump restarts, sensor finishes the job
+  mock_pulseIn_value = echoForCm(11.0f);
+  mock_millis_value += TPA_CUTOFF_SETTLE_MS;
+  wm.update();
+  TEST_ASSERT_EQUAL(TPAState::REFILLING, wm.getState());
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_REFILL]);
+
+  mock_pulseIn_value = echoForCm(9.8f);
+  expireLevelCache();
+  wm.update();
   TEST_ASSERT_EQUAL(TPAState::CANISTER_ON, wm.getState());
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_REFILL]);
+  TEST_ASSERT_FLOAT_WITHIN(0.1f, 0.2f, wm.getLastRefillOvershootCm());
 }
 
 // --- Complete Cycle ---
@@ -318,16 +520,14 @@ void test_refill_calibration_during_tpa() {
 
   // Water reaches drain target
   mock_pulseIn_value = 1200; // ~20.4cm
-  wm.update();               // → FILLING_RESERVOIR
+  expireLevelCache();
+  wm.update(); // → FILLING_RESERVOIR
 
   // Float switch triggered (reservoir full)
   mock_pin_read_value[PIN_FLOAT] = LOW;
   wm.update(); // → DOSING_PRIME
 
-  // First DOSING_PRIME tick: doses and sets wait
-  wm.update();
-  mock_millis_value += 2001;
-  wm.update(); // wait elapsed → REFILLING
+  finishPrimeDose(wm); // → REFILLING
   TEST_ASSERT_EQUAL(TPAState::REFILLING, wm.getState());
 
   // First REFILLING tick: pump on, records _calStartLevel at ~20.4cm
@@ -402,6 +602,93 @@ void test_is_calibrated_getter() {
   TEST_ASSERT_TRUE(wm.isCalibrated());
 }
 
+// --- Checkpoint / resume after reset ---
+
+void test_resume_draining_keeps_targets_and_elapsed() {
+  WaterManager wm = makeWM();
+  wm.setTimeoutDrainMs(10000);
+  goToDraining(wm);
+  wm.update(); // Drain pump ON
+  mock_millis_value += 6000;
+  wm.update(); // Still draining: 6 s in state
+
+  reboot();
+  WaterManager wm2;
+  TEST_ASSERT_TRUE(wm2.loadCheckpoint());
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_CANISTER]); // Held OFF
+  wm2.begin(&safety, &fert);
+  wm2.resumeTPA();
+  TEST_ASSERT_EQUAL(TPAState::DRAINING, wm2.getState());
+  TEST_ASSERT_EQUAL_FLOAT(20.0f, wm2.getDrainTargetCm());
+  TEST_ASSERT_EQUAL_FLOAT(10.0f, wm2.getRefillTargetCm());
+
+  wm2.update();
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_DRAIN]); // Pump back ON
+  mock_millis_value += 4001; // 6 s + 4 s: the timeout kept counting
+  wm2.update();
+  TEST_ASSERT_EQUAL(TPAState::ERROR, wm2.getState());
+}
+
+void test_resume_does_not_dose_prime_twice() {
+  WaterManager wm = makeWM();
+  goToDosingPrime(wm);
+  wm.update(); // Prime pump started, stock debited
+  TEST_ASSERT_TRUE(fert.isDosing(NUM_FERTS));
+
+  reboot();
+  WaterManager wm2;
+  TEST_ASSERT_TRUE(wm2.loadCheckpoint());
+  wm2.begin(&safety, &fert);
+  wm2.resumeTPA();
+  TEST_ASSERT_EQUAL(TPAState::DOSING_PRIME, wm2.getState());
+  wm2.update(); // Mixing wait only
+  TEST_ASSERT_FALSE(fert.isDosing(NUM_FERTS));
+
+  mock_millis_value += 2001;
+  wm2.update();
+  TEST_ASSERT_EQUAL(TPAState::REFILLING, wm2.getState());
+}
+
+void test_nvs_mirror_resumes_after_power_loss() {
+  WaterManager wm = makeWM();
+  goToFilling(wm);
+  Preferences::mock_writeCount = 0;
+  wm.mirrorCheckpoint();
+  wm.update(); // Same state: nothing new to mirror
+  wm.mirrorCheckpoint();
+  TEST_ASSERT_EQUAL(1, Preferences::mock_writeCount);
+
+  reboot();
+  memset(&tpaRtcCheckpoint, 0xA5, sizeof(tpaRtcCheckpoint)); // Power lost
+  WaterManager wm2;
+  TEST_ASSERT_TRUE(wm2.loadCheckpoint());
+  wm2.begin(&safety, &fert);
+  wm2.resumeTPA();
+  TEST_ASSERT_EQUAL(TPAState::FILLING_RESERVOIR, wm2.getState());
+  wm2.update();
+  TEST_ASSERT_EQUAL(HIGH, mock_pin_state[PIN_SOLENOID]); // Reopened
+}
+
+void test_finished_cycle_is_not_resumed() {
+  WaterManager wm = makeWM();
+  goToRefilling(wm);
+  wm.mirrorCheckpoint();
+  TEST_ASSERT_NOT_NULL(Preferences::mock_bytes("tpa", "ckpt"));
+  mock_pin_read_value[PIN_OPTICAL] = LOW;
+  wm.update(); // REFILLING → CANISTER_ON
+  wm.update(); // CANISTER_ON → COMPLETE
+  wm.mirrorCheckpoint();
+  TEST_ASSERT_NULL(Preferences::mock_bytes("tpa", "ckpt")); // Removed
+
+  reboot();
+  WaterManager wm2;
+  TEST_ASSERT_FALSE(wm2.loadCheckpoint());
+  TEST_ASSERT_EQUAL(LOW, mock_pin_state[PIN_CANISTER]); // Left ON
+  wm2.begin(&safety, &fert);
+  wm2.resumeTPA();
+  TEST_ASSERT_EQUAL(TPAState::IDLE, wm2.getState());
+}
+
 int main(int argc, char **argv) {
   UNITY_BEGIN();
 
@@ -415,11 +702,20 @@ int main(int argc, char **argv) {
   RUN_TEST(test_draining_timeout_causes_error);
   RUN_TEST(test_fill_opens_solenoid);
   RUN_TEST(test_fill_stops_on_float_switch);
+  RUN_TEST(test_filling_ends_on_float_isr_trip);
   RUN_TEST(test_fill_timeout_causes_error);
+  RUN_TEST(test_prime_dose_does_not_block);
+  RUN_TEST(test_abort_stops_prime_dose);
   RUN_TEST(test_abort_stops_all_and_restores_canister);
   RUN_TEST(test_emergency_during_tpa_aborts);
   RUN_TEST(test_refill_stops_on_optical_sensor);
+  RUN_TEST(test_refill_stops_on_optical_isr_trip);
   RUN_TEST(test_refill_stops_at_setpoint);
+  RUN_TEST(test_refill_stops_early_on_predicted_level);
+
+  // Predictive cut-off timer
+  RUN_TEST(test_drain_cutoff_timer_stops_pump_at_projected_time);
+  RUN_TEST(test_refill_cutoff_short_resumes_pump);
   RUN_TEST(test_complete_cycle_restores_canister);
   RUN_TEST(test_state_names);
 
@@ -431,6 +727,12 @@ int main(int argc, char **argv) {
   RUN_TEST(test_uncalibrated_defaults_are_short);
   RUN_TEST(test_is_calibrated_getter);
 
+  // Checkpoint / resume after reset
+  RUN_TEST(test_resume_draining_keeps_targets_and_elapsed);
+  RUN_TEST(test_resume_does_not_dose_prime_twice);
+  RUN_TEST(test_nvs_mirror_resumes_after_power_loss);
+  RUN_TEST(test_finished_cycle_is_not_resumed);
+
   UNITY_END();
   return 0;
 }